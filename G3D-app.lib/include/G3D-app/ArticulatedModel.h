@@ -194,7 +194,8 @@ public:
         enum Type {SCALE, MOVE_CENTER_TO_ORIGIN, MOVE_BASE_TO_ORIGIN, SET_CFRAME, TRANSFORM_CFRAME, 
                    TRANSFORM_GEOMETRY, REMOVE_MESH, REMOVE_PART, SET_MATERIAL, SET_TWO_SIDED, 
                    MERGE_ALL, RENAME_PART, RENAME_MESH, ADD, REVERSE_WINDING, 
-                   COPY_TEXCOORD0_TO_TEXCOORD1, SCALE_AND_OFFSET_TEXCOORD1, SCALE_AND_OFFSET_TEXCOORD0, INTERSECT_BOX};
+                   COPY_TEXCOORD0_TO_TEXCOORD1, SCALE_AND_OFFSET_TEXCOORD1, SCALE_AND_OFFSET_TEXCOORD0, INTERSECT_BOX,
+                   GENERATE_LODS};
 
         /**
           An identifier is one of:
@@ -393,6 +394,12 @@ Example:
                 renameMesh("foo", "bar");
 
                 renameGeometry("base_geom", "floor");
+
+                // Build 4 progressively coarser levels of detail for the mesh, each with
+                // about half as many triangles as the previous one. pose() chooses a level
+                // from the projected size of the mesh. Always runs after cleanGeometry,
+                // wherever it appears in the program.
+                generateLODs("statue", 4, 0.5);
             );
         }
 </pre>
@@ -737,6 +744,10 @@ Example:
 
     private:
 
+        /** CPU skinning buffers handed out by ArticulatedModel::pose. An entry is reused once no
+            UniversalSurface references it, so steady-state posing does not allocate. */
+        Array<shared_ptr<SkinnedCPUVertexArray>> m_skinnedVertexArrayPool;
+
         Geometry(const String& name) : name(name) {}
 
         void copyToGPU(ArticulatedModel* model);
@@ -808,6 +819,29 @@ Example:
         
         int                                     uniqueID = 0;
 
+        /** \brief A simplified version of a Mesh that shares its Geometry.
+            \sa ArticulatedModel::generateLODs, MeshAlg::simplify */
+        class LOD {
+        public:
+            /** Triangle list indexing geometry->cpuVertexArray */
+            Array<int>                              cpuIndexArray;
+
+            /** Estimated maximum object-space distance from the full-resolution surface */
+            float                                   geometricError = 0.0f;
+
+            /** Written by Mesh::copyToGPU */
+            IndexStream                             gpuIndexArray;
+
+            /** Mesh::gpuGeom with gpuIndexArray in place of the full-resolution indices */
+            shared_ptr<UniversalSurface::GPUGeom>   gpuGeom;
+        };
+
+        /** Progressively coarser levels of detail, not including the full-resolution
+            cpuIndexArray. Empty unless built by ArticulatedModel::generateLODs. Cleared
+            when cleanGeometry() renumbers the vertices, but not updated for other changes
+            to cpuIndexArray. */
+        Array<LOD>                              lodArray;
+
         int triangleCount() const {
             alwaysAssertM(primitive == PrimitiveType::TRIANGLES, 
                     "Only implemented for PrimitiveType::TRIANGLES");
@@ -824,6 +858,9 @@ Example:
         /** If you modify cpuIndexArray, invoke this method to force the GPU arrays to update on the next ArticulatedMode::pose() */
         void clearIndexStream();
 
+        /** Number of indices in cpuIndexArray and all lodArray levels */
+        int totalIndexCount() const;
+
         ~Mesh() {}
 
     private:
@@ -1187,6 +1224,24 @@ Example:
     /** The rest pose.*/
     static const Pose& defaultPose();
 
+    /** \brief Wall-clock seconds spent in each phase of loading a model.
+        \sa loadTimes(), createConcurrently() */
+    class LoadTimes {
+    public:
+        /** Parsing the file and creating the Part%s, Mesh%es, and materials */
+        RealTime        import = 0;
+
+        /** Mesh merging, scaling, and Specification::preprocess */
+        RealTime        preprocess = 0;
+
+        /** cleanGeometry(), array compaction, bounds, and levels of detail */
+        RealTime        cleanGeometry = 0;
+
+        RealTime total() const {
+            return import + preprocess + cleanGeometry;
+        }
+    };
+
 protected:       
     
     String                          m_name;
@@ -1218,6 +1273,13 @@ protected:
 
     Specification                   m_sourceSpecification;
 
+    LoadTimes                       m_loadTimes;
+
+    SkinnedCPUVertexArray::Method   m_cpuSkinningMethod = SkinnedCPUVertexArray::Method::LINEAR_BLEND;
+
+    /** Returns an unreferenced SkinnedCPUVertexArray from \a geometry's pool, allocating one if necessary */
+    shared_ptr<SkinnedCPUVertexArray> acquireSkinnedVertexArray(Geometry* geometry);
+
     int getID() {
         ++m_nextID;
         return m_nextID - 1;
@@ -1227,6 +1289,22 @@ protected:
 
     static shared_ptr<ArticulatedModel> loadArticulatedModel(const Specification& specification, const String& n);
 
+    /** Increment whenever the disk cache layout or the result of loading any model changes */
+    static const uint32 DISK_CACHE_VERSION = 4;
+
+    /** Combines the source file's contents with the whole \a specification. 
+        \param specificationText Receives the unparsed specification, which the cache file must match exactly. */
+    static uint64 diskCacheKey(const Specification& specification, String& specificationText);
+
+    static String diskCacheFilename(uint64 key);
+
+    /** Returns null if there is no valid cache file for \a key. \sa setDiskCacheDirectory */
+    static shared_ptr<ArticulatedModel> loadDiskCache(const Specification& specification, const String& specificationText, uint64 key);
+
+    /** Does nothing if this model has animations or a material that was not created from a
+        UniversalMaterial::Specification, since those cannot be reconstructed from the cache. */
+    void saveDiskCache(const String& specificationText, uint64 key) const;
+
     
     /** \brief Execute the program.  Called from load() */
     void preprocess(const Array<Instruction>& program);
@@ -1277,8 +1355,18 @@ protected:
     void loadASSIMP(const Specification& specification);
 #   endif
 
+    /** Invokes beginLoad() and then endLoad() */
     void load(const Specification& specification);
 
+    /** First half of load(): import, mesh merging, and preprocessing. Importers and
+        preprocess instructions create UniversalMaterial%s and Texture%s, so this must
+        run on the thread that owns the OpenGL context. */
+    void beginLoad(const Specification& specification);
+
+    /** Second half of load(): cleanGeometry(), bounds, and generateLODs(). Touches only this model's CPU
+        data, so it may run on any thread concurrently with loads of other models. */
+    void endLoad(const Specification& specification);
+
     ArticulatedModel() : m_nextID(1) {}
 
     Mesh* mesh(const Instruction::Identifier& mesh);
@@ -1314,7 +1402,42 @@ public:
         and erases any CPU TriTrees for optimized intersections.
       */
     void clearGPUArrays();
- 
+
+    /** \brief Replaces the Mesh::lodArray of each identified triangle mesh with up to \a numLevels
+        simplified levels of detail, each with about \a reduction times as many triangles
+        as the previous one. Stops early when simplification can no longer make progress.
+
+        Invoked for the generateLODs preprocess instruction after cleanGeometry(), because
+        vertex merging would invalidate the levels' indices. Once the model has been posed,
+        call this only on the thread that owns the OpenGL context, since it releases the
+        levels' GPU index streams.
+
+        \sa MeshAlg::simplify, LODViewer */
+    void generateLODs(const Instruction::Identifier& meshId, int numLevels, float reduction = 0.5f, const Any& source = Any());
+
+    /** \brief The viewer for which pose() chooses among each Mesh's levels of detail.
+
+        pose() rasterizes the coarsest Mesh::LOD whose geometric error projects to at most
+        maxPixelError pixels at the distance of the Mesh's bounds. The CPU geometry of the
+        posed Surface%s, which feeds TriTree and intersection, is always full resolution.
+
+        pose() reads the viewer from the Scene of its Entity. GApp::onPose sets it from the
+        active camera before posing the scene. \sa Scene::setLODViewer */
+    class LODViewer {
+    public:
+        Point3          wsPosition;
+
+        /** As returned by Projection::imagePlanePixelsPerMeter. Zero (the default) always poses full resolution. */
+        float           imagePlanePixelsPerMeter = 0.0f;
+
+        float           maxPixelError = 1.0f;
+
+        LODViewer() {}
+
+        LODViewer(const Point3& wsPosition, float imagePlanePixelsPerMeter, float maxPixelError = 1.0f) :
+            wsPosition(wsPosition), imagePlanePixelsPerMeter(imagePlanePixelsPerMeter), maxPixelError(maxPixelError) {}
+    };
+
     void pose(Array<shared_ptr<Surface> >&   surfaceArray, 
      const CFrame&                  rootFrame, 
      const CFrame&                  prevFrame, 
@@ -1351,6 +1474,16 @@ public:
     bool usesSkeletalAnimation() const { 
         return m_boneArray.size() > 0;
     }
+
+    /** Blending used when skinned meshes are deformed on the CPU for Surface::getTris and ray tracing.
+        Rasterization always uses linear blending on the GPU. \sa SkinnedCPUVertexArray */
+    void setCPUSkinningMethod(SkinnedCPUVertexArray::Method method) {
+        m_cpuSkinningMethod = method;
+    }
+
+    SkinnedCPUVertexArray::Method cpuSkinningMethod() const {
+        return m_cpuSkinningMethod;
+    }
     
     bool usesAnimation() const {
         return m_animationTable.size() != 0;
@@ -1379,6 +1512,37 @@ public:
     /** \sa G3D::Scene::registerModelSubclass */
     static lazy_ptr<Model> lazyCreate(const String& name, const Any& any);
 
+    /** \brief Directory in which create() stores fully loaded models in a binary format
+        that loads much faster than the source files.
+
+        A cached model is used only if the source file's contents, the entire Specification
+        (including preprocess instructions and CleanGeometrySettings), any OBJ material
+        libraries, and DISK_CACHE_VERSION all match those that produced it. Textures are 
+        stored by reference and loaded from their own files. Models with animations are not cached.
+
+        The default is empty, which disables the disk cache. */
+    static void setDiskCacheDirectory(const String& directory);
+
+    /** \copydoc setDiskCacheDirectory */
+    static const String& diskCacheDirectory();
+
+    /** \brief Loads many models at once, overlapping their geometry processing on up to \a maxConcurrentLoads threads.
+
+        Each model is imported and preprocessed on the calling thread, because that creates
+        GPU resources. Its endLoad() phase then runs on a worker thread while the calling thread
+        imports the next model. Cachable specifications share models with create().
+
+        \param nameArray One name per specification. Empty names default to the filename, as for create().
+        \param maxConcurrentLoads If zero, use one thread per hardware thread
+        \param progress If not null, invoked on the calling thread as each model finishes,
+        with the index of that model and the number of models finished so far. */
+    static void createConcurrently
+       (const Array<Specification>&                         specificationArray,
+        const Array<String>&                                nameArray,
+        Array<shared_ptr<ArticulatedModel>>&                modelArray,
+        int                                                 maxConcurrentLoads = 0,
+        const std::function<void (int index, int numFinished)>& progress = nullptr);
+
     /** From a model filename (e.g., .obj, .fbx) */
     static shared_ptr<ArticulatedModel> fromFile(const String& filename) {
         Specification s;
@@ -1567,6 +1731,11 @@ public:
     const Specification& sourceSpecification() const {
         return m_sourceSpecification;
     }
+
+    /** Time spent in each phase of loading this model from its sourceSpecification() */
+    const LoadTimes& loadTimes() const {
+        return m_loadTimes;
+    }
 };
 
 }  // namespace G3D
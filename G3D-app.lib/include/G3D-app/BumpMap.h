@@ -138,6 +138,10 @@ public:
         m_normalBump->setStorage(s);
     }
 
+    inline void setLoadPriority(float priority) const {
+        m_normalBump->setLoadPriority(priority);
+    }
+
 
 
      /**
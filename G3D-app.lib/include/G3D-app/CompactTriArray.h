@@ -0,0 +1,209 @@
+/**
+  \file G3D-app.lib/include/G3D-app/CompactTriArray.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/Vector2.h"
+#include "G3D-base/Vector3.h"
+#include "G3D-base/AABox.h"
+#include "G3D-base/snorm16.h"
+#include "G3D-base/unorm16.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-gfx/CPUVertexArray.h"
+#include "G3D-app/Tri.h"
+
+namespace G3D {
+
+class Surfel;
+
+/**
+ \brief Quantized storage for a G3D::Tri array and its CPUVertexArray, for
+ ray tracing scenes that are too large to fit in memory at full precision.
+
+ - Tri::data() pointers are replaced by indices into a table of unique data objects
+ - Positions are stored as 16-bit fixed point relative to the bounds of a block
+   of consecutive vertices. Blocks never span two meshes, where a mesh is a run of
+   consecutive vertices that no triangle connects to its neighbors. Surface::getTris
+   emits each mesh's vertices contiguously, so quantization error is relative to the
+   size of each mesh (or of each PAGE_SIZE vertices of a large mesh) rather than to
+   the distance between meshes.
+ - Normals and tangents are octahedral-encoded in 2x16 bits each
+ - Texture coordinates are 16-bit fixed point relative to the block's texture coordinate bounds
+
+ Only CPUVertexArray::Vertex attributes are preserved; texCoord1, vertex colors,
+ bones, and prevPosition are dropped.
+
+ Attributes are decoded on demand for intersection and sampling.
+
+ \sa TriTreeBase::setCompactStorage
+*/
+class CompactTriArray {
+public:
+
+    /** Memory consumption reported by encode() */
+    class Stats {
+    public:
+        int         numTris = 0;
+        int         numVertices = 0;
+
+        /** Tri array and CPUVertexArray, including the optional per-vertex arrays */
+        size_t      uncompressedBytes = 0;
+        size_t      compressedBytes = 0;
+
+        float uncompressedBytesPerTri() const {
+            return (numTris > 0) ? float(uncompressedBytes) / float(numTris) : 0.0f;
+        }
+
+        float compressedBytesPerTri() const {
+            return (numTris > 0) ? float(compressedBytes) / float(numTris) : 0.0f;
+        }
+    };
+
+protected:
+
+    /** Vertices per page. Each page is divided at mesh boundaries into one or more Blocks. */
+    static const int PAGE_SIZE = 1024;
+
+    static const uint32 TWO_SIDED            = 1u << 30;
+    static const uint32 HAS_PARTIAL_COVERAGE = 1u << 31;
+    static const uint32 DATA_INDEX_MASK      = ~(TWO_SIDED | HAS_PARTIAL_COVERAGE);
+    static const uint32 NO_DATA              = DATA_INDEX_MASK;
+
+    /** 20 bytes per Tri, vs. 48 for G3D::Tri */
+    class PackedTri {
+    public:
+        uint32          index[3];
+
+        /** Index into m_dataTable in the low 30 bits, and the Tri flags in the high bits */
+        uint32          dataIndexAndFlags;
+        float           area;
+    };
+
+    /** Flags for PackedVertex */
+    enum {
+        NEGATIVE_HANDEDNESS = 1,
+        NAN_NORMAL          = 2,
+        NAN_TANGENT         = 4,
+
+        /** PackedVertex::flags above this bit hold the index of the vertex's Block within its page */
+        BLOCK_SHIFT         = 3
+    };
+
+    /** 20 bytes per vertex, vs. 48 for CPUVertexArray::Vertex */
+    class PackedVertex {
+    public:
+        unorm16         position[3];
+        uint16          flags;
+        snorm16         normal[2];
+        snorm16         tangent[2];
+        unorm16         texCoord0[2];
+    };
+
+    /** Dequantization parameters for consecutive vertices of one mesh within one page */
+    class Block {
+    public:
+        Point3          positionLow;
+        Vector3         positionScale;
+        Point2          texCoordLow;
+        Vector2         texCoordScale;
+    };
+
+    Array<PackedTri>                            m_tri;
+    Array<PackedVertex>                         m_vertex;
+    Array<Block>                                m_block;
+
+    /** Index into m_block of the first Block of each page */
+    Array<int>                                  m_pageFirstBlock;
+
+    /** Unique Tri::data() values */
+    Array<shared_ptr<ReferenceCountedObject>>   m_dataTable;
+
+    bool                                        m_hasTexCoord0 = true;
+    bool                                        m_hasTangent = true;
+
+    Stats                                       m_stats;
+
+    static void octEncode(const Vector3& v, snorm16 oct[2]);
+    static Vector3 octDecode(const snorm16 oct[2]);
+
+    const Block& block(int vertexIndex) const {
+        return m_block[m_pageFirstBlock[vertexIndex / PAGE_SIZE] + (m_vertex[vertexIndex].flags >> BLOCK_SHIFT)];
+    }
+
+public:
+
+    /** Replaces the current contents */
+    void encode(const Array<Tri>& triArray, const CPUVertexArray& vertexArray);
+
+    void clear();
+
+    int size() const {
+        return m_tri.size();
+    }
+
+    int numVertices() const {
+        return m_vertex.size();
+    }
+
+    const Stats& stats() const {
+        return m_stats;
+    }
+
+    /** Decoded vertex position */
+    Point3 position(int vertexIndex) const {
+        const PackedVertex& v = m_vertex[vertexIndex];
+        const Block& b = block(vertexIndex);
+        return b.positionLow + b.positionScale * Vector3(float(v.position[0].bits()), float(v.position[1].bits()), float(v.position[2].bits()));
+    }
+
+    /** Decoded positions of the vertices of triangle \a triIndex */
+    void getPositions(int triIndex, Point3& v0, Point3& v1, Point3& v2) const {
+        const PackedTri& t = m_tri[triIndex];
+        v0 = position(t.index[0]);
+        v1 = position(t.index[1]);
+        v2 = position(t.index[2]);
+    }
+
+    float area(int triIndex) const {
+        return m_tri[triIndex].area;
+    }
+
+    bool twoSided(int triIndex) const {
+        return (m_tri[triIndex].dataIndexAndFlags & TWO_SIDED) != 0;
+    }
+
+    bool hasPartialCoverage(int triIndex) const {
+        return (m_tri[triIndex].dataIndexAndFlags & HAS_PARTIAL_COVERAGE) != 0;
+    }
+
+    void decodeVertex(int vertexIndex, CPUVertexArray::Vertex& vertex) const;
+
+    /** Returns a Tri whose indices refer to this array's vertices, for use with position() and decodeVertex(). */
+    Tri tri(int triIndex) const;
+
+    /** Decodes the three vertices of \a triIndex into \a vertexArray (which is resized to three elements) and
+        returns a Tri with indices 0, 1, 2 referring to them. This is the form that Tri::sample and
+        Material::sample expect. */
+    Tri decodeTri(int triIndex, CPUVertexArray& vertexArray) const;
+
+    /** \copydoc Tri::intersectionAlphaTest */
+    bool intersectionAlphaTest(int triIndex, float u, float v, float threshold) const;
+
+    /** \copydoc Tri::sample */
+    void sample(float u, float v, int triIndex, bool backface, shared_ptr<Surfel>& surfel, float du = 0, float dv = 0, bool twoSided = true) const;
+
+    /** Bytes currently allocated by this array */
+    size_t sizeInBytes() const;
+
+    /** Bytes used by the equivalent uncompressed representation */
+    static size_t sizeInBytes(const Array<Tri>& triArray, const CPUVertexArray& vertexArray);
+};
+
+} // namespace G3D
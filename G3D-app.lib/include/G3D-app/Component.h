@@ -269,6 +269,11 @@ public:
         }
     }
 
+    /** \sa Texture::setLoadPriority. Does not create the texture. */
+    void setLoadPriority(float priority) const {
+        if (notNull(m_gpuImage)) { m_gpuImage->setLoadPriority(priority); }
+    }
+
 #   undef MyType
 };
 
@@ -413,6 +418,11 @@ public:
         if (notNull(m_map)) { m_map->setStorage(s); }
     }
 
+    /** \sa Texture::setLoadPriority */
+    inline void setLoadPriority(float priority) const {
+        if (notNull(m_map)) { m_map->setLoadPriority(priority); }
+    }
+
     /** Says nothing about the alpha channel */
     inline bool notBlack() const {
         return ! isBlack();
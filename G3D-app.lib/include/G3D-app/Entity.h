@@ -276,6 +276,9 @@ protected:
     /** \copydoc shouldBeSaved */
     bool                            m_shouldBeSaved;
 
+    /** \copydoc concurrentSimulation */
+    bool                            m_concurrentSimulation;
+
     /** Construct an entity, m_framSplineChange defaults to false */
     Entity();
     
@@ -364,6 +367,11 @@ public:
         return m_name;
     }
 
+    /** The Scene that this Entity was created in, or nullptr */
+    Scene* scene() const {
+        return m_scene;
+    }
+
     /**
        True if this Entity should be saved when the scene is converted to Any for saving/serialization.
        Defaults to true.  Set to false for transient objects.  For example, a character's spawn point
@@ -379,6 +387,23 @@ public:
         m_shouldBeSaved = b;
     }
 
+    /**
+       True if Scene::onSimulation may invoke this Entity's onSimulation() on a worker thread, concurrently with
+       other Entity%s that do not depend on it through Scene::setOrder. Defaults to true.
+
+       Subclasses whose onSimulation() inserts or removes Entity%s, calls non-thread-safe libraries, or reads
+       the state of Entity%s other than those it depends on should set this to false, or specify
+       <code>concurrentSimulation = false</code> in the scene file. Those Entity%s are simulated on the calling
+       thread after the concurrent Entity%s of the same dependency level.
+     */
+    bool concurrentSimulation() const {
+        return m_concurrentSimulation;
+    }
+
+    void setConcurrentSimulation(bool b) {
+        m_concurrentSimulation = b;
+    }
+
     /** 
         If there is a controller on this object and it is a SplineTrack,
         mutate it to store this value.  Otherwise, create a new SplineTrack
@@ -507,6 +532,13 @@ public:
         return m_lastChangeTime;
     }
 
+    /** Wall-clock time at which the bounds returned by getLastBounds() were last recomputed.
+        Some Entity subclasses recompute bounds without updating this, so combine it with
+        lastChangeTime() when detecting movement. */
+    RealTime lastBoundsTime() const {
+        return m_lastBoundsTime;
+    }
+
     /** Sets the lastChangeTime() to the current System::time() */
     void markChanged() {
         m_lastChangeTime = System::time();
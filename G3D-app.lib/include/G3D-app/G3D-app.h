@@ -26,6 +26,7 @@
 #include "G3D-app/Light.h"
 #include "G3D-app/GApp.h"
 #include "G3D-app/Surface.h"
+#include "G3D-app/SurfaceCuller.h"
 #include "G3D-app/MD2Model.h"
 #include "G3D-app/MD3Model.h"
 #include "G3D-app/DepthOfFieldSettings.h"
@@ -64,6 +65,7 @@
 #include "G3D-app/GuiTabPane.h"
 #include "G3D-app/FileDialog.h"
 #include "G3D-app/IconSet.h"
+#include "G3D-app/ImageDenoiser.h"
 #include "G3D-app/MotionBlurSettings.h"
 #include "G3D-app/LightingEnvironment.h"
 #include "G3D-app/UprightSplineManipulator.h"
@@ -0,0 +1,75 @@
+/**
+  \file G3D-app.lib/include/G3D-app/ImageDenoiser.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Image.h"
+
+namespace G3D {
+
+/**
+ \brief Multithreaded CPU edge-avoiding &agrave;-trous wavelet filter for path traced images.
+
+ Removes Monte Carlo noise from a radiance image using per-pixel albedo, normal, and depth
+ features of the primary hit, such as those produced by PathTracer::traceImage. Runs entirely
+ on Image data, so it requires no GPU. This is the CPU analog of the edge-aware weights that
+ BilateralFilter applies on the GPU to a GBuffer.
+
+ Radiance is first divided by albedo so that texture detail is not blurred, filtered with a
+ 5x5 B3-spline kernel whose taps are spread by 2<sup>i</sup> pixels on iteration i, and then
+ multiplied by albedo again. Each tap is weighted by the similarity of its color, normal, and depth
+ to the center pixel.
+
+ \cite Dammertz, Sewtz, Hanika, and Lensch, Edge-Avoiding &Agrave;-Trous Wavelet Transform for fast Global Illumination Filtering, HPG 2010
+
+ \sa PathTracer::Options::denoise
+*/
+class ImageDenoiser {
+public:
+
+    class Settings {
+    public:
+        /** Number of &agrave;-trous passes. Pass i reaches 2<sup>i + 1</sup> pixels from the center,
+            so five passes filter over about 125 pixels. Set to zero to disable filtering. Default is 5. */
+        int         iterations = 5;
+
+        /** Tolerance for relative color differences, which is halved on each iteration so that
+            later, wider passes preserve more detail. Larger values blur more. Default is 1. */
+        float       colorSigma = 1.0f;
+
+        /** Exponent on the cosine between normals. Larger values preserve more geometric edges. Default is 64. */
+        float       normalPower = 64.0f;
+
+        /** Tolerance for relative depth differences per pixel of tap distance. Default is 0.02. */
+        float       depthSigma = 0.02f;
+
+        /** If true, divide the radiance by the albedo before filtering so that texture detail is preserved. Default is true. */
+        bool        demodulateAlbedo = true;
+
+        Settings() {}
+    };
+
+    /** Filters \a radiance into \a result, which may be the same image.
+
+        \param albedo Optional (may be null). Reflectivity at the primary hit, used for demodulation.
+        \param normal Optional. World-space normal at the primary hit, or zero where the primary ray missed.
+        \param depth  Optional. Distance to the primary hit, or zero where the primary ray missed.
+
+        All non-null images must have the same dimensions as \a radiance. \a result is
+        created with format RGB32F if it is null or has different dimensions. */
+    static void apply
+       (const shared_ptr<Image>&        radiance,
+        const shared_ptr<Image>&        albedo,
+        const shared_ptr<Image>&        normal,
+        const shared_ptr<Image>&        depth,
+        shared_ptr<Image>&              result,
+        const Settings&                 settings = Settings());
+};
+
+} // namespace G3D
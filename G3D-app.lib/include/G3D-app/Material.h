@@ -47,6 +47,10 @@ public:
     /** Returns true if this material has an alpha value less than \a alphaThreshold at texCoord. */
     virtual bool coverageLessThanEqual(const float alphaThreshold, const Point2& texCoord) const = 0;
     virtual void setStorage(ImageStorage s) const = 0;
+
+    /** Calls Texture::setLoadPriority on the textures of this material that are still loading. The default does nothing. */
+    virtual void setLoadPriority(float priority) const {}
+
     virtual const String& name() const = 0;
     virtual void sample(const Tri& tri, float u, float v, int triIndex, const CPUVertexArray& vertexArray, bool backside, shared_ptr<Surfel>& surfel, float du = 0, float dv = 0, bool twoSided = true) const = 0;
 };
@@ -73,13 +73,18 @@ public:
 
     class Settings {
     public:
-        /*
+        /**
         \param computePrevPosition If true, compute the
         CPUVertexArray::prevPosition array that is then used to
         compute Surfel::prevPosition.  This requires more space in
         memory but allows the reconstruction of motion vectors for
-        post-processed motion blur.  Note that NativeTriTree::intersect only
-        traces against the current time, however. */
+        post-processed motion blur, and enables the intersectRays()
+        overloads that take a time per ray to trace against geometry
+        interpolated between the previous and current poses.
+
+        Moving triangles are bounded over both poses and are never clipped
+        during the build, so trees of fast-moving scenes are somewhat slower
+        to trace. Ignored in compact storage mode, which drops prevPosition. */
         bool               computePrevPosition;
 
         SplitAlgorithm     algorithm;
@@ -110,6 +115,7 @@ public:
         int                accurateSAHCountThreshold;
 
         inline Settings() : 
+            computePrevPosition(false),
             algorithm(MEAN_EXTENT), 
             maxAreaFraction(1.0f / 11.0f), 
             valuesPerLeaf(4),
@@ -149,12 +155,17 @@ private:
     /** A convex polygon formed by repeatedly clipping a Tri with axis-aligned planes */
     class Poly {
     private:
-        /** Pointer into the NativeTriTree::m_triArray */
-        const Tri*             m_source;
+        /** Index into NativeTriTree::m_triArray, or m_compactTriArray in compact mode */
+        int                    m_source;
         Vector3                m_low;
         Vector3                m_high;
         float                  m_area;
 
+        /** True if the source triangle moves between the previous and current poses.
+            The bounds then cover both poses, and the polygon is never clipped because
+            clipping one pose would not bound the other. */
+        bool                   m_moving;
+
         /** Preallocate space for several vertices
             to avoid heap allocation per-poly.*/
         SmallArray<Vector3, 4> m_vertex;
@@ -183,10 +194,13 @@ private:
 
         Poly();
 
-        Poly(const CPUVertexArray& vertexArray, const Tri* t);
+        Poly(const Point3& v0, const Point3& v1, const Point3& v2, float area, int source);
 
-        /** Original triangle from which this was created */
-        inline const Tri* source() const {
+        /** A triangle that moves from \a p0, \a p1, \a p2 at time 0 to \a v0, \a v1, \a v2 at time 1 */
+        Poly(const Point3& v0, const Point3& v1, const Point3& v2, const Point3& p0, const Point3& p1, const Point3& p2, float area, int source);
+
+        /** Index of the original triangle from which this was created */
+        inline int source() const {
             return m_source;
         }
 
@@ -216,7 +230,8 @@ private:
             then this is added to largeSpanArray instead.  Choose
             minSpanArea = inf() to prevent this case from ever arising.
             Choose minSpanArea = 0 to force all spanning polys to fall into
-            largeSpanArray.        
+            largeSpanArray. Moving polys that span the plane always fall into
+            largeSpanArray.
         */
         void split
         (Vector3::Axis axis,
@@ -255,7 +270,8 @@ private:
 
     /** Does not have to be deleted; has no constructor. */
     struct ValueArray {
-        /** Pointers into the NativeTriTree's 
+        /** Indices into the NativeTriTree's m_triArray, or m_compactTriArray
+            in compact mode.
 
             Each Tri may extend out of the Node's bounds, because it has been
             split. That does not affect performance because the time
@@ -263,7 +279,7 @@ private:
             of the Tri, and by proceeding in splitting-plane order
             the probability dependent on the area outside the
             bounds is zero. */
-        const Tri**      data;
+        int*             data;
 
         int              size;
 
@@ -408,9 +424,19 @@ private:
 
     public:
 
+        /** Empty leaf, for deserialize() */
+        Node() : splitLocation(0), packedChildAxis(0), valueArray(nullptr) {}
+
         Node(Array<Poly>& originals, const Settings& settings, 
              const shared_ptr<MemoryManager>& mm);
 
+        /** Writes this node and its subtree in depth-first order */
+        void serialize(class BinaryOutput& b) const;
+
+        /** Reads a subtree written by serialize(), allocating children and value arrays from \a mm.
+            Returns false if the data is inconsistent with \a numTris. */
+        bool deserialize(class BinaryInput& b, int numTris, const shared_ptr<MemoryManager>& mm);
+
         /** Call in lieu of delete to remove children.  Caller must
             free the Node itself.*/
         void destroy(const shared_ptr<MemoryManager>& mm);
@@ -423,16 +449,18 @@ private:
             \param alreadyAdded Since nodes do not have unique ownership of triangles, this set is needed
             to avoid adding duplicates to the triArray.
           */  
-        void intersectBox(const AABox& box, const CPUVertexArray& vertexArray, Array<Tri>& triArray, Set<Tri*>& alreadyAdded) const;
-        void intersectSphere(const Sphere& sphere, const CPUVertexArray& vertexArray, Array<Tri>& triArray, Set<Tri*>& alreadyAdded) const;
+        void intersectBox(const NativeTriTree& triTree, const AABox& box, Array<Tri>& triArray, Set<int>& alreadyAdded) const;
+        void intersectSphere(const NativeTriTree& triTree, const Sphere& sphere, Array<Tri>& triArray, Set<int>& alreadyAdded) const;
 
         void print(const String& indent) const;
 
         void getStats(Stats& s, int level, int valuesPerNode) const;
 
+        /** \param time Interpolation parameter between the previous (0) and current (1) poses */
         bool intersectRay
         (const NativeTriTree&               triTree,
          const PrecomputedRay&              ray,
+         float                              time,
          float                              maxDistance,
          Hit&                               hit,
          IntersectRayOptions                options) const;
@@ -443,6 +471,70 @@ private:
 
     /** Allocated with m_memoryManager */
     Node*                m_root;
+
+    Settings             m_settings;
+
+    /** Increment when the cache file layout or the build algorithm changes */
+    static const uint32  CACHE_VERSION = 2;
+
+    /** Hash of the triangle positions and m_settings, which determine the tree */
+    uint64 cacheKey() const;
+
+    String cacheFilename(uint64 key) const;
+
+    /** Replaces m_root with the cached tree for \a key. Returns false if there is no valid cache entry. */
+    bool loadCache(uint64 key);
+
+    void saveCache(uint64 key) const;
+
+    // Triangle accessors that read m_compactTriArray when it is in use, and m_triArray otherwise
+
+    bool compact() const {
+        return m_compactTriArray.size() > 0;
+    }
+
+    int numTris() const {
+        return compact() ? m_compactTriArray.size() : m_triArray.size();
+    }
+
+    void getTriPositions(int t, Point3& v0, Point3& v1, Point3& v2) const {
+        if (compact()) {
+            m_compactTriArray.getPositions(t, v0, v1, v2);
+        } else {
+            const Tri& tri = m_triArray[t];
+            v0 = tri.position(m_vertexArray, 0);
+            v1 = tri.position(m_vertexArray, 1);
+            v2 = tri.position(m_vertexArray, 2);
+        }
+    }
+
+    /** Positions at \a time, linearly interpolated from CPUVertexArray::prevPosition at time 0 */
+    void getTriPositions(int t, float time, Point3& v0, Point3& v1, Point3& v2) const {
+        getTriPositions(t, v0, v1, v2);
+        if ((time < 1.0f) && hasMotion() && ! compact()) {
+            const Tri& tri = m_triArray[t];
+            const Point3* prev = m_vertexArray.prevPosition.getCArray();
+            v0 = prev[tri.index[0]].lerp(v0, time);
+            v1 = prev[tri.index[1]].lerp(v1, time);
+            v2 = prev[tri.index[2]].lerp(v2, time);
+        }
+    }
+
+    float triArea(int t) const {
+        return compact() ? m_compactTriArray.area(t) : m_triArray[t].area();
+    }
+
+    bool triTwoSided(int t) const {
+        return compact() ? m_compactTriArray.twoSided(t) : m_triArray[t].twoSided();
+    }
+
+    bool triIntersectionAlphaTest(int t, float u, float v, float threshold) const {
+        return compact() ? m_compactTriArray.intersectionAlphaTest(t, u, v, threshold) : m_triArray[t].intersectionAlphaTest(m_vertexArray, u, v, threshold);
+    }
+
+    Tri tri(int t) const {
+        return compact() ? m_compactTriArray.tri(t) : m_triArray[t];
+    }
     
 public:
 
@@ -456,6 +548,33 @@ public:
 
     virtual const String& className() const override { static const String n = "NativeTriTree"; return n; }
 
+    /** Traverses quantized positions and decodes attributes on demand in compact mode */
+    virtual bool supportsCompactStorage() const override {
+        return true;
+    }
+
+    virtual bool supportsCache() const override {
+        return true;
+    }
+
+    /** Requires Settings::computePrevPosition */
+    virtual bool supportsMotion() const override {
+        return true;
+    }
+
+    virtual bool computePrevPosition() const override {
+        return m_settings.computePrevPosition && ! m_compactStorage;
+    }
+
+    /** Takes effect on the next rebuild() */
+    void setSettings(const Settings& settings) {
+        m_settings = settings;
+    }
+
+    const Settings& settings() const {
+        return m_settings;
+    }
+
     virtual void clear() override;
 
     /** Walk the entire tree, computing statistics */
@@ -486,6 +605,12 @@ public:
         Array<Hit>&                         results,
         IntersectRayOptions                 options         = IntersectRayOptions(0)) const;
 
+    virtual void intersectRays
+       (const Array<Ray>&                   rays,
+        const Array<float>&                 rayTime,
+        Array<Hit>&                         results,
+        IntersectRayOptions                 options         = IntersectRayOptions(0)) const override;
+
     shared_ptr<Surfel> intersectRay
        (const PrecomputedRay&               ray, 
         IntersectRayOptions                 options,
@@ -497,6 +622,13 @@ public:
          Hit&                               hit,
          IntersectRayOptions                options         = IntersectRayOptions(0)) const;
 
+    /** \param time In [0, 1], between the previous and current poses. \sa Settings::computePrevPosition */
+    bool intersectRay
+        (const PrecomputedRay&              ray,
+         float                              time,
+         Hit&                               hit,
+         IntersectRayOptions                options         = IntersectRayOptions(0)) const;
+
     /** Render the tree for debugging and visualization purposes. 
         Inefficent.
 
@@ -13,7 +13,9 @@
 #include "G3D-base/ReferenceCount.h"
 #include "G3D-base/Array.h"
 #include "G3D-base/Ray.h"
+#include "G3D-base/Rect2D.h"
 #include "G3D-app/TriTree.h"
+#include "G3D-app/ImageDenoiser.h"
 
 namespace G3D {
 
@@ -67,6 +69,23 @@ public:
             */
         float       areaLightDirectFraction = 0.7f;
 
+        /** If true, each path is traced at a uniformly random time in the shutter interval between
+            the previous and current poses of the Scene's entities, producing motion blur
+            without rebuilding the TriTree per sub-frame. Camera motion is not blurred.
+            
+            Requires a TriTree that TriTreeBase::supportsMotion() without compact storage. If
+            triTree() is any other tree, including the default EmbreeTriTree, prepare() replaces it
+            with a NativeTriTree. For NativeTriTree, this enables NativeTriTree::Settings::computePrevPosition
+            and rebuilds the tree if needed. Default = false. */
+        bool        motionBlur = false;
+
+        /** If true, traceImage() filters the result with ImageDenoiser using the primary-hit
+            albedo, normal, and depth, so that previews at a few rays per pixel are smooth.
+            Default = false. */
+        bool        denoise = false;
+
+        ImageDenoiser::Settings denoiserSettings;
+
         G3D_DECLARE_ENUM_CLASS(LightSamplingMethod,
             UNIFORM_AREA,
             STRATIFIED_AREA,
@@ -84,6 +103,87 @@ public:
         {}
     };
 
+    /** Controls for traceImageProgressive(). The image is divided into square tiles that are
+        refined over successive passes. Each pass spends samples on a tile in proportion to how
+        far its estimated error is from the target, and tiles stop receiving samples once they
+        have converged.
+
+        The PathTracer::Options::raysPerPixel value is ignored in progressive mode. */
+    class ProgressiveOptions {
+    public:
+        /** Width and height of a tile in pixels */
+        int         tileSize = 32;
+
+        /** Samples per pixel taken on the first pass, before any variance estimate is trusted. */
+        int         minSamplesPerPixel = 8;
+
+        /** A tile is considered converged when every pixel reaches this many samples,
+            even if it has not reached targetRelativeError. */
+        int         maxSamplesPerPixel = 1024;
+
+        /** Upper bound on the samples per pixel that any single tile receives in one pass after the first.
+            Smaller values stream preview images more often. */
+        int         maxSamplesPerPass = 16;
+
+        /** Estimated relative standard error of the mean pixel luminance at which a tile 
+            has converged. Averaged over the pixels of the tile. */
+        float       targetRelativeError = 0.02f;
+
+        /** Maximum number of passes. Rendering stops early if all tiles converge. */
+        int         maxPasses = 1000;
+
+        ProgressiveOptions()
+#       ifdef G3D_DEBUG
+            : minSamplesPerPixel(1),
+            maxSamplesPerPixel(8)
+#       endif
+        {}
+    };
+
+    /** Reported after each pass of traceImageProgressive() */
+    class ProgressiveStats {
+    public:
+        /** Index of the pass that just completed, starting from 0 */
+        int         pass = 0;
+
+        int         numTiles = 0;
+
+        /** Tiles that still require samples after this pass */
+        int         activeTiles = 0;
+
+        /** Total samples taken over all pixels and passes so far */
+        int64       totalSamples = 0;
+
+        /** Mean over all pixels of the number of samples taken so far */
+        float       averageSamplesPerPixel = 0.0f;
+
+        /** Largest estimated relative error over all unconverged tiles */
+        float       maxTileError = 0.0f;
+    };
+
+    /** Optional per-pixel features of the primary hit ("arbitrary output variables") written by traceImage().
+        Each image may be null, and non-null images must have the dimensions of the radiance image.
+        Like radiance, the features are averaged over all rays that contribute to each pixel. */
+    class AOVImages {
+    public:
+        /** RGB32F. Lambertian plus glossy reflectivity, or one where the primary ray missed. */
+        shared_ptr<Image>       albedo;
+
+        /** RGB32F. World-space shading normal, or zero where the primary ray missed. */
+        shared_ptr<Image>       normal;
+
+        /** R32F. Distance from the eye to the primary hit, or zero where the primary ray missed. */
+        shared_ptr<Image>       depth;
+
+        bool empty() const {
+            return isNull(albedo) && isNull(normal) && isNull(depth);
+        }
+    };
+
+    /** Invoked after each progressive pass with the current estimate in the radiance image.
+        Return false to stop rendering early. */
+    typedef std::function<bool(const shared_ptr<Image>& radianceImage, const ProgressiveStats& stats)> PassCallback;
+
 protected:
     typedef Point2                              PixelCoord;
 
@@ -125,11 +225,14 @@ protected:
         /** Location in the output image to write the final radiance to.*/
         Array<PixelCoord>                       outputCoord;
 
+        /** Shutter time in [0, 1] of each path. Empty unless Options::motionBlur is enabled. */
+        Array<float>                            time;
+
         size_t size() const {
             return ray.size();
         }
 
-        /** Does not resize outputIndex or outputCoord */
+        /** Does not resize outputIndex, outputCoord, or time */
         void resize(size_t n) {
             ray.resize(n);
             modulation.resize(n);
@@ -140,7 +243,7 @@ protected:
             impulseRay.resize(n);
         }
 
-        /** Removes element \a i from all arrays, including either outputIndex or outputCoord. */
+        /** Removes element \a i from all arrays, including outputIndex and outputCoord if they are in use. */
         void fastRemove(int i) {
             ray.fastRemove(i);
             modulation.fastRemove(i);
@@ -152,9 +255,15 @@ protected:
 
             if (outputIndex.size() > 0) {
                 outputIndex.fastRemove(i);
-            } else {
+            }
+
+            if (outputCoord.size() > 0) {
                 outputCoord.fastRemove(i);
             }
+
+            if (time.size() > 0) {
+                time.fastRemove(i);
+            }
         }
     };
 
@@ -187,6 +296,17 @@ protected:
     */
     Point3 sampleOneLight(const shared_ptr<Light>& light, const Point3& X, const Vector3& n, int pixelIndex, int lightIndex, int sampleIndex, int numSamples, float& areaTimesPDFValue) const;
 
+    /** Eye ray through \a P in pixel coordinates, sampling the lens for physical depth of field when
+        \a depthOfField is true. Shared by generateEyeRays and traceImageProgressive. */
+    Ray eyeRay
+       (const shared_ptr<Camera>&               camera,
+        const Rect2D&                           viewport,
+        const Point2int32&                      pixel,
+        const Point2&                           P,
+        bool                                    depthOfField,
+        int                                     rayIndex,
+        int                                     raysPerPixel) const;
+
     /** Produces a buffer of eye rays, stored in raster order in the preallocated rayBuffer. 
         \param castThroughCenter When true (for the first ray at each pixel), cast the ray through
                the pixel center to make images look less noisy.
@@ -298,6 +418,9 @@ protected:
 
         If \a distance is not null, the distance to each primary
         hit is written to it (not the "Z" value).
+
+        If \a aovImages is not null, the features of each primary hit are
+        bilinearly blended into its images. Requires a radianceImage.
      */
     virtual void traceBufferInternal
        (BufferSet&                              buffers, 
@@ -306,7 +429,8 @@ protected:
         float*                                  distance,
         const Array<shared_ptr<Light>>&         directLightArray,
         const Array<shared_ptr<Light>>&         indirectLightArray,
-        int                                     currentRayIndex) const;
+        int                                     currentRayIndex,
+        const AOVImages*                        aovImages = nullptr) const;
 
 public:
 
@@ -333,6 +457,29 @@ public:
       */
     void traceImage(const shared_ptr<Image>& radianceImage, const shared_ptr<Camera>& camera, const Options& options, const std::function<void(const String&, float)>& statusCallback = nullptr) const;
 
+    /** Also writes the primary-hit features to the non-null images of \a aovImages, which
+        are overwritten. When Options::denoise is enabled, the denoiser uses these features,
+        computing any that are null internally. */
+    void traceImage(const shared_ptr<Image>& radianceImage, const AOVImages& aovImages, const shared_ptr<Camera>& camera, const Options& options, const std::function<void(const String&, float)>& statusCallback = nullptr) const;
+
+    /** Adaptive, tile-based alternative to traceImage(). Renders in passes, keeping a per-pixel
+        estimate of the variance of luminance, and directs more samples to tiles with high estimated
+        error. Tiles whose error falls below ProgressiveOptions::targetRelativeError stop receiving samples.
+
+        Each pixel is box filtered (samples are not splatted to neighbors as in traceImage), so that
+        the per-pixel statistics are independent.
+
+        \param passCallback If not null, invoked on the calling thread after every pass with
+        the current normalized estimate in \a radianceImage, which can be used to stream previews.
+
+        \return Statistics for the final pass. */
+    ProgressiveStats traceImageProgressive
+       (const shared_ptr<Image>&                radianceImage,
+        const shared_ptr<Camera>&               camera,
+        const Options&                          options,
+        const ProgressiveOptions&               progressiveOptions = ProgressiveOptions(),
+        const PassCallback&                     passCallback = nullptr) const;
+
     /** 
      \param output Must be allocated to at least the size of rayBuffer. This may be uncached, memory mapped memory.
      \param weight if not null, each output is scaled by the corresponding weight. 
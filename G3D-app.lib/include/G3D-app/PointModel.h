@@ -15,6 +15,7 @@
 
 namespace G3D {
 class PointSurface;
+class MemoryMappedFile;
 
 /**
   \sa PointSurface 
@@ -107,7 +108,10 @@ protected:
     Array<shared_ptr<PointArray>> m_pointArrayArray;
 
     void load(const Specification& spec);
+    /** Binary PLY files are streamed through ParsePLY. ASCII files are assumed to be in the format
+        of a particular laser scanner that places the scan coordinates before each point. */
     void loadPLY(const Specification& spec);
+    void loadBinaryPLY(const Specification& spec, const shared_ptr<MemoryMappedFile>& file);
     void loadXYZ(const Specification& spec);
     void loadVOX(const Specification& spec);
 
@@ -25,6 +25,7 @@ class SceneVisualizationSettings;
 class RenderPassType;
 class Rect2D;
 class TriTree;
+class SurfaceCuller;
 
 /** \brief Base class for 3D rendering pipelines. 
     \sa GApp::onGraphics3D */
@@ -44,6 +45,12 @@ protected:
     
     /** For VR. Default is false. */
     bool                        m_diskFramebuffer = false;
+
+    /** Texture::setLoadPriority that cullAndSort() assigns to the textures of visible surfaces */
+    static constexpr float      VISIBLE_TEXTURE_LOAD_PRIORITY = 1.0f;
+
+    /** Frustum and occlusion culling for cullAndSort(). Created on first use. */
+    shared_ptr<SurfaceCuller>   m_surfaceCuller;
     
     /**
      \brief Appends to \a sortedVisibleSurfaces and \a forwardSurfaces.
@@ -113,6 +120,11 @@ public:
         return m_diskFramebuffer;
     }
 
+    /** The culler used by cullAndSort(). Change its SurfaceCuller::settings() to
+        enable occlusion culling, and read its SurfaceCuller::stats() for the number of
+        surfaces rejected by each stage in the most recent frame. */
+    const shared_ptr<SurfaceCuller>& surfaceCuller();
+
     virtual const String& className() const = 0;
 
     /** 
@@ -15,6 +15,7 @@
 #include "G3D-base/Array.h"
 #include "G3D-base/SmallArray.h"
 #include "G3D-base/lazy_ptr.h"
+#include "G3D-base/DynamicAABBTree.h"
 #include "G3D-app/LightingEnvironment.h"
 #include "G3D-app/ArticulatedModel.h"
 #include "G3D-app/TriTree.h"
@@ -81,7 +82,21 @@ public:
         /** Remove VisibleEntitys for which canChange = false. Default = false */
         bool        stripDynamicVisibleEntitys;
 
-        LoadOptions() : stripStaticVisibleEntitys(false), stripDynamicVisibleEntitys(false) {}
+        /** If true, Scene::load first collects every ArticulatedModel that an Entity references
+            and loads them all with ArticulatedModel::createConcurrently before creating any Entity,
+            instead of loading each model on demand as Entitys are created. The time spent
+            in each phase of loading each model is written to the log. Default = false */
+        bool        prefetchModels;
+
+        /** Maximum number of models processed concurrently when prefetchModels is true.
+            Zero means one per hardware thread. Default = 0 */
+        int         maxConcurrentModelLoads;
+
+        /** If not null and prefetchModels is true, invoked on the loading thread
+            as each model finishes, e.g., to update a progress bar. */
+        std::function<void (const String& modelName, int numLoaded, int numModels)> modelLoadCallback;
+
+        LoadOptions() : stripStaticVisibleEntitys(false), stripDynamicVisibleEntitys(false), prefetchModels(false), maxConcurrentModelLoads(0) {}
     };
 
     /** \sa registerEntityType */
@@ -92,11 +107,30 @@ public:
 
     const shared_ptr<TriTree>& tritree();
 
+    /** If non-empty, tritree() loads previously built acceleration structures from this directory
+        instead of rebuilding them when the scene geometry has not changed, and saves new ones there.
+
+        Only NativeTriTree supports the cache, so while this is non-empty tritree() uses a NativeTriTree
+        instead of the default TriTree::create() implementation (usually EmbreeTriTree), which may
+        trace more slowly. Cached trees are read and deserialized, not memory-mapped, so loading still
+        costs time and memory proportional to the tree size.
+        Default is empty (disabled). \sa TriTreeBase::setCacheDirectory */
+    void setTriTreeCacheDirectory(const String& directory) {
+        m_triTreeCacheDirectory = directory;
+    }
+
+    const String& triTreeCacheDirectory() const {
+        return m_triTreeCacheDirectory;
+    }
+
 protected:
 
     // BVH used for ray tracing.
     shared_ptr<TriTree>                 m_triTree;
 
+    /** \sa setTriTreeCacheDirectory */
+    String                              m_triTreeCacheDirectory;
+
     enum VisitorState {NOT_VISITED, VISITING, ALREADY_VISITED};
 
     // We expect one dependency per object maximum, but it is cheap to allocate two
@@ -116,6 +150,28 @@ protected:
     /** When true, the m_entityArray needs to be re-sorted based on dependencies before iterating. */
     bool                                m_needEntitySort;
 
+    /** An Entity in m_simulationArray */
+    class SimulationEntry {
+    public:
+        shared_ptr<Entity>              entity;
+
+        /** EntityTypeBits */
+        uint32                          typeBits = 0;
+    };
+
+    /** All Entitys, grouped by dependency level. Entitys in level i depend only on Entitys
+        in levels less than i, so each level may be simulated concurrently. Level i occupies
+        m_simulationArray[m_simulationLevelStart[i]] through m_simulationArray[m_simulationLevelStart[i + 1] - 1].
+        \sa updateSimulationLevels */
+    Array<SimulationEntry>              m_simulationArray;
+    Array<int>                          m_simulationLevelStart;
+
+    /** When true, m_simulationArray must be rebuilt before simulating */
+    bool                                m_needSimulationLevels;
+
+    /** \copydoc setConcurrentSimulation */
+    bool                                m_concurrentSimulation;
+
     String                              m_name;
 
     /** The Any from which this scene was constructed. */
@@ -132,6 +188,31 @@ protected:
     /** All Entitys, including Cameras, Lights, and MarkerEntitys */
     Array< shared_ptr<Entity> >         m_entityArray;
 
+    typedef DynamicAABBTree< shared_ptr<Entity> > EntityTree;
+
+    /** Location of an Entity in m_entityTree */
+    class EntityTreeEntry {
+    public:
+        /** EntityTree::NONE if the Entity has empty bounds */
+        EntityTree::Handle              handle = EntityTree::NONE;
+
+        /** EntityTypeBits, computed once on insertion */
+        uint32                          typeBits = 0;
+    };
+
+    /** World-space bounds of all Entitys with non-empty bounds, for intersect(), intersectBounds(),
+        and the other spatial queries. Updated by onPose() from Entity::lastChangeTime() and Entity::lastBoundsTime(). */
+    EntityTree                          m_entityTree;
+
+    Table<const Entity*, EntityTreeEntry> m_entityTreeTable;
+
+    /** Entitys that are not in m_entityTree because their bounds are empty. Ray queries still
+        test these, since a subclass may override Entity::intersect() without providing bounds. */
+    Array< shared_ptr<Entity> >         m_unboundedEntityArray;
+
+    /** System::time() at the start of the last updateEntityTree() */
+    RealTime                            m_lastEntityTreeUpdateTime;
+
     Array< shared_ptr<Camera> >         m_cameraArray;
 
     shared_ptr<Skybox>                  m_skybox;
@@ -160,15 +241,32 @@ protected:
 
     VRSettings                          m_vrSettings;
 
+    ArticulatedModel::LODViewer         m_lodViewer;
+
     String                              m_description;
 
     Scene(const shared_ptr<AmbientOcclusion>& ambientOcclusion);
 
     const shared_ptr<Entity> _entity(const String& name) const;
      
+    /** Moves the tree leaf for \a entity to its current bounds, inserting or removing it as its bounds
+        become non-empty or empty */
+    void updateEntityTreeEntry(const shared_ptr<Entity>& entity, EntityTreeEntry& entry);
+
+    /** Updates m_entityTree for all Entitys that have changed since the last call. Called from onPose */
+    void updateEntityTree();
+
+    /** Calls \a test on the Entitys with any of the \a typeBits whose tree bounds cannot be used to cull a ray:
+        those in m_unboundedEntityArray and those that changed since the last updateEntityTree(). */
+    template<class Test>
+    void testEntitiesOutsideTree(uint32 typeBits, float& distance, const Test& test) const;
+
     /** If m_needEntitySort, sort Entitys to resolve dependencies and set m_needEntitySort = false. Called fromOnSimulation */
     void sortEntitiesByDependency();
 
+    /** If m_needSimulationLevels, partition the sorted m_entityArray into m_simulationArray. Called from onSimulation */
+    void updateSimulationLevels();
+
 public:
 
     const VRSettings& vrSettings() const {
@@ -188,6 +286,10 @@ public:
     /** Adds the model to the model table and returns it. */
     virtual lazy_ptr<Model> createModel(const Any& v, const String& name);
 
+    /** Invoked by load() when LoadOptions::prefetchModels is set. Resolves the ArticulatedModel%s
+        in the model table that the entity sections of \a sceneAny reference, concurrently. */
+    void prefetchModels(const Any& sceneAny, const LoadOptions& options);
+
     const ModelTable& modelTable() const {
         return m_modelTable;
     }
@@ -311,8 +413,40 @@ public:
     */
     virtual Any load(const String& sceneName, const LoadOptions& loadOptions = LoadOptions());
 
+    /** Bits identifying Entity subclasses, for filtering the spatial queries such as intersect() and getEntitiesInBox().
+        An Entity may have several bits; for example, a Light also has VISIBLE_ENTITY_BIT. Combine with bitwise OR. */
+    enum EntityTypeBits : uint32 {
+        VISIBLE_ENTITY_BIT  = 1,
+        LIGHT_BIT           = 2,
+        CAMERA_BIT          = 4,
+        MARKER_ENTITY_BIT   = 8,
+        SKYBOX_BIT          = 16,
+
+        /** Entitys that are none of the above */
+        OTHER_ENTITY_BIT    = 0x80000000,
+
+        ALL_ENTITY_BITS     = 0xFFFFFFFF
+    };
+
+    /** Computes the EntityTypeBits for \a entity. Scene caches these for the Entitys that it contains. */
+    static uint32 entityTypeBits(const shared_ptr<Entity>& entity);
+
+    /** The union of the bounds of all visible VisibleEntity%s that have models, as of the last onPose() */
     void getVisibleBounds(AABox& box) const;
 
+    /** Appends the Entity%s whose world-space AABox bounds intersect \a box and that have any of
+        the \a typeBits, using bounds as of the last onPose(). Runs in O(log n) time for small boxes.
+        \sa EntityTypeBits */
+    void getEntitiesInBox(const AABox& box, Array<shared_ptr<Entity> >& array, uint32 typeBits = ALL_ENTITY_BITS) const;
+
+    /** Appends the Entity%s whose world-space AABox bounds intersect \a sphere. \sa getEntitiesInBox */
+    void getEntitiesInSphere(const Sphere& sphere, Array<shared_ptr<Entity> >& array, uint32 typeBits = ALL_ENTITY_BITS) const;
+
+    /** Appends the (up to) \a k Entity%s whose world-space AABox bounds are closest to \a point,
+        nearest first. Entitys whose bounds contain the point are at distance zero.
+        \sa getEntitiesInBox */
+    void getNearestEntities(const Point3& point, int k, Array<shared_ptr<Entity> >& array, uint32 typeBits = ALL_ENTITY_BITS, float maxDistance = finf()) const;
+
     /** Returns the default camera, set by defaultCamera = "name" in the Scene file. */
     const shared_ptr<Camera> defaultCamera() const;
 
@@ -333,8 +467,31 @@ public:
 
     virtual void onPose(Array<shared_ptr<Surface> >& surfaceArray);
 
+    /** Simulates all Entity%s in dependency order (see setOrder). Entity%s that do not depend on each other
+        are simulated concurrently unless concurrentSimulation() is false or Entity::concurrentSimulation()
+        is false for them. */
     virtual void onSimulation(SimTime deltaTime);
 
+    /** If true (the default), onSimulation() simulates independent Entity%s on multiple threads. The result is
+        identical either way for Entity%s that only depend on others through setOrder() and Entity::Track. */
+    void setConcurrentSimulation(bool b) {
+        m_concurrentSimulation = b;
+    }
+
+    bool concurrentSimulation() const {
+        return m_concurrentSimulation;
+    }
+
+    /** Sets the viewer from which ArticulatedModel::pose() chooses the levels of detail of this Scene's
+        Entity%s. GApp::onPose sets it from the active camera. \sa ArticulatedModel::LODViewer */
+    void setLODViewer(const ArticulatedModel::LODViewer& viewer) {
+        m_lodViewer = viewer;
+    }
+
+    const ArticulatedModel::LODViewer& lodViewer() const {
+        return m_lodViewer;
+    }
+
     const LightingEnvironment & lightingEnvironment() const {
         return m_localLightingEnvironment;
     }
@@ -0,0 +1,101 @@
+/**
+  \file G3D-app.lib/include/G3D-app/SkinnedCPUVertexArray.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/CoordinateFrame.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-base/enumclass.h"
+#include "G3D-gfx/CPUVertexArray.h"
+
+namespace G3D {
+
+/**
+ \brief Bone-deformed copy of a bind-pose CPUVertexArray, computed on the CPU.
+
+ The GPU deforms skinned meshes in the vertex shader, so the bind-pose CPUVertexArray
+ that UniversalSurface::CPUGeom references does not match what is rendered.
+ ArticulatedModel::pose attaches one of these to the CPUGeom of every skinned mesh so that
+ Surface::getTris, TriTree, and PathTracer see the animated geometry.
+
+ Skinning is deferred until vertexArray() is first invoked, so programs that only rasterize
+ do not pay for it. The result is stored in a buffer that ArticulatedModel reuses on
+ subsequent poses, and the vertex count and order always match the bind pose, so a TriTree
+ built from one pose can be refit to the next.
+
+ \sa ArticulatedModel::setCPUSkinningMethod
+*/
+class SkinnedCPUVertexArray : public ReferenceCountedObject {
+public:
+
+    /** LINEAR_BLEND matches the GPU vertex shader exactly. DUAL_QUATERNION avoids the "candy wrapper"
+        volume loss at twisting joints but ignores any scale in the bone transformations. */
+    G3D_DECLARE_ENUM_CLASS(Method, LINEAR_BLEND, DUAL_QUATERNION);
+
+protected:
+
+    const CPUVertexArray*   m_bindPose = nullptr;
+
+    /** Object space bone transformations, indexed by CPUVertexArray::boneIndices */
+    Array<CFrame>           m_boneFrame;
+    Array<CFrame>           m_prevBoneFrame;
+
+    Method                  m_method = Method::LINEAR_BLEND;
+
+    std::mutex              m_mutex;
+
+    /** True when m_vertexArray and m_prevPosition are up to date with the bones */
+    std::atomic<bool>       m_posed;
+
+    CPUVertexArray          m_vertexArray;
+
+    /** Object-space positions under m_prevBoneFrame */
+    Array<Point3>           m_prevPosition;
+
+    SkinnedCPUVertexArray() : m_posed(false) {}
+
+    void skin();
+
+public:
+
+    static shared_ptr<SkinnedCPUVertexArray> create() {
+        return createShared<SkinnedCPUVertexArray>();
+    }
+
+    /** Invalidates the current contents. Skinning is performed lazily by vertexArray().
+        \a bindPose must remain valid until the next setPose() call. */
+    void setPose(const CPUVertexArray* bindPose, const Array<CFrame>& boneFrame, const Array<CFrame>& prevBoneFrame, Method method = Method::LINEAR_BLEND);
+
+    const CPUVertexArray* bindPose() const {
+        return m_bindPose;
+    }
+
+    /** The posed vertices in object space. Bone indices and weights are not copied.
+        Threadsafe; skins on the first call after setPose(). */
+    const CPUVertexArray& vertexArray();
+
+    /** Object-space positions under the previous frame's bones, parallel to vertexArray().vertex */
+    const Array<Point3>& prevPosition();
+
+    /** Linear-blend or dual-quaternion skins the positions, normals, and tangents of \a bindPose into
+        \a result, reusing its storage. If \a prevBoneFrame and \a prevPosition are not null, also
+        computes the positions under the previous bone transformations. Multithreaded. */
+    static void skin
+       (const CPUVertexArray&   bindPose,
+        const Array<CFrame>&    boneFrame,
+        Method                  method,
+        CPUVertexArray&         result,
+        const Array<CFrame>*    prevBoneFrame = nullptr,
+        Array<Point3>*          prevPosition = nullptr);
+};
+
+} // namespace G3D
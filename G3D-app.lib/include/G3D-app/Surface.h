@@ -241,6 +241,21 @@ public:
         Array<Point2>&               texCoord,
         bool                         previous = false) const {}
 
+    /** \brief Clears the arrays and, if this surface is opaque, sets them to an indexed
+        triangle list that it completely covers, for use as a software occluder by SurfaceCuller.
+
+        Returns false if the surface cannot occlude (e.g., it has transparency or no CPU geometry)
+        or has more than \a maxTriangles triangles. The default implementation returns false.*/
+    virtual bool getObjectSpaceOccluderGeometry
+       (Array<int>&                  index,
+        Array<Point3>&               vertex,
+        int                          maxTriangles,
+        bool                         previous = false) const {
+        index.fastClear();
+        vertex.fastClear();
+        return false;
+    }
+
     /** If true, this object transmits light, potentially refracting it and
         filtering the background with color or diffusion. This says nothing about whether it
         has partial coverage.
@@ -595,6 +610,10 @@ public:
 
     virtual void setStorage(ImageStorage newStorage) = 0;
 
+    /** Calls Texture::setLoadPriority on the textures of this surface's material that are still loading,
+        so that they decode ahead of lower-priority textures. The default does nothing. */
+    virtual void setLoadPriority(float priority) const {}
+
 };
 
 /////////////////////////////////////////////////////////////////
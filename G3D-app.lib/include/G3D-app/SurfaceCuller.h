@@ -0,0 +1,230 @@
+/**
+  \file G3D-app.lib/include/G3D-app/SurfaceCuller.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_SurfaceCuller_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/Vector3.h"
+#include "G3D-base/Vector4.h"
+#include "G3D-base/Matrix4.h"
+#include "G3D-base/CoordinateFrame.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-base/G3DGameUnits.h"
+
+namespace G3D {
+
+class Surface;
+class Projection;
+class Rect2D;
+class Plane;
+
+/**
+  \brief Visibility culling for Surface arrays on the CPU.
+
+  Culling runs in two stages:
+
+  1. <b>Frustum culling</b>. The world-space oriented bounding boxes of all
+     surfaces are gathered into structure-of-arrays form and tested against
+     the view frustum planes four at a time with SSE.
+
+  2. <b>Occlusion culling</b>. The largest opaque surfaces that survived the
+     frustum stage are rasterized by a low-resolution, multithreaded software
+     depth rasterizer. Every other surface is then rejected if its bounding box
+     lies entirely behind that depth buffer, using a hierarchical-Z test
+     against per-tile maximum depths before falling back to individual pixels.
+
+  Occluders write the farthest depth within each pixel whose center they cover, and
+  surfaces are tested over their screen-space bounds dilated by one pixel, so the
+  low-resolution buffer does not reject surfaces that are visible at full resolution
+  except possibly through sub-pixel gaps between occluders.
+
+  Renderer::cullAndSort uses a SurfaceCuller for the primary camera. The occlusion
+  stage is disabled by default; enable it with Settings::occlusionCulling.
+  Surface::cull uses only the frustum stage.
+
+  \sa Surface::getObjectSpaceOccluderGeometry
+*/
+class SurfaceCuller : public ReferenceCountedObject {
+public:
+
+    class Settings {
+    public:
+        /** If false, every surface with a nonempty bounding box is passed to the occlusion stage */
+        bool        frustumCulling = true;
+
+        /** Off by default. The software depth buffer costs CPU time every frame and only
+            pays for itself in scenes where large opaque surfaces hide many others. */
+        bool        occlusionCulling = false;
+
+        /** Width of the software depth buffer in pixels. The height is chosen to match the aspect ratio of the viewport. */
+        int         depthBufferWidth = 256;
+
+        /** Maximum number of surfaces rasterized into the depth buffer each frame */
+        int         maxOccluders = 64;
+
+        /** Surfaces with more triangles than this are not used as occluders */
+        int         maxOccluderTriangles = 8000;
+
+        /** Surfaces whose bounding sphere covers less than this fraction of the viewport
+            height are not used as occluders */
+        float       minOccluderSize = 0.1f;
+    };
+
+    /** Counts from the most recent call to cull() */
+    class Stats {
+    public:
+        int         surfaces = 0;
+
+        /** Rejected because their bounding box was empty or outside of the view frustum */
+        int         frustumCulled = 0;
+
+        /** Rejected by the software depth buffer */
+        int         occlusionCulled = 0;
+
+        int         occluders = 0;
+
+        int         occluderTriangles = 0;
+
+        int         visible = 0;
+
+        /** Wall-clock time spent in each stage */
+        RealTime    frustumTime = 0;
+        RealTime    occlusionTime = 0;
+    };
+
+protected:
+
+    /** World-space oriented bounding boxes in structure-of-arrays form. Each box is
+        center + a * axis0 + b * axis1 + c * axis2 for a, b, c in [-1, 1]. Padded
+        to a multiple of four elements. */
+    class BoxArrays {
+    public:
+        Array<float>    center[3];
+        Array<float>    axis0[3];
+        Array<float>    axis1[3];
+        Array<float>    axis2[3];
+
+        /** 0 = empty box, 1 = finite box, 2 = infinite box */
+        Array<uint8>    kind;
+
+        void resize(int n);
+        void set(int i, const CFrame& frame, const class AABox& osBox);
+        Point3 corner(int i, int c) const;
+    };
+
+    /** A triangle in depth buffer coordinates, set up for rasterization */
+    class ScreenTri {
+    public:
+        /** Edge function coefficients: e(x, y) = a * x + b * y + c, inside when all are >= 0 */
+        float           a[3], b[3], c[3];
+
+        /** Depth plane z(x, y) = zA * x + zB * y + zC, in normalized device coordinates */
+        float           zA, zB, zC;
+
+        /** Bounds in depth buffer pixels */
+        int             x0, y0, x1, y1;
+    };
+
+    Settings            m_settings;
+    Stats               m_stats;
+
+    BoxArrays           m_boxes;
+
+    /** Per-surface frustum culling result */
+    Array<bool>         m_visible;
+
+    Array<ScreenTri>    m_triArray;
+
+    /** Scratch space for setupOccluder() */
+    Array<int>          m_occluderIndex;
+    Array<Point3>       m_occluderVertex;
+    Array<Vector4>      m_occluderClip;
+
+    /** Side length of a hierarchical-Z tile in pixels */
+    enum { TILE_SIZE = 8 };
+
+    int                 m_width = 0;
+    int                 m_height = 0;
+
+    /** Normalized device coordinate depth. Larger is farther. */
+    Array<float>        m_depth;
+
+    /** Maximum depth within each TILE_SIZE x TILE_SIZE tile */
+    Array<float>        m_tileMaxDepth;
+
+    /** World space to normalized device coordinates */
+    Matrix4             m_worldToClip;
+
+    SurfaceCuller() {}
+
+    void gatherBounds(const Array<shared_ptr<Surface>>& surfaceArray, bool previous);
+
+    /** Sets m_visible[i] = false for every box that is completely outside of one of the planes */
+    void cullBoxesByPlanes(const Array<Plane>& planeArray);
+
+    /** Returns the number of triangles appended to m_triArray */
+    int setupOccluder(const shared_ptr<Surface>& surface, bool previous);
+
+    /** Appends the triangle with clip-space vertices \a v0, \a v1, \a v2 to m_triArray if it
+        covers at least one pixel center. The vertices must not be behind the near plane. */
+    void addScreenTri(const Vector4& v0, const Vector4& v1, const Vector4& v2);
+
+    void rasterizeOccluders();
+
+    bool occluded(int i) const;
+
+public:
+
+    static shared_ptr<SurfaceCuller> create() {
+        return createShared<SurfaceCuller>();
+    }
+
+    Settings& settings() {
+        return m_settings;
+    }
+
+    const Settings& settings() const {
+        return m_settings;
+    }
+
+    const Stats& stats() const {
+        return m_stats;
+    }
+
+    /** Appends to \a outSurfaces the elements of \a allSurfaces that may be visible from the camera,
+        preserving their order. */
+    void cull
+       (const CoordinateFrame&                  cameraFrame,
+        const Projection&                       cameraProjection,
+        const Rect2D&                           viewport,
+        const Array<shared_ptr<Surface>>&       allSurfaces,
+        Array<shared_ptr<Surface>>&             outSurfaces,
+        bool                                    previous = false);
+
+    /** Frustum stage only. Sets \a visible[i] to false for every surface that is
+        outside of the view frustum or has an empty bounding box. Used by Surface::cull. */
+    static void computeFrustumVisibility
+       (const CoordinateFrame&                  cameraFrame,
+        const Projection&                       cameraProjection,
+        const Rect2D&                           viewport,
+        const Array<shared_ptr<Surface>>&       allSurfaces,
+        Array<bool>&                            visible,
+        bool                                    previous = false);
+
+    /** The software depth buffer from the most recent cull(), for debugging. Values are
+        normalized device coordinate depths; pixels not covered by any occluder are finf(). */
+    const Array<float>& depthBuffer(int& width, int& height) const {
+        width = m_width;
+        height = m_height;
+        return m_depth;
+    }
+};
+
+} // namespace G3D
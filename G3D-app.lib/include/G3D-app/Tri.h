@@ -42,6 +42,7 @@ class Tri {
 private:
     friend class NativeTriTree;
     friend class UniversalSurfel;
+    friend class CompactTriArray;
 
     // Flags:
     static const uint64 TWO_SIDED            = 1;
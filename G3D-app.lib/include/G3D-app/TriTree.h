@@ -99,13 +99,14 @@ public:
         return m_vertexArray;
     }
 
-    /** Array access to the stored Tris */
-    const Tri& operator[](int i) const {
+    /** Array access to the stored Tris. Subclasses that store triangles elsewhere
+        (see TriTreeBase::compactStorage()) override this and size(). */
+    virtual Tri operator[](int i) const {
         debugAssert(i >= 0 && i < m_triArray.size());
         return m_triArray[i];
     }
 
-    int size() const {
+    virtual int size() const {
         return m_triArray.size();
     }
 
@@ -273,6 +274,35 @@ public:
          Array<bool>&                       results,
          IntersectRayOptions                options         = IntersectRayOptions(0)) const = 0;
 
+    /** Motion-blurred ray casting.
+
+        \param rayTime One value per ray in [0, 1], where 0 is the previous frame's pose
+        (CPUVertexArray::prevPosition) and 1 is the current pose. Triangle vertices are
+        linearly interpolated between the two poses at each ray's time.
+
+        Implementations that do not support motion, or trees built without
+        CPUVertexArray::prevPosition, trace every ray at time 1. */
+    virtual void intersectRays
+        (const Array<Ray>&                  rays,
+         const Array<float>&                rayTime,
+         Array<Hit>&                        results,
+         IntersectRayOptions                options         = IntersectRayOptions(0)) const = 0;
+
+    /** \copydoc intersectRays(const Array<Ray>&, const Array<float>&, Array<Hit>&, IntersectRayOptions) const
+
+        Surfel positions are at the ray's time; other attributes are from the current pose. */
+    virtual void intersectRays
+        (const Array<Ray>&                  rays,
+         const Array<float>&                rayTime,
+         Array<shared_ptr<Surfel>>&         results,
+         IntersectRayOptions                options         = IntersectRayOptions(0)) const = 0;
+
+    virtual void intersectRays
+        (const Array<Ray>&                  rays,
+         const Array<float>&                rayTime,
+         Array<bool>&                       results,
+         IntersectRayOptions                options         = IntersectRayOptions(0)) const = 0;
+
     /** Returns all triangles that lie within the box. Default implementation
         tests each triangle in turn (linear time). */
     virtual void intersectBox
@@ -288,7 +318,8 @@ public:
         (const Sphere&                      sphere,
          Array<Tri>&                        triArray) const = 0;
 
-    void sample(const Hit& hit, shared_ptr<Surfel>& surfel) const;
+    /** Sets \a surfel to the surface at \a hit, or nullptr if the hit is Hit::NONE */
+    virtual void sample(const Hit& hit, shared_ptr<Surfel>& surfel) const;
 
     /** Create an instance of whatever is the fastest implementation subclass for this machine.
         \param preferGPUData If true, use an implementation that is fast for ray buffers already on the GPU. */
@@ -16,6 +16,7 @@
 #include "G3D-gfx/CPUVertexArray.h"
 #include "G3D-app/Tri.h"
 #include "G3D-app/TriTree.h"
+#include "G3D-app/CompactTriArray.h"
 #ifndef _MSC_VER
 #include <stdint.h>
 #endif
@@ -31,6 +32,29 @@ class GBuffer;
 class TriTreeBase : public TriTree {
 protected:
 
+    /** \sa setCompactStorage */
+    bool                m_compactStorage = false;
+
+    /** \sa setCacheDirectory */
+    String              m_cacheDirectory;
+
+    /** Populated instead of m_triArray and m_vertexArray when 
+        m_compactStorage is true and the subclass supportsCompactStorage(). */
+    CompactTriArray     m_compactTriArray;
+
+    /** If compact storage is enabled and supported, encodes m_triArray and m_vertexArray
+        into m_compactTriArray and then frees them. Called by setContents() before rebuild(). */
+    void compactContents();
+
+    /** Whether setContents(const Array<shared_ptr<Surface>>&) should populate
+        CPUVertexArray::prevPosition. The default is false. */
+    virtual bool computePrevPosition() const {
+        return false;
+    }
+
+    /** Samples surfels at \a hits, interpolating their positions to \a rayTime if it is not null */
+    void sampleHits(const Array<Hit>& hits, const Array<float>* rayTime, Array<shared_ptr<Surfel>>& results) const;
+
     static void copyToCPU
        (const shared_ptr<GLPixelTransferBuffer>& rayOrigin,
         const shared_ptr<GLPixelTransferBuffer>& rayDirection,
@@ -46,6 +70,79 @@ public:
     
     virtual ~TriTreeBase();
 
+    /** True for subclasses that can trace against m_compactTriArray. The default is false. */
+    virtual bool supportsCompactStorage() const {
+        return false;
+    }
+
+    /** When enabled, subsequent setContents() calls store triangles in a CompactTriArray that
+        uses about 40% of the memory of the Tri and CPUVertexArray representation, at the cost
+        of quantized vertex attributes and decoding during intersection.
+
+        In compact mode, triArray() and vertexArray() are empty, and the Tris returned by intersectBox()
+        and intersectSphere() index compactTriArray() vertices. Ignored if the subclass does not
+        supportsCompactStorage(). Default is false. */
+    void setCompactStorage(bool b) {
+        m_compactStorage = b;
+    }
+
+    bool compactStorage() const {
+        return m_compactStorage && supportsCompactStorage();
+    }
+
+    /** Empty unless compactStorage() is enabled. CompactTriArray::stats() reports bytes per triangle before and after compaction. */
+    const CompactTriArray& compactTriArray() const {
+        return m_compactTriArray;
+    }
+
+    /** If the tree was built with compactStorage(), the returned Tri indexes compactTriArray() vertices */
+    virtual Tri operator[](int i) const override {
+        if (m_compactTriArray.size() > 0) {
+            debugAssert(i >= 0 && i < m_compactTriArray.size());
+            return m_compactTriArray.tri(i);
+        } else {
+            return TriTree::operator[](i);
+        }
+    }
+
+    virtual int size() const override {
+        return (m_compactTriArray.size() > 0) ? m_compactTriArray.size() : TriTree::size();
+    }
+
+    /** True for subclasses whose time-varying intersectRays() overloads interpolate between
+        the previous and current poses. The default is false, which traces at the current pose. */
+    virtual bool supportsMotion() const {
+        return false;
+    }
+
+    /** True if the current contents have a CPUVertexArray::prevPosition for every vertex, so that
+        rays can be traced at times between the previous and current poses */
+    bool hasMotion() const {
+        return (m_vertexArray.prevPosition.size() > 0) && (m_vertexArray.prevPosition.size() == m_vertexArray.size());
+    }
+
+    /** True for subclasses that can save a built tree to disk and load it in rebuild(). The default is false. */
+    virtual bool supportsCache() const {
+        return false;
+    }
+
+    /** When non-empty and the subclass supportsCache(), rebuild() looks in this directory for a tree that
+        was previously built from the same triangle positions and build settings, loads it instead
+        of building, and writes newly built trees there. Files are versioned and keyed by a hash of
+        the inputs, so stale entries are ignored rather than loaded.
+
+        The Tri and CPUVertexArray contents are still produced by setContents() because Tri::data() refers
+        to live Surface%s; only the build is skipped. Default is empty, which disables caching. */
+    void setCacheDirectory(const String& directory) {
+        m_cacheDirectory = directory;
+    }
+
+    const String& cacheDirectory() const {
+        return m_cacheDirectory;
+    }
+
+    virtual void sample(const Hit& hit, shared_ptr<Surfel>& surfel) const override;
+
     virtual void clear() override;
 
     virtual void setContents
@@ -108,6 +205,25 @@ public:
          Array<bool>&                             results,
          IntersectRayOptions                      options         = IntersectRayOptions(0)) const override;
 
+    /** The base class ignores \a rayTime unless the subclass overrides this method */
+    virtual void intersectRays
+        (const Array<Ray>&                        rays,
+         const Array<float>&                      rayTime,
+         Array<Hit>&                              results,
+         IntersectRayOptions                      options         = IntersectRayOptions(0)) const override;
+
+    virtual void intersectRays
+        (const Array<Ray>&                        rays,
+         const Array<float>&                      rayTime,
+         Array<shared_ptr<Surfel>>&               results,
+         IntersectRayOptions                      options         = IntersectRayOptions(0)) const override;
+
+    virtual void intersectRays
+        (const Array<Ray>&                        rays,
+         const Array<float>&                      rayTime,
+         Array<bool>&                             results,
+         IntersectRayOptions                      options         = IntersectRayOptions(0)) const override;
+
     virtual void intersectBox
         (const AABox&                             box,
          Array<Tri>&                              results) const override;
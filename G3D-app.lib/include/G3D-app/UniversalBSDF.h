@@ -254,6 +254,9 @@ public:
         Called from G3DMaterial::setStorage(). */
     virtual void setStorage(ImageStorage s) const;
 
+    /** \brief Texture::setLoadPriority for every texture. Called from UniversalMaterial::setLoadPriority(). */
+    virtual void setLoadPriority(float priority) const;
+
     /** \brief Return true if there is any glossy (non-Lambertian, non-mirror) 
         reflection from this BSDF. */
     bool hasGlossy() const;
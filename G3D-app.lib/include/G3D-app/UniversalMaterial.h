@@ -226,8 +226,13 @@ Any component can be a Texture::Specification, Color3/Color4, or table of <code>
 
         bool operator==(const Specification& s) const;
 
+        /** Texture%s set directly as objects, rather than by Texture::Specification,
+            cannot be represented and are omitted. \sa usesTextureObjects */
         Any toAny() const;
 
+        /** True if this refers to Texture objects, such as light maps, that toAny() cannot represent. */
+        bool usesTextureObjects() const;
+
         bool operator!=(const Specification& s) const {
             return !((*this) == s);
         }
@@ -417,6 +422,9 @@ protected:
 
     Sampler                     m_sampler;
 
+    /** \copydoc specification */
+    shared_ptr<Specification>   m_specification;
+
     UniversalMaterial();
 
 public:
@@ -431,6 +439,12 @@ public:
        return m_name;
     }
 
+    /** The Specification that create() built this material from, or null if the material
+        was constructed directly, e.g., with createEmpty(). Used to save references to the material. */
+    const shared_ptr<Specification>& specification() const {
+        return m_specification;
+    }
+
     /** The sampler used for all Texture%s */
     const Sampler& sampler() const {
         return m_sampler;
@@ -531,6 +545,8 @@ public:
 
     void setStorage(ImageStorage s) const override;
 
+    void setLoadPriority(float priority) const override;
+
     /** Never nullptr */
     const shared_ptr<UniversalBSDF>& bsdf() const {
         return m_bsdf;
@@ -21,6 +21,7 @@
 #include "G3D-gfx/AttributeArray.h"
 #include "G3D-app/Surface.h"
 #include "G3D-gfx/UniformTable.h"
+#include "G3D-app/SkinnedCPUVertexArray.h"
 
 namespace G3D {
 
@@ -192,6 +193,11 @@ public:
         /** May be nullptr */
         const Array<Vector2unorm16>*    texCoord1;
         const Array<Color4>*            vertexColors;
+
+        /** If not nullptr, vertexArray is the bind pose of a skinned mesh and this
+            produces the bone-deformed vertices on demand. Shared by all surfaces posed
+            from the same geometry. \sa posedVertexArray */
+        shared_ptr<SkinnedCPUVertexArray> skinnedVertexArray;
         
         CPUGeom
            (const Array<int>*           index,
@@ -220,6 +226,12 @@ public:
             vertexColors(nullptr) {}
 
         CPUGeom() : index(nullptr), vertexArray(nullptr), geometry(nullptr), packedTangent(nullptr), texCoord0(nullptr), texCoord1(nullptr), vertexColors(nullptr) {}
+
+        /** The object-space vertices after CPU skinning, or vertexArray if there is no skinning.
+            Use this instead of vertexArray when ray tracing or otherwise processing the geometry as rendered. */
+        const CPUVertexArray* posedVertexArray() const {
+            return notNull(skinnedVertexArray) ? &skinnedVertexArray->vertexArray() : vertexArray;
+        }
          
         /** Updates the interleaved vertex arrays.  If they are not
             big enough, allocates a new vertex buffer and reallocates
@@ -448,6 +460,12 @@ public:
      Array<Vector4>&              packedTangent, 
      Array<Point2>&               texCoord, 
      bool                         previous = false) const override;
+
+    virtual bool getObjectSpaceOccluderGeometry
+    (Array<int>&                  index,
+     Array<Point3>&               vertex,
+     int                          maxTriangles,
+     bool                         previous = false) const override;
         
     static void sortFrontToBack(Array<shared_ptr<UniversalSurface> >& a, const Vector3& v);
 
@@ -491,6 +509,8 @@ public:
 
     virtual void setStorage(ImageStorage newStorage) override;
 
+    virtual void setLoadPriority(float priority) const override;
+
 };
 
 } // G3D
@@ -11,6 +11,8 @@
 #include "G3D-base/FileSystem.h"
 #include "G3D-base/Stopwatch.h"
 #include "G3D-app/GApp.h"
+#include <condition_variable>
+#include <mutex>
 
 namespace G3D {
 
@@ -37,6 +39,20 @@ void ArticulatedModel::clearCache() {
 
 
 shared_ptr<ArticulatedModel> ArticulatedModel::loadArticulatedModel(const ArticulatedModel::Specification& specification, const String& n) {
+    const bool useDiskCache = ! diskCacheDirectory().empty();
+    String specificationText;
+    uint64 key = 0;
+    if (useDiskCache) {
+        const RealTime startTime = System::time();
+        key = diskCacheKey(specification, specificationText);
+        const shared_ptr<ArticulatedModel>& cached = loadDiskCache(specification, specificationText, key);
+        if (notNull(cached)) {
+            cached->m_name = n.empty() ? FilePath::base(specification.filename) : n;
+            cached->m_loadTimes.import = System::time() - startTime;
+            return cached;
+        }
+    }
+
     const shared_ptr<ArticulatedModel>& a = createShared<ArticulatedModel>();
 
     if (n.empty()) {
@@ -48,6 +64,10 @@ shared_ptr<ArticulatedModel> ArticulatedModel::loadArticulatedModel(const Articu
     if (! n.empty()) {
         a->m_name = n;
     }
+
+    if (useDiskCache) {
+        a->saveDiskCache(specificationText, key);
+    }
     
     return a;
 }
@@ -229,11 +249,18 @@ ArticulatedModel::Part* ArticulatedModel::part(const String& partName) {
 const bool timeArticulatedModelLoad = false;
 
 void ArticulatedModel::load(const Specification& specification) {
+    beginLoad(specification);
+    endLoad(specification);
+}
+
+
+void ArticulatedModel::beginLoad(const Specification& specification) {
     m_sourceSpecification = specification;
+    m_loadTimes = LoadTimes();
     ContinuousStopwatch timer;
 
     timer.setEnabled(timeArticulatedModelLoad);
-    m_sourceSpecification = specification;
+    RealTime startTime = System::time();
     
     const String& ext = toLower(FilePath::ext(specification.filename));
 
@@ -265,6 +292,8 @@ void ArticulatedModel::load(const Specification& specification) {
         loadHeightfield(specification);
     }
     timer.printElapsedTime("import file");
+    m_loadTimes.import = System::time() - startTime;
+    startTime = System::time();
     
     if (((specification.meshMergeOpaqueClusterRadius != 0.0f) ||
         (specification.meshMergeTransmissiveClusterRadius != 0.0f)) &&
@@ -293,7 +322,17 @@ void ArticulatedModel::load(const Specification& specification) {
     }
     preprocess(specification.preprocess);
     timer.printElapsedTime("preprocess");
-    
+    m_loadTimes.preprocess = System::time() - startTime;
+}
+
+
+void ArticulatedModel::endLoad(const Specification& specification) {
+    ContinuousStopwatch timer;
+    timer.setEnabled(timeArticulatedModelLoad);
+    const RealTime startTime = System::time();
+
+    const String& ext = toLower(FilePath::ext(specification.filename));
+
     // Compute missing elements (normals, tangents) of the part geometry, 
     // perform vertex welding, and recompute bounds.
     if ((ext != "hair") && (ext != "vox")) {
@@ -302,8 +341,165 @@ void ArticulatedModel::load(const Specification& specification) {
 
     maybeCompactArrays();
     computeBounds();
+
+    // Simplification must follow cleanGeometry, which renumbers the vertices
+    for (const Instruction& instruction : specification.preprocess) {
+        if (instruction.type == Instruction::GENERATE_LODS) {
+            const float reduction = (instruction.source.size() == 3) ? float(instruction.source[2].number()) : 0.5f;
+            generateLODs(instruction.mesh, iRound(instruction.arg.number()), reduction, instruction.source);
+        }
+    }
     
     timer.printElapsedTime("cleanGeometry");
+    m_loadTimes.cleanGeometry = System::time() - startTime;
+}
+
+
+void ArticulatedModel::createConcurrently
+   (const Array<Specification>&                         specificationArray,
+    const Array<String>&                                nameArray,
+    Array<shared_ptr<ArticulatedModel>>&                modelArray,
+    int                                                 maxConcurrentLoads,
+    const std::function<void (int index, int numFinished)>& progress) {
+
+    alwaysAssertM(specificationArray.size() == nameArray.size(), "ArticulatedModel::createConcurrently requires one name per specification");
+    const int n = specificationArray.size();
+    modelArray.resize(n);
+    modelArray.setAll(nullptr);
+
+    // State shared with the worker threads
+    std::mutex              mutex;
+    std::condition_variable finishedCondition;
+    Array<int>              finishedArray;
+    int                     numEnqueued = 0;
+    int                     numCompleted = 0;
+    std::exception_ptr      error;
+
+    // For cachable specifications repeated within this call, the index of the first occurrence
+    Table<Specification, int> firstIndexTable;
+    Array<int>              duplicateArray;
+
+    const bool useDiskCache = ! diskCacheDirectory().empty();
+    Array<uint64> keyArray;
+    Array<String> specificationTextArray;
+    Array<bool> needsSave;
+    if (useDiskCache) {
+        keyArray.resize(n);
+        specificationTextArray.resize(n);
+        needsSave.resize(n);
+        needsSave.setAll(false);
+    }
+
+    int numFinished = 0;
+    const auto reportFinished = [&](int i) {
+        ++numFinished;
+        if (progress) {
+            progress(i, numFinished);
+        }
+    };
+
+    // Reports the models that have finished on worker threads. If wait is true, first
+    // blocks until every enqueued model has finished.
+    const auto reportWorkerProgress = [&](bool wait) {
+        Array<int> finished;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wait) {
+                finishedCondition.wait(lock, [&]() { return numCompleted == numEnqueued; });
+            }
+            Array<int>::swap(finished, finishedArray);
+        }
+        for (int f = 0; f < finished.size(); ++f) {
+            reportFinished(finished[f]);
+        }
+    };
+
+    // Reserve no slots for this thread, which is busy importing while the workers run
+    tbb::task_arena arena((maxConcurrentLoads > 0) ? maxConcurrentLoads : int(tbb::task_arena::automatic), 0);
+
+    try {
+        for (int i = 0; i < n; ++i) {
+            const Specification& specification = specificationArray[i];
+            if (specification.cachable) {
+                const shared_ptr<ArticulatedModel>* cached = s_cache.getPointer(specification);
+                if (notNull(cached)) {
+                    modelArray[i] = *cached;
+                    reportFinished(i);
+                    continue;
+                }
+
+                bool created = false;
+                int& first = firstIndexTable.getCreate(specification, created);
+                if (! created) {
+                    duplicateArray.append(i);
+                    continue;
+                }
+                first = i;
+            }
+
+            if (useDiskCache) {
+                const RealTime startTime = System::time();
+                keyArray[i] = diskCacheKey(specification, specificationTextArray[i]);
+                const shared_ptr<ArticulatedModel>& cached = loadDiskCache(specification, specificationTextArray[i], keyArray[i]);
+                if (notNull(cached)) {
+                    cached->m_name = nameArray[i].empty() ? FilePath::base(specification.filename) : nameArray[i];
+                    cached->m_loadTimes.import = System::time() - startTime;
+                    modelArray[i] = cached;
+                    reportFinished(i);
+                    continue;
+                }
+                needsSave[i] = true;
+            }
+
+            // Import on this thread, because importers and preprocessing create GPU resources
+            const shared_ptr<ArticulatedModel>& model = createShared<ArticulatedModel>();
+            model->m_name = nameArray[i].empty() ? FilePath::base(specification.filename) : nameArray[i];
+            model->beginLoad(specification);
+            modelArray[i] = model;
+
+            ++numEnqueued;
+            arena.enqueue([&, model, i]() {
+                try {
+                    model->endLoad(specificationArray[i]);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (! error) { error = std::current_exception(); }
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                finishedArray.append(i);
+                ++numCompleted;
+                finishedCondition.notify_all();
+            });
+
+            reportWorkerProgress(false);
+        }
+    } catch (...) {
+        // The workers reference this stack frame, so they must finish before unwinding
+        std::unique_lock<std::mutex> lock(mutex);
+        finishedCondition.wait(lock, [&]() { return numCompleted == numEnqueued; });
+        throw;
+    }
+
+    reportWorkerProgress(true);
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        if (specificationArray[i].cachable && ! s_cache.containsKey(specificationArray[i]) && notNull(modelArray[i])) {
+            s_cache.set(specificationArray[i], modelArray[i]);
+        }
+
+        if (useDiskCache && needsSave[i]) {
+            modelArray[i]->saveDiskCache(specificationTextArray[i], keyArray[i]);
+        }
+    }
+
+    for (int d = 0; d < duplicateArray.size(); ++d) {
+        const int i = duplicateArray[d];
+        modelArray[i] = modelArray[firstIndexTable[specificationArray[i]]];
+        reportFinished(i);
+    }
 }
 
 
@@ -284,9 +284,8 @@ void ArticulatedModel::loadOBJ(const Specification& specification) {
 
     ParseOBJ parseData;
     {
-        BinaryInput bi(specification.filename, G3D_LITTLE_ENDIAN);
-        timer.printElapsedTime(" open file");
-        parseData.parse(bi, specification.objOptions);
+        // Memory-maps the file and parses it on all cores
+        parseData.parseFile(specification.filename, specification.objOptions);
 
         m_mtlArray = parseData.mtlArray;
         //adds a dummy entry to the end of the array so that models loaded from an OBJ without textures can be distinguished from other models
@@ -294,7 +293,6 @@ void ArticulatedModel::loadOBJ(const Specification& specification) {
         m_mtlArray.append("");
 
         timer.printElapsedTime(" parse OBJ");
-        // Let the BinaryInput go out of scope, reclaiming its memory
     }
     bool hasTexCoord1s = parseData.texCoord1Array.size() > 0;
     alwaysAssertM(!hasTexCoord1s || parseData.texCoord1Array.size() == parseData.texCoord0Array.size(), 
@@ -11,6 +11,8 @@
 #include "G3D-app/ArticulatedModel.h"
 #ifndef DISABLE_PLY
 #include "G3D-base/ParsePLY.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/MemoryMappedFile.h"
 #include "G3D-base/FileSystem.h"
 #include "G3D-base/MeshAlg.h"
 
@@ -24,44 +26,37 @@ void ArticulatedModel::loadPLY(const Specification& specification) {
     Mesh*       mesh = addMesh("mesh", part, geom);
     mesh->material = UniversalMaterial::create();
     
-    ParsePLY parseData;
-    {
-        BinaryInput bi(specification.filename, G3D_LITTLE_ENDIAN);
-        parseData.parse(bi);
-    }
-
-    // Convert the format
-    
-    geom->cpuVertexArray.vertex.resize(parseData.numVertices);
     geom->cpuVertexArray.hasTangent = false;
     geom->cpuVertexArray.hasTexCoord0 = false;
-     
-    // The PLY format is technically completely flexible, so we have
-    // to search for the location of the X, Y, and Z fields within each
-    // vertex.
-    int axisIndex[3];
-    const String axisName[3] = {"x", "y", "z"};
-    const int numVertexProperties = parseData.vertexProperty.size();
-    for (int a = 0; a < 3; ++a) {
-        axisIndex[a] = 0;
-        for (int p = 0; p < numVertexProperties; ++p) {
-            if (parseData.vertexProperty[p].name == axisName[a]) {
-                axisIndex[a] = p;
-                break;
-            }
-        }
-    }
 
-    for (int v = 0; v < parseData.numVertices; ++v) {
-        CPUVertexArray::Vertex& vertex = geom->cpuVertexArray.vertex[v];
+    // Decode the positions directly into the vertex array instead of materializing every vertex
+    // property, and then read the faces in place from the same bytes
+    ParsePLY parseData;
+    Array<CPUVertexArray::Vertex>& vertexArray = geom->cpuVertexArray.vertex;
+    const ParsePLY::VertexCallback& copyPositions = [&](const ParsePLY::VertexChunk& chunk) {
+        if (chunk.firstVertex == 0) {
+            vertexArray.resize(parseData.numVertices);
+        }
+        for (int i = 0; i < chunk.position.size(); ++i) {
+            CPUVertexArray::Vertex& vertex = vertexArray[chunk.firstVertex + i];
+            vertex.position = chunk.position[i];
 
-        // Read the position
-        for (int a = 0; a < 3; ++a) {
-            vertex.position[a] = parseData.vertexData[v * numVertexProperties + axisIndex[a]];
+            // Flag the normal as undefined 
+            vertex.normal.x = fnan();
         }
+    };
 
-        // Flag the normal as undefined 
-        vertex.normal.x = fnan();
+    const shared_ptr<MemoryMappedFile>& file = MemoryMappedFile::create(specification.filename, MemoryMappedFile::SEQUENTIAL);
+    if (notNull(file)) {
+        parseData.streamVertices(file, copyPositions);
+        BinaryInput bi(file, G3D_LITTLE_ENDIAN);
+        parseData.parse(bi, false);
+    } else {
+        // Zipfile
+        BinaryInput bi(specification.filename, G3D_LITTLE_ENDIAN);
+        parseData.streamVertices(bi.getCArray(), size_t(bi.size()), copyPositions);
+        bi.setPosition(0);
+        parseData.parse(bi, false);
     }
 
     if (parseData.numFaces > 0) {
@@ -0,0 +1,476 @@
+/**
+  \file G3D-app.lib/source/ArticulatedModel_cache.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-app/ArticulatedModel.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/Crypto.h"
+#include "G3D-base/FileSystem.h"
+
+namespace G3D {
+
+static String s_diskCacheDirectory;
+
+static const char* DISK_CACHE_MAGIC = "G3D ArticulatedModel";
+
+/** Arrays are aligned to this many bytes from the start of the file. They are still copied
+    out of the BinaryInput, so this only keeps those copies on aligned source addresses. */
+static const int DISK_CACHE_ALIGNMENT = 16;
+
+/** Serialized size of a CoordinateFrame */
+enum { CFRAME_BYTES = sizeof(float) * 12 };
+
+void ArticulatedModel::setDiskCacheDirectory(const String& directory) {
+    s_diskCacheDirectory = directory;
+}
+
+
+const String& ArticulatedModel::diskCacheDirectory() {
+    return s_diskCacheDirectory;
+}
+
+
+/** Hash of the length and contents of \a filename, or zero if it does not exist */
+static uint64 hashFile(const String& filename) {
+    if (! FileSystem::exists(filename, false)) {
+        return 0;
+    }
+
+    uint64 hash = Crypto::FNV1A64_BASIS;
+    BinaryInput b(filename, G3D_LITTLE_ENDIAN);
+    const int64 length = b.size();
+    hash = Crypto::fnv1a64(&length, sizeof(length), hash);
+
+    static const int64 chunkSize = 1 << 20;
+    Array<uint8> buffer;
+    buffer.resize(int(min(length, chunkSize)));
+    for (int64 remaining = length; remaining > 0; ) {
+        const int64 n = min(remaining, chunkSize);
+        b.readBytes(buffer.getCArray(), n);
+        hash = Crypto::fnv1a64(buffer.getCArray(), size_t(n), hash);
+        remaining -= n;
+    }
+    return hash;
+}
+
+
+/** Hash of an OBJ material library, whose filename is relative to the model */
+static uint64 hashMaterialLibrary(const String& modelFilename, const String& mtl) {
+    return mtl.empty() ? 0 : hashFile(FilePath::concat(FilePath::parent(modelFilename), mtl));
+}
+
+
+uint64 ArticulatedModel::diskCacheKey(const Specification& specification, String& specificationText) {
+    specificationText = specification.toAny().unparse();
+
+    uint64 hash = Crypto::FNV1A64_BASIS;
+    // Copy the constant, because taking the address of an in-class initialized static member requires a definition
+    const uint32 version = DISK_CACHE_VERSION;
+    hash = Crypto::fnv1a64(&version, sizeof(version), hash);
+    hash = Crypto::fnv1a64(specificationText.c_str(), specificationText.size(), hash);
+    const uint64 fileHash = hashFile(specification.filename);
+    hash = Crypto::fnv1a64(&fileHash, sizeof(fileHash), hash);
+    return hash;
+}
+
+
+String ArticulatedModel::diskCacheFilename(uint64 key) {
+    return FilePath::concat(s_diskCacheDirectory, format("%016llx.ArticulatedModel", (unsigned long long)key));
+}
+
+
+/** Pads with zeros to DISK_CACHE_ALIGNMENT */
+static void writeAlignment(BinaryOutput& b) {
+    while ((b.position() % DISK_CACHE_ALIGNMENT) != 0) {
+        b.writeUInt8(0);
+    }
+}
+
+
+/** BinaryInput checks bounds only in debug builds, so loadDiskCache() calls this before reading
+    from a file that may have been truncated. Throws if fewer than \a numBytes remain. */
+static void require(const BinaryInput& b, int64 numBytes) {
+    if ((numBytes < 0) || (b.getLength() - b.getPosition() < numBytes)) {
+        throw "Truncated ArticulatedModel cache file";
+    }
+}
+
+
+/** Reads a string written by BinaryOutput::writeString, stopping at the end of the file */
+static String readString(BinaryInput& b) {
+    require(b, 1);
+    return b.readString();
+}
+
+
+/** Writes the element count followed by the raw, aligned elements */
+template<class T>
+static void writeArray(BinaryOutput& b, const Array<T>& array) {
+    b.writeInt32(array.size());
+    writeAlignment(b);
+    b.writeBytes(array.getCArray(), int64(sizeof(T)) * array.size());
+}
+
+
+/** Returns false if the array would extend past the end of the file */
+template<class T>
+static bool readArray(BinaryInput& b, Array<T>& array) {
+    require(b, sizeof(int32));
+    const int n = b.readInt32();
+    const int64 start = ((b.getPosition() + DISK_CACHE_ALIGNMENT - 1) / DISK_CACHE_ALIGNMENT) * DISK_CACHE_ALIGNMENT;
+    const int64 numBytes = int64(sizeof(T)) * n;
+    if ((n < 0) || (start + numBytes > b.size())) {
+        return false;
+    }
+
+    b.setPosition(start);
+    array.resize(n);
+    b.readBytes(array.getCArray(), numBytes);
+    return true;
+}
+
+
+static void writeIndexArray(BinaryOutput& b, const Array<int>& array) {
+    b.writeInt32(array.size());
+    for (int i = 0; i < array.size(); ++i) {
+        b.writeInt32(array[i]);
+    }
+}
+
+
+static bool readIndexArray(BinaryInput& b, Array<int>& array) {
+    require(b, sizeof(int32));
+    const int n = b.readInt32();
+    if ((n < 0) || (b.getPosition() + int64(n) * 4 > b.size())) {
+        return false;
+    }
+    array.resize(n);
+    for (int i = 0; i < n; ++i) {
+        array[i] = b.readInt32();
+    }
+    return true;
+}
+
+
+/** Maps an index into \a source to a pointer, where -1 is nullptr. Returns false if the index is out of bounds. */
+template<class T>
+static bool toPointer(int index, const Array<T*>& source, T*& result) {
+    if ((index < -1) || (index >= source.size())) {
+        return false;
+    }
+    result = (index == -1) ? nullptr : source[index];
+    return true;
+}
+
+
+template<class T>
+static bool toPointers(const Array<int>& indices, const Array<T*>& source, Array<T*>& result) {
+    result.resize(indices.size());
+    for (int i = 0; i < indices.size(); ++i) {
+        if (! toPointer(indices[i], source, result[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void ArticulatedModel::saveDiskCache(const String& specificationText, uint64 key) const {
+    // Animations are not stored, and materials must be reconstructible from their specifications
+    if (m_animationTable.size() > 0) {
+        return;
+    }
+
+    Array<shared_ptr<UniversalMaterial>> materialArray;
+    Table<const UniversalMaterial*, int> materialIndex;
+    for (const Mesh* mesh : m_meshArray) {
+        const shared_ptr<UniversalMaterial>& material = mesh->material;
+        if (notNull(material) && ! materialIndex.containsKey(material.get())) {
+            if (isNull(material->specification()) || material->specification()->usesTextureObjects()) {
+                return;
+            }
+            materialIndex.set(material.get(), materialArray.size());
+            materialArray.append(material);
+        }
+    }
+
+    Table<const Part*, int> partIndex;
+    for (int p = 0; p < m_partArray.size(); ++p) {
+        partIndex.set(m_partArray[p], p);
+    }
+    partIndex.set(nullptr, -1);
+
+    Table<const Geometry*, int> geometryIndex;
+    for (int g = 0; g < m_geometryArray.size(); ++g) {
+        geometryIndex.set(m_geometryArray[g], g);
+    }
+    geometryIndex.set(nullptr, -1);
+
+    const auto toIndices = [](const Table<const Part*, int>& table, const Array<Part*>& parts) {
+        Array<int> indices;
+        for (const Part* part : parts) {
+            indices.append(table[part]);
+        }
+        return indices;
+    };
+
+    FileSystem::createDirectory(s_diskCacheDirectory);
+    BinaryOutput b(diskCacheFilename(key), G3D_LITTLE_ENDIAN);
+    b.writeString(DISK_CACHE_MAGIC);
+    b.writeUInt32(DISK_CACHE_VERSION);
+    b.writeUInt64(key);
+    b.writeString(specificationText);
+
+    // OBJ material libraries also determine the result
+    b.writeInt32(m_mtlArray.size());
+    for (const String& mtl : m_mtlArray) {
+        b.writeString(mtl);
+        b.writeUInt64(hashMaterialLibrary(m_sourceSpecification.filename, mtl));
+    }
+
+    b.writeInt32(m_nextID);
+
+    b.writeInt32(materialArray.size());
+    for (const shared_ptr<UniversalMaterial>& material : materialArray) {
+        b.writeString(material->name());
+
+        // Prefixed by its length, so that the loader can check that it is all present before parsing
+        BinaryOutput any("<memory>", G3D_LITTLE_ENDIAN);
+        material->specification()->toAny().serialize(any);
+        Array<uint8> bytes;
+        bytes.resize(int(any.size()));
+        any.commit(bytes.getCArray());
+        b.writeInt32(bytes.size());
+        b.writeBytes(bytes.getCArray(), bytes.size());
+    }
+
+    b.writeInt32(m_partArray.size());
+    for (const Part* part : m_partArray) {
+        b.writeString(part->name);
+        b.writeInt32(part->uniqueID);
+        b.writeInt32(partIndex[part->m_parent]);
+        part->cframe.serialize(b);
+        part->inverseBindPoseTransform.serialize(b);
+        writeIndexArray(b, toIndices(partIndex, part->m_children));
+    }
+    writeIndexArray(b, toIndices(partIndex, m_rootArray));
+    writeIndexArray(b, toIndices(partIndex, m_boneArray));
+
+    b.writeInt32(m_geometryArray.size());
+    for (const Geometry* geometry : m_geometryArray) {
+        const CPUVertexArray& vertexArray = geometry->cpuVertexArray;
+        b.writeString(geometry->name);
+        b.writeBool8(vertexArray.hasTexCoord0);
+        b.writeBool8(vertexArray.hasTexCoord1);
+        b.writeBool8(vertexArray.hasTangent);
+        b.writeBool8(vertexArray.hasBones);
+        b.writeBool8(vertexArray.hasVertexColors);
+        writeArray(b, vertexArray.vertex);
+        writeArray(b, vertexArray.texCoord1);
+        writeArray(b, vertexArray.vertexColors);
+        writeArray(b, vertexArray.boneIndices);
+        writeArray(b, vertexArray.boneWeights);
+        writeArray(b, vertexArray.prevPosition);
+    }
+
+    b.writeInt32(m_meshArray.size());
+    for (const Mesh* mesh : m_meshArray) {
+        b.writeString(mesh->name);
+        b.writeInt32(partIndex[mesh->logicalPart]);
+        writeIndexArray(b, toIndices(partIndex, mesh->contributingJoints));
+        b.writeInt32(isNull(mesh->material) ? -1 : materialIndex[mesh->material.get()]);
+        b.writeInt32(geometryIndex[mesh->geometry]);
+        b.writeInt32(int(mesh->primitive));
+        b.writeBool8(mesh->twoSided);
+        b.writeInt32(mesh->uniqueID);
+        writeArray(b, mesh->cpuIndexArray);
+        b.writeInt32(mesh->lodArray.size());
+        for (const Mesh::LOD& lod : mesh->lodArray) {
+            b.writeFloat32(lod.geometricError);
+            writeArray(b, lod.cpuIndexArray);
+        }
+    }
+
+    b.commit();
+}
+
+
+shared_ptr<ArticulatedModel> ArticulatedModel::loadDiskCache(const Specification& specification, const String& specificationText, uint64 key) {
+    const String& filename = diskCacheFilename(key);
+    if (! FileSystem::exists(filename, false)) {
+        return nullptr;
+    }
+
+    const shared_ptr<ArticulatedModel>& a = createShared<ArticulatedModel>();
+    try {
+        BinaryInput b(filename, G3D_LITTLE_ENDIAN);
+
+        // Magic string with its terminator, version, and key
+        const int64 magicBytes = int64(strlen(DISK_CACHE_MAGIC)) + 1;
+        require(b, magicBytes + sizeof(uint32) + sizeof(uint64));
+        if ((b.readString(magicBytes) != DISK_CACHE_MAGIC) || (b.readUInt32() != DISK_CACHE_VERSION) ||
+            (b.readUInt64() != key) || (readString(b) != specificationText)) {
+            return nullptr;
+        }
+
+        require(b, sizeof(int32));
+        const int numMTL = b.readInt32();
+        for (int i = 0; i < numMTL; ++i) {
+            const String& mtl = readString(b);
+            require(b, sizeof(uint64));
+            if (b.readUInt64() != hashMaterialLibrary(specification.filename, mtl)) {
+                // A material library changed
+                return nullptr;
+            }
+            a->m_mtlArray.append(mtl);
+        }
+
+        require(b, sizeof(int32) * 2);
+        a->m_nextID = b.readInt32();
+
+        const int numMaterials = b.readInt32();
+        if (numMaterials < 0) {
+            return nullptr;
+        }
+        Array<shared_ptr<UniversalMaterial>> materialArray;
+        materialArray.resize(numMaterials);
+        Array<uint8> bytes;
+        for (int m = 0; m < materialArray.size(); ++m) {
+            const String& name = readString(b);
+            require(b, sizeof(int32));
+            const int numBytes = b.readInt32();
+            require(b, numBytes);
+            bytes.resize(numBytes);
+            b.readBytes(bytes.getCArray(), numBytes);
+
+            BinaryInput anyInput(bytes.getCArray(), numBytes, G3D_LITTLE_ENDIAN, false, false);
+            Any any;
+            any.deserialize(anyInput);
+            materialArray[m] = UniversalMaterial::create(name, UniversalMaterial::Specification(any));
+        }
+
+        // Create all parts before linking them, since a part may precede its parent
+        require(b, sizeof(int32));
+        const int numParts = b.readInt32();
+        if (numParts < 0) {
+            return nullptr;
+        }
+        Array<int> parentIndex;
+        Array<Array<int>> childIndex;
+        parentIndex.resize(numParts);
+        childIndex.resize(numParts);
+        for (int p = 0; p < numParts; ++p) {
+            const String& name = readString(b);
+            require(b, sizeof(int32) * 2 + CFRAME_BYTES * 2);
+            const int uniqueID = b.readInt32();
+            Part* part = new Part(name, nullptr, uniqueID);
+            a->m_partArray.append(part);
+            parentIndex[p] = b.readInt32();
+            part->cframe.deserialize(b);
+            part->inverseBindPoseTransform.deserialize(b);
+            if (! readIndexArray(b, childIndex[p])) {
+                return nullptr;
+            }
+        }
+
+        for (int p = 0; p < numParts; ++p) {
+            Part* part = a->m_partArray[p];
+            if (! toPointer(parentIndex[p], a->m_partArray, part->m_parent) ||
+                ! toPointers(childIndex[p], a->m_partArray, part->m_children)) {
+                return nullptr;
+            }
+        }
+
+        Array<int> indices;
+        if (! readIndexArray(b, indices) || ! toPointers(indices, a->m_partArray, a->m_rootArray) ||
+            ! readIndexArray(b, indices) || ! toPointers(indices, a->m_partArray, a->m_boneArray)) {
+            return nullptr;
+        }
+
+        require(b, sizeof(int32));
+        const int numGeometry = b.readInt32();
+        for (int g = 0; g < numGeometry; ++g) {
+            Geometry* geometry = new Geometry(readString(b));
+            a->m_geometryArray.append(geometry);
+
+            CPUVertexArray& vertexArray = geometry->cpuVertexArray;
+            require(b, 5);
+            vertexArray.hasTexCoord0    = b.readBool8();
+            vertexArray.hasTexCoord1    = b.readBool8();
+            vertexArray.hasTangent      = b.readBool8();
+            vertexArray.hasBones        = b.readBool8();
+            vertexArray.hasVertexColors = b.readBool8();
+            if (! readArray(b, vertexArray.vertex) ||
+                ! readArray(b, vertexArray.texCoord1) ||
+                ! readArray(b, vertexArray.vertexColors) ||
+                ! readArray(b, vertexArray.boneIndices) ||
+                ! readArray(b, vertexArray.boneWeights) ||
+                ! readArray(b, vertexArray.prevPosition)) {
+                return nullptr;
+            }
+        }
+
+        require(b, sizeof(int32));
+        const int numMeshes = b.readInt32();
+        for (int m = 0; m < numMeshes; ++m) {
+            const String& name = readString(b);
+            Part* logicalPart = nullptr;
+            require(b, sizeof(int32));
+            if (! toPointer(b.readInt32(), a->m_partArray, logicalPart) || ! readIndexArray(b, indices)) {
+                return nullptr;
+            }
+
+            require(b, sizeof(int32) * 3 + 1 + sizeof(int32));
+            const int material = b.readInt32();
+            Geometry* geometry = nullptr;
+            if ((material < -1) || (material >= materialArray.size()) ||
+                ! toPointer(b.readInt32(), a->m_geometryArray, geometry) || isNull(geometry)) {
+                return nullptr;
+            }
+
+            Mesh* mesh = new Mesh(name, logicalPart, geometry, 0);
+            a->m_meshArray.append(mesh);
+            if (! toPointers(indices, a->m_partArray, mesh->contributingJoints)) {
+                return nullptr;
+            }
+            if (material >= 0) {
+                mesh->material = materialArray[material];
+            }
+            mesh->primitive = PrimitiveType(b.readInt32());
+            mesh->twoSided  = b.readBool8();
+            mesh->uniqueID  = b.readInt32();
+            if (! readArray(b, mesh->cpuIndexArray)) {
+                return nullptr;
+            }
+            require(b, sizeof(int32));
+            const int numLODs = b.readInt32();
+            if (numLODs < 0) {
+                return nullptr;
+            }
+            mesh->lodArray.resize(numLODs);
+            for (Mesh::LOD& lod : mesh->lodArray) {
+                require(b, sizeof(float));
+                lod.geometricError = b.readFloat32();
+                if (! readArray(b, lod.cpuIndexArray)) {
+                    return nullptr;
+                }
+            }
+        }
+
+        // Bounds are cheap to recompute, and the per-Mesh tri trees that intersect() needs are not stored
+        a->computeBounds();
+
+        a->m_sourceSpecification = specification;
+        return a;
+    } catch (...) {
+        debugPrintf("ArticulatedModel: ignoring unreadable cache file %s\n", filename.c_str());
+        return nullptr;
+    }
+}
+
+} // namespace G3D
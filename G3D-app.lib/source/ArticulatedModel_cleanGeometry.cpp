@@ -258,10 +258,11 @@ void ArticulatedModel::Geometry::subdivideUntilThresholdEdgeLength
 
     generateFaceArray(faceArray, affectedMeshes, cpuVertexArray);
 
-    // Clear all mesh index arrays
+    // Clear all mesh index arrays. Levels of detail index the old vertices.
     for (int m = 0; m < affectedMeshes.size(); ++m) {
         Mesh* mesh = affectedMeshes[m];
         mesh->cpuIndexArray.fastClear();
+        mesh->lodArray.clear();
         mesh->gpuIndexArray = IndexStream();
     }
 
@@ -422,6 +423,18 @@ void ArticulatedModel::Geometry::clearAttributeArrays() {
 
 void ArticulatedModel::Mesh::clearIndexStream() {
     gpuIndexArray = IndexStream();
+    for (LOD& lod : lodArray) {
+        lod.gpuIndexArray = IndexStream();
+    }
+}
+
+
+int ArticulatedModel::Mesh::totalIndexCount() const {
+    int count = cpuIndexArray.size();
+    for (const LOD& lod : lodArray) {
+        count += lod.cpuIndexArray.size();
+    }
+    return count;
 }
 
 
@@ -623,12 +636,137 @@ void ArticulatedModel::Geometry::computeMissingTangents(const Array<Mesh*> affec
     
  }
 
+/** Below this many face vertices, mergeVertices() is not worth running on multiple threads */
+static const int MIN_CONCURRENT_MERGE_VERTICES = 100000;
+
+/**
+ Produces exactly the same cpuVertexArray and index arrays as the serial loop in
+ Geometry::mergeVertices(). That loop merges each face vertex into the first earlier
+ output vertex with identical attributes and a close normal, so only face vertices
+ with the same hash code can affect each other. This groups them by hash code, replays
+ the serial loop within each group concurrently, and then numbers the surviving
+ vertices in the order in which the serial loop would have created them.
+ */
+static void mergeVerticesConcurrently(const Array<ArticulatedModel::Geometry::Face>& faceArray, float normalClosenessThreshold, CPUVertexArray& cpuVertexArray) {
+    typedef ArticulatedModel::Geometry::Face Face;
+    const int numVertices = 3 * faceArray.size();
+    const auto faceVertex = [&](int k) -> const Face::Vertex& {
+        return faceArray[k / 3].vertex[k % 3];
+    };
+
+    class HashedVertex {
+    public:
+        size_t      hashCode;
+        int         index;
+        bool operator<(const HashedVertex& other) const {
+            return (hashCode != other.hashCode) ? (hashCode < other.hashCode) : (index < other.index);
+        }
+    };
+
+    Array<HashedVertex> hashed;
+    hashed.resize(numVertices);
+    runConcurrently(0, numVertices, [&](int k) {
+        hashed[k].hashCode = Face::AMFaceVertexHash::hashCode(faceVertex(k));
+        hashed[k].index = k;
+    });
+    tbb::parallel_sort(hashed.begin(), hashed.end());
+
+    Array<int> groupStart;
+    for (int i = 0; i < numVertices; ++i) {
+        if ((i == 0) || (hashed[i].hashCode != hashed[i - 1].hashCode)) {
+            groupStart.append(i);
+        }
+    }
+    groupStart.append(numVertices);
+
+    // The face vertex whose copy in cpuVertexArray each face vertex uses
+    Array<int> representative;
+    representative.resize(numVertices);
+    runConcurrently(0, groupStart.size() - 1, [&](int g) {
+        // Face vertices that the serial loop appends to cpuVertexArray, in order
+        SmallArray<int, 4> created;
+        for (int i = groupStart[g]; i < groupStart[g + 1]; ++i) {
+            const int k = hashed[i].index;
+            const Face::Vertex& vertex = faceVertex(k);
+
+            int index = -1;
+            for (int j = 0; j < created.size(); ++j) {
+                const Face::Vertex& other = faceVertex(created[j]);
+                const Vector3& otherNormal = other.normal;
+                if (Face::AMFaceVertexHash::equals(other, vertex) &&
+                    ((otherNormal.dot(vertex.normal) >= normalClosenessThreshold) 
+                     || otherNormal.isZero() || vertex.normal.isZero())) {
+                    index = created[j];
+                    break;
+                }
+            }
+
+            if (index == -1) {
+                created.append(k);
+                representative[k] = k;
+            } else {
+                representative[k] = index;
+            }
+        }
+    });
+
+    Array<int> newIndex;
+    newIndex.resize(numVertices);
+    int numOutput = 0;
+    for (int k = 0; k < numVertices; ++k) {
+        if (representative[k] == k) {
+            newIndex[k] = numOutput;
+            ++numOutput;
+        }
+    }
+
+    cpuVertexArray.vertex.resize(numOutput);
+    if (cpuVertexArray.hasTexCoord1) {
+        cpuVertexArray.texCoord1.resize(numOutput);
+    }
+    if (cpuVertexArray.hasVertexColors) {
+        cpuVertexArray.vertexColors.resize(numOutput);
+    }
+    if (cpuVertexArray.hasBones) {
+        cpuVertexArray.boneIndices.resize(numOutput);
+        cpuVertexArray.boneWeights.resize(numOutput);
+    }
+    runConcurrently(0, numVertices, [&](int k) {
+        if (representative[k] == k) {
+            const Face::Vertex& vertex = faceVertex(k);
+            const int i = newIndex[k];
+            cpuVertexArray.vertex[i] = vertex;
+            if (cpuVertexArray.hasTexCoord1) {
+                cpuVertexArray.texCoord1[i] = vertex.texCoord1;
+            }
+            if (cpuVertexArray.hasVertexColors) {
+                cpuVertexArray.vertexColors[i] = vertex.vertexColor;
+            }
+            if (cpuVertexArray.hasBones) {
+                cpuVertexArray.boneIndices[i] = vertex.boneIndices;
+                cpuVertexArray.boneWeights[i] = vertex.boneWeights;
+            }
+        }
+    });
+
+    for (int f = 0; f < faceArray.size(); ++f) {
+        const int k = 3 * f;
+        const int vertexIndex[3] = {newIndex[representative[k]], newIndex[representative[k + 1]], newIndex[representative[k + 2]]};
+
+        // Add only non-degenerate triangles
+        if ((vertexIndex[0] != vertexIndex[1]) && (vertexIndex[1] != vertexIndex[2]) && (vertexIndex[2] != vertexIndex[0])) {
+            faceArray[f].mesh->cpuIndexArray.append(vertexIndex[0], vertexIndex[1], vertexIndex[2]);
+        }
+    }
+}
+
  
 void ArticulatedModel::Geometry::mergeVertices(const Array<Face>& faceArray, float maxNormalWeldAngle, const Array<Mesh*> affectedMeshes) {
-    // Clear all mesh index arrays
+    // Clear all mesh index arrays. Levels of detail index the old vertices.
     for (int m = 0; m < affectedMeshes.size(); ++m) {
         Mesh* mesh = affectedMeshes[m];
         mesh->cpuIndexArray.fastClear();
+        mesh->lodArray.clear();
         mesh->gpuIndexArray = IndexStream();
     }
 
@@ -639,6 +777,13 @@ void ArticulatedModel::Geometry::mergeVertices(const Array<Face>& faceArray, flo
     cpuVertexArray.boneIndices.fastClear();
     cpuVertexArray.boneWeights.fastClear();
 
+    const float normalClosenessThreshold = cos(maxNormalWeldAngle);
+
+    if (3 * faceArray.size() >= MIN_CONCURRENT_MERGE_VERTICES) {
+        mergeVerticesConcurrently(faceArray, normalClosenessThreshold, cpuVertexArray);
+        return;
+    }
+
     Stopwatch timer;
     timer.setEnabled(false);
 
@@ -656,8 +801,6 @@ void ArticulatedModel::Geometry::mergeVertices(const Array<Face>& faceArray, flo
     // Conservative estimate of the size (overallocation here is bad for large models on low RAM systems (such as San Miguel on a standard 8GB RAM computer)
     vertexIndexTable.setSizeHint(faceArray.size() / 6); 
 
-    const float normalClosenessThreshold = cos(maxNormalWeldAngle);
-
     // Iterate over all faces
     int longestListLength = 0;
     for (int f = 0; f < faceArray.size(); ++f) {
@@ -727,8 +870,9 @@ void ArticulatedModel::Geometry::computeMissingVertexNormals
 
     const float smoothThreshold = cos(maximumSmoothAngle);
 
-    // Compute vertex normals as needed
-    for (int f = 0; f < faceArray.size(); ++f) {
+    // Compute vertex normals as needed. Each face only writes its own vertices and
+    // only reads the face normals of its neighbors, so faces are independent.
+    runConcurrently(0, faceArray.size(), [&](int f) {
         Face& face = faceArray[f];
 
         for (int v = 0; v < 3; ++v) {
@@ -781,7 +925,7 @@ void ArticulatedModel::Geometry::computeMissingVertexNormals
                     "the adjacent face normals were probably corrupt"); 
             }
         }
-    }
+    });
 }
 
 
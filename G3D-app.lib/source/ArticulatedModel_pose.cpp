@@ -9,6 +9,7 @@
 #include "G3D-app/ArticulatedModel.h"
 #include "G3D-base/Queue.h"
 #include "G3D-app/GApp.h"
+#include "G3D-app/Scene.h"
 #include "G3D-base/CPUPixelTransferBuffer.h"
 
 
@@ -16,6 +17,27 @@ namespace G3D {
 
 const PhysicsFrame ArticulatedModel::Pose::identity;
 
+/** Returns the index in mesh->lodArray of the coarsest level whose error projects to at most
+    viewer.maxPixelError pixels anywhere within \a wsBounds, or -1 for full resolution */
+static int chooseLOD(const ArticulatedModel::Mesh* mesh, const Sphere& wsBounds, const ArticulatedModel::LODViewer& viewer) {
+    if ((mesh->lodArray.size() == 0) || (viewer.imagePlanePixelsPerMeter <= 0.0f)) {
+        return -1;
+    }
+
+    const float distance = (wsBounds.center - viewer.wsPosition).length() - wsBounds.radius;
+    if (distance <= 0.0f) {
+        return -1;
+    }
+
+    const float pixelsPerMeter = viewer.imagePlanePixelsPerMeter / distance;
+    for (int i = mesh->lodArray.size() - 1; i >= 0; --i) {
+        if (mesh->lodArray[i].geometricError * pixelsPerMeter <= viewer.maxPixelError) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 void ArticulatedModel::Pose::interpolate(const Pose& pose1, const Pose& pose2, float alpha, Pose& interpolatedPose) {
     // TODO: handle poses with different sets of keys'
     // TODO: don't clear interpolated pose every frame for every object!
@@ -202,17 +224,32 @@ void ArticulatedModel::pose
     const ArticulatedModel::Pose& pose = isNull(ppose) ? ArticulatedModel::Pose() : *ppose;
     const ArticulatedModel::Pose& prevPose = isNull(pprevPose) ? ArticulatedModel::Pose() : *pprevPose;
 
+    // Models posed outside of a Scene are always full resolution
+    const LODViewer& lodViewer = (notNull(entity) && notNull(entity->scene())) ? entity->scene()->lodViewer() : LODViewer();
+
     const shared_ptr<Texture>& boneTexture = (m_boneArray.size() > 0) ? UniversalSurface::GPUGeom::allocateBoneTexture(m_boneArray.size(), 3) : nullptr;
     const shared_ptr<Texture>& prevBoneTexture = (m_boneArray.size() > 0) ? UniversalSurface::GPUGeom::allocateBoneTexture(m_boneArray.size(), 3) : nullptr;
 
     // Compute the part transformations in Model space (i.e., relative to the Entity's reference frame)
     computePartTransforms(m_partTransformTable, m_prevPartTransformTable, CFrame(), pose, CFrame(), prevPose);
     
+    // Object-space bone transformations for CPU skinning, indexed the same as the bone texture
+    Array<CFrame> boneFrame, prevBoneFrame;
     if (m_boneArray.size() > 0) {
         // Compute the global bone transformations, which are not specific to a particular mesh only model has bones
         uploadBones(boneTexture,     m_boneArray, m_partTransformTable);
         uploadBones(prevBoneTexture, m_boneArray, m_prevPartTransformTable);
+
+        boneFrame.resize(m_boneArray.size());
+        prevBoneFrame.resize(m_boneArray.size());
+        for (int i = 0; i < m_boneArray.size(); ++i) {
+            boneFrame[i]     = getFinalBoneTransform(m_boneArray[i], m_partTransformTable);
+            prevBoneFrame[i] = getFinalBoneTransform(m_boneArray[i], m_prevPartTransformTable);
+        }
     }
+
+    // One lazily-skinned vertex array per skinned Geometry, shared by all of its Meshes
+    Table<Geometry*, shared_ptr<SkinnedCPUVertexArray>> skinnedVertexArrayTable;
     
     for (int g = 0; g < m_geometryArray.size(); ++g) {
         Geometry* geometry = m_geometryArray[g];
@@ -235,7 +272,7 @@ void ArticulatedModel::pose
             const Mesh* mesh = m_meshArray[m];
             // We don't need padding on this because currently all indices are 32-bits, and must
             // be 4-byte aligned.
-            totalIndexSize += mesh->cpuIndexArray.size();
+            totalIndexSize += mesh->totalIndexCount();
         }
 
         if (totalIndexSize > 0) {
@@ -298,7 +335,28 @@ void ArticulatedModel::pose
         debugAssert(! isNaN(frame.translation.x));
         debugAssert(! isNaN(frame.rotation[0][0]));
 
-        const UniversalSurface::CPUGeom cpuGeom(&mesh->cpuIndexArray, &mesh->geometry->cpuVertexArray);
+        // Only the rasterized indices change, so that ray casts do not depend on the viewer
+        const int lodIndex = chooseLOD(mesh, frame.toWorldSpace(gpuGeom->sphereBounds), lodViewer);
+        if (lodIndex >= 0) {
+            const Mesh::LOD& lod = mesh->lodArray[lodIndex];
+            if (geometry->hasBones()) {
+                // gpuGeom is already a copy for this surface
+                gpuGeom->index = lod.gpuIndexArray;
+            } else {
+                gpuGeom = lod.gpuGeom;
+            }
+        }
+
+        UniversalSurface::CPUGeom cpuGeom(&mesh->cpuIndexArray, &mesh->geometry->cpuVertexArray);
+        if (geometry->hasBones() && (boneFrame.size() > 0)) {
+            bool created = false;
+            shared_ptr<SkinnedCPUVertexArray>& skinned = skinnedVertexArrayTable.getCreate(geometry, created);
+            if (created) {
+                skinned = acquireSkinnedVertexArray(geometry);
+                skinned->setPose(&geometry->cpuVertexArray, boneFrame, prevBoneFrame, m_cpuSkinningMethod);
+            }
+            cpuGeom.skinnedVertexArray = skinned;
+        }
 
         const shared_ptr<UniversalSurface>& surface = 
             UniversalSurface::create
@@ -315,6 +373,19 @@ void ArticulatedModel::pose
      }
 }
 
+shared_ptr<SkinnedCPUVertexArray> ArticulatedModel::acquireSkinnedVertexArray(Geometry* geometry) {
+    for (const shared_ptr<SkinnedCPUVertexArray>& skinned : geometry->m_skinnedVertexArrayPool) {
+        // Only the pool holds a reference, so no surface from a previous pose can observe the change
+        if (skinned.use_count() == 1) {
+            return skinned;
+        }
+    }
+
+    const shared_ptr<SkinnedCPUVertexArray>& skinned = SkinnedCPUVertexArray::create();
+    geometry->m_skinnedVertexArrayPool.append(skinned);
+    return skinned;
+}
+
 /*
 void ArticulatedModel::Part::pose
 (const shared_ptr<ArticulatedModel>& model,
@@ -406,6 +477,11 @@ void ArticulatedModel::Mesh::updateGPUGeom() {
     gpuGeom->boneIndices    = geometry->gpuBoneIndicesArray;
     gpuGeom->boneWeights    = geometry->gpuBoneWeightsArray;
     gpuGeom->twoSided       = twoSided;
+
+    for (LOD& lod : lodArray) {
+        lod.gpuGeom        = UniversalSurface::GPUGeom::create(gpuGeom);
+        lod.gpuGeom->index = lod.gpuIndexArray;
+    }
 }
 
 
@@ -420,7 +496,7 @@ void ArticulatedModel::Mesh::copyToGPU(const shared_ptr<VertexBuffer>& indexBuff
     
     if (isNull(all)) {
         const size_t indexBytes = 4;
-        all = VertexBuffer::create(triangleCount() * 3 * indexBytes, VertexBuffer::WRITE_ONCE);
+        all = VertexBuffer::create(totalIndexCount() * indexBytes, VertexBuffer::WRITE_ONCE);
     }
 
     if (false) { //indexBytes == 2) {
@@ -437,6 +513,9 @@ void ArticulatedModel::Mesh::copyToGPU(const shared_ptr<VertexBuffer>& indexBuff
     } else {
         // Directly copy the 32-bit indices
         gpuIndexArray = IndexStream(cpuIndexArray, all);
+        for (LOD& lod : lodArray) {
+            lod.gpuIndexArray = IndexStream(lod.cpuIndexArray, all);
+        }
     }
 
     updateGPUGeom();
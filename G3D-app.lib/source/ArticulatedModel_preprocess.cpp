@@ -6,6 +6,8 @@
   All rights reserved
   Available under the BSD License
 */
+#include "G3D-base/MeshAlg.h"
+#include "G3D-base/Thread.h"
 #include "G3D-app/ArticulatedModel.h"
 
 namespace G3D {
@@ -257,6 +259,10 @@ void ArticulatedModel::preprocess(const Array<Instruction>& program) {
             }
             break;
 
+        case Instruction::GENERATE_LODS:
+            // Deferred to endLoad, because cleanGeometry renumbers the vertices
+            break;
+
         default:
             alwaysAssertM(false, "Instruction not implemented");
         }
@@ -602,6 +608,64 @@ void ArticulatedModel::SetTwoSidedCallback::operator()
 }
 
 
+/** Levels of detail whose error approaches the size of the mesh are never worth rendering */
+static const float MAX_LOD_ERROR_FRACTION = 0.25f;
+
+void ArticulatedModel::generateLODs(const Instruction::Identifier& meshId, int numLevels, float reduction, const Any& source) {
+    source.verify((reduction > 0.0f) && (reduction < 1.0f), "The reduction must be between 0 and 1");
+
+    Array<Mesh*> meshArray;
+    getIdentifiedMeshes(meshId, meshArray);
+
+    // Drop the old levels. endLoad() runs this before the first pose(), so there are no GPU index
+    // streams to release yet even when createConcurrently() calls it on a worker thread.
+    for (Mesh* mesh : meshArray) {
+        mesh->lodArray.clear();
+        mesh->clearIndexStream();
+    }
+
+    runConcurrently(0, meshArray.size(), [&](int m) {
+        Mesh* mesh = meshArray[m];
+        if ((mesh->primitive != PrimitiveType::TRIANGLES) || isNull(mesh->geometry)) {
+            return;
+        }
+
+        const Array<CPUVertexArray::Vertex>& vertex = mesh->geometry->cpuVertexArray.vertex;
+        Array<Vector3> position;
+        position.resize(vertex.size());
+        for (int v = 0; v < vertex.size(); ++v) {
+            position[v] = vertex[v].position;
+        }
+
+        AABox box;
+        Sphere sphere;
+        MeshAlg::computeBounds(position, mesh->cpuIndexArray, box, sphere);
+        const float maxError = MAX_LOD_ERROR_FRACTION * sphere.radius;
+
+        for (int level = 0; level < numLevels; ++level) {
+            const Array<int>& previous = (level == 0) ? mesh->cpuIndexArray : mesh->lodArray.last().cpuIndexArray;
+            const float previousError  = (level == 0) ? 0.0f : mesh->lodArray.last().geometricError;
+            const int previousTriangles = previous.size() / 3;
+            const int target = iFloor(float(previousTriangles) * reduction);
+            if ((target < 1) || (previousError >= maxError)) {
+                break;
+            }
+
+            // Errors of successive levels add, because each level simplifies the previous one
+            Mesh::LOD lod;
+            lod.geometricError = previousError + MeshAlg::simplify(position, previous, lod.cpuIndexArray, target, maxError - previousError);
+
+            // Stop when the error bound or the mesh's seams prevent most of the requested reduction
+            const int triangles = lod.cpuIndexArray.size() / 3;
+            if ((triangles == 0) || (triangles > (previousTriangles + target) / 2)) {
+                break;
+            }
+            mesh->lodArray.append(lod);
+        }
+    });
+}
+
+
 void ArticulatedModel::scaleAnimations(float scaleFactor) {
     for (Table<String, Animation>::Iterator it = m_animationTable.begin(); it.isValid(); ++it) {
         const Animation& anim = it->value;
@@ -461,6 +461,16 @@ ArticulatedModel::Instruction::Instruction(const Any& any) {
         part = any[0];
         arg = any[1];
 
+    } else if (instructionName == "generateLODs") {
+
+        type = GENERATE_LODS;
+        any.verifySize(2, 3);
+        mesh = any[0];
+        arg = any[1];
+        any.verify(arg.type() == Any::NUMBER, "Expected the number of levels of detail");
+        // Parse the third (reduction) argument explicitly
+        // during application.
+
     } else {
 
         any.verify(false, String("Unknown instruction: \"") + instructionName + "\"");
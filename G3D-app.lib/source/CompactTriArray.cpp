@@ -0,0 +1,262 @@
+/**
+  \file G3D-app.lib/source/CompactTriArray.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/Table.h"
+#include "G3D-base/Thread.h"
+#include "G3D-app/CompactTriArray.h"
+#include "G3D-app/Surfel.h"
+
+namespace G3D {
+
+void CompactTriArray::octEncode(const Vector3& v, snorm16 oct[2]) {
+    // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower hemisphere over the upper
+    const Vector3& p = v / max(fabsf(v.x) + fabsf(v.y) + fabsf(v.z), 1e-20f);
+    Vector2 e(p.x, p.y);
+    if (p.z < 0.0f) {
+        e = Vector2((1.0f - fabsf(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+                    (1.0f - fabsf(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    oct[0] = snorm16(e.x);
+    oct[1] = snorm16(e.y);
+}
+
+
+Vector3 CompactTriArray::octDecode(const snorm16 oct[2]) {
+    const float x = float(oct[0]);
+    const float y = float(oct[1]);
+    Vector3 v(x, y, 1.0f - fabsf(x) - fabsf(y));
+    if (v.z < 0.0f) {
+        v.x = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        v.y = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return v.direction();
+}
+
+
+void CompactTriArray::clear() {
+    m_tri.clear();
+    m_vertex.clear();
+    m_block.clear();
+    m_pageFirstBlock.clear();
+    m_dataTable.clear();
+    m_stats = Stats();
+}
+
+
+size_t CompactTriArray::sizeInBytes() const {
+    return m_tri.size() * sizeof(PackedTri) + m_vertex.size() * sizeof(PackedVertex) +
+        m_block.size() * sizeof(Block) + m_pageFirstBlock.size() * sizeof(int) + m_dataTable.size() * sizeof(shared_ptr<ReferenceCountedObject>);
+}
+
+
+size_t CompactTriArray::sizeInBytes(const Array<Tri>& triArray, const CPUVertexArray& vertexArray) {
+    return triArray.size() * sizeof(Tri) +
+        vertexArray.vertex.size() * sizeof(CPUVertexArray::Vertex) +
+        vertexArray.texCoord1.size() * sizeof(Point2unorm16) +
+        vertexArray.vertexColors.size() * sizeof(Color4) +
+        vertexArray.boneIndices.size() * sizeof(Vector4int32) +
+        vertexArray.boneWeights.size() * sizeof(Vector4) +
+        vertexArray.prevPosition.size() * sizeof(Point3);
+}
+
+
+void CompactTriArray::encode(const Array<Tri>& triArray, const CPUVertexArray& vertexArray) {
+    clear();
+    m_stats.numTris = triArray.size();
+    m_stats.numVertices = vertexArray.size();
+    m_stats.uncompressedBytes = sizeInBytes(triArray, vertexArray);
+
+    m_hasTexCoord0 = vertexArray.hasTexCoord0;
+    m_hasTangent = vertexArray.hasTangent;
+
+    const int numVertices = vertexArray.size();
+    m_vertex.resize(numVertices);
+
+    // A mesh boundary precedes vertex v unless some triangle spans it. reach[v] is the
+    // highest vertex index connected to a triangle whose lowest index is v.
+    Array<int> reach;
+    reach.resize(numVertices);
+    for (int v = 0; v < numVertices; ++v) {
+        reach[v] = v;
+    }
+    for (const Tri& tri : triArray) {
+        const int lo = int(min(tri.index[0], tri.index[1], tri.index[2]));
+        reach[lo] = max(reach[lo], int(max(tri.index[0], tri.index[1], tri.index[2])));
+    }
+
+    // Each page is divided into Blocks at the mesh boundaries within it
+    Array<int> blockStart;
+    const int numPages = iCeil(float(numVertices) / float(PAGE_SIZE));
+    m_pageFirstBlock.resize(numPages);
+    for (int v = 0, meshEnd = -1; v < numVertices; ++v) {
+        if (v % PAGE_SIZE == 0) {
+            m_pageFirstBlock[v / PAGE_SIZE] = blockStart.size();
+            blockStart.append(v);
+        } else if (v > meshEnd) {
+            blockStart.append(v);
+        }
+        meshEnd = max(meshEnd, reach[v]);
+    }
+    blockStart.append(numVertices);
+    m_block.resize(blockStart.size() - 1);
+
+    runConcurrently(0, m_block.size(), [&](int b) {
+        const int start = blockStart[b];
+        const int stopBefore = blockStart[b + 1];
+        const uint16 blockFlags = uint16((b - m_pageFirstBlock[start / PAGE_SIZE]) << BLOCK_SHIFT);
+
+        // Bounds of this block
+        Point3 lo = Point3::inf(), hi = -Point3::inf();
+        Point2 tlo = Point2::inf(), thi = -Point2::inf();
+        for (int i = start; i < stopBefore; ++i) {
+            const CPUVertexArray::Vertex& vertex = vertexArray.vertex[i];
+            lo = lo.min(vertex.position);
+            hi = hi.max(vertex.position);
+            if (m_hasTexCoord0) {
+                tlo = tlo.min(vertex.texCoord0);
+                thi = thi.max(vertex.texCoord0);
+            }
+        }
+
+        if (! m_hasTexCoord0) {
+            tlo = thi = Point2::zero();
+        }
+
+        Block& block = m_block[b];
+        block.positionLow = lo;
+        block.positionScale = (hi - lo) / 65535.0f;
+        block.texCoordLow = tlo;
+        block.texCoordScale = (thi - tlo) / 65535.0f;
+
+        const Vector3 invPositionExtent = Vector3(1.0f, 1.0f, 1.0f) / (hi - lo).max(Vector3(1e-20f, 1e-20f, 1e-20f));
+        const Vector2 invTexCoordExtent = Vector2(1.0f, 1.0f) / (thi - tlo).max(Vector2(1e-20f, 1e-20f));
+
+        for (int i = start; i < stopBefore; ++i) {
+            const CPUVertexArray::Vertex& vertex = vertexArray.vertex[i];
+            PackedVertex& packed = m_vertex[i];
+            const Vector3& p = (vertex.position - lo) * invPositionExtent;
+            for (int a = 0; a < 3; ++a) {
+                packed.position[a] = unorm16(p[a]);
+            }
+
+            packed.flags = blockFlags;
+            if (vertex.normal.isNaN()) {
+                packed.flags |= NAN_NORMAL;
+            } else {
+                octEncode(vertex.normal, packed.normal);
+            }
+
+            if (! m_hasTangent || ! vertex.tangent.isFinite()) {
+                packed.flags |= NAN_TANGENT;
+            } else {
+                octEncode(vertex.tangent.xyz(), packed.tangent);
+                if (vertex.tangent.w < 0.0f) {
+                    packed.flags |= NEGATIVE_HANDEDNESS;
+                }
+            }
+
+            const Vector2& t = m_hasTexCoord0 ? (vertex.texCoord0 - tlo) * invTexCoordExtent : Vector2::zero();
+            packed.texCoord0[0] = unorm16(t.x);
+            packed.texCoord0[1] = unorm16(t.y);
+        }
+    });
+
+    // Replace data pointers with indices into a table of unique values. This is serial
+    // because the table is shared, but it is only a hash lookup per Tri.
+    Table<ReferenceCountedObject*, uint32> dataIndex;
+    m_tri.resize(triArray.size());
+    for (int t = 0; t < triArray.size(); ++t) {
+        const Tri& src = triArray[t];
+        PackedTri& dst = m_tri[t];
+        for (int v = 0; v < 3; ++v) {
+            dst.index[v] = src.index[v];
+        }
+        dst.area = src.area();
+
+        uint32 d = NO_DATA;
+        ReferenceCountedObject* data = src.m_data.get();
+        if (notNull(data)) {
+            bool created = false;
+            uint32& index = dataIndex.getCreate(data, created);
+            if (created) {
+                index = uint32(m_dataTable.size());
+                alwaysAssertM(index < NO_DATA, "Too many unique Tri data objects for CompactTriArray");
+                m_dataTable.append(src.m_data);
+            }
+            d = index;
+        }
+
+        dst.dataIndexAndFlags = d |
+            (src.twoSided() ? TWO_SIDED : 0) |
+            (src.hasPartialCoverage() ? HAS_PARTIAL_COVERAGE : 0);
+    }
+
+    m_stats.compressedBytes = sizeInBytes();
+}
+
+
+void CompactTriArray::decodeVertex(int vertexIndex, CPUVertexArray::Vertex& vertex) const {
+    const PackedVertex& packed = m_vertex[vertexIndex];
+    const Block& b = block(vertexIndex);
+
+    vertex.position = position(vertexIndex);
+    vertex.normal = (packed.flags & NAN_NORMAL) ? Vector3::nan() : octDecode(packed.normal);
+    vertex.tangent = (packed.flags & NAN_TANGENT) ? Vector4::nan() :
+        Vector4(octDecode(packed.tangent), (packed.flags & NEGATIVE_HANDEDNESS) ? -1.0f : 1.0f);
+    vertex.texCoord0 = b.texCoordLow + b.texCoordScale * Vector2(float(packed.texCoord0[0].bits()), float(packed.texCoord0[1].bits()));
+}
+
+
+Tri CompactTriArray::tri(int triIndex) const {
+    const PackedTri& packed = m_tri[triIndex];
+    const uint32 d = packed.dataIndexAndFlags & DATA_INDEX_MASK;
+
+    Tri t;
+    for (int v = 0; v < 3; ++v) {
+        t.index[v] = packed.index[v];
+    }
+    t.m_data  = (d == NO_DATA) ? nullptr : m_dataTable[d];
+    t.m_area  = packed.area;
+    t.m_flags = ((packed.dataIndexAndFlags & TWO_SIDED) ? Tri::TWO_SIDED : 0) |
+                ((packed.dataIndexAndFlags & HAS_PARTIAL_COVERAGE) ? Tri::HAS_PARTIAL_COVERAGE : 0);
+    return t;
+}
+
+
+Tri CompactTriArray::decodeTri(int triIndex, CPUVertexArray& vertexArray) const {
+    Tri t = tri(triIndex);
+
+    vertexArray.hasTexCoord0 = m_hasTexCoord0;
+    vertexArray.hasTangent = m_hasTangent;
+    vertexArray.vertex.resize(3, false);
+    for (int v = 0; v < 3; ++v) {
+        decodeVertex(t.index[v], vertexArray.vertex[v]);
+        t.index[v] = v;
+    }
+
+    return t;
+}
+
+
+bool CompactTriArray::intersectionAlphaTest(int triIndex, float u, float v, float threshold) const {
+    if (! hasPartialCoverage(triIndex)) {
+        return true;
+    }
+
+    // Reuse the per-thread scratch vertex array to avoid a heap allocation per test
+    static thread_local CPUVertexArray vertexArray;
+    return decodeTri(triIndex, vertexArray).intersectionAlphaTest(vertexArray, u, v, threshold);
+}
+
+
+void CompactTriArray::sample(float u, float v, int triIndex, bool backface, shared_ptr<Surfel>& surfel, float du, float dv, bool twoSided) const {
+    static thread_local CPUVertexArray vertexArray;
+    decodeTri(triIndex, vertexArray).sample(u, v, triIndex, vertexArray, backface, surfel, du, dv, twoSided);
+}
+
+} // namespace G3D
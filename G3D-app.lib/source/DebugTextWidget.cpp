@@ -98,9 +98,16 @@ void DebugTextWidget::render(RenderDevice *rd) const {
 
                     const int swapTime = iRound(rd->swapBufferTimer().smoothElapsedTime() / units::milliseconds());
 
-                    const String& str =
+                    String str =
                         format("Time:%4d ms Gfx,%4d ms Swap,%4d ms Sim,%4d ms Pose,%4d ms AI,%4d ms Net,%4d ms UI,%4d ms idle",
                         g, swapTime, s, p, L, n, u, w);
+
+                    const Texture::LoaderStats& loader = Texture::loaderStats();
+                    if (loader.queueDepth + loader.decoding > 0) {
+                        str += format("   Textures: %d queued, %d decoding,%4d ms avg decode",
+                            loader.queueDepth, loader.decoding,
+                            iRound(loader.totalDecodeTime / max(1, loader.decoded) / units::milliseconds()));
+                    }
                     m_app->debugFont->appendToCharVertexArray(charVertexArray, indexArray, rd, str, pos, size, statColor);
                 }
 
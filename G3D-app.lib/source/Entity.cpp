@@ -23,7 +23,7 @@
 
 namespace G3D {
 
-Entity::Entity() : m_scene(nullptr), m_movedSinceLoad(false), m_lastBoundsTime(0), m_lastChangeTime(0), m_canChange(true), m_shouldBeSaved(true) {}
+Entity::Entity() : m_scene(nullptr), m_movedSinceLoad(false), m_lastBoundsTime(0), m_lastChangeTime(0), m_canChange(true), m_shouldBeSaved(true), m_concurrentSimulation(true) {}
 
 
 void Entity::init
@@ -58,6 +58,7 @@ void Entity::init
     propertyTable.getIfPresent("mass", m_mass);
     propertyTable.getIfPresent("physicalSimulation", m_physicalSimulation);
     propertyTable.getIfPresent("canCauseCollisions", m_canCauseCollisions);
+    propertyTable.getIfPresent("concurrentSimulation", m_concurrentSimulation);
 }
 
 
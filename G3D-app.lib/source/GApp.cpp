@@ -17,6 +17,7 @@
 #include "G3D-base/units.h"
 #include "G3D-base/NetworkDevice.h"
 #include "G3D-app/AmbientOcclusion.h"
+#include "G3D-app/ArticulatedModel.h"
 #include "G3D-app/Camera.h"
 #include "G3D-app/CameraControlWindow.h"
 #include "G3D-app/DebugTextWidget.h"
@@ -1609,6 +1610,10 @@ void GApp::onPose(Array<shared_ptr<Surface> >& surface, Array<shared_ptr<Surface
     m_widgetManager->onPose(surface, surface2D);
 
     if (scene()) {
+        const shared_ptr<Camera>& camera = activeCamera();
+        if (notNull(camera)) {
+            scene()->setLODViewer(ArticulatedModel::LODViewer(camera->frame().translation, camera->projection().imagePlanePixelsPerMeter(renderDevice->viewport())));
+        }
         scene()->onPose(surface);
     }
 }
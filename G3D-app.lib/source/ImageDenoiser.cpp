@@ -0,0 +1,124 @@
+/**
+  \file G3D-app.lib/source/ImageDenoiser.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/Thread.h"
+#include "G3D-app/ImageDenoiser.h"
+
+namespace G3D {
+
+/** Copies \a image into a tightly packed array, or fills the array with \a defaultValue if the image is null */
+template<class ColorN, class T, class Convert>
+static void readImage(const shared_ptr<Image>& image, int width, int height, const T& defaultValue, Array<T>& array, const Convert& convert) {
+    array.resize(width * height);
+    if (isNull(image)) {
+        array.setAll(defaultValue);
+        return;
+    }
+
+    alwaysAssertM((image->width() == width) && (image->height() == height), "ImageDenoiser feature images must match the radiance image dimensions");
+    runConcurrently(0, height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            array[x + y * width] = convert(image->get<ColorN>(Point2int32(x, y)));
+        }
+    });
+}
+
+
+void ImageDenoiser::apply
+   (const shared_ptr<Image>&        radiance,
+    const shared_ptr<Image>&        albedo,
+    const shared_ptr<Image>&        normal,
+    const shared_ptr<Image>&        depth,
+    shared_ptr<Image>&              result,
+    const Settings&                 settings) {
+
+    alwaysAssertM(notNull(radiance), "ImageDenoiser requires a radiance image");
+    const int width = radiance->width();
+    const int height = radiance->height();
+
+    Array<Color3> color, albedoArray;
+    Array<Vector3> normalArray;
+    Array<float> depthArray;
+    readImage<Color3>(radiance, width, height, Color3::zero(), color, [](const Color3& c) { return c; });
+    readImage<Color3>(settings.demodulateAlbedo ? albedo : nullptr, width, height, Color3::one(), albedoArray, [](const Color3& c) { return c; });
+    readImage<Color3>(normal, width, height, Vector3::zero(), normalArray, [](const Color3& c) { return Vector3(c.r, c.g, c.b).directionOrZero(); });
+    readImage<Color1>(depth, width, height, 0.0f, depthArray, [](const Color1& c) { return c.value; });
+
+    // Avoid dividing by zero albedo on emitters and black surfaces; remodulation below is the exact inverse
+    static const float albedoEpsilon = 0.01f;
+    runConcurrently(0, color.size(), [&](int i) {
+        color[i] = color[i] / (albedoArray[i] + Color3(albedoEpsilon));
+    });
+
+    static const float kernel[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+    const bool useNormal = notNull(normal);
+    const bool useDepth = notNull(depth);
+
+    Array<Color3> filtered;
+    filtered.resize(color.size());
+    float colorSigma = settings.colorSigma;
+    for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+        const int step = 1 << iteration;
+        const float invColorSigma2 = 1.0f / max(square(colorSigma), 1e-10f);
+
+        runConcurrently(0, height, [&](int y) {
+            for (int x = 0; x < width; ++x) {
+                const int p = x + y * width;
+                const Color3& cP = color[p];
+                const Vector3& nP = normalArray[p];
+                const float zP = depthArray[p];
+                // Color differences are relative to the center, so that the filter is independent of exposure
+                const float invLuminance2 = 1.0f / (square(cP.average()) + 1e-6f);
+                const float invDepthScale = 1.0f / (settings.depthSigma * zP * float(step) + 1e-6f);
+
+                Color3 sum = Color3::zero();
+                float weightSum = 0.0f;
+                for (int j = -2; j <= 2; ++j) {
+                    const int qy = y + j * step;
+                    if ((qy < 0) || (qy >= height)) { continue; }
+                    for (int i = -2; i <= 2; ++i) {
+                        const int qx = x + i * step;
+                        if ((qx < 0) || (qx >= width)) { continue; }
+                        const int q = qx + qy * width;
+
+                        const Color3& delta = color[q] - cP;
+                        float w = kernel[i + 2] * kernel[j + 2] * expf(-delta.dot(delta) * invLuminance2 * invColorSigma2);
+                        if (useNormal) {
+                            w *= powf(max(0.0f, nP.dot(normalArray[q])), settings.normalPower);
+                        }
+                        if (useDepth) {
+                            w *= expf(-fabsf(depthArray[q] - zP) * invDepthScale);
+                        }
+
+                        sum += color[q] * w;
+                        weightSum += w;
+                    }
+                }
+
+                // The center tap always has weight unless the normal is zero (a miss), in which case keep the input
+                filtered[p] = (weightSum > 0.0f) ? sum / weightSum : cP;
+            }
+        });
+
+        Array<Color3>::swap(color, filtered);
+        colorSigma *= 0.5f;
+    }
+
+    if (isNull(result) || (result->width() != width) || (result->height() != height)) {
+        result = Image::create(width, height, ImageFormat::RGB32F());
+    }
+
+    runConcurrently(0, height, [&](int y) {
+        for (int x = 0; x < width; ++x) {
+            const int p = x + y * width;
+            result->set(Point2int32(x, y), color[p] * (albedoArray[p] + Color3(albedoEpsilon)));
+        }
+    });
+}
+
+} // namespace G3D
@@ -10,6 +10,10 @@
 #include "G3D-base/AreaMemoryManager.h"
 #include "G3D-base/Intersect.h"
 #include "G3D-base/CollisionDetection.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/Crypto.h"
+#include "G3D-base/FileSystem.h"
 #include "G3D-app/NativeTriTree.h"
 #include "G3D-gfx/RenderDevice.h"
 #include "G3D-app/Draw.h"
@@ -37,8 +41,8 @@ void NativeTriTree::intersectSphere
    (const Sphere& sphere,
     Array<Tri>&   triArray) const {
     if (m_root) {
-        Set<Tri*> alreadyAdded;
-        m_root->intersectSphere(sphere, m_vertexArray, triArray, alreadyAdded);
+        Set<int> alreadyAdded;
+        m_root->intersectSphere(*this, sphere, triArray, alreadyAdded);
     }
 }
 
@@ -47,8 +51,8 @@ void NativeTriTree::intersectBox
    (const AABox&  box,
     Array<Tri>&   triArray) const {
     if (m_root) {
-        Set<Tri*> alreadyAdded;
-        m_root->intersectBox(box, m_vertexArray, triArray, alreadyAdded);
+        Set<int> alreadyAdded;
+        m_root->intersectBox(*this, box, triArray, alreadyAdded);
     }
 }
 
@@ -61,14 +65,35 @@ void NativeTriTree::rebuild() {
         m_memoryManager.reset();
     }
 
-    Settings settings;
+    uint64 key = 0;
+    const bool useCache = ! m_cacheDirectory.empty() && (numTris() > 0);
+    if (useCache) {
+        key = cacheKey();
+        if (loadCache(key)) {
+            m_lastBuildTime = System::time();
+            return;
+        }
+    }
+
+    const Settings& settings = m_settings;
     static const float epsilon = 0.000001f;
 
     Array<Poly> source;
     // Don't add 0 area triangles to source
-    for (int i = 0; i < m_triArray.size(); ++i) {
-        if (m_triArray[i].area() > epsilon) {
-            source.append(Poly(m_vertexArray, &m_triArray[i]));
+    const int numTris = this->numTris();
+    const bool motion = hasMotion() && ! compact();
+    for (int i = 0; i < numTris; ++i) {
+        const float area = triArea(i);
+        if (area > epsilon) {
+            Point3 v0, v1, v2;
+            getTriPositions(i, v0, v1, v2);
+            if (motion) {
+                Point3 p0, p1, p2;
+                getTriPositions(i, 0.0f, p0, p1, p2);
+                source.append(Poly(v0, v1, v2, p0, p1, p2, area, i));
+            } else {
+                source.append(Poly(v0, v1, v2, area, i));
+            }
         }
     }
     
@@ -77,6 +102,10 @@ void NativeTriTree::rebuild() {
         m_root = new (m_memoryManager->alloc(sizeof(Node))) Node(source, settings, m_memoryManager);
     }
 
+    if (useCache && notNull(m_root)) {
+        saveCache(key);
+    }
+
     m_lastBuildTime = System::time();
 
     // alwaysAssertM(m_triArray.size() == m_triArray.capacity(), "Allocated too much memory for the Tri Array");
@@ -106,19 +135,14 @@ void NativeTriTree::Node::setValueArray(const Array<Poly>& src, const shared_ptr
     valueArray = reinterpret_cast<ValueArray*>(mm->alloc(sizeof(ValueArray)));
 
     valueArray->size = src.size();
-    valueArray->data = reinterpret_cast<const Tri**>(mm->alloc(sizeof(const Tri*) * valueArray->size));
+    valueArray->data = reinterpret_cast<int*>(mm->alloc(sizeof(int) * valueArray->size));
     for (int i = 0; i < valueArray->size; ++i) {
         const Poly& t = src[i];
         
         debugAssert(t.area() > 0.0f);
         
         valueArray->data[i] = t.source();
-        debugAssert(isValidHeapPointer(valueArray->data[i]));
-
-#       ifdef G3D_DEBUG
-            // Try dereferencing the tri to verify that it is legal
-            (void)valueArray->data[i]->getIndex(0); 
-#       endif
+        debugAssert(t.source() >= 0);
 
         // Update bounds on the value array
         lo = lo.min(t.low());
@@ -195,6 +219,72 @@ void NativeTriTree::Node::split(Array<Poly>& original, const Settings& settings,
 }
 
 
+void NativeTriTree::Node::serialize(BinaryOutput& b) const {
+    bounds.serialize(b);
+    b.writeFloat32(splitLocation);
+
+    // -1 marks a leaf
+    b.writeInt32(isLeaf() ? -1 : int32(splitAxis()));
+
+    b.writeInt32(notNull(valueArray) ? valueArray->size : 0);
+    if (notNull(valueArray)) {
+        valueArray->bounds.serialize(b);
+        for (int i = 0; i < valueArray->size; ++i) {
+            b.writeInt32(valueArray->data[i]);
+        }
+    }
+
+    if (! isLeaf()) {
+        child(0).serialize(b);
+        child(1).serialize(b);
+    }
+}
+
+
+bool NativeTriTree::Node::deserialize(BinaryInput& b, int numTris, const shared_ptr<MemoryManager>& mm) {
+    // Bounds, split location, axis, and value count. Guards against truncated files.
+    static const int64 HEADER_BYTES = sizeof(float) * 7 + sizeof(int32) * 2;
+    if (b.getLength() - b.getPosition() < HEADER_BYTES) {
+        return false;
+    }
+
+    bounds.deserialize(b);
+    splitLocation = b.readFloat32();
+    const int axis = b.readInt32();
+    const int numValues = b.readInt32();
+
+    if ((axis < -1) || (axis > 2) || (numValues < 0) || (numValues > numTris) ||
+        ((numValues > 0) && (b.getLength() - b.getPosition() < int64(sizeof(float) * 6 + sizeof(int32) * numValues)))) {
+        return false;
+    }
+
+    if (numValues > 0) {
+        valueArray = reinterpret_cast<ValueArray*>(mm->alloc(sizeof(ValueArray)));
+        valueArray->size = numValues;
+        valueArray->data = reinterpret_cast<int*>(mm->alloc(sizeof(int) * numValues));
+        valueArray->bounds.deserialize(b);
+        for (int i = 0; i < numValues; ++i) {
+            const int t = b.readInt32();
+            if ((t < 0) || (t >= numTris)) {
+                return false;
+            }
+            valueArray->data[i] = t;
+        }
+    }
+
+    if (axis >= 0) {
+        // Same layout as split(): children adjacent in memory, axis in the low bits
+        Node* ptr = (Node*) mm->alloc(sizeof(Node) * 2);
+        new (ptr) Node();
+        new (ptr + 1) Node();
+        packedChildAxis = reinterpret_cast<uintptr_t>(ptr) | static_cast<uintptr_t>(axis);
+        return ptr[0].deserialize(b, numTris, mm) && ptr[1].deserialize(b, numTris, mm);
+    }
+
+    return true;
+}
+
+
 void NativeTriTree::Node::destroy(const shared_ptr<MemoryManager>& mm) {
     // Destroy children
     if (! isLeaf()) {
@@ -424,8 +514,11 @@ static bool rayTriangleIntersection
    (const PrecomputedRay&                         ray,
     float                              minDistance,
     float                              maxDistance,
-    const Tri&                         tri,
-    const CPUVertexArray&              vertexArray,
+    const Point3&                      v0,
+    const Point3&                      v1,
+    const Point3&                      v2,
+    bool                               twoSided,
+    float                              area,
     TriTree::Hit&                  hitData,
     TriTree::IntersectRayOptions   options) {
     
@@ -436,21 +529,15 @@ static bool rayTriangleIntersection
     // How much to grow the edges of triangles by to allow for small roundoff.
     static const float conservative = 1e-8f;
 
-    // Get all vertex attributes from these to avoid unneccessary pointer indirection
-    const CPUVertexArray::Vertex& vertex0 = tri.vertex(vertexArray, 0);
-    const CPUVertexArray::Vertex& vertex1 = tri.vertex(vertexArray, 1);
-    const CPUVertexArray::Vertex& vertex2 = tri.vertex(vertexArray, 2);
-    
-    const Vector3& v0 = vertex0.position;
-    const Vector3& e1 = vertex1.position - v0;
-    const Vector3& e2 = vertex2.position - v0;
+    const Vector3& e1 = v1 - v0;
+    const Vector3& e2 = v2 - v0;
 
     const bool noBackfaceTest = (options & NativeTriTree::DO_NOT_CULL_BACKFACES) != 0;
 
     // This test is equivalent to n.dot(ray.direction()) >= -EPS
     // Where n is the face unit normal, which we do not explicitly store
     // The first two check whether we should treat the tri as double sided
-    if (! (noBackfaceTest || tri.twoSided()) && (tri.area() >= 0) && (e1.cross(e2)).dot(ray.direction()) >= -EPS * 2.0f * tri.area()) {
+    if (! (noBackfaceTest || twoSided) && (area >= 0) && (e1.cross(e2)).dot(ray.direction()) >= -EPS * 2.0f * area) {
         // Backface or nearly parallel
         return false;
     }
@@ -487,25 +574,16 @@ static bool rayTriangleIntersection
     const float t = e2.dot(q);
 
     if ((t > minDistance) && (t < maxDistance)) {
-        const bool alphaTest = ((options & NativeTriTree::NO_PARTIAL_COVERAGE_TEST) == 0);
-        const float alphaThreshold = ((options & NativeTriTree::PARTIAL_COVERAGE_THRESHOLD_ZERO) != 0) ? 1.0f : 0.5f;
-
-        if (alphaTest && ! tri.intersectionAlphaTest(vertexArray, u, v, alphaThreshold)) {
-            // Failed the filter (e.g., alpha test)
-            return false;
-        } else {
-
-            // This is a new hit.  Save away the data about the hit
-            // location (including if we hit the backside), but don't bother computing barycentric w,
-            // the hit location or the normal until after we've checked
-            // against all triangles.
-            // The triangle index will be filled in by the caller
-            hitData.distance = t;
-            hitData.u = u;
-            hitData.v = v;
-            hitData.backface = (a < 0);
-            return true;
-        }
+        // This is a candidate hit.  Save away the data about the hit
+        // location (including if we hit the backside), but don't bother computing barycentric w,
+        // the hit location or the normal until after we've checked
+        // against all triangles.
+        // The caller applies the partial coverage test and fills in the triangle index.
+        hitData.distance = t;
+        hitData.u = u;
+        hitData.v = v;
+        hitData.backface = (a < 0);
+        return true;
     } else {
         return false;
     }
@@ -515,6 +593,7 @@ static bool rayTriangleIntersection
 bool NativeTriTree::Node::intersectRay
    (const NativeTriTree&                     triTree,
     const PrecomputedRay&                         ray,
+    float                              time,
     float                              maxDistance,
     Hit&                               hitData,
     IntersectRayOptions                options) const {
@@ -539,7 +618,7 @@ bool NativeTriTree::Node::intersectRay
     bool hit = false;
     // Test on the side closer to the ray origin.
     if (firstChild != NONE) {
-        hit = child(firstChild).intersectRay(triTree, ray, maxDistance, hitData, options) || hit;
+        hit = child(firstChild).intersectRay(triTree, ray, time, maxDistance, hitData, options) || hit;
         if (((options & OCCLUSION_TEST_ONLY) != 0) && hit) {
             return true;
         } else if (hit) {
@@ -554,16 +633,24 @@ bool NativeTriTree::Node::intersectRay
         (valueArray->size > 0) && 
         intersect(ray, valueArray->bounds, maxDistance)) {
 
+        const bool alphaTest = ((options & NativeTriTree::NO_PARTIAL_COVERAGE_TEST) == 0);
+        const float alphaThreshold = ((options & NativeTriTree::PARTIAL_COVERAGE_THRESHOLD_ZERO) != 0) ? 1.0f : 0.5f;
+
         // Test for intersection against every object at this node.
         for (int v = 0; v < valueArray->size; ++v) { 
-            const Tri& tri = *(valueArray->data[v]);
-            const bool justHit = rayTriangleIntersection(ray, ray.minDistance(), maxDistance, tri, triTree.m_vertexArray, hitData, options);
+            const int triIndex = valueArray->data[v];
+            Point3 v0, v1, v2;
+            triTree.getTriPositions(triIndex, time, v0, v1, v2);
+
+            Hit candidate;
+            const bool justHit = rayTriangleIntersection(ray, ray.minDistance(), maxDistance, v0, v1, v2, triTree.triTwoSided(triIndex), triTree.triArea(triIndex), candidate, options) &&
+                // Filter (e.g., alpha test)
+                (! alphaTest || triTree.triIntersectionAlphaTest(triIndex, candidate.u, candidate.v, alphaThreshold));
             
             if (justHit) {
                 hit = true;
-                // Pointer arithmetic to find what index in the tri tree array this triangle was.
-                // The data array is a set of pointers into the triArray.
-                hitData.triIndex = int(valueArray->data[v] - triTree.m_triArray.getCArray());
+                hitData = candidate;
+                hitData.triIndex = triIndex;
 
                 if ((options & OCCLUSION_TEST_ONLY) != 0) {
                     return true;
@@ -591,7 +678,7 @@ bool NativeTriTree::Node::intersectRay
             }
         }
         
-        hit = child(secondChild).intersectRay(triTree, ray, maxDistance, hitData, options) || hit;
+        hit = child(secondChild).intersectRay(triTree, ray, time, maxDistance, hitData, options) || hit;
     }
 
     return hit;
@@ -629,7 +716,7 @@ static void draw(RenderDevice* rd, const AABox& m_box, const Color4& color) {
 #endif
 
 
-void NativeTriTree::Node::intersectSphere(const Sphere& sphere, const CPUVertexArray& vertexArray, Array<Tri>& triArray, Set<Tri*>& alreadyAdded) const {
+void NativeTriTree::Node::intersectSphere(const NativeTriTree& triTree, const Sphere& sphere, Array<Tri>& triArray, Set<int>& alreadyAdded) const {
     if (! bounds.intersects(sphere)) {
         return;
     }
@@ -637,12 +724,13 @@ void NativeTriTree::Node::intersectSphere(const Sphere& sphere, const CPUVertexA
     // Add the triangles at this node
     if (valueArray && valueArray->bounds.intersects(sphere)) {
         for (int v = 0; v < valueArray->size; ++v) {
-            Tri* tri = const_cast<Tri*>(valueArray->data[v]);
-            if (! alreadyAdded.contains(tri)) {
-                if ((tri->area() > 0) && CollisionDetection::fixedSolidSphereIntersectsFixedTriangle(sphere, Triangle(tri->position(vertexArray, 0), 
-                                                                                       tri->position(vertexArray, 1), tri->position(vertexArray, 2)))) {
-                    triArray.append(*tri);
-                    alreadyAdded.insert(tri);
+            const int t = valueArray->data[v];
+            if (! alreadyAdded.contains(t)) {
+                Point3 v0, v1, v2;
+                triTree.getTriPositions(t, v0, v1, v2);
+                if ((triTree.triArea(t) > 0) && CollisionDetection::fixedSolidSphereIntersectsFixedTriangle(sphere, Triangle(v0, v1, v2))) {
+                    triArray.append(triTree.tri(t));
+                    alreadyAdded.insert(t);
                 }
             }
         }
@@ -651,13 +739,13 @@ void NativeTriTree::Node::intersectSphere(const Sphere& sphere, const CPUVertexA
     // Recurse into children
     if (! isLeaf()) {
         for (int c = 0; c < 2; ++c) {
-            child(c).intersectSphere(sphere, vertexArray, triArray, alreadyAdded);
+            child(c).intersectSphere(triTree, sphere, triArray, alreadyAdded);
         }
     }
 }
 
 
-void NativeTriTree::Node::intersectBox(const AABox& box,  const CPUVertexArray& vertexArray, Array<Tri>& triArray, Set<Tri*>& alreadyAdded) const {
+void NativeTriTree::Node::intersectBox(const NativeTriTree& triTree, const AABox& box, Array<Tri>& triArray, Set<int>& alreadyAdded) const {
     if (! bounds.intersects(box)) {
         return;
     }
@@ -665,12 +753,13 @@ void NativeTriTree::Node::intersectBox(const AABox& box,  const CPUVertexArray&
     // Add the triangles at this node
     if (valueArray && valueArray->bounds.intersects(box)) {
         for (int v = 0; v < valueArray->size; ++v) {
-            Tri* tri = const_cast<Tri*>(valueArray->data[v]);
-            if (! alreadyAdded.contains(tri)) {
-                if ((tri->area() > 0) && CollisionDetection::fixedSolidBoxIntersectsFixedTriangle(box, Triangle(tri->position(vertexArray, 0), 
-                                                                                 tri->position(vertexArray, 1), tri->position(vertexArray, 2)))) {
-                    triArray.append(*tri);
-                    alreadyAdded.insert(tri);
+            const int t = valueArray->data[v];
+            if (! alreadyAdded.contains(t)) {
+                Point3 v0, v1, v2;
+                triTree.getTriPositions(t, v0, v1, v2);
+                if ((triTree.triArea(t) > 0) && CollisionDetection::fixedSolidBoxIntersectsFixedTriangle(box, Triangle(v0, v1, v2))) {
+                    triArray.append(triTree.tri(t));
+                    alreadyAdded.insert(t);
                 }
             }
         }
@@ -679,7 +768,7 @@ void NativeTriTree::Node::intersectBox(const AABox& box,  const CPUVertexArray&
     // Recurse into children
     if (! isLeaf()) {
         for (int c = 0; c < 2; ++c) {
-            child(c).intersectBox(box, vertexArray, triArray, alreadyAdded);
+            child(c).intersectBox(triTree, box, triArray, alreadyAdded);
         }
     }
 }
@@ -805,6 +894,97 @@ void NativeTriTree::clear() {
 }
 
 
+uint64 NativeTriTree::cacheKey() const {
+    uint64 hash = Crypto::FNV1A64_BASIS;
+
+    // Copy the constant, because taking the address of an in-class initialized static member requires a definition
+    const uint32 version = CACHE_VERSION;
+    hash = Crypto::fnv1a64(&version, sizeof(version), hash);
+    hash = Crypto::fnv1a64(&m_settings.algorithm, sizeof(m_settings.algorithm), hash);
+    hash = Crypto::fnv1a64(&m_settings.maxAreaFraction, sizeof(m_settings.maxAreaFraction), hash);
+    hash = Crypto::fnv1a64(&m_settings.valuesPerLeaf, sizeof(m_settings.valuesPerLeaf), hash);
+    hash = Crypto::fnv1a64(&m_settings.accurateSAHCountThreshold, sizeof(m_settings.accurateSAHCountThreshold), hash);
+
+    // The tree depends only on the triangle positions and areas, and not on the other vertex attributes
+    const int n = numTris();
+    const bool motion = hasMotion() && ! compact();
+    hash = Crypto::fnv1a64(&n, sizeof(n), hash);
+    hash = Crypto::fnv1a64(&motion, sizeof(motion), hash);
+    for (int t = 0; t < n; ++t) {
+        Point3 v[6];
+        getTriPositions(t, v[0], v[1], v[2]);
+        const float area = triArea(t);
+        hash = Crypto::fnv1a64(v, sizeof(Point3) * 3, hash);
+        hash = Crypto::fnv1a64(&area, sizeof(area), hash);
+        if (motion) {
+            getTriPositions(t, 0.0f, v[3], v[4], v[5]);
+            hash = Crypto::fnv1a64(v + 3, sizeof(Point3) * 3, hash);
+        }
+    }
+
+    return hash;
+}
+
+
+String NativeTriTree::cacheFilename(uint64 key) const {
+    return FilePath::concat(m_cacheDirectory, format("%016llx.NativeTriTree", (unsigned long long)key));
+}
+
+
+static const char* CACHE_MAGIC = "G3D NativeTriTree";
+
+bool NativeTriTree::loadCache(uint64 key) {
+    const String& filename = cacheFilename(key);
+    if (! FileSystem::exists(filename, false)) {
+        return false;
+    }
+
+    BinaryInput b(filename, G3D_LITTLE_ENDIAN);
+
+    // BinaryInput checks bounds only in debug builds, so reject empty and truncated files before reading
+    // the magic string with its terminator, version, key, and triangle count
+    const int64 magicBytes = int64(strlen(CACHE_MAGIC)) + 1;
+    if (b.getLength() < magicBytes + int64(sizeof(uint32) + sizeof(uint64) + sizeof(int32))) {
+        debugPrintf("NativeTriTree: ignoring truncated cache file %s\n", filename.c_str());
+        return false;
+    }
+
+    if ((b.readString(magicBytes) != CACHE_MAGIC) || (b.readUInt32() != CACHE_VERSION) || (b.readUInt64() != key)) {
+        return false;
+    }
+
+    const int n = b.readInt32();
+    if (n != numTris()) {
+        return false;
+    }
+
+    m_memoryManager = AreaMemoryManager::create();
+    m_root = new (m_memoryManager->alloc(sizeof(Node))) Node();
+    if (! m_root->deserialize(b, n, m_memoryManager)) {
+        debugPrintf("NativeTriTree: ignoring corrupt cache file %s\n", filename.c_str());
+        // The area memory manager releases the partial tree all at once
+        m_root = nullptr;
+        m_memoryManager.reset();
+        return false;
+    }
+
+    return true;
+}
+
+
+void NativeTriTree::saveCache(uint64 key) const {
+    FileSystem::createDirectory(m_cacheDirectory);
+
+    BinaryOutput b(cacheFilename(key), G3D_LITTLE_ENDIAN);
+    b.writeString(CACHE_MAGIC);
+    b.writeUInt32(CACHE_VERSION);
+    b.writeUInt64(key);
+    b.writeInt32(numTris());
+    m_root->serialize(b);
+    b.commit();
+}
+
+
 void NativeTriTree::draw(RenderDevice* rd, int level, bool showBoxes, int minNodeSize) {
     if (m_root) {
         rd->setCullFace(CullFace::NONE);
@@ -826,8 +1006,18 @@ bool NativeTriTree::intersectRay
     Hit&                               hit,
     IntersectRayOptions                options) const {
 
+    return intersectRay(ray, 1.0f, hit, options);
+}
+
+
+bool NativeTriTree::intersectRay
+   (const PrecomputedRay&              ray,
+    float                              time,
+    Hit&                               hit,
+    IntersectRayOptions                options) const {
+
     float maxDistance = ray.maxDistance();
-    return notNull(m_root) && m_root->intersectRay(*this, ray, maxDistance, hit, options);        
+    return notNull(m_root) && m_root->intersectRay(*this, ray, time, maxDistance, hit, options);
 }
 
 
@@ -850,7 +1040,7 @@ shared_ptr<Surfel> NativeTriTree::intersectRay
     Hit hit;
     if (intersectRay(ray, hit, options)) {
         shared_ptr<Surfel> surfel;
-        m_triArray[hit.triIndex].sample(hit.u, hit.v, hit.triIndex, m_vertexArray, hit.backface, surfel);
+        sample(hit, surfel);
         return surfel;
     } else {
         return nullptr;
@@ -888,6 +1078,20 @@ void NativeTriTree::intersectRays
     runConcurrently(0, prays.size(), [&](int i) { intersectRay(prays[i], results[i], options); });
 }
 
+
+void NativeTriTree::intersectRays
+   (const Array<Ray>&        rays,
+    const Array<float>&      rayTime,
+    Array<Hit>&              results,
+    IntersectRayOptions      options) const {
+
+    debugAssertM(rayTime.size() == rays.size(), "Must have one time per ray");
+    results.resize(rays.size());
+    runConcurrently(0, rays.size(), [&](int i) {
+        intersectRay(PrecomputedRay(rays[i]), clamp(rayTime[i], 0.0f, 1.0f), results[i], options);
+    });
+}
+
 #ifdef _MSC_VER
 // Turn off fast floating-point optimizations
 #pragma float_control( pop )
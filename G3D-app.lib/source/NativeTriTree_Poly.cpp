@@ -12,28 +12,36 @@
 
 namespace G3D {
 
-NativeTriTree::Poly::Poly() : m_source(nullptr), m_area(0) {}
+NativeTriTree::Poly::Poly() : m_source(-1), m_area(0), m_moving(false) {}
 
-NativeTriTree::Poly::Poly(const CPUVertexArray& vertexArray, const Tri* tri) : 
-    m_source(tri),
-    m_low(Vector3::inf()),
-    m_high(-Vector3::inf()),
-    m_area(tri->area()) {
+NativeTriTree::Poly::Poly(const Point3& v0, const Point3& v1, const Point3& v2, float area, int source) : 
+    m_source(source),
+    m_low(v0.min(v1).min(v2)),
+    m_high(v0.max(v1).max(v2)),
+    m_area(area),
+    m_moving(false) {
 
     m_vertex.resize(3);
-    for (int v = 0; v < 3; ++v) {
-        const Vector3& x = tri->position(vertexArray, v);
-        m_vertex[v] = x;
-        m_low  = m_low.min(x);
-        m_high = m_high.max(x);
-    }
+    m_vertex[0] = v0;
+    m_vertex[1] = v1;
+    m_vertex[2] = v2;
+}
+
+
+NativeTriTree::Poly::Poly(const Point3& v0, const Point3& v1, const Point3& v2, const Point3& p0, const Point3& p1, const Point3& p2, float area, int source) :
+    Poly(v0, v1, v2, area, source) {
+
+    // Every point of the interpolated triangle is a convex combination of the six vertices
+    m_low  = m_low.min(p0).min(p1).min(p2);
+    m_high = m_high.max(p0).max(p1).max(p2);
+    m_moving = (v0 != p0) || (v1 != p1) || (v2 != p2);
 }
 
 
 void NativeTriTree::Poly::draw(RenderDevice* rd, const CPUVertexArray& vertexArray) const {
     /*
     rd->beginPrimitive(PrimitiveType::TRIANGLE_FAN);
-    rd->setNormal(m_source->normal(vertexArray));
+    rd->setNormal((m_vertex[1] - m_vertex[0]).cross(m_vertex[2] - m_vertex[0]).directionOrZero());
     for (int i = 0; i < m_vertex.size(); ++i) {
         rd->sendVertex(m_vertex[i]);
     }
@@ -59,7 +67,7 @@ void NativeTriTree::Poly::split
     } else if (m_low[axis] >= offset) {
         highArray.append(*this);
         //debugPrintf("HIGH\n");
-    } else if (m_area >= minSpanArea) {
+    } else if (m_moving || (m_area >= minSpanArea)) {
         //debugPrintf("--span--\n");
         largeSpanArray.append(*this);
     } else {
@@ -68,10 +76,12 @@ void NativeTriTree::Poly::split
         Poly& H = highArray.next();
 
         L.m_source     = m_source;
+        L.m_moving     = false;
         L.m_low        = Vector3::inf();
         L.m_high       = -Vector3::inf();
 
         H.m_source     = m_source;
+        H.m_moving     = false;
         H.m_low        = Vector3::inf();
         H.m_high       = -Vector3::inf();
 
@@ -284,7 +284,8 @@ void ParticleSystemModel::Emitter::spawnParticles(ParticleSystem* system, int ne
     // a good location by rejection sampling after this many tries.
     const int MAX_NOISE_SAMPLING_TRIES = 20;
 
-    Random& rng = Random::threadCommon();
+    // Each system has its own generator so that emission does not depend on which thread simulates it
+    Random& rng = system->m_rng;
     Noise& noise = Noise::common();
     
     debugAssert(notNull(m_spawnShape));
@@ -13,6 +13,7 @@
 #include "G3D-app/Camera.h"
 #include "G3D-app/Scene.h"
 #include "G3D-app/UniversalSurfel.h"
+#include "G3D-app/NativeTriTree.h"
 #include "G3D-gfx/GLPixelTransferBuffer.h"
 
 namespace G3D {
@@ -55,6 +56,17 @@ void PathTracer::traceImage
     const shared_ptr<Camera>&           camera,
     const Options&                      options,
     const std::function<void(const String&, float)>& statusCallback) const {
+
+    traceImage(radianceImage, AOVImages(), camera, options, statusCallback);
+}
+
+
+void PathTracer::traceImage
+   (const shared_ptr<Image>&            radianceImage,
+    const AOVImages&                    aovImages,
+    const shared_ptr<Camera>&           camera,
+    const Options&                      options,
+    const std::function<void(const String&, float)>& statusCallback) const {
     
     // Visible area lights are handled by indirect rays during
     // recursive ray importance sampling. Point lights and invisible
@@ -70,6 +82,22 @@ void PathTracer::traceImage
     // Total contribution, taking individual ray filter footprints into account
     const shared_ptr<Image>& weightSumImage = Image::create(radianceImage->width(), radianceImage->height(), ImageFormat::R32F());
 
+    // The denoiser needs every feature, so allocate the ones that the caller did not request
+    AOVImages features = aovImages;
+    if (options.denoise) {
+        if (isNull(features.albedo)) { features.albedo = Image::create(radianceImage->width(), radianceImage->height(), ImageFormat::RGB32F()); }
+        if (isNull(features.normal)) { features.normal = Image::create(radianceImage->width(), radianceImage->height(), ImageFormat::RGB32F()); }
+        if (isNull(features.depth))  { features.depth  = Image::create(radianceImage->width(), radianceImage->height(), ImageFormat::R32F()); }
+    }
+
+    for (const shared_ptr<Image>& image : {features.albedo, features.normal, features.depth}) {
+        if (notNull(image)) {
+            alwaysAssertM((image->width() == radianceImage->width()) && (image->height() == radianceImage->height()), "AOV images must have the same dimensions as the radiance image");
+            image->setAll(Color3::zero());
+        }
+    }
+    const AOVImages* aovPtr = features.empty() ? nullptr : &features;
+
     // All operations act on all pixels in parallel
     radianceImage->setAll(Radiance3::zero());
     for (int rayIndex = 0; rayIndex < options.raysPerPixel; ++rayIndex) {
@@ -83,7 +111,7 @@ void PathTracer::traceImage
         // Visualize eye rays
         // for (Point2int32 P(0, 0); P.y < radianceImage->height(); ++P.y) for (P.x = 0; P.x < radianceImage->width(); ++P.x) radianceImage->set(P, Radiance3(rayBuffer[P.x + P.y * radianceImage->width()].direction() * 0.5f + Vector3::one() * 0.5f)); return;
 
-        traceBufferInternal(buffers, nullptr, radianceImage, nullptr, directLightArray, indirectLightArray, rayIndex);
+        traceBufferInternal(buffers, nullptr, radianceImage, nullptr, directLightArray, indirectLightArray, rayIndex, aovPtr);
 
         if (statusCallback) { statusCallback(format("%d/%d rays/pixel", rayIndex, options.raysPerPixel), float(rayIndex) / float(options.raysPerPixel)); }
     } // for rays per pixel
@@ -91,9 +119,241 @@ void PathTracer::traceImage
     // Normalize by the weight per pixel
     runConcurrently(Point2int32(0, 0), Point2int32(radianceImage->width(), radianceImage->height()), [&](Point2int32 pix) {
         debugAssertM(isFinite(weightSumImage->get<Color1>(pix).value), "Infinite/NaN weight");
-        radianceImage->set(pix, radianceImage->get<Radiance3>(pix) / max(0.00001f, weightSumImage->get<Color1>(pix).value));
+        const float invWeight = 1.0f / max(0.00001f, weightSumImage->get<Color1>(pix).value);
+        radianceImage->set(pix, radianceImage->get<Radiance3>(pix) * invWeight);
         debugAssertM(radianceImage->get<Color3>(pix).isFinite(), "Infinite/NaN radiance");
+
+        if (notNull(features.albedo)) { features.albedo->set(pix, features.albedo->get<Color3>(pix) * invWeight); }
+        if (notNull(features.normal)) { features.normal->set(pix, features.normal->get<Color3>(pix) * invWeight); }
+        if (notNull(features.depth))  { features.depth->set(pix, features.depth->get<Color1>(pix) * invWeight); }
     }, ! m_options.multithreaded);
+
+    if (options.denoise) {
+        if (statusCallback) { statusCallback("Denoising", 1.0f); }
+        shared_ptr<Image> result = radianceImage;
+        ImageDenoiser::apply(radianceImage, features.albedo, features.normal, features.depth, result, options.denoiserSettings);
+    }
+}
+
+
+namespace _internal {
+/** A rectangular region of the image refined together by PathTracer::traceImageProgressive. 
+    All pixels in a tile always have the same number of samples. */
+class ProgressiveTile {
+public:
+    Point2int32     start;
+    Point2int32     stopBefore;
+
+    /** Samples taken at each pixel so far */
+    int             sampleCount = 0;
+
+    /** Samples to take at each pixel during the current pass */
+    int             samplesThisPass = 0;
+
+    /** Mean estimated relative standard error of the pixels */
+    float           error = finf();
+
+    bool            converged = false;
+};
+} // namespace _internal
+
+
+PathTracer::ProgressiveStats PathTracer::traceImageProgressive
+   (const shared_ptr<Image>&            radianceImage,
+    const shared_ptr<Camera>&           camera,
+    const Options&                      options,
+    const ProgressiveOptions&           progressiveOptions,
+    const PassCallback&                 passCallback) const {
+
+    using _internal::ProgressiveTile;
+
+    Array<shared_ptr<Light>> directLightArray, indirectLightArray;
+    prepare(options, directLightArray, indirectLightArray);
+
+    const int width  = radianceImage->width();
+    const int height = radianceImage->height();
+    const int tileSize = max(1, progressiveOptions.tileSize);
+    const int minSamplesPerPixel = max(2, progressiveOptions.minSamplesPerPixel);
+    const int maxSamplesPerPixel = max(minSamplesPerPixel, progressiveOptions.maxSamplesPerPixel);
+
+    // Low-discrepancy sequences for lens and light sampling span the largest possible sample count
+    m_options.raysPerPixel = maxSamplesPerPixel;
+
+    // Luminance is small for dark pixels, so use an absolute floor to avoid
+    // spending samples on noise that is invisible after tone mapping
+    static const float minMeanLuminance = 1e-3f;
+
+    Array<ProgressiveTile> tileArray;
+    for (int y = 0; y < height; y += tileSize) {
+        for (int x = 0; x < width; x += tileSize) {
+            ProgressiveTile& tile = tileArray.next();
+            tile.start = Point2int32(x, y);
+            tile.stopBefore = Point2int32(min(x + tileSize, width), min(y + tileSize, height));
+        }
+    }
+
+    // Per-pixel running sums for the mean radiance and the variance of the luminance
+    const int numPixels = width * height;
+    Array<Radiance3> radianceSum;
+    Array<double> luminanceSum, luminanceSquaredSum;
+    radianceSum.resize(numPixels);
+    luminanceSum.resize(numPixels);
+    luminanceSquaredSum.resize(numPixels);
+    radianceSum.setAll(Radiance3::zero());
+    luminanceSum.setAll(0.0);
+    luminanceSquaredSum.setAll(0.0);
+
+    const Rect2D viewport = Rect2D::xywh(0.0f, 0.0f, float(width), float(height));
+    const bool depthOfField = camera->depthOfFieldSettings().enabled() && (camera->depthOfFieldSettings().model() == DepthOfFieldModel::PHYSICAL);
+
+    ProgressiveStats stats;
+    stats.numTiles = tileArray.size();
+    stats.activeTiles = tileArray.size();
+
+    BufferSet buffers;
+    Array<Radiance3> output;
+    Array<Point2int32> pixelOfRay;
+    Array<int> sampleIndexOfRay;
+    int rayIndex = 0;
+
+    radianceImage->setAll(Radiance3::zero());
+    for (int pass = 0; (pass < progressiveOptions.maxPasses) && (stats.activeTiles > 0); ++pass) {
+
+        // Allocate samples to tiles. Error falls with the square root of the sample count,
+        // so the count needed to reach the target is n * (error / target)^2.
+        int maxSamplesThisPass = 0;
+        for (ProgressiveTile& tile : tileArray) {
+            if (tile.converged) {
+                tile.samplesThisPass = 0;
+            } else if (tile.sampleCount == 0) {
+                tile.samplesThisPass = minSamplesPerPixel;
+            } else {
+                const float ratio = tile.error / max(progressiveOptions.targetRelativeError, 1e-6f);
+                const int remaining = iCeil(float(tile.sampleCount) * square(ratio)) - tile.sampleCount;
+                tile.samplesThisPass = iClamp(remaining, 1, min(max(1, progressiveOptions.maxSamplesPerPass), maxSamplesPerPixel - tile.sampleCount));
+            }
+            maxSamplesThisPass = max(maxSamplesThisPass, tile.samplesThisPass);
+        }
+
+        // Each trace gives a pixel at most one sample, so that the per-sample radiance
+        // is available for the variance estimate
+        for (int s = 0; s < maxSamplesThisPass; ++s, ++rayIndex) {
+            pixelOfRay.fastClear();
+            sampleIndexOfRay.fastClear();
+            for (const ProgressiveTile& tile : tileArray) {
+                if (tile.samplesThisPass > s) {
+                    for (Point2int32 P(tile.start); P.y < tile.stopBefore.y; ++P.y) {
+                        for (P.x = tile.start.x; P.x < tile.stopBefore.x; ++P.x) {
+                            pixelOfRay.append(P);
+                            sampleIndexOfRay.append(tile.sampleCount + s);
+                        }
+                    }
+                }
+            }
+
+            const int numRays = pixelOfRay.size();
+            buffers.resize(numRays);
+            buffers.modulation.setAll(Color3::one());
+            buffers.impulseRay.setAll(true);
+            buffers.outputIndex.resize(numRays);
+            buffers.outputCoord.resize(numRays);
+            output.resize(numRays);
+
+            runConcurrently(0, numRays, [&](int i) {
+                const Point2int32& pixel = pixelOfRay[i];
+                Random& rng = Random::threadCommon();
+                const Point2 P(float(pixel.x) + rng.uniform(), float(pixel.y) + rng.uniform());
+                buffers.ray[i] = eyeRay(camera, viewport, pixel, P, depthOfField, sampleIndexOfRay[i], maxSamplesPerPixel);
+                buffers.outputIndex[i] = i;
+                buffers.outputCoord[i] = Point2(pixel);
+                output[i] = Radiance3::zero();
+            }, ! m_options.multithreaded);
+
+            traceBufferInternal(buffers, output.getCArray(), radianceImage, nullptr, directLightArray, indirectLightArray, rayIndex % maxSamplesPerPixel);
+
+            // Each pixel appears at most once per trace, so these writes do not conflict
+            runConcurrently(0, numRays, [&](int i) {
+                const int p = pixelOfRay[i].x + pixelOfRay[i].y * width;
+                const Radiance3& L = output[i];
+                debugAssertM(L.isFinite(), "Infinite/NaN radiance");
+                const double luminance = double(L.r) * 0.2126 + double(L.g) * 0.7152 + double(L.b) * 0.0722;
+                radianceSum[p] += L;
+                luminanceSum[p] += luminance;
+                luminanceSquaredSum[p] += square(luminance);
+            }, ! m_options.multithreaded);
+
+            stats.totalSamples += numRays;
+        } // for sample
+
+        // Update error estimates and write the current estimate for tiles that changed
+        runConcurrently(0, tileArray.size(), [&](int t) {
+            ProgressiveTile& tile = tileArray[t];
+            if (tile.samplesThisPass == 0) { return; }
+            tile.sampleCount += tile.samplesThisPass;
+
+            const double n = double(tile.sampleCount);
+            double errorSum = 0.0;
+            for (Point2int32 P(tile.start); P.y < tile.stopBefore.y; ++P.y) {
+                for (P.x = tile.start.x; P.x < tile.stopBefore.x; ++P.x) {
+                    const int p = P.x + P.y * width;
+                    radianceImage->set(P, radianceSum[p] / float(n));
+
+                    const double mean = luminanceSum[p] / n;
+                    const double variance = max(0.0, (luminanceSquaredSum[p] / n - square(mean)) * n / (n - 1.0));
+                    errorSum += sqrt(variance / n) / max(mean, double(minMeanLuminance));
+                }
+            }
+
+            const Vector2int32 extent = tile.stopBefore - tile.start;
+            tile.error = float(errorSum / double(extent.x * extent.y));
+            tile.converged = (tile.sampleCount >= maxSamplesPerPixel) ||
+                ((tile.sampleCount >= minSamplesPerPixel) && (tile.error <= progressiveOptions.targetRelativeError));
+        }, ! m_options.multithreaded);
+
+        stats.pass = pass;
+        stats.activeTiles = 0;
+        stats.maxTileError = 0.0f;
+        int64 pixelSamples = 0;
+        for (const ProgressiveTile& tile : tileArray) {
+            const Vector2int32 extent = tile.stopBefore - tile.start;
+            pixelSamples += int64(tile.sampleCount) * int64(extent.x * extent.y);
+            if (! tile.converged) {
+                ++stats.activeTiles;
+                stats.maxTileError = max(stats.maxTileError, tile.error);
+            }
+        }
+        stats.averageSamplesPerPixel = float(double(pixelSamples) / double(max(numPixels, 1)));
+
+        if (passCallback && ! passCallback(radianceImage, stats)) {
+            break;
+        }
+    } // for pass
+
+    return stats;
+}
+
+
+Ray PathTracer::eyeRay
+   (const shared_ptr<Camera>&           camera,
+    const Rect2D&                       viewport,
+    const Point2int32&                  pixel,
+    const Point2&                       P,
+    bool                                depthOfField,
+    int                                 rayIndex,
+    int                                 raysPerPixel) const {
+
+    if (depthOfField) {
+        // Hammersley sequence remapped from a square to a disk
+        const uint32_t hash = superFastHash(&pixel, sizeof(pixel));
+        const Point2 pixelShift((hash >> 16) / float(0xFFFF), (hash & 0xFFFF) / float(0xFFFF));
+        const Point2& h = (Point2::hammersleySequence2D(rayIndex, raysPerPixel) + pixelShift).mod1();
+        const float angle = 2.0f * h.x * pif();
+        const float radius = sqrt(h.y);
+        const Point2 lens(cos(angle) * radius, sin(angle) * radius);
+        return camera->worldRay(P.x, P.y, lens.x, lens.y, viewport);
+    } else {
+        return camera->worldRay(P.x, P.y, viewport);
+    }
 }
 
 
@@ -121,20 +381,7 @@ void PathTracer::generateEyeRays
         const int i = point.x + point.y * width;
 
         const Point2 P(float(point.x) + offset.x, float(point.y) + offset.y);
-
-        if (depthOfField) {
-            // Hammersley sequence remapped from a square to a disk
-            const uint32_t hash = superFastHash(&point, sizeof(point));
-            const Point2 pixelShift((hash >> 16) / float(0xFFFF), (hash & 0xFFFF) / float(0xFFFF));
-            const Point2& h = (Point2::hammersleySequence2D(rayIndex, raysPerPixel) + pixelShift).mod1();
-            const float angle = 2.0f * h.x * pif();
-            const float radius = sqrt(h.y);
-            const Point2 lens(cos(angle) * radius, sin(angle) * radius);
-            rayBuffer[i] = camera->worldRay(P.x, P.y, lens.x, lens.y, viewport);
-        }
-        else {
-            rayBuffer[i] = camera->worldRay(P.x, P.y, viewport);
-        }
+        rayBuffer[i] = eyeRay(camera, viewport, point, P, depthOfField, rayIndex, raysPerPixel);
 
         // Camera coords put integers at top left, but image coords put them at pixel centers
         const PixelCoord& pixelCoord = Point2(point) + offset - Point2(0.5f, 0.5f);
@@ -573,7 +820,26 @@ void PathTracer::prepare
     m_options = options;
 
     debugAssert(notNull(m_scene));
-    if (max(m_scene->lastEditingTime(), m_scene->lastStructuralChangeTime(), m_scene->lastVisibleChangeTime()) > m_triTree->lastBuildTime()) {
+    // Rebuild with previous positions the first time that motion blur is requested
+    bool needsPrevPosition = false;
+    if (m_options.motionBlur) {
+        const shared_ptr<TriTreeBase>& baseTree = dynamic_pointer_cast<TriTreeBase>(m_triTree);
+        if (isNull(baseTree) || ! baseTree->supportsMotion() || baseTree->compactStorage()) {
+            // Other trees, including the default EmbreeTriTree, would silently trace only the current pose
+            debugPrintf("PathTracer: %s cannot trace motion blur. Switching to NativeTriTree.\n", m_triTree->className().c_str());
+            m_triTree = NativeTriTree::create();
+        }
+
+        const shared_ptr<NativeTriTree>& nativeTree = dynamic_pointer_cast<NativeTriTree>(m_triTree);
+        if (notNull(nativeTree) && ! nativeTree->settings().computePrevPosition) {
+            NativeTriTree::Settings settings = nativeTree->settings();
+            settings.computePrevPosition = true;
+            nativeTree->setSettings(settings);
+            needsPrevPosition = true;
+        }
+    }
+
+    if (needsPrevPosition || (max(m_scene->lastEditingTime(), m_scene->lastStructuralChangeTime(), m_scene->lastVisibleChangeTime()) > m_triTree->lastBuildTime())) {
         // Reset the tree
         debugPrintf("Rebuilding TriTree\n");
         m_triTree->setContents(m_scene);
@@ -612,7 +878,8 @@ void PathTracer::traceBufferInternal
     float*                              distance,
     const Array<shared_ptr<Light>>&     directLightArray,
     const Array<shared_ptr<Light>>&     indirectLightArray,
-    int                                 currentRayIndex) const {
+    int                                 currentRayIndex,
+    const AOVImages*                    aovImages) const {
 
     const int numRays = buffers.ray.size();
     if (numRays == 0) { return; }
@@ -623,11 +890,26 @@ void PathTracer::traceBufferInternal
     
     const int numTraceIterations = m_options.maxScatteringEvents - (m_options.useEnvironmentMapForLastScatteringEvent ?  1 : 0);
 
-    int radianceImageWidth = radianceImage->width();
+    // traceBuffer() supplies no image; the width is only needed to decorrelate light samples by pixel
+    const int radianceImageWidth = notNull(radianceImage) ? radianceImage->width() : 0;
+
+    // Each path keeps its shutter time across all scattering events
+    const bool motionBlur = m_options.motionBlur;
+    if (motionBlur) {
+        buffers.time.resize(numRays);
+        runConcurrently(0, numRays, [&](int i) { buffers.time[i] = Random::threadCommon().uniform(); });
+    } else {
+        buffers.time.fastClear();
+    }
 
     for (int scatteringEvents = 0; (scatteringEvents < numTraceIterations) && (buffers.surfel.size() > 0); ++scatteringEvents) {
 
-        m_triTree->intersectRays(buffers.ray, buffers.surfel, (scatteringEvents == 0) ? TriTree::COHERENT_RAY_HINT : 0);
+        const TriTree::IntersectRayOptions options = (scatteringEvents == 0) ? TriTree::COHERENT_RAY_HINT : 0;
+        if (motionBlur) {
+            m_triTree->intersectRays(buffers.ray, buffers.time, buffers.surfel, options);
+        } else {
+            m_triTree->intersectRays(buffers.ray, buffers.surfel, options);
+        }
 
         if (notNull(distance) && (scatteringEvents == 0)) {
             // Write to the distance buffer.
@@ -638,6 +920,28 @@ void PathTracer::traceBufferInternal
             });
         }
 
+        if (notNull(aovImages) && notNull(radianceImage) && (scatteringEvents == 0)) {
+            // Serial because bilinearIncrement is not threadsafe
+            Random& rng = Random::threadCommon();
+            for (int i = 0; i < numRays; ++i) {
+                const shared_ptr<Surfel>& surfel = buffers.surfel[i];
+                const PixelCoord& P = buffers.outputCoord[i];
+                Color3 albedo = Color3::one();
+                Vector3 normal = Vector3::zero();
+                float depth = 0.0f;
+                if (notNull(surfel)) {
+                    const shared_ptr<UniversalSurfel>& u = dynamic_pointer_cast<UniversalSurfel>(surfel);
+                    albedo = notNull(u) ? (u->lambertianReflectivity + u->glossyReflectionCoefficient).min(Color3::one()) : surfel->reflectivity(rng);
+                    normal = surfel->shadingNormal;
+                    depth = (surfel->position - buffers.ray[i].origin()).length();
+                }
+
+                if (notNull(aovImages->albedo)) { aovImages->albedo->bilinearIncrement(P, albedo); }
+                if (notNull(aovImages->normal)) { aovImages->normal->bilinearIncrement(P, Color3(normal.x, normal.y, normal.z)); }
+                if (notNull(aovImages->depth))  { aovImages->depth->bilinearIncrement(P, Color1(depth)); }
+            }
+        }
+
         addEmissive(buffers.ray, buffers.surfel, buffers.impulseRay, buffers.modulation, output, buffers.outputIndex, radianceImage, buffers.outputCoord);
 
         // Compact buffers by removing paths that terminated (missed the entire scene)
@@ -652,7 +956,12 @@ void PathTracer::traceBufferInternal
         // Direct lighting
         if (directLightArray.size() > 0) {
             computeDirectIllumination(buffers.surfel, directLightArray, buffers.ray, scatteringEvents, currentRayIndex, m_options, buffers.outputCoord, radianceImageWidth, buffers.direct, buffers.shadowRay);
-            m_triTree->intersectRays(buffers.shadowRay, buffers.lightShadowed, TriTree::COHERENT_RAY_HINT | TriTree::DO_NOT_CULL_BACKFACES | TriTree::OCCLUSION_TEST_ONLY);
+            const TriTree::IntersectRayOptions shadowOptions = TriTree::COHERENT_RAY_HINT | TriTree::DO_NOT_CULL_BACKFACES | TriTree::OCCLUSION_TEST_ONLY;
+            if (motionBlur) {
+                m_triTree->intersectRays(buffers.shadowRay, buffers.time, buffers.lightShadowed, shadowOptions);
+            } else {
+                m_triTree->intersectRays(buffers.shadowRay, buffers.lightShadowed, shadowOptions);
+            }
             shade(buffers.surfel, buffers.ray, buffers.shadowRay, buffers.lightShadowed, buffers.direct, buffers.modulation, output, buffers.outputIndex, radianceImage, buffers.outputCoord);
         }
 
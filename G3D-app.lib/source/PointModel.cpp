@@ -11,6 +11,8 @@
 #include "G3D-app/PointSurface.h"
 #include "G3D-app/Entity.h"
 #include "G3D-base/FileSystem.h"
+#include "G3D-base/MemoryMappedFile.h"
+#include "G3D-base/ParsePLY.h"
 #include "G3D-base/ParseVOX.h"
 #include "G3D-base/Ray.h"
 
@@ -358,6 +360,12 @@ void PointModel::PointArray::addPoint(const Point3& position, const Color4unorm8
 
 
 void PointModel::loadPLY(const Specification& spec) {
+    const shared_ptr<MemoryMappedFile>& file = MemoryMappedFile::create(spec.filename, MemoryMappedFile::SEQUENTIAL);
+    if (notNull(file) && ParsePLY::isBinary(file->data(), file->size())) {
+        loadBinaryPLY(spec, file);
+        return;
+    }
+
     TextInput t(spec.filename);
     //bool c = t.hasMore();
 
@@ -395,6 +403,39 @@ void PointModel::loadPLY(const Specification& spec) {
 }
 
 
+void PointModel::loadBinaryPLY(const Specification& spec, const shared_ptr<MemoryMappedFile>& file) {
+    alwaysAssertM(spec.sourceColorSpace == ImageFormat::COLOR_SPACE_RGB || 
+        spec.sourceColorSpace == ImageFormat::COLOR_SPACE_SRGB, "Only RGB and sRGB color spaces supported");
+
+    // Stream the vertices so that large scans are never held in memory twice
+    PointArray& points = *m_pointArrayArray[0];
+    ParsePLY parser;
+    parser.streamVertices(file, [&](const ParsePLY::VertexChunk& chunk) {
+        if (chunk.firstVertex == 0) {
+            points.cpuPosition.reserve(int(points.size()) + parser.numVertices);
+            points.cpuRadiance.reserve(int(points.size()) + parser.numVertices);
+        }
+
+        for (int i = 0; i < chunk.position.size(); ++i) {
+            Color4unorm8 color(unorm8::one(), unorm8::one(), unorm8::one(), unorm8::one());
+            if (chunk.color.size() > 0) {
+                color = chunk.color[i];
+                if (spec.sourceColorSpace == ImageFormat::COLOR_SPACE_RGB) {
+                    color.r = unorm8(pow(float(color.r), 1/2.2f));
+                    color.g = unorm8(pow(float(color.g), 1/2.2f));
+                    color.b = unorm8(pow(float(color.b), 1/2.2f));
+                }
+            }
+            points.addPoint((spec.transform * Vector4(chunk.position[i], 1.0f)).xyz(), color);
+        }
+    });
+
+    if (spec.center) {
+        points.centerPoints();
+    }
+}
+
+
 bool PointModel::intersect
    (const Ray&                      R, 
     const CoordinateFrame&          cframe, 
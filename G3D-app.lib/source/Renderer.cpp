@@ -13,6 +13,7 @@
 #include "G3D-app/LightingEnvironment.h"
 #include "G3D-app/Camera.h"
 #include "G3D-app/Surface.h"
+#include "G3D-app/SurfaceCuller.h"
 #include "G3D-app/AmbientOcclusion.h"
 #include "G3D-app/SkyboxSurface.h"
 #include "G3D-app/Light.h"
@@ -67,6 +68,14 @@ void Renderer::computeShadowing
 }
 
 
+const shared_ptr<SurfaceCuller>& Renderer::surfaceCuller() {
+    if (isNull(m_surfaceCuller)) {
+        m_surfaceCuller = SurfaceCuller::create();
+    }
+    return m_surfaceCuller;
+}
+
+
 void Renderer::cullAndSort
    (const shared_ptr<Camera>&           camera,
     const shared_ptr<GBuffer>&          gbuffer,
@@ -77,7 +86,13 @@ void Renderer::cullAndSort
     Array<shared_ptr<Surface>>&         forwardBlendedSurfaces) {
 
     BEGIN_PROFILER_EVENT("Renderer::cullAndSort");
-    Surface::cull(camera->frame(), camera->projection(), viewport, allSurfaces, allVisibleSurfaces);
+    surfaceCuller()->cull(camera->frame(), camera->projection(), viewport, allSurfaces, allVisibleSurfaces);
+
+    // Decode the textures that this frame will force first, so that the loader threads
+    // work on them while shadow maps and earlier surfaces render
+    for (const shared_ptr<Surface>& surface : allVisibleSurfaces) {
+        surface->setLoadPriority(VISIBLE_TEXTURE_LOAD_PRIORITY);
+    }
 
     Surface::sortBackToFront(allVisibleSurfaces, camera->frame().lookVector());
 
@@ -8,8 +8,11 @@
 */
 
 #include "G3D-app/Scene.h"
+#include "G3D-app/TriTreeBase.h"
+#include "G3D-app/NativeTriTree.h"
 #include "G3D-base/units.h"
 #include "G3D-base/Table.h"
+#include "G3D-base/Set.h"
 #include "G3D-base/FileSystem.h"
 #include "G3D-base/Log.h"
 #include "G3D-base/Ray.h"
@@ -44,24 +47,57 @@ bool Scene::contains(const shared_ptr<Camera>& c) const {
 
 void Scene::onSimulation(SimTime deltaTime) {
     sortEntitiesByDependency();
+    updateSimulationLevels();
     m_time += isNaN(deltaTime) ? 0 : deltaTime;
-    for (int i = 0; i < m_entityArray.size(); ++i) {
-        const shared_ptr<Entity> entity = m_entityArray[i];
-        
+
+    // Each thread accumulates its own maximum change times, which are merged after simulation
+    class ChangeTimes {
+    public:
+        RealTime light = 0;
+        RealTime visible = 0;
+    };
+    tbb::combinable<ChangeTimes> changeTimes;
+
+    const auto simulate = [&](const SimulationEntry& s) {
+        Entity* entity = s.entity.get();
         entity->onSimulation(m_time, deltaTime);
 
-        const shared_ptr<Light>& light = dynamic_pointer_cast<Light>(entity);
-        if (light) {
-            m_lastLightChangeTime = max(m_lastLightChangeTime, entity->lastChangeTime());
-            if (light->visible()) {
-                m_lastVisibleChangeTime = max(m_lastVisibleChangeTime, entity->lastChangeTime());
+        ChangeTimes& t = changeTimes.local();
+        if ((s.typeBits & LIGHT_BIT) != 0) {
+            t.light = max(t.light, entity->lastChangeTime());
+            if (static_cast<const Light*>(entity)->visible()) {
+                t.visible = max(t.visible, entity->lastChangeTime());
             }
-        } else if (dynamic_pointer_cast<VisibleEntity>(entity)) {
-            m_lastVisibleChangeTime = max(m_lastVisibleChangeTime, entity->lastChangeTime());
+        } else if ((s.typeBits & VISIBLE_ENTITY_BIT) != 0) {
+            t.visible = max(t.visible, entity->lastChangeTime());
         }
         // Intentionally ignoring the case of other Entity subclasses
+    };
+
+    for (int level = 0; level < m_simulationLevelStart.size() - 1; ++level) {
+        const int start = m_simulationLevelStart[level];
+        const int stopBefore = m_simulationLevelStart[level + 1];
+
+        runConcurrently(start, stopBefore, [&](int i) {
+            if (m_simulationArray[i].entity->concurrentSimulation()) {
+                simulate(m_simulationArray[i]);
+            }
+        }, ! m_concurrentSimulation || (stopBefore - start < 2));
+
+        // Entitys that are not thread safe run afterward on this thread. They may insert or
+        // remove Entitys, which only marks m_simulationArray for rebuilding on the next call.
+        for (int i = start; i < stopBefore; ++i) {
+            if (! m_simulationArray[i].entity->concurrentSimulation()) {
+                simulate(m_simulationArray[i]);
+            }
+        }
     }
 
+    changeTimes.combine_each([&](const ChangeTimes& t) {
+        m_lastLightChangeTime = max(m_lastLightChangeTime, t.light);
+        m_lastVisibleChangeTime = max(m_lastVisibleChangeTime, t.visible);
+    });
+
     if (m_editing) {
         m_lastEditingTime = System::time();
     }
@@ -95,6 +131,14 @@ const shared_ptr<TriTree>& Scene::tritree() {
             // Will attempt to create a GPU tritree by default.
             m_triTree = TriTree::create();
         }
+    shared_ptr<TriTreeBase> base = dynamic_pointer_cast<TriTreeBase>(m_triTree);
+    if (! m_triTreeCacheDirectory.empty() && (isNull(base) || ! base->supportsCache())) {
+        // The default tree (EmbreeTriTree on most platforms) cannot use the cache
+        m_triTree = base = NativeTriTree::create();
+    }
+    if (notNull(base)) {
+        base->setCacheDirectory(m_triTreeCacheDirectory);
+    }
     const shared_ptr<Scene>& scene = dynamic_pointer_cast<Scene>(shared_from_this());
 	// No-op if no changes (on OptiXTriTree), safe to call repeatedly.
 	m_triTree->setContents(scene);
@@ -216,7 +260,10 @@ Array<String> Scene::sceneNames() {
 
 Scene::Scene(const shared_ptr<AmbientOcclusion>& ambientOcclusion) :
     m_needEntitySort(false),
+    m_needSimulationLevels(true),
+    m_concurrentSimulation(true),
     m_time(0),
+    m_lastEntityTreeUpdateTime(0),
     m_lastStructuralChangeTime(0),
     m_lastVisibleChangeTime(0),
     m_lastLightChangeTime(0),
@@ -250,8 +297,14 @@ void Scene::clear() {
     // Entitys, cameras, lights, all settings back to intial defauls
     m_ancestorTable.clear();
     m_needEntitySort = false;
+    m_simulationArray.fastClear();
+    m_simulationLevelStart.fastClear();
+    m_needSimulationLevels = true;
     m_entityTable.clear();
     m_entityArray.fastClear();
+    m_entityTree.clear();
+    m_entityTreeTable.clear();
+    m_unboundedEntityArray.fastClear();
     m_cameraArray.fastClear();
     m_localLightingEnvironment = LightingEnvironment();
     m_localLightingEnvironment.ambientOcclusion = old;
@@ -360,6 +413,10 @@ Any Scene::load(const String& scene, const LoadOptions& loadOptions) {
         }
     }
 
+    if (loadOptions.prefetchModels) {
+        prefetchModels(any, loadOptions);
+    }
+
     // Instantiate the entities
     // Try for both the current and extended format entity group names...intended to support using #include to merge
     // different files with entitys in them
@@ -462,17 +519,91 @@ Any Scene::load(const String& scene, const LoadOptions& loadOptions) {
 
 void Scene::getVisibleBounds(AABox& box) const {
     box = AABox();
-    for (int e = 0; e < m_entityArray.size(); ++e) {
-        const shared_ptr<VisibleEntity>& entity = dynamic_pointer_cast<VisibleEntity>(m_entityArray[e]);
-        if (notNull(entity) && entity->visible() && notNull(entity->model())) {
+    const auto merge = [&box](const Entity* e) {
+        const VisibleEntity* entity = static_cast<const VisibleEntity*>(e);
+        if (entity->visible() && notNull(entity->model())) {
             AABox eBox;
             entity->getLastBounds(eBox);
             box.merge(eBox);
         }
+    };
+
+    m_entityTree.forEachOverlapping([](const AABox&) { return true; }, [&](EntityTree::Handle h) {
+        merge(m_entityTree.value(h).get());
+    }, VISIBLE_ENTITY_BIT);
+
+    // Infinite bounds are kept out of the tree but still make the union infinite
+    for (const shared_ptr<Entity>& entity : m_unboundedEntityArray) {
+        if ((m_entityTreeTable[entity.get()].typeBits & VISIBLE_ENTITY_BIT) != 0) {
+            merge(entity.get());
+        }
     }
 }
 
 
+void Scene::getEntitiesInBox(const AABox& box, Array<shared_ptr<Entity> >& array, uint32 typeBits) const {
+    m_entityTree.getIntersectingMembers(box, array, typeBits);
+}
+
+
+void Scene::getEntitiesInSphere(const Sphere& sphere, Array<shared_ptr<Entity> >& array, uint32 typeBits) const {
+    m_entityTree.getIntersectingMembers(sphere, array, typeBits);
+}
+
+
+void Scene::getNearestEntities(const Point3& point, int k, Array<shared_ptr<Entity> >& array, uint32 typeBits, float maxDistance) const {
+    m_entityTree.getNearestMembers(point, k, array, typeBits, maxDistance);
+}
+
+
+uint32 Scene::entityTypeBits(const shared_ptr<Entity>& entity) {
+    const Entity* e = entity.get();
+    uint32 bits = 0;
+    if (notNull(dynamic_cast<const VisibleEntity*>(e))) { bits |= VISIBLE_ENTITY_BIT; }
+    if (notNull(dynamic_cast<const Light*>(e)))         { bits |= LIGHT_BIT; }
+    if (notNull(dynamic_cast<const Camera*>(e)))        { bits |= CAMERA_BIT; }
+    if (notNull(dynamic_cast<const MarkerEntity*>(e)))  { bits |= MARKER_ENTITY_BIT; }
+    if (notNull(dynamic_cast<const Skybox*>(e)))        { bits |= SKYBOX_BIT; }
+    return (bits == 0) ? uint32(OTHER_ENTITY_BIT) : bits;
+}
+
+
+void Scene::updateEntityTreeEntry(const shared_ptr<Entity>& entity, EntityTreeEntry& entry) {
+    AABox bounds;
+    entity->getLastBounds(bounds);
+
+    // Infinite bounds would make every query visit the entity anyway, so treat them like empty bounds
+    if (! bounds.isEmpty() && bounds.isFinite()) {
+        if (entry.handle == EntityTree::NONE) {
+            entry.handle = m_entityTree.insert(bounds, entity, entry.typeBits);
+            const int i = m_unboundedEntityArray.findIndex(entity);
+            if (i != -1) {
+                m_unboundedEntityArray.fastRemove(i);
+            }
+        } else {
+            m_entityTree.update(entry.handle, bounds);
+        }
+    } else if (entry.handle != EntityTree::NONE) {
+        m_entityTree.remove(entry.handle);
+        entry.handle = EntityTree::NONE;
+        m_unboundedEntityArray.append(entity);
+    }
+}
+
+
+void Scene::updateEntityTree() {
+    const RealTime now = System::time();
+    for (const shared_ptr<Entity>& entity : m_entityArray) {
+        if (max(entity->lastChangeTime(), entity->lastBoundsTime()) >= m_lastEntityTreeUpdateTime) {
+            EntityTreeEntry* entry = m_entityTreeTable.getPointer(entity.get());
+            debugAssert(notNull(entry));
+            updateEntityTreeEntry(entity, *entry);
+        }
+    }
+    m_lastEntityTreeUpdateTime = now;
+}
+
+
 lazy_ptr<Model> Scene::createModel(const Any& v, const String& name) {
     v.verify(! m_modelTable.containsKey(name), "A model named '" + name + "' already exists in this scene.");
 
@@ -505,6 +636,81 @@ lazy_ptr<Model> Scene::createModel(const Any& v, const String& name) {
 }
 
 
+void Scene::prefetchModels(const Any& sceneAny, const LoadOptions& options) {
+    const String entitySectionName[] = {"entities", "entities2"};
+
+    Array<ArticulatedModel::Specification> specificationArray;
+    Array<String> nameArray;
+    Set<String> referenced;
+    for (int i = 0; i < 2; ++i) {
+        if (! sceneAny.containsKey(entitySectionName[i]) || (sceneAny[entitySectionName[i]].size() == 0)) {
+            continue;
+        }
+
+        for (Table<String, Any>::Iterator it = sceneAny[entitySectionName[i]].table().begin(); it.isValid(); ++it) {
+            const Any& entityAny = it->value;
+            if ((entityAny.type() != Any::TABLE) || ! entityAny.containsKey("model") || (entityAny["model"].type() != Any::STRING)) {
+                continue;
+            }
+
+            // Skip models whose only users will be stripped by VisibleEntity::create
+            if (entityAny.name() == "VisibleEntity") {
+                const bool canChange = entityAny.containsKey("canChange") && entityAny["canChange"].boolean();
+                if ((canChange && options.stripDynamicVisibleEntitys) || (! canChange && options.stripStaticVisibleEntitys)) {
+                    continue;
+                }
+            }
+
+            const String& modelName = entityAny["model"].string();
+            if (referenced.contains(modelName) || ! m_modelTable.containsKey(modelName) || m_modelTable[modelName].resolved()) {
+                continue;
+            }
+            referenced.insert(modelName);
+
+            // Only prefetch models that createModel() would load through ArticulatedModel::lazyCreate
+            const Any& modelAny = m_modelsAny[modelName];
+            bool isArticulatedModel = (modelAny.type() == Any::STRING);
+            if (! isArticulatedModel) {
+                String modelClassName = modelAny.name();
+                const size_t j = modelClassName.find("::");
+                if (j != String::npos) {
+                    modelClassName = modelClassName.substr(0, j);
+                }
+                const LazyModelFactory* factory = m_modelFactory.getPointer(modelClassName);
+                isArticulatedModel = notNull(factory) && (*factory == static_cast<LazyModelFactory>(&ArticulatedModel::lazyCreate));
+            }
+
+            if (isArticulatedModel) {
+                specificationArray.append(ArticulatedModel::Specification(modelAny));
+                nameArray.append(modelName);
+            }
+        }
+    }
+
+    if (specificationArray.size() == 0) {
+        return;
+    }
+
+    Array<shared_ptr<ArticulatedModel>> modelArray;
+    const RealTime startTime = System::time();
+    ArticulatedModel::createConcurrently(specificationArray, nameArray, modelArray, options.maxConcurrentModelLoads, [&](int index, int numFinished) {
+        if (options.modelLoadCallback) {
+            options.modelLoadCallback(nameArray[index], numFinished, nameArray.size());
+        }
+    });
+
+    logPrintf("Scene::prefetchModels loaded %d models for \"%s\" in %fs\n", modelArray.size(), m_name.c_str(), System::time() - startTime);
+    logPrintf("    %-32s %10s %10s %10s %10s\n", "model", "import", "preprocess", "clean", "total");
+    for (int m = 0; m < modelArray.size(); ++m) {
+        const ArticulatedModel::LoadTimes& t = modelArray[m]->loadTimes();
+        logPrintf("    %-32s %9.3fs %9.3fs %9.3fs %9.3fs\n", nameArray[m].c_str(), t.import, t.preprocess, t.cleanGeometry, t.total());
+
+        // Replace the unresolved lazy_ptr so that Entitys find the loaded model
+        m_modelTable.set(nameArray[m], lazy_ptr<Model>(modelArray[m]));
+    }
+}
+
+
 void Scene::getEntityNames(Array<String>& names) const {
     for (int e = 0; e < m_entityArray.size(); ++e) {
         names.append(m_entityArray[e]->name());
@@ -586,6 +792,22 @@ void Scene::remove(const shared_ptr<Entity>& entity) {
     
     m_entityTable.remove(name);
     m_entityArray.remove(m_entityArray.findIndex(entity));
+    m_needSimulationLevels = true;
+
+    {
+        const EntityTreeEntry* entry = m_entityTreeTable.getPointer(entity.get());
+        if (notNull(entry)) {
+            if (entry->handle != EntityTree::NONE) {
+                m_entityTree.remove(entry->handle);
+            } else {
+                const int i = m_unboundedEntityArray.findIndex(entity);
+                if (i != -1) {
+                    m_unboundedEntityArray.fastRemove(i);
+                }
+            }
+            m_entityTreeTable.remove(entity.get());
+        }
+    }
 
     const shared_ptr<VisibleEntity>& visible = dynamic_pointer_cast<VisibleEntity>(entity);
     if (notNull(visible)) {
@@ -612,6 +834,10 @@ shared_ptr<Entity> Scene::insert(const shared_ptr<Entity>& entity) {
     debugAssertM(! m_entityTable.containsKey(entity->name()), "Two Entitys with the same name, \"" + entity->name() + "\"");
     m_entityTable.set(entity->name(), entity);
     m_entityArray.append(entity);
+    m_needSimulationLevels = true;
+
+    // Entitys that depend on this one may already be in the array, ahead of it
+    m_needEntitySort = m_needEntitySort || m_descendantTable.containsKey(entity->name());
     m_lastStructuralChangeTime = System::time();
     
     const shared_ptr<VisibleEntity>& visible = dynamic_pointer_cast<VisibleEntity>(entity);
@@ -640,6 +866,11 @@ shared_ptr<Entity> Scene::insert(const shared_ptr<Entity>& entity) {
     Array< shared_ptr<Surface> > ignore;
     entity->onPose(ignore);
 
+    EntityTreeEntry& entry = m_entityTreeTable.getCreate(entity.get());
+    entry.typeBits = entityTypeBits(entity);
+    m_unboundedEntityArray.append(entity);
+    updateEntityTreeEntry(entity, entry);
+
     return entity;
 }
 
@@ -667,24 +898,79 @@ shared_ptr<Entity> Scene::createEntity(const String& entityType, const String& n
 }
 
 
+template<class Test>
+void Scene::testEntitiesOutsideTree(uint32 typeBits, float& distance, const Test& test) const {
+    for (const shared_ptr<Entity>& entity : m_unboundedEntityArray) {
+        if ((m_entityTreeTable[entity.get()].typeBits & typeBits) != 0) {
+            test(entity, distance);
+        }
+    }
+
+    // Entitys that changed after the last onPose(), e.g., in onSimulation() or user code, may no longer
+    // be inside their tree bounds. Testing one of these twice cannot change the result.
+    for (const shared_ptr<Entity>& entity : m_entityArray) {
+        if ((entity->lastChangeTime() >= m_lastEntityTreeUpdateTime) &&
+            ((m_entityTreeTable[entity.get()].typeBits & typeBits) != 0)) {
+            test(entity, distance);
+        }
+    }
+}
+
+
 void Scene::onPose(Array<shared_ptr<Surface> >& surfaceArray) {
     for (int e = 0; e < m_entityArray.size(); ++e) {
         m_entityArray[e]->onPose(surfaceArray);
     }
+    updateEntityTree();
 }
 
 
+namespace _internal {
+/** The \a exclude argument of Scene::intersect, hashed when it is large enough that linear search would dominate */
+class EntityExcludeSet {
+    const Array<shared_ptr<Entity> >&   m_array;
+    Set<const Entity*>                  m_set;
+    const bool                          m_useSet;
+
+public:
+
+    EntityExcludeSet(const Array<shared_ptr<Entity> >& array) : m_array(array), m_useSet(array.size() > 8) {
+        if (m_useSet) {
+            for (const shared_ptr<Entity>& entity : array) {
+                m_set.insert(entity.get());
+            }
+        }
+    }
+
+    bool contains(const Entity* entity) const {
+        if (m_useSet) {
+            return m_set.contains(entity);
+        }
+        for (const shared_ptr<Entity>& e : m_array) {
+            if (e.get() == entity) { return true; }
+        }
+        return false;
+    }
+};
+} // namespace _internal
+
+
 shared_ptr<Entity> Scene::intersectBounds(const Ray& ray, float& distance, bool intersectMarkers, const Array<shared_ptr<Entity> >& exclude) const {
+    const uint32 typeBits = intersectMarkers ? uint32(ALL_ENTITY_BITS) : ~uint32(MARKER_ENTITY_BIT);
+    const _internal::EntityExcludeSet excludeSet(exclude);
     shared_ptr<Entity> closest;
-    
-    for (int e = 0; e < m_entityArray.size(); ++e) {
-        const shared_ptr<Entity>& entity = m_entityArray[e];
-        if ((intersectMarkers || isNull(dynamic_pointer_cast<MarkerEntity>(entity))) &&
-            ! exclude.contains(entity) && 
-            entity->intersectBounds(ray, distance)) {
+
+    const auto test = [&](const shared_ptr<Entity>& entity, float& maxDistance) {
+        if (! excludeSet.contains(entity.get()) && entity->intersectBounds(ray, maxDistance)) {
             closest = entity;
+            return true;
+        } else {
+            return false;
         }
-    }
+    };
+
+    m_entityTree.intersectRay(ray, distance, test, typeBits);
+    testEntitiesOutsideTree(typeBits, distance, test);
 
     return closest;
 }
@@ -697,14 +983,22 @@ shared_ptr<Entity> Scene::intersect
     const Array<shared_ptr<Entity> >&   exclude, 
     Model::HitInfo&                     info) const {
 
-    shared_ptr<Entity> closest;    
-    for (const shared_ptr<Entity>& entity : m_entityArray) {
-        if ((intersectMarkers || isNull(dynamic_pointer_cast<MarkerEntity>(entity))) &&
-            ! exclude.contains(entity) &&
-            entity->intersect(ray, distance, info)) {
+    const uint32 typeBits = intersectMarkers ? uint32(ALL_ENTITY_BITS) : ~uint32(MARKER_ENTITY_BIT);
+    const _internal::EntityExcludeSet excludeSet(exclude);
+    shared_ptr<Entity> closest;
+
+    // Entitys are visited roughly front to back, so the precise test prunes those behind the first hit
+    const auto test = [&](const shared_ptr<Entity>& entity, float& maxDistance) {
+        if (! excludeSet.contains(entity.get()) && entity->intersect(ray, maxDistance, info)) {
             closest = entity;
+            return true;
+        } else {
+            return false;
         }
-    }
+    };
+
+    m_entityTree.intersectRay(ray, distance, test, typeBits);
+    testEntitiesOutsideTree(typeBits, distance, test);
 
     return closest;
 }
@@ -872,6 +1166,60 @@ void Scene::sortEntitiesByDependency() {
     */
 
     m_needEntitySort = false;
+    m_needSimulationLevels = true;
+}
+
+
+void Scene::updateSimulationLevels() {
+    if (! m_needSimulationLevels) { return; }
+
+    // m_entityArray is sorted by dependency, so each ancestor's level is known before it is needed.
+    // An Entity's level is one more than its deepest ancestor's.
+    Table<const Entity*, int> levelTable;
+    Array<int> level;
+    level.resize(m_entityArray.size());
+    int numLevels = 0;
+    for (int e = 0; e < m_entityArray.size(); ++e) {
+        const shared_ptr<Entity>& entity = m_entityArray[e];
+        int L = 0;
+        const DependencyList* dependencies = m_ancestorTable.getPointer(entity->name());
+        if (notNull(dependencies)) {
+            for (int d = 0; d < dependencies->size(); ++d) {
+                const shared_ptr<Entity>* parent = m_entityTable.getPointer((*dependencies)[d]);
+                if (notNull(parent)) {
+                    const int* parentLevel = levelTable.getPointer(parent->get());
+                    debugAssertM(notNull(parentLevel), entity->name() + " was sorted ahead of " + (*dependencies)[d]);
+                    if (notNull(parentLevel)) {
+                        L = max(L, *parentLevel + 1);
+                    }
+                }
+            }
+        }
+        level[e] = L;
+        levelTable.set(entity.get(), L);
+        numLevels = max(numLevels, L + 1);
+    }
+
+    // Counting sort by level, which preserves the dependency order within each level
+    m_simulationLevelStart.resize(numLevels + 1);
+    m_simulationLevelStart.setAll(0);
+    for (int e = 0; e < level.size(); ++e) {
+        ++m_simulationLevelStart[level[e] + 1];
+    }
+    for (int L = 1; L <= numLevels; ++L) {
+        m_simulationLevelStart[L] += m_simulationLevelStart[L - 1];
+    }
+
+    Array<int> next;
+    next.copyPOD(m_simulationLevelStart);
+    m_simulationArray.resize(m_entityArray.size());
+    for (int e = 0; e < m_entityArray.size(); ++e) {
+        SimulationEntry& entry = m_simulationArray[next[level[e]]++];
+        entry.entity = m_entityArray[e];
+        entry.typeBits = m_entityTreeTable[entry.entity.get()].typeBits;
+    }
+
+    m_needSimulationLevels = false;
 }
 
 
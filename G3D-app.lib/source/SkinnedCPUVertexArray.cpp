@@ -0,0 +1,226 @@
+/**
+  \file G3D-app.lib/source/SkinnedCPUVertexArray.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/Thread.h"
+#include "G3D-base/Quat.h"
+#include "G3D-app/SkinnedCPUVertexArray.h"
+
+namespace G3D {
+
+namespace _internal {
+
+/** 3x4 affine bone matrix stored as rows, matching the layout uploaded to the GPU bone texture */
+class BoneMatrix {
+public:
+    Vector4 row[3];
+
+    BoneMatrix() {}
+
+    explicit BoneMatrix(const CFrame& frame) {
+        const Matrix3& R = frame.rotation;
+        const Vector3& T = frame.translation;
+        for (int r = 0; r < 3; ++r) {
+            row[r] = Vector4(R[r][0], R[r][1], R[r][2], T[r]);
+        }
+    }
+
+    Point3 transformPoint(const Point3& p) const {
+        const Vector4 h(p, 1.0f);
+        return Point3(row[0].dot(h), row[1].dot(h), row[2].dot(h));
+    }
+
+    Vector3 transformVector(const Vector3& v) const {
+        return Vector3(row[0].xyz().dot(v), row[1].xyz().dot(v), row[2].xyz().dot(v));
+    }
+};
+
+
+/** Unit dual quaternion: rotation in real, 0.5 * translation * real in dual. Stored as (x, y, z, w). */
+class DualQuat {
+public:
+    Vector4 real;
+    Vector4 dual;
+
+    DualQuat() {}
+
+    explicit DualQuat(const CFrame& frame) {
+        const Quat q(frame.rotation);
+        real = Vector4(q.x, q.y, q.z, q.w);
+        real *= 1.0f / real.length();
+        const Vector3& t = frame.translation;
+        const Vector3& r = real.xyz();
+        dual = Vector4((t * real.w + t.cross(r)) * 0.5f, -0.5f * t.dot(r));
+    }
+
+    /** Normalizes in place. Assumes that real is nonzero. */
+    void normalize() {
+        const float s = 1.0f / real.length();
+        real *= s;
+        dual *= s;
+    }
+
+    Vector3 rotate(const Vector3& v) const {
+        const Vector3& r = real.xyz();
+        return v + 2.0f * r.cross(r.cross(v) + real.w * v);
+    }
+
+    Vector3 translation() const {
+        const Vector3& r = real.xyz();
+        const Vector3& d = dual.xyz();
+        return 2.0f * (real.w * d - dual.w * r + r.cross(d));
+    }
+};
+
+} // namespace _internal
+
+
+void SkinnedCPUVertexArray::setPose(const CPUVertexArray* bindPose, const Array<CFrame>& boneFrame, const Array<CFrame>& prevBoneFrame, Method method) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bindPose = bindPose;
+    m_boneFrame.copyPOD(boneFrame);
+    m_prevBoneFrame.copyPOD(prevBoneFrame);
+    m_method = method;
+    m_posed = false;
+}
+
+
+const CPUVertexArray& SkinnedCPUVertexArray::vertexArray() {
+    if (! m_posed) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Another thread may have skinned while this one waited for the lock
+        if (! m_posed) {
+            skin();
+            m_posed = true;
+        }
+    }
+    return m_vertexArray;
+}
+
+
+const Array<Point3>& SkinnedCPUVertexArray::prevPosition() {
+    vertexArray();
+    return m_prevPosition;
+}
+
+
+void SkinnedCPUVertexArray::skin() {
+    alwaysAssertM(notNull(m_bindPose), "SkinnedCPUVertexArray::setPose was never called");
+    skin(*m_bindPose, m_boneFrame, m_method, m_vertexArray, &m_prevBoneFrame, &m_prevPosition);
+}
+
+
+void SkinnedCPUVertexArray::skin
+   (const CPUVertexArray&   bindPose,
+    const Array<CFrame>&    boneFrame,
+    Method                  method,
+    CPUVertexArray&         result,
+    const Array<CFrame>*    prevBoneFrame,
+    Array<Point3>*          prevPosition) {
+
+    alwaysAssertM(bindPose.hasBones && (bindPose.boneIndices.size() == bindPose.size()) && (bindPose.boneWeights.size() == bindPose.size()),
+        "SkinnedCPUVertexArray::skin requires a CPUVertexArray with bones");
+
+    const int numVertices = bindPose.size();
+    const bool computePrev = notNull(prevBoneFrame) && notNull(prevPosition);
+
+    // Copy the non-skinned attributes, reusing the previous allocation
+    result.hasTexCoord0    = bindPose.hasTexCoord0;
+    result.hasTexCoord1    = bindPose.hasTexCoord1;
+    result.hasTangent      = bindPose.hasTangent;
+    result.hasVertexColors = bindPose.hasVertexColors;
+    result.hasBones        = false;
+    result.boneIndices.fastClear();
+    result.boneWeights.fastClear();
+    result.prevPosition.fastClear();
+    result.vertex.resize(numVertices, false);
+    result.texCoord1.copyPOD(bindPose.texCoord1);
+    result.vertexColors.copyPOD(bindPose.vertexColors);
+    if (computePrev) {
+        prevPosition->resize(numVertices, false);
+    }
+
+    // Convert each bone once, rather than per vertex
+    Array<_internal::BoneMatrix> boneMatrix, prevBoneMatrix;
+    Array<_internal::DualQuat>   boneDualQuat, prevBoneDualQuat;
+    if (method == Method::DUAL_QUATERNION) {
+        boneDualQuat.resize(boneFrame.size());
+        for (int b = 0; b < boneFrame.size(); ++b) { boneDualQuat[b] = _internal::DualQuat(boneFrame[b]); }
+        if (computePrev) {
+            prevBoneDualQuat.resize(prevBoneFrame->size());
+            for (int b = 0; b < prevBoneFrame->size(); ++b) { prevBoneDualQuat[b] = _internal::DualQuat((*prevBoneFrame)[b]); }
+        }
+    } else {
+        boneMatrix.resize(boneFrame.size());
+        for (int b = 0; b < boneFrame.size(); ++b) { boneMatrix[b] = _internal::BoneMatrix(boneFrame[b]); }
+        if (computePrev) {
+            prevBoneMatrix.resize(prevBoneFrame->size());
+            for (int b = 0; b < prevBoneFrame->size(); ++b) { prevBoneMatrix[b] = _internal::BoneMatrix((*prevBoneFrame)[b]); }
+        }
+    }
+
+    // Blend the four influences. Matches UniversalSurface_getFullBoneTransform.
+    const auto blendMatrix = [](const Array<_internal::BoneMatrix>& bone, const Vector4int32& index, const Vector4& weight) {
+        _internal::BoneMatrix M;
+        for (int r = 0; r < 3; ++r) {
+            M.row[r] = bone[index.x].row[r] * weight.x + bone[index.y].row[r] * weight.y +
+                       bone[index.z].row[r] * weight.z + bone[index.w].row[r] * weight.w;
+        }
+        return M;
+    };
+
+    // Blend in the hemisphere of the first influence so that antipodal quaternions do not cancel
+    const auto blendDualQuat = [](const Array<_internal::DualQuat>& bone, const Vector4int32& index, const Vector4& weight) {
+        const _internal::DualQuat& q0 = bone[index.x];
+        _internal::DualQuat Q;
+        Q.real = q0.real * weight.x;
+        Q.dual = q0.dual * weight.x;
+        for (int i = 1; i < 4; ++i) {
+            const _internal::DualQuat& q = bone[index[i]];
+            const float w = (q.real.dot(q0.real) < 0.0f) ? -weight[i] : weight[i];
+            Q.real += q.real * w;
+            Q.dual += q.dual * w;
+        }
+        Q.normalize();
+        return Q;
+    };
+
+    const int BLOCK_SIZE = 1024;
+    runConcurrently(0, iCeil(float(numVertices) / float(BLOCK_SIZE)), [&](int block) {
+        const int start = block * BLOCK_SIZE;
+        const int stopBefore = min(start + BLOCK_SIZE, numVertices);
+        for (int i = start; i < stopBefore; ++i) {
+            const CPUVertexArray::Vertex& src = bindPose.vertex[i];
+            CPUVertexArray::Vertex&       dst = result.vertex[i];
+            const Vector4int32&         index = bindPose.boneIndices[i];
+            const Vector4&             weight = bindPose.boneWeights[i];
+
+            dst.texCoord0 = src.texCoord0;
+            if (method == Method::DUAL_QUATERNION) {
+                const _internal::DualQuat& Q = blendDualQuat(boneDualQuat, index, weight);
+                dst.position = Q.rotate(src.position) + Q.translation();
+                dst.normal   = Q.rotate(src.normal);
+                dst.tangent  = Vector4(Q.rotate(src.tangent.xyz()), src.tangent.w);
+                if (computePrev) {
+                    const _internal::DualQuat& P = blendDualQuat(prevBoneDualQuat, index, weight);
+                    (*prevPosition)[i] = P.rotate(src.position) + P.translation();
+                }
+            } else {
+                const _internal::BoneMatrix& M = blendMatrix(boneMatrix, index, weight);
+                dst.position = M.transformPoint(src.position);
+                // Blended matrices are not orthonormal, so renormalize
+                dst.normal   = M.transformVector(src.normal).directionOrZero();
+                dst.tangent  = Vector4(M.transformVector(src.tangent.xyz()).directionOrZero(), src.tangent.w);
+                if (computePrev) {
+                    (*prevPosition)[i] = blendMatrix(prevBoneMatrix, index, weight).transformPoint(src.position);
+                }
+            }
+        }
+    });
+}
+
+} // namespace G3D
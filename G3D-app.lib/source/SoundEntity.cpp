@@ -16,7 +16,10 @@
 
 namespace G3D {
 
-SoundEntity::SoundEntity() {}
+SoundEntity::SoundEntity() {
+    // onSimulation() calls FMOD and removes this from the Scene when the sound finishes
+    m_concurrentSimulation = false;
+}
 
 void SoundEntity::init(AnyTableReader& propertyTable) {
     Any a;
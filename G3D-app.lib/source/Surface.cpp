@@ -27,6 +27,7 @@
 #include "G3D-app/LightingEnvironment.h"
 #include "G3D-app/SVO.h"
 #include "G3D-app/SkyboxSurface.h"
+#include "G3D-app/SurfaceCuller.h"
 
 namespace G3D {
 
@@ -255,45 +256,17 @@ void Surface::cull
         debugAssert(&allSurfaces != &outSurfaces);
         outSurfaces.fastClear();
     }
-    Frustum fr;
-    cameraProjection.frustum(viewport, fr);
-    fr = cameraFrame.toWorldSpace(fr);
-    
-    static Array<Plane> clipPlanes;
-    cameraProjection.getClipPlanes(viewport, clipPlanes);
-    for (int i = 0; i < clipPlanes.size(); ++i) {
-        clipPlanes[i] = cameraFrame.toWorldSpace(clipPlanes[i]);
-    }
-
-    for (int i = 0; i < allSurfaces.size(); ++i) {
-        Sphere sphere;
-        CFrame c;
 
-        // We actually remove this shared_ptr from the array below,
-        // at which point this reference will become invalid. However,
-        // the code doesn't touch the reference again afterwards, so 
-        // that dangling pointer is ok.
-        const shared_ptr<Surface>& m = allSurfaces[i];
-        m->getCoordinateFrame(c, previous);
-        m->getObjectSpaceBoundingSphere(sphere, previous);
-        sphere = c.toWorldSpace(sphere);
-        
-        // Not const because it is reevaluated in the branch immediately below
-        bool culled = sphere.culledBy(clipPlanes);
-        if (!culled) {
-            AABox osBox;
-            m->getObjectSpaceBoundingBox(osBox, previous);
-            if (osBox.isEmpty()) {
-                culled = true;
-            } else {
-                const Box& wsBox = c.toWorldSpace(osBox);
-                culled = wsBox.culledBy(fr);
-            }
-        }
+    // Test the bounds of all surfaces against the frustum planes in SIMD batches
+    Array<bool> visible;
+    SurfaceCuller::computeFrustumVisibility(cameraFrame, cameraProjection, viewport, allSurfaces, visible, previous);
 
-        if (! culled) {
+    for (int i = 0; i < allSurfaces.size(); ++i) {
+        if (visible[i]) {
             if (inPlace) {
+                // Keep the visibility flags aligned with the surfaces that fastRemove moves
                 allSurfaces.fastRemove(i);
+                visible.fastRemove(i);
                 --i;
             } else {
                 outSurfaces.append(allSurfaces[i]);
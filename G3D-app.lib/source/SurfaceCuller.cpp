@@ -0,0 +1,464 @@
+/**
+  \file G3D-app.lib/source/SurfaceCuller.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/platform.h"
+#ifdef G3D_X86
+#    include <emmintrin.h>
+#endif
+#include "G3D-base/AABox.h"
+#include "G3D-base/Plane.h"
+#include "G3D-base/Projection.h"
+#include "G3D-base/Rect2D.h"
+#include "G3D-base/Thread.h"
+#include "G3D-base/System.h"
+#include "G3D-app/SurfaceCuller.h"
+#include "G3D-app/Surface.h"
+
+namespace G3D {
+
+void SurfaceCuller::BoxArrays::resize(int n) {
+    // Pad to a full SIMD batch. The padding boxes are empty and so are never visible.
+    const int padded = (n + 3) & ~3;
+    for (int a = 0; a < 3; ++a) {
+        center[a].resize(padded, DONT_SHRINK_UNDERLYING_ARRAY);
+        axis0[a].resize(padded, DONT_SHRINK_UNDERLYING_ARRAY);
+        axis1[a].resize(padded, DONT_SHRINK_UNDERLYING_ARRAY);
+        axis2[a].resize(padded, DONT_SHRINK_UNDERLYING_ARRAY);
+    }
+    kind.resize(padded, DONT_SHRINK_UNDERLYING_ARRAY);
+    for (int i = n; i < padded; ++i) {
+        set(i, CFrame(), AABox::empty());
+    }
+}
+
+
+void SurfaceCuller::BoxArrays::set(int i, const CFrame& frame, const AABox& osBox) {
+    if (osBox.isEmpty() || ! osBox.isFinite()) {
+        // Zero the fields so that the SIMD test never sees NaN or infinity
+        for (int a = 0; a < 3; ++a) {
+            center[a][i] = axis0[a][i] = axis1[a][i] = axis2[a][i] = 0.0f;
+        }
+        kind[i] = osBox.isEmpty() ? 0 : 2;
+        return;
+    }
+
+    const Point3&  c = frame.pointToWorldSpace(osBox.center());
+    const Vector3& halfExtent = osBox.extent() * 0.5f;
+    const Vector3& a0 = frame.rotation.column(0) * halfExtent.x;
+    const Vector3& a1 = frame.rotation.column(1) * halfExtent.y;
+    const Vector3& a2 = frame.rotation.column(2) * halfExtent.z;
+    for (int a = 0; a < 3; ++a) {
+        center[a][i] = c[a];
+        axis0[a][i]  = a0[a];
+        axis1[a][i]  = a1[a];
+        axis2[a][i]  = a2[a];
+    }
+    kind[i] = 1;
+}
+
+
+Point3 SurfaceCuller::BoxArrays::corner(int i, int c) const {
+    const float s0 = (c & 1) ? 1.0f : -1.0f;
+    const float s1 = (c & 2) ? 1.0f : -1.0f;
+    const float s2 = (c & 4) ? 1.0f : -1.0f;
+    Point3 p;
+    for (int a = 0; a < 3; ++a) {
+        p[a] = center[a][i] + s0 * axis0[a][i] + s1 * axis1[a][i] + s2 * axis2[a][i];
+    }
+    return p;
+}
+
+
+void SurfaceCuller::gatherBounds(const Array<shared_ptr<Surface>>& surfaceArray, bool previous) {
+    // Surface bounds accessors are not required to be thread-safe, so this pass is serial.
+    // Everything after it reads only the arrays.
+    m_boxes.resize(surfaceArray.size());
+    m_visible.resize(surfaceArray.size(), DONT_SHRINK_UNDERLYING_ARRAY);
+    for (int i = 0; i < surfaceArray.size(); ++i) {
+        CFrame frame;
+        AABox osBox;
+        surfaceArray[i]->getCoordinateFrame(frame, previous);
+        surfaceArray[i]->getObjectSpaceBoundingBox(osBox, previous);
+        m_boxes.set(i, frame, osBox);
+        m_visible[i] = (m_boxes.kind[i] != 0);
+    }
+}
+
+
+void SurfaceCuller::cullBoxesByPlanes(const Array<Plane>& planeArray) {
+    const int N = m_visible.size();
+    const int padded = m_boxes.kind.size();
+
+    // A box is outside of a plane when the signed distance of its center plus its
+    // projected radius |n.axis0| + |n.axis1| + |n.axis2| is negative.
+    for (int i = 0; i < padded; i += 4) {
+        int outsideMask = 0;
+
+#       ifdef G3D_X86
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 cx = _mm_loadu_ps(&m_boxes.center[0][i]), cy = _mm_loadu_ps(&m_boxes.center[1][i]), cz = _mm_loadu_ps(&m_boxes.center[2][i]);
+        const __m128 ax = _mm_loadu_ps(&m_boxes.axis0[0][i]),  ay = _mm_loadu_ps(&m_boxes.axis0[1][i]),  az = _mm_loadu_ps(&m_boxes.axis0[2][i]);
+        const __m128 bx = _mm_loadu_ps(&m_boxes.axis1[0][i]),  by = _mm_loadu_ps(&m_boxes.axis1[1][i]),  bz = _mm_loadu_ps(&m_boxes.axis1[2][i]);
+        const __m128 dx = _mm_loadu_ps(&m_boxes.axis2[0][i]),  dy = _mm_loadu_ps(&m_boxes.axis2[1][i]),  dz = _mm_loadu_ps(&m_boxes.axis2[2][i]);
+
+        for (int p = 0; (p < planeArray.size()) && (outsideMask != 0xF); ++p) {
+            const Vector3& n = planeArray[p].normal();
+            const __m128 nx = _mm_set1_ps(n.x), ny = _mm_set1_ps(n.y), nz = _mm_set1_ps(n.z);
+            const __m128 offset = _mm_set1_ps(planeArray[p].distance(Point3::zero()));
+
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), offset));
+            const __m128 r0 = _mm_and_ps(absMask, _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, ax), _mm_mul_ps(ny, ay)), _mm_mul_ps(nz, az)));
+            const __m128 r1 = _mm_and_ps(absMask, _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, bx), _mm_mul_ps(ny, by)), _mm_mul_ps(nz, bz)));
+            const __m128 r2 = _mm_and_ps(absMask, _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, dx), _mm_mul_ps(ny, dy)), _mm_mul_ps(nz, dz)));
+
+            outsideMask |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, _mm_add_ps(r0, _mm_add_ps(r1, r2))), _mm_setzero_ps()));
+        }
+#       else
+        for (int p = 0; (p < planeArray.size()) && (outsideMask != 0xF); ++p) {
+            const Vector3& n = planeArray[p].normal();
+            const float offset = planeArray[p].distance(Point3::zero());
+            for (int j = 0; j < 4; ++j) {
+                const int k = i + j;
+                const float distance = n.x * m_boxes.center[0][k] + n.y * m_boxes.center[1][k] + n.z * m_boxes.center[2][k] + offset;
+                const float r = fabsf(n.x * m_boxes.axis0[0][k] + n.y * m_boxes.axis0[1][k] + n.z * m_boxes.axis0[2][k]) +
+                                fabsf(n.x * m_boxes.axis1[0][k] + n.y * m_boxes.axis1[1][k] + n.z * m_boxes.axis1[2][k]) +
+                                fabsf(n.x * m_boxes.axis2[0][k] + n.y * m_boxes.axis2[1][k] + n.z * m_boxes.axis2[2][k]);
+                if (distance + r < 0.0f) {
+                    outsideMask |= 1 << j;
+                }
+            }
+        }
+#       endif
+
+        if (outsideMask != 0) {
+            for (int j = 0; (j < 4) && (i + j < N); ++j) {
+                // Infinite boxes were zeroed and are never culled
+                if (((outsideMask >> j) & 1) && (m_boxes.kind[i + j] == 1)) {
+                    m_visible[i + j] = false;
+                }
+            }
+        }
+    }
+}
+
+
+void SurfaceCuller::computeFrustumVisibility
+   (const CFrame&                       cameraFrame,
+    const Projection&                   cameraProjection,
+    const Rect2D&                       viewport,
+    const Array<shared_ptr<Surface>>&   allSurfaces,
+    Array<bool>&                        visible,
+    bool                                previous) {
+
+    SurfaceCuller culler;
+    culler.gatherBounds(allSurfaces, previous);
+
+    Array<Plane> clipPlanes;
+    cameraProjection.getClipPlanes(viewport, clipPlanes);
+    for (int i = 0; i < clipPlanes.size(); ++i) {
+        clipPlanes[i] = cameraFrame.toWorldSpace(clipPlanes[i]);
+    }
+    culler.cullBoxesByPlanes(clipPlanes);
+
+    visible.fastClear();
+    visible.swap(culler.m_visible);
+}
+
+
+void SurfaceCuller::addScreenTri(const Vector4& v0, const Vector4& v1, const Vector4& v2) {
+    const Vector4* clip[3] = { &v0, &v1, &v2 };
+    float x[3], y[3], z[3];
+    for (int k = 0; k < 3; ++k) {
+        const float invW = 1.0f / clip[k]->w;
+        x[k] = (clip[k]->x * invW * 0.5f + 0.5f) * float(m_width);
+        y[k] = (0.5f - clip[k]->y * invW * 0.5f) * float(m_height);
+        z[k] = clip[k]->z * invW;
+    }
+
+    const float det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (fabsf(det) < 1e-6f) {
+        return;
+    }
+
+    ScreenTri tri;
+    tri.x0 = max(0, iFloor(min(x[0], x[1], x[2])));
+    tri.y0 = max(0, iFloor(min(y[0], y[1], y[2])));
+    tri.x1 = min(m_width - 1,  iFloor(max(x[0], x[1], x[2])));
+    tri.y1 = min(m_height - 1, iFloor(max(y[0], y[1], y[2])));
+    if ((tri.x0 > tri.x1) || (tri.y0 > tri.y1)) {
+        return;
+    }
+
+    for (int e = 0; e < 3; ++e) {
+        const int i = e, j = (e + 1) % 3, k = (e + 2) % 3;
+        float a = y[i] - y[j];
+        float b = x[j] - x[i];
+        float c = x[i] * y[j] - y[i] * x[j];
+        if (a * x[k] + b * y[k] + c < 0.0f) {
+            a = -a; b = -b; c = -c;
+        }
+        // Coverage is at pixel centers so that triangles sharing an edge leave no cracks.
+        // occluded() compensates by dilating the tested bounds.
+        tri.a[e] = a;
+        tri.b[e] = b;
+        tri.c[e] = c;
+    }
+
+    tri.zA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / det;
+    tri.zB = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / det;
+    // Offset to the farthest depth within the pixel square so that the buffer never overestimates occlusion
+    tri.zC = z[0] - tri.zA * x[0] - tri.zB * y[0] + 0.5f * (fabsf(tri.zA) + fabsf(tri.zB));
+
+    m_triArray.append(tri);
+}
+
+
+int SurfaceCuller::setupOccluder(const shared_ptr<Surface>& surface, bool previous) {
+    if (! surface->getObjectSpaceOccluderGeometry(m_occluderIndex, m_occluderVertex, m_settings.maxOccluderTriangles, previous)) {
+        return 0;
+    }
+
+    CFrame frame;
+    surface->getCoordinateFrame(frame, previous);
+    const Matrix4& objectToClip = m_worldToClip * frame.toMatrix4();
+
+    m_occluderClip.resize(m_occluderVertex.size(), DONT_SHRINK_UNDERLYING_ARRAY);
+    for (int v = 0; v < m_occluderVertex.size(); ++v) {
+        m_occluderClip[v] = objectToClip * Vector4(m_occluderVertex[v], 1.0f);
+    }
+
+    const int oldSize = m_triArray.size();
+    for (int i = 0; i + 2 < m_occluderIndex.size(); i += 3) {
+        // Clip against the near plane, z >= -w, which produces a convex polygon of at most four vertices
+        Vector4 polygon[4];
+        int n = 0;
+        for (int k = 0; k < 3; ++k) {
+            const Vector4& a = m_occluderClip[m_occluderIndex[i + k]];
+            const Vector4& b = m_occluderClip[m_occluderIndex[i + (k + 1) % 3]];
+            const float da = a.z + a.w;
+            const float db = b.z + b.w;
+            if (da >= 0.0f) {
+                polygon[n++] = a;
+            }
+            if ((da >= 0.0f) != (db >= 0.0f)) {
+                polygon[n++] = a + (b - a) * (da / (da - db));
+            }
+        }
+
+        for (int k = 2; k < n; ++k) {
+            addScreenTri(polygon[0], polygon[k - 1], polygon[k]);
+        }
+    }
+
+    return m_triArray.size() - oldSize;
+}
+
+
+void SurfaceCuller::rasterizeOccluders() {
+    const int tilesX = m_width / TILE_SIZE;
+    const int tilesY = m_height / TILE_SIZE;
+    m_depth.resize(m_width * m_height, DONT_SHRINK_UNDERLYING_ARRAY);
+    m_tileMaxDepth.resize(tilesX * tilesY, DONT_SHRINK_UNDERLYING_ARRAY);
+
+    // Each row of tiles is rasterized independently, so threads never write the same pixel
+    runConcurrently(0, tilesY, [&](int ty) {
+        const int rowStart = ty * TILE_SIZE;
+        const int rowEnd   = rowStart + TILE_SIZE - 1;
+
+        float* depth = m_depth.getCArray();
+        for (int i = rowStart * m_width; i < (rowEnd + 1) * m_width; ++i) {
+            depth[i] = finf();
+        }
+
+        for (int t = 0; t < m_triArray.size(); ++t) {
+            const ScreenTri& tri = m_triArray[t];
+            const int y0 = max(tri.y0, rowStart);
+            const int y1 = min(tri.y1, rowEnd);
+            for (int y = y0; y <= y1; ++y) {
+                const float fy = float(y) + 0.5f;
+                float* row = depth + y * m_width;
+                for (int x = tri.x0; x <= tri.x1; ++x) {
+                    const float fx = float(x) + 0.5f;
+                    if ((tri.a[0] * fx + tri.b[0] * fy + tri.c[0] >= 0.0f) &&
+                        (tri.a[1] * fx + tri.b[1] * fy + tri.c[1] >= 0.0f) &&
+                        (tri.a[2] * fx + tri.b[2] * fy + tri.c[2] >= 0.0f)) {
+                        row[x] = min(row[x], tri.zA * fx + tri.zB * fy + tri.zC);
+                    }
+                }
+            }
+        }
+
+        for (int tx = 0; tx < tilesX; ++tx) {
+            float tileMax = -finf();
+            for (int y = rowStart; y <= rowEnd; ++y) {
+                for (int x = tx * TILE_SIZE; x < (tx + 1) * TILE_SIZE; ++x) {
+                    tileMax = max(tileMax, depth[y * m_width + x]);
+                }
+            }
+            m_tileMaxDepth[ty * tilesX + tx] = tileMax;
+        }
+    });
+}
+
+
+bool SurfaceCuller::occluded(int i) const {
+    float xMin = finf(), yMin = finf(), xMax = -finf(), yMax = -finf(), zMin = finf();
+    for (int c = 0; c < 8; ++c) {
+        const Vector4& v = m_worldToClip * Vector4(m_boxes.corner(i, c), 1.0f);
+        if (v.z < -v.w) {
+            // Crosses the near plane
+            return false;
+        }
+        const float invW = 1.0f / v.w;
+        const float x = (v.x * invW * 0.5f + 0.5f) * float(m_width);
+        const float y = (0.5f - v.y * invW * 0.5f) * float(m_height);
+        xMin = min(xMin, x); xMax = max(xMax, x);
+        yMin = min(yMin, y); yMax = max(yMax, y);
+        zMin = min(zMin, v.z * invW);
+    }
+
+    // Dilate by one pixel because occluder coverage is only sampled at pixel centers
+    const int x0 = max(0, iFloor(xMin) - 1), x1 = min(m_width - 1,  iFloor(xMax) + 1);
+    const int y0 = max(0, iFloor(yMin) - 1), y1 = min(m_height - 1, iFloor(yMax) + 1);
+    if ((x0 > x1) || (y0 > y1)) {
+        // Off screen. The frustum stage should have rejected this, so be conservative.
+        return false;
+    }
+
+    // Hierarchical test: whole tiles that are entirely in front of the box need no
+    // per-pixel test
+    const int tilesX = m_width / TILE_SIZE;
+    for (int ty = y0 / TILE_SIZE; ty <= y1 / TILE_SIZE; ++ty) {
+        for (int tx = x0 / TILE_SIZE; tx <= x1 / TILE_SIZE; ++tx) {
+            if (m_tileMaxDepth[ty * tilesX + tx] < zMin) {
+                continue;
+            }
+
+            const int px1 = min(x1, (tx + 1) * TILE_SIZE - 1);
+            const int py1 = min(y1, (ty + 1) * TILE_SIZE - 1);
+            for (int y = max(y0, ty * TILE_SIZE); y <= py1; ++y) {
+                for (int x = max(x0, tx * TILE_SIZE); x <= px1; ++x) {
+                    if (m_depth[y * m_width + x] >= zMin) {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void SurfaceCuller::cull
+   (const CFrame&                       cameraFrame,
+    const Projection&                   cameraProjection,
+    const Rect2D&                       viewport,
+    const Array<shared_ptr<Surface>>&   allSurfaces,
+    Array<shared_ptr<Surface>>&         outSurfaces,
+    bool                                previous) {
+
+    m_stats = Stats();
+    m_stats.surfaces = allSurfaces.size();
+
+    RealTime start = System::time();
+    gatherBounds(allSurfaces, previous);
+    if (m_settings.frustumCulling) {
+        Array<Plane> clipPlanes;
+        cameraProjection.getClipPlanes(viewport, clipPlanes);
+        for (int i = 0; i < clipPlanes.size(); ++i) {
+            clipPlanes[i] = cameraFrame.toWorldSpace(clipPlanes[i]);
+        }
+        cullBoxesByPlanes(clipPlanes);
+    }
+    for (int i = 0; i < m_visible.size(); ++i) {
+        if (! m_visible[i]) {
+            ++m_stats.frustumCulled;
+        }
+    }
+    m_stats.frustumTime = System::time() - start;
+
+    if (m_settings.occlusionCulling && (m_stats.frustumCulled < m_stats.surfaces) && (viewport.width() > 0) && (viewport.height() > 0)) {
+        start = System::time();
+
+        m_width  = max(int(TILE_SIZE), (m_settings.depthBufferWidth + TILE_SIZE - 1) & ~(TILE_SIZE - 1));
+        m_height = max(int(TILE_SIZE), (iCeil(float(m_width) * viewport.height() / viewport.width()) + TILE_SIZE - 1) & ~(TILE_SIZE - 1));
+
+        Matrix4 projection;
+        cameraProjection.getProjectUnitMatrix(viewport, projection);
+        m_worldToClip = projection * cameraFrame.inverse().toMatrix4();
+
+        // Choose the occluders with the largest projected bounding spheres
+        const float pixelsPerMeter = cameraProjection.imagePlanePixelsPerMeter(viewport);
+        Array<int>   candidateArray;
+        Array<float> projectedSize;
+        projectedSize.resize(m_visible.size());
+        for (int i = 0; i < m_visible.size(); ++i) {
+            if (m_visible[i] && (m_boxes.kind[i] == 1)) {
+                const Vector3 a0(m_boxes.axis0[0][i], m_boxes.axis0[1][i], m_boxes.axis0[2][i]);
+                const Vector3 a1(m_boxes.axis1[0][i], m_boxes.axis1[1][i], m_boxes.axis1[2][i]);
+                const Vector3 a2(m_boxes.axis2[0][i], m_boxes.axis2[1][i], m_boxes.axis2[2][i]);
+                const Point3  center(m_boxes.center[0][i], m_boxes.center[1][i], m_boxes.center[2][i]);
+                const float radius = sqrtf(a0.squaredLength() + a1.squaredLength() + a2.squaredLength());
+                const float distance = max((center - cameraFrame.translation).length(), -cameraProjection.nearPlaneZ());
+                projectedSize[i] = radius * pixelsPerMeter / (distance * viewport.height());
+                if (projectedSize[i] >= m_settings.minOccluderSize) {
+                    candidateArray.append(i);
+                }
+            }
+        }
+        candidateArray.sort([&](int a, int b) { return projectedSize[a] > projectedSize[b]; });
+
+        m_triArray.fastClear();
+        for (int c = 0; (c < candidateArray.size()) && (m_stats.occluders < m_settings.maxOccluders); ++c) {
+            const int n = setupOccluder(allSurfaces[candidateArray[c]], previous);
+            if (n > 0) {
+                ++m_stats.occluders;
+                m_stats.occluderTriangles += n;
+            }
+        }
+
+        if (m_triArray.size() > 0) {
+            rasterizeOccluders();
+
+            Array<int> testArray;
+            for (int i = 0; i < m_visible.size(); ++i) {
+                if (m_visible[i] && (m_boxes.kind[i] == 1)) {
+                    testArray.append(i);
+                }
+            }
+
+            Array<bool> hidden;
+            hidden.resize(testArray.size());
+            runConcurrently(0, testArray.size(), [&](int t) {
+                hidden[t] = occluded(testArray[t]);
+            });
+
+            for (int t = 0; t < testArray.size(); ++t) {
+                if (hidden[t]) {
+                    m_visible[testArray[t]] = false;
+                    ++m_stats.occlusionCulled;
+                }
+            }
+        } else {
+            m_depth.fastClear();
+            m_tileMaxDepth.fastClear();
+        }
+
+        m_stats.occlusionTime = System::time() - start;
+    }
+
+    for (int i = 0; i < m_visible.size(); ++i) {
+        if (m_visible[i]) {
+            outSurfaces.append(allSurfaces[i]);
+        }
+    }
+    m_stats.visible = m_stats.surfaces - m_stats.frustumCulled - m_stats.occlusionCulled;
+}
+
+} // namespace G3D
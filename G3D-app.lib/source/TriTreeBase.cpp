@@ -23,6 +23,31 @@ namespace G3D {
 void TriTreeBase::clear() {
     m_triArray.fastClear();
     m_vertexArray.clear();
+    m_compactTriArray.clear();
+}
+
+
+void TriTreeBase::compactContents() {
+    if (! compactStorage() || (m_triArray.size() == 0)) {
+        return;
+    }
+
+    m_compactTriArray.encode(m_triArray, m_vertexArray);
+    m_triArray.clear();
+    m_vertexArray.clear();
+
+    const CompactTriArray::Stats& stats = m_compactTriArray.stats();
+    debugPrintf("%s compact storage: %d tris, %.1f bytes/tri uncompressed, %.1f bytes/tri compressed\n",
+                className().c_str(), stats.numTris, stats.uncompressedBytesPerTri(), stats.compressedBytesPerTri());
+}
+
+
+void TriTreeBase::sample(const Hit& hit, shared_ptr<Surfel>& surfel) const {
+    if ((hit.triIndex != Hit::NONE) && (m_compactTriArray.size() > 0)) {
+        m_compactTriArray.sample(hit.u, hit.v, hit.triIndex, hit.backface, surfel);
+    } else {
+        TriTree::sample(hit, surfel);
+    }
 }
 
 
@@ -61,11 +86,11 @@ void TriTreeBase::setContents
 (const Array<shared_ptr<Surface> >& surfaceArray, 
  ImageStorage                       newStorage) {
 
-    const bool computePrevPosition = false;
     clear();
-    Surface::getTris(surfaceArray, m_vertexArray, m_triArray, computePrevPosition);
+    Surface::getTris(surfaceArray, m_vertexArray, m_triArray, computePrevPosition());
     Surface::setStorage(surfaceArray, newStorage);
     m_sky = nullptr;
+    compactContents();
     rebuild();
 }
 
@@ -80,6 +105,7 @@ void TriTreeBase::setContents
     m_vertexArray.copyFrom(vertexArray);
     Tri::setStorage(m_triArray, newStorage);
     m_sky = nullptr;
+    compactContents();
     rebuild();
 }
 
@@ -132,35 +158,89 @@ void TriTreeBase::intersectSphere
 }
 
 
-void TriTreeBase::intersectRays
-    (const Array<Ray>&                 rays,
-    Array<shared_ptr<Surfel>>&         results,
-    IntersectRayOptions                options,
-    const Array<float>&                coherence) const {
-
-    Array<Hit> hits;
-    results.resize(rays.size());
-    intersectRays(rays, hits, options);
+void TriTreeBase::sampleHits(const Array<Hit>& hits, const Array<float>* rayTime, Array<shared_ptr<Surfel>>& results) const {
+    results.resize(hits.size());
 
     const Hit* pHit = hits.getCArray();
     shared_ptr<Surfel>* pSurfel = results.getCArray();
     const Tri* pTri = m_triArray.getCArray();
+    const bool compact = (m_compactTriArray.size() > 0);
+    const Point3* pPrevPosition = (notNull(rayTime) && ! compact && hasMotion()) ? m_vertexArray.prevPosition.getCArray() : nullptr;
 
     tbb::parallel_for(tbb::blocked_range<size_t>(0, hits.size(), 128), [&](const tbb::blocked_range<size_t>& r) {
         const size_t start = r.begin();
         const size_t end   = r.end();
         for (size_t i = start; i < end; ++i) {
             const Hit& hit = pHit[i];
-            if (hit.triIndex != Hit::NONE) {
+            if (compact && (hit.triIndex != Hit::NONE)) {
+                m_compactTriArray.sample(hit.u, hit.v, hit.triIndex, hit.backface, pSurfel[i], 0, 0, m_compactTriArray.twoSided(hit.triIndex));
+            } else if (hit.triIndex != Hit::NONE) {
+                const Tri& tri = pTri[hit.triIndex];
                 // Pass twoSided to determine whether or not to flip normals.
-                pTri[hit.triIndex].sample(hit.u, hit.v, hit.triIndex, m_vertexArray, hit.backface, pSurfel[i], pTri[hit.triIndex].twoSided());
-            }
-            else {
+                tri.sample(hit.u, hit.v, hit.triIndex, m_vertexArray, hit.backface, pSurfel[i], tri.twoSided());
+
+                const float time = notNull(pPrevPosition) ? (*rayTime)[int(i)] : 1.0f;
+                if (time < 1.0f) {
+                    // Move the surfel to where the triangle was at the ray's time
+                    const float w = 1.0f - hit.u - hit.v;
+                    const Point3& prev = pPrevPosition[tri.index[0]] * w + pPrevPosition[tri.index[1]] * hit.u + pPrevPosition[tri.index[2]] * hit.v;
+                    pSurfel[i]->position = prev.lerp(pSurfel[i]->position, time);
+                }
+            } else {
                 pSurfel[i] = nullptr;
             }
         }
     });
+}
+
+
+void TriTreeBase::intersectRays
+    (const Array<Ray>&                 rays,
+    Array<shared_ptr<Surfel>>&         results,
+    IntersectRayOptions                options,
+    const Array<float>&                coherence) const {
+
+    Array<Hit> hits;
+    intersectRays(rays, hits, options);
+    sampleHits(hits, nullptr, results);
+}
+
+
+void TriTreeBase::intersectRays
+    (const Array<Ray>&                 rays,
+    const Array<float>&                rayTime,
+    Array<Hit>&                        results,
+    IntersectRayOptions                options) const {
+
+    intersectRays(rays, results, options);
+}
+
+
+void TriTreeBase::intersectRays
+    (const Array<Ray>&                 rays,
+    const Array<float>&                rayTime,
+    Array<shared_ptr<Surfel>>&         results,
+    IntersectRayOptions                options) const {
+
+    debugAssertM(rayTime.size() == rays.size(), "Must have one time per ray");
+    Array<Hit> hits;
+    intersectRays(rays, rayTime, hits, options);
+    sampleHits(hits, &rayTime, results);
+}
 
+
+void TriTreeBase::intersectRays
+    (const Array<Ray>&                 rays,
+    const Array<float>&                rayTime,
+    Array<bool>&                       results,
+    IntersectRayOptions                options) const {
+
+    Array<Hit> hits;
+    results.resize(rays.size());
+    intersectRays(rays, rayTime, hits, options);
+    runConcurrently(0, rays.size(), [&](int i) {
+        results[i] = (hits[i].triIndex != Hit::NONE);
+    });
 }
 
 
@@ -52,6 +52,13 @@ void UniversalBSDF::setStorage(ImageStorage s) const {
 }
 
 
+void UniversalBSDF::setLoadPriority(float priority) const {
+    m_lambertian.setLoadPriority(priority);
+    m_transmissive.setLoadPriority(priority);
+    m_glossy.setLoadPriority(priority);
+}
+
+
 bool UniversalBSDF::hasMirror() const {
     const Color4& m = m_glossy.max();
     return (m.a == 1.0f) && ! m.rgb().isZero();
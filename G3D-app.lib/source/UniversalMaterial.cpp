@@ -204,6 +204,7 @@ shared_ptr<UniversalMaterial> UniversalMaterial::create(const String& name, cons
         }
 
         value->m_name = name;
+        value->m_specification = std::make_shared<Specification>(specification);
 
         value->m_constantTable = specification.m_constantTable;
 
@@ -259,6 +260,15 @@ void UniversalMaterial::setStorage(ImageStorage s) const {
 }
 
 
+void UniversalMaterial::setLoadPriority(float priority) const {
+    m_bsdf->setLoadPriority(priority);
+    m_emissive.setLoadPriority(priority);
+    if (m_bump) {
+        m_bump->setLoadPriority(priority);
+    }
+}
+
+
 bool UniversalMaterial::hasTransmissive() const {
     return notNull(m_bsdf->transmissive().texture()) && (m_bsdf->transmissive().texture()->max().rgb().max() > 0);
 }
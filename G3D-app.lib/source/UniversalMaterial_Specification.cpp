@@ -158,12 +158,50 @@ UniversalMaterial::Specification::Specification(const Any& any) {
 
 Any UniversalMaterial::Specification::toAny() const {
     Any a(Any::TABLE, "UniversalMaterial::Specification");
-    // TODO
-    debugAssertM(false, "Unimplemented");
+    a["lambertian"]         = m_lambertian;
+    a["glossy"]             = m_glossy;
+    a["transmissive"]       = m_transmissive;
+    a["emissive"]           = m_emissive;
+    a["etaTransmit"]        = m_etaTransmit;
+    a["extinctionTransmit"] = m_extinctionTransmit;
+    a["etaReflect"]         = m_etaReflect;
+    a["extinctionReflect"]  = m_extinctionReflect;
+    a["refractionHint"]     = m_refractionHint;
+    a["mirrorHint"]         = m_mirrorHint;
+    a["alphaFilter"]        = m_alphaFilter;
+    a["sampler"]            = m_sampler;
+    a["flags"]              = int(m_flags);
+    a["inferAmbientOcclusionAtTransparentPixels"] = m_inferAmbientOcclusionAtTransparentPixels;
+
+    if (! m_customShaderPrefix.empty()) {
+        a["customShaderPrefix"] = m_customShaderPrefix;
+    }
+
+    if (! m_bump.texture.filename.empty()) {
+        Any bump(Any::TABLE, "BumpMap::Specification");
+        bump["texture"]  = m_bump.texture;
+        bump["settings"] = m_bump.settings;
+        a["bump"] = bump;
+    }
+
+    if (m_constantTable.size() > 0) {
+        Any constants(Any::TABLE);
+        for (Table<String, double>::Iterator it = m_constantTable.begin(); it.isValid(); ++it) {
+            constants[it->key] = it->value;
+        }
+        a["constantTable"] = constants;
+    }
+
     return a;
 }
 
 
+bool UniversalMaterial::Specification::usesTextureObjects() const {
+    return notNull(m_lambertianTex) || notNull(m_glossyTex) || notNull(m_transmissiveTex) ||
+        notNull(m_emissiveTex) || (m_numLightMapDirections > 0);
+}
+
+
 void UniversalMaterial::Specification::setLambertian(const shared_ptr<Texture>& tex) {
     m_lambertianTex = tex;
 }
@@ -33,6 +33,11 @@ void UniversalSurface::setStorage(ImageStorage newStorage) {
 }
 
 
+void UniversalSurface::setLoadPriority(float priority) const {
+    m_material->setLoadPriority(priority);
+}
+
+
 TransparencyType UniversalSurface::transparencyType() const {
     if ((m_material->bsdf()->lambertian().max().a < 1.0f) && (m_material->alphaFilter() == AlphaFilter::BLEND)) {
         // Because the max alpha is less than one, this surface has no fully nontransparent texels
@@ -883,7 +888,9 @@ void UniversalSurface::getObjectSpaceGeometry
     index.copyPOD(*(m_cpuGeom.index));
     //  If the CPUVertexArray is not null, then it supercedes the other data
     if (notNull(m_cpuGeom.vertexArray)) {
-        const Array<CPUVertexArray::Vertex>& vertexArray = (m_cpuGeom.vertexArray)->vertex;
+        const Array<CPUVertexArray::Vertex>& vertexArray = m_cpuGeom.posedVertexArray()->vertex;
+        // Skinned geometry carries its own previous positions because the bones move
+        const Array<Point3>* prevPosition = (previous && notNull(m_cpuGeom.skinnedVertexArray)) ? &m_cpuGeom.skinnedVertexArray->prevPosition() : nullptr;
         const int offset = vertex.size();
         const int N = vertexArray.size();
         vertex.resize(offset + N);
@@ -893,7 +900,7 @@ void UniversalSurface::getObjectSpaceGeometry
         runConcurrently(0, N, [&](int i) {
             const CPUVertexArray::Vertex& vert = vertexArray[i];
             const int j = i + offset;
-            vertex[j] = vert.position;
+            vertex[j] = notNull(prevPosition) ? (*prevPosition)[i] : vert.position;
             normal[j] = vert.normal;
             packedTangent[j] = vert.tangent;
             texCoord[j] = vert.texCoord0;
@@ -907,6 +914,39 @@ void UniversalSurface::getObjectSpaceGeometry
 }
 
 
+bool UniversalSurface::getObjectSpaceOccluderGeometry
+   (Array<int>&                  index,
+    Array<Point3>&               vertex,
+    int                          maxTriangles,
+    bool                         previous) const {
+
+    index.fastClear();
+    vertex.fastClear();
+    if (isNull(m_cpuGeom.index) || (m_cpuGeom.index->size() > maxTriangles * 3) ||
+        (isNull(m_cpuGeom.vertexArray) && isNull(m_cpuGeom.geometry)) ||
+        (transparencyType() != TransparencyType::NONE)) {
+        return false;
+    }
+
+    index.copyPOD(*(m_cpuGeom.index));
+    if (notNull(m_cpuGeom.vertexArray)) {
+        const Array<CPUVertexArray::Vertex>& vertexArray = m_cpuGeom.posedVertexArray()->vertex;
+        const Array<Point3>* prevPosition = (previous && notNull(m_cpuGeom.skinnedVertexArray)) ? &m_cpuGeom.skinnedVertexArray->prevPosition() : nullptr;
+        if (notNull(prevPosition)) {
+            vertex.copyPOD(*prevPosition);
+        } else {
+            vertex.resize(vertexArray.size());
+            for (int i = 0; i < vertexArray.size(); ++i) {
+                vertex[i] = vertexArray[i].position;
+            }
+        }
+    } else {
+        vertex.copyPOD(m_cpuGeom.geometry->vertexArray);
+    }
+    return true;
+}
+
+
 void UniversalSurface::CPUGeom::copyVertexDataToGPU
 (AttributeArray&               vertex, 
  AttributeArray&               normal, 
@@ -1005,7 +1045,7 @@ void UniversalSurface::getTrisHomogeneous
     
         const Array<int>& index(*cpuGeom.index);
     
-        _internal::IndexOffsetTableKey key(cpuGeom.vertexArray);
+        _internal::IndexOffsetTableKey key(cpuGeom.posedVertexArray());
         // Object to world matrix.  Guaranteed to be an RT transformation,
         // so we can directly transform normals as if they were vectors.
         surface->getCoordinateFrame(key.cFrame, CURRENT);
@@ -1022,6 +1062,14 @@ void UniversalSurface::getTrisHomogeneous
 
             if (computePrevPosition) {
                 cpuVertexArray.transformAndAppend(*(key.vertexArray), key.cFrame, prevFrame);
+                if (notNull(cpuGeom.skinnedVertexArray)) {
+                    // The bones moved as well as the surface, so replace the rigidly transformed
+                    // previous positions with the previous skinned ones
+                    const Array<Point3>& prevPosition = cpuGeom.skinnedVertexArray->prevPosition();
+                    for (int v = 0; v < prevPosition.size(); ++v) {
+                        cpuVertexArray.prevPosition[indexOffset + v] = prevFrame.pointToWorldSpace(prevPosition[v]);
+                    }
+                }
             } else {
                 cpuVertexArray.transformAndAppend(*(key.vertexArray), key.cFrame);
             }
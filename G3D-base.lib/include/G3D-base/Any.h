@@ -824,10 +824,29 @@ public:
     void clear();
 
     /** Parse from a file.
+
+     If binaryCacheDirectory() is set, this reads the binary form of the file from the cache
+     instead when the cache is newer than the file and everything that it #includes.
+
      \sa deserialize, parse, fromFile, loadIfExists
      */
     void load(const String& filename);
 
+    /** \brief Sets the directory in which load() caches the binary serialization of each text file
+        that it parses.
+
+        Reading the binary form skips tokenization and is about three times faster than parsing 
+        the text, which matters for large scene files. Source locations are preserved, so errors
+        reported against a cached Any still point into the original text. A cache entry is 
+        ignored when the file or any file that it #includes has changed size or is newer than
+        the entry. Files inside zipfiles are not cached.
+
+        The default is empty, which disables the cache. */
+    static void setBinaryCacheDirectory(const String& directory);
+
+    /** \copydoc setBinaryCacheDirectory */
+    static const String& binaryCacheDirectory();
+
     /** Load a new Any from \a filename. \sa load, save, loadIfExists */
     static Any fromFile(const String& filename);
 
@@ -840,12 +859,17 @@ public:
     /** \param coerce.  If json=true, should features that JSON doesn't support be coerced or produce errors?*/
     void serialize(TextOutput& to, bool json = false, bool coerce = false) const;
 
+    /** Writes a compact binary form of this Any and its children. Strings, including names,
+        keys, comments, and source filenames, are written once and referenced by index.
+        Comments, brackets, #include lines, and source locations are preserved. */
     void serialize(class BinaryOutput& b) const;
 
     /** Parse from a stream.
      \sa load, parse */
     void deserialize(TextInput& ti);
 
+    /** Reads the form written by serialize(BinaryOutput&), including the unparsed text written
+        by older versions. Throws a ParseError for unknown versions and truncated or corrupt input. */
     void deserialize(class BinaryInput& b);
 
     const Source& source() const;
@@ -970,6 +994,16 @@ private:
     void deserializeTable(TextInput& ti);
     void deserializeArray(TextInput& ti,const String& term);
 
+    /** Interns strings for serialize(BinaryOutput&) */
+    class BinaryStringTable;
+
+    void serializeBinary(class BinaryOutput& b, BinaryStringTable& strings) const;
+    void deserializeBinary(class BinaryInput& b, const Array<String>& strings);
+
+    /** Returns false if there is no valid cache entry for \a filename */
+    bool loadBinaryCache(const String& filename);
+    void saveBinaryCache(const String& filename, const Array<String>& dependencies) const;
+
     /** Turns an empty container into a table or an array */
     void become(const Type& t);
 
@@ -0,0 +1,153 @@
+/**
+  \file G3D-base.lib/include/G3D-base/AsyncFileReader.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "G3D-base/platform.h"
+#include "G3D-base/G3DString.h"
+#include "G3D-base/g3dmath.h"
+#include "G3D-base/ReferenceCount.h"
+
+namespace G3D {
+
+/** \brief Reads whole files on a pool of I/O threads so that callers can overlap disk access with
+    decoding or other work.
+
+    Files may be on disk or inside zipfiles. Reads are served first-in-first-out, ahead of all
+    prefetch hints. The FileSystem lock is held only while resolving zipfile names, never while
+    waiting on the disk.
+
+    \code
+    const shared_ptr<AsyncFileReader>& reader = AsyncFileReader::common();
+    reader->prefetch("level2.obj");
+
+    std::future<shared_ptr<AsyncFileReader::Buffer>> texture = reader->read("wall.png");
+    ...
+    const shared_ptr<AsyncFileReader::Buffer>& buffer = texture.get();
+    if (buffer->ok()) {
+        BinaryInput bi(buffer->data, buffer->size, G3D_LITTLE_ENDIAN, false, false);
+        ...
+    }
+    \endcode
+
+    \sa BinaryInput, MemoryMappedFile, FileSystem */
+class AsyncFileReader : public ReferenceCountedObject {
+public:
+
+    /** The contents of one file */
+    class Buffer : public ReferenceCountedObject {
+    protected:
+        Buffer(const String& filename) : filename(filename), data(nullptr), size(0) {}
+
+    public:
+        String          filename;
+
+        /** Aligned to 16 bytes. nullptr if the file is empty or could not be read. */
+        uint8*          data;
+
+        int64           size;
+
+        /** Empty unless the read failed */
+        String          error;
+
+        ~Buffer();
+
+        bool ok() const {
+            return error.empty();
+        }
+    };
+
+    /** Invoked on an I/O thread when a read completes, whether or not it succeeded. Must not throw,
+        and should hand expensive work off to another thread so that it does not delay other reads. */
+    typedef std::function<void(const shared_ptr<Buffer>&)> Callback;
+
+protected:
+
+    class Request {
+    public:
+        String                                  filename;
+
+        /** Set for read() with a future */
+        std::promise<shared_ptr<Buffer>>        promise;
+
+        /** Set for read() with a callback */
+        Callback                                callback;
+    };
+
+    std::mutex                  m_mutex;
+
+    /** Signaled when a request is queued or the threads are stopping */
+    std::condition_variable     m_workAvailable;
+
+    std::deque<Request>         m_readQueue;
+
+    /** Served only when m_readQueue is empty */
+    std::deque<String>          m_prefetchQueue;
+
+    std::vector<std::thread>    m_threadArray;
+
+    bool                        m_stop;
+
+    AsyncFileReader(int numThreads);
+
+    void workerMain();
+
+    /** Does not throw */
+    static shared_ptr<Buffer> readFile(const String& filename);
+
+    /** Throws a String on failure */
+    static void readFromZipfile(const String& zipfile, const String& internalFile, Buffer& buffer);
+
+    /** Throws a String on failure */
+    static void readFromDisk(const String& filename, Buffer& buffer);
+
+    static void prefetchFile(const String& filename);
+
+    void enqueue(Request&& request);
+
+public:
+
+    /** Reads block on the device rather than the CPU, so the default does not depend on the number
+        of cores. Several outstanding requests let SSDs and network drives reorder and overlap them. */
+    enum { DEFAULT_NUM_THREADS = 4 };
+
+    static shared_ptr<AsyncFileReader> create(int numThreads = DEFAULT_NUM_THREADS);
+
+    /** A reader shared by the whole program, created on first use */
+    static const shared_ptr<AsyncFileReader>& common();
+
+    /** Completes all queued reads and drops queued prefetches */
+    ~AsyncFileReader();
+
+    int numThreads() const {
+        return int(m_threadArray.size());
+    }
+
+    /** Queues a read of all of \a filename. Errors are reported in Buffer::error rather than thrown. */
+    std::future<shared_ptr<Buffer>> read(const String& filename);
+
+    /** Queues a read of all of \a filename and passes the result to \a callback on an I/O thread */
+    void read(const String& filename, const Callback& callback);
+
+    /** Hints that \a filename will be read soon. The operating system begins loading it into its
+        file cache in the background when no reads are queued, so that a later read(), BinaryInput,
+        or MemoryMappedFile finds it there. Missing files are ignored. */
+    void prefetch(const String& filename);
+
+    /** Number of reads and prefetches that have not started */
+    int queueDepth();
+};
+
+} // namespace G3D
@@ -33,6 +33,7 @@
 #include "G3D-base/g3dmath.h"
 #include "G3D-base/debug.h"
 #include "G3D-base/System.h"
+#include "G3D-base/MemoryMappedFile.h"
 
 
 namespace G3D {
@@ -118,6 +119,12 @@ private:
      */
     bool            m_freeBuffer;
 
+    /** Non-null when m_buffer is a view of a memory-mapped file */
+    shared_ptr<MemoryMappedFile> m_mappedFile;
+
+    /** Points m_buffer at m_mappedFile's pages */
+    void initFromMappedFile();
+
     /** Ensures that we are able to read at least minLength from startPosition (relative
         to start of file). */
     void loadIntoMemory(int64 startPosition, int64 minLength = 0);
@@ -138,18 +145,54 @@ public:
     /** false, constant to use with the copyMemory option */
     static const bool       NO_COPY;
 
+    /** Uncompressed local files, and zipfile entries stored without compression, at least this
+        many bytes long are memory-mapped by the filename constructor instead of read into a heap
+        buffer. 16 MB */
+    static const int64      MEMORY_MAP_MIN_LENGTH = 16 * 1024 * 1024;
+
     /**
        If the file cannot be opened, a zero length buffer is presented.
        Automatically opens files that are inside zipfiles.
 
+       Uncompressed files of at least MEMORY_MAP_MIN_LENGTH bytes are
+       memory-mapped, so that they occupy no heap memory and pages are read
+       from disk only when first accessed. Inside zipfiles, this applies to
+       entries stored without compression, which are read in place from the
+       archive's mapping (see FileSystem::zipArchive()); smaller entries are copied.
+
+       A mapped file stays mapped until this BinaryInput is destroyed. Until then, do not
+       modify or replace the file: Windows refuses to replace it, and on other platforms
+       truncating or rewriting it in place makes later reads fault with SIGBUS. BinaryOutput::commit()
+       rewrites files in place, so destroy the BinaryInput before writing the same file.
+       isMemoryMapped() reports whether this applies.
+
        @param compressed Set to true if and only if the file was
        compressed using BinaryOutput's zlib compression.  This has
        nothing to do with whether the input is in a zipfile.
+
+       @param accessPattern Read-ahead hint used if the file is memory-mapped
     */
     BinaryInput(
         const String&  filename,
         G3DEndian           fileEndian,
-        bool                compressed = false);
+        bool                compressed = false,
+        MemoryMappedFile::AccessPattern accessPattern = MemoryMappedFile::SEQUENTIAL);
+
+    /**
+     Reads directly from the pages of \a file without copying them, regardless
+     of the file's size. The mapping is kept alive until this BinaryInput is destroyed.
+
+     \code
+        const shared_ptr<MemoryMappedFile>& file = MemoryMappedFile::create(filename, MemoryMappedFile::RANDOM);
+        if (notNull(file)) {
+            BinaryInput bi(file, G3D_LITTLE_ENDIAN);
+            ...
+        }
+     \endcode
+     */
+    BinaryInput(
+        const shared_ptr<MemoryMappedFile>& file,
+        G3DEndian           fileEndian);
 
     /**
      Creates input stream from an in memory source.
@@ -196,6 +239,15 @@ public:
         return m_filename;
     }
 
+    /** True if the bytes are read directly from a memory-mapped file */
+    bool isMemoryMapped() const {
+        return notNull(m_mappedFile);
+    }
+
+    /** Asks the operating system to begin paging in the next \a numBytes
+        after the current position. Has no effect unless isMemoryMapped(). */
+    void prefetch(int64 numBytes) const;
+
     /**
      Performs bounds checks in debug mode.  [] are relative to
      the start of the file, not the current position.
@@ -228,7 +280,7 @@ public:
 
     /**
      Returns a pointer to the internal memory buffer.
-     May throw an exception for huge files.
+     May throw an exception for huge files that are not memory-mapped.
      */
     const uint8* getCArray() {
         if (m_alreadyRead > 0 || m_bufferLength < m_length) {
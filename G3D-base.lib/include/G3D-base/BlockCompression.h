@@ -0,0 +1,162 @@
+/**
+  \file G3D-base.lib/include/G3D-base/BlockCompression.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+#define G3D_BlockCompression_h
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/G3DString.h"
+#include "G3D-base/G3DGameUnits.h"
+#include "G3D-base/g3dmath.h"
+
+namespace G3D {
+
+class Image;
+class ImageFormat;
+class PixelTransferBuffer;
+class BinaryInput;
+class BinaryOutput;
+
+/**
+  \brief CPU encoder and decoder for the BCn (S3TC/RGTC/BPTC) GPU texture compression formats.
+
+  Every format stores each 4x4 block of pixels in a fixed number of bytes, so a compressed
+  image of width w and height h occupies ceil(w / 4) * ceil(h / 4) * bytesPerBlock() bytes,
+  in row-major block order from the top of the image.
+
+  Endpoints are fit to the principal axis of each block's colors, refined by least squares,
+  and indices are chosen with SSE on x86. Block rows are encoded concurrently.
+
+  The encoder and decoder do not require OpenGL. Texture uploads the results through
+  ImageFormat::RGB_DXT1, RGBA_DXT5, R_RGTC1, RG_RGTC2, and RGBA_BPTC and their sRGB versions.
+
+  \sa Texture::setBlockCompressionCacheDirectory
+*/
+class BlockCompression {
+public:
+
+    enum class Format {
+        /** RGB at 4 bits per pixel. Also known as DXT1. */
+        BC1,
+
+        /** RGBA at 8 bits per pixel: BC1 color plus a BC4 alpha block. Also known as DXT5. */
+        BC3,
+
+        /** R at 4 bits per pixel, for masks and heights. */
+        BC4,
+
+        /** RG at 8 bits per pixel, for tangent-space normal maps. */
+        BC5,
+
+        /** RGBA at 8 bits per pixel. The encoder emits only mode 6 blocks, and
+            the decoder reads only mode 6 blocks. */
+        BC7
+    };
+
+    /** Quality and speed of one encode() */
+    class Report {
+    public:
+        Format      format = Format::BC1;
+        int         width = 0;
+        int         height = 0;
+
+        /** Peak signal-to-noise ratio in dB over the channels that \a format stores.
+            finf() if the result was lossless. */
+        float       psnr = 0.0f;
+
+        RealTime    encodeTime = 0;
+
+        float megapixelsPerSecond() const {
+            return (encodeTime > 0) ? float(double(width) * double(height) / (encodeTime * 1e6)) : finf();
+        }
+
+        String toString() const;
+    };
+
+    /** A compressed image and its MIP levels, largest first */
+    class MipChain {
+    public:
+        Format                  format = Format::BC1;
+        int                     width = 0;
+        int                     height = 0;
+
+        /** True if the color channels hold sRGB-encoded values */
+        bool                    sRGB = false;
+
+        Array<Array<uint8>>     level;
+
+        int levelWidth(int m) const  { return G3D::max(1, width >> m); }
+        int levelHeight(int m) const { return G3D::max(1, height >> m); }
+
+        /** Writes a small header followed by the raw blocks of every level, in the spirit of
+            DDS and KTX2, so that a reader can upload each level directly. */
+        void serialize(BinaryOutput& b) const;
+
+        /** Throws a String if the data is malformed */
+        void deserialize(BinaryInput& b);
+
+        /** The ImageFormat of every level, or nullptr if \a format has no sRGB version and \a sRGB is true */
+        const ImageFormat* imageFormat() const {
+            return BlockCompression::imageFormat(format, sRGB);
+        }
+
+        /** Wraps level \a m for Texture upload. Requires imageFormat() to be non-null.
+            The result references this MipChain's memory, which must outlive it. */
+        shared_ptr<PixelTransferBuffer> toPixelTransferBuffer(int m) const;
+    };
+
+private:
+
+    BlockCompression() {}
+
+public:
+
+    static const char* toString(Format format);
+
+    /** 8 for BC1 and BC4, 16 otherwise */
+    static int bytesPerBlock(Format format);
+
+    /** 1 for BC4, 2 for BC5, 3 for BC1, and 4 otherwise */
+    static int numChannels(Format format);
+
+    static size_t encodedSize(Format format, int width, int height);
+
+    /** The ImageFormat for data in \a format, or nullptr for sRGB BC4 and BC5, which do not exist */
+    static const ImageFormat* imageFormat(Format format, bool sRGB);
+
+    /** Encodes tightly packed RGBA8 pixels. \a dst must hold encodedSize(format, width, height) bytes.
+        Channels that \a format does not store are ignored. */
+    static void encode(Format format, const uint8* rgba8, int width, int height, uint8* dst, bool singleThread = false);
+
+    /** Encodes any format that Image can convert to RGBA8. R8/L8 and RG8 sources are
+        read directly, so BC4 and BC5 can encode single- and dual-channel data. */
+    static void encode(Format format, const shared_ptr<PixelTransferBuffer>& src, Array<uint8>& dst, bool singleThread = false);
+
+    /** Writes width * height RGBA8 pixels. Channels that \a format does not store are 0,
+        except alpha, which is 255. */
+    static void decode(Format format, const uint8* src, int width, int height, uint8* rgba8);
+
+    /** \copydoc decode */
+    static shared_ptr<Image> decode(Format format, const Array<uint8>& src, int width, int height);
+
+    /** Peak signal-to-noise ratio in dB between the first \a numChannels channels of two
+        RGBA8 arrays of \a numPixels pixels. Returns finf() if they are identical. */
+    static float psnr(const uint8* a, const uint8* b, int numPixels, int numChannels = 4);
+
+    /** Encodes \a src, then decodes it to measure quality */
+    static Report measure(Format format, const shared_ptr<PixelTransferBuffer>& src);
+
+    /** Encodes \a src and a MIP chain down to 1x1 generated by Image::generateMipChain.
+
+        \param sRGB If true, \a src holds sRGB-encoded color that is filtered in linear space.
+        \param alphaCoverageReference See Image::ResampleSettings::alphaCoverageReference */
+    static void encodeMipChain(Format format, const shared_ptr<PixelTransferBuffer>& src, bool sRGB, MipChain& chain, float alphaCoverageReference = -1.0f);
+};
+
+} // namespace G3D
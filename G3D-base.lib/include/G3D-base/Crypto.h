@@ -111,6 +111,22 @@ public:
      */
     static MD5Hash md5(const void* bytes, size_t numBytes);
 
+    /** Initial value for fnv1a64 */
+    static const uint64 FNV1A64_BASIS = 14695981039346656037ull;
+
+    /**
+     Continues the 64-bit FNV-1a hash \a hash over a byte array and returns the result.
+     Whole 8-byte words are folded in at once so that hashing large files is fast, so the
+     values differ from byte-wise FNV-1a. Use this for cache keys, not for security.
+
+     Hash several arrays by passing each result to the next call:
+     <pre>
+       uint64 h = Crypto::fnv1a64(&version, sizeof(version));
+       h = Crypto::fnv1a64(text.c_str(), text.size(), h);
+     </pre>
+     */
+    static uint64 fnv1a64(const void* bytes, size_t numBytes, uint64 hash = FNV1A64_BASIS);
+
     /**
      Returns the nth prime less than 2000 in constant time.  The first prime has index
      0 and is the number 2.
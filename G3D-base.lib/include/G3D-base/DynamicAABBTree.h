@@ -0,0 +1,515 @@
+/**
+  \file G3D-base.lib/include/G3D-base/DynamicAABBTree.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+
+#include "G3D-base/platform.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/SmallArray.h"
+#include "G3D-base/AABox.h"
+#include "G3D-base/Sphere.h"
+#include "G3D-base/Ray.h"
+#include <queue>
+#include <vector>
+#include <tuple>
+#include <functional>
+
+namespace G3D {
+
+/**
+ \brief Bounding volume hierarchy over a changing set of objects, for ray, box, sphere, and nearest-neighbor queries.
+
+ Unlike KDTree and TriTree, which are rebuilt from scratch when their contents change, this tree
+ is maintained incrementally. Each member is stored in a leaf whose box is <i>fattened</i> by a margin
+ beyond the member's actual bounds. update() is free as long as the new bounds remain inside the fattened
+ box, and otherwise reinserts the leaf. Insertion chooses the sibling that least increases surface area and
+ the tree is kept height-balanced by rotations, so a member that moves every frame costs O(log n).
+
+ Each member also carries a 32-bit mask. Internal nodes store the union of their descendants' masks, so queries
+ that pass a \a mask skip entire subtrees that contain no matching members.
+
+ T is copied into the tree and must have a default constructor. It is typically a pointer or shared_ptr.
+
+ \cite Catto, Box2D b2DynamicTree, 2009
+ \sa KDTree, PointHashGrid
+*/
+template<class T>
+class DynamicAABBTree {
+public:
+
+    /** Identifies a member of the tree. Handles are stable until the member is removed. */
+    typedef int Handle;
+
+    enum { NONE = -1 };
+
+    /** Matches every mask */
+    static const uint32 ALL = 0xFFFFFFFF;
+
+protected:
+
+    class Node {
+    public:
+        /** Fattened bounds for a leaf; the union of the children's bounds for an internal node */
+        AABox       bounds;
+
+        /** Actual bounds of the member. Only used by leaves. */
+        AABox       tightBounds;
+
+        T           value;
+
+        /** For internal nodes, the union of the descendant masks */
+        uint32      mask = 0;
+
+        /** For a node on the free list, the next free node */
+        int         parent = NONE;
+
+        int         child[2] = {NONE, NONE};
+
+        /** 0 for a leaf, -1 for a free node */
+        int         height = -1;
+
+        bool isLeaf() const {
+            return child[0] == NONE;
+        }
+    };
+
+    Array<Node>     m_node;
+    int             m_root = NONE;
+    int             m_freeList = NONE;
+    int             m_size = 0;
+    float           m_relativeMargin;
+    float           m_absoluteMargin;
+
+    Handle allocateNode() {
+        Handle n;
+        if (m_freeList != NONE) {
+            n = m_freeList;
+            m_freeList = m_node[n].parent;
+        } else {
+            n = m_node.size();
+            m_node.next();
+        }
+        Node& node = m_node[n];
+        node.parent = NONE;
+        node.child[0] = node.child[1] = NONE;
+        node.height = 0;
+        node.mask = 0;
+        return n;
+    }
+
+    void freeNode(Handle n) {
+        Node& node = m_node[n];
+        // Release any reference held by the value
+        node.value = T();
+        node.height = -1;
+        node.parent = m_freeList;
+        m_freeList = n;
+    }
+
+    AABox fatten(const AABox& box) const {
+        const Vector3& d = box.extent() * m_relativeMargin + Vector3(m_absoluteMargin, m_absoluteMargin, m_absoluteMargin);
+        return AABox(box.low() - d, box.high() + d);
+    }
+
+    static AABox merge(const AABox& a, const AABox& b) {
+        return AABox(a.low().min(b.low()), a.high().max(b.high()));
+    }
+
+    /** Recomputes the bounds, mask, and height of internal node \a n from its children */
+    void refit(Handle n) {
+        Node& node = m_node[n];
+        const Node& A = m_node[node.child[0]];
+        const Node& B = m_node[node.child[1]];
+        node.bounds = merge(A.bounds, B.bounds);
+        node.mask = A.mask | B.mask;
+        node.height = 1 + max(A.height, B.height);
+    }
+
+    /** Walks from \a n to the root, balancing and refitting each ancestor */
+    void refitAncestors(Handle n) {
+        while (n != NONE) {
+            n = balance(n);
+            refit(n);
+            n = m_node[n].parent;
+        }
+    }
+
+    /** Replaces \a oldChild of \a parent (or the root) with \a newChild */
+    void replaceChild(Handle parent, Handle oldChild, Handle newChild) {
+        if (parent == NONE) {
+            m_root = newChild;
+        } else if (m_node[parent].child[0] == oldChild) {
+            m_node[parent].child[0] = newChild;
+        } else {
+            m_node[parent].child[1] = newChild;
+        }
+    }
+
+    /** If the subtree at \a a is unbalanced, rotates a grandchild up to replace it and
+        returns the index of the new subtree root. */
+    Handle balance(Handle a) {
+        const Node& A = m_node[a];
+        if (A.isLeaf()) {
+            return a;
+        }
+
+        const Handle b = A.child[0];
+        const Handle c = A.child[1];
+        const int skew = m_node[c].height - m_node[b].height;
+
+        if (skew > 1) {
+            return rotate(a, c, 1);
+        } else if (skew < -1) {
+            return rotate(a, b, 0);
+        } else {
+            return a;
+        }
+    }
+
+    /** Promotes child \a c (which is A.child[side]) of \a a, moving \a a down to become a child of \a c */
+    Handle rotate(Handle a, Handle c, int side) {
+        Node& A = m_node[a];
+        Node& C = m_node[c];
+        const Handle f = C.child[0];
+        const Handle g = C.child[1];
+
+        C.child[0] = a;
+        C.parent = A.parent;
+        A.parent = c;
+        replaceChild(C.parent, a, c);
+
+        // Keep the taller grandchild under C and give the shorter one to A
+        Handle keep = f, give = g;
+        if (m_node[f].height < m_node[g].height) {
+            keep = g;
+            give = f;
+        }
+        C.child[1] = keep;
+        A.child[side] = give;
+        m_node[give].parent = a;
+
+        refit(a);
+        refit(c);
+        return c;
+    }
+
+    void insertLeaf(Handle leaf) {
+        if (m_root == NONE) {
+            m_root = leaf;
+            m_node[leaf].parent = NONE;
+            return;
+        }
+
+        // Descend to the sibling that minimizes the surface area added to the tree
+        const AABox& leafBounds = m_node[leaf].bounds;
+        Handle sibling = m_root;
+        while (! m_node[sibling].isLeaf()) {
+            const Node& node = m_node[sibling];
+            const float area = node.bounds.area();
+            const float combinedArea = merge(node.bounds, leafBounds).area();
+
+            // Cost of creating a new parent for this node and the leaf
+            const float cost = 2.0f * combinedArea;
+
+            // Minimum cost of pushing the leaf further down the tree
+            const float inheritanceCost = 2.0f * (combinedArea - area);
+
+            float childCost[2];
+            for (int i = 0; i < 2; ++i) {
+                const Node& child = m_node[node.child[i]];
+                const float enlarged = merge(child.bounds, leafBounds).area();
+                childCost[i] = (child.isLeaf() ? enlarged : (enlarged - child.bounds.area())) + inheritanceCost;
+            }
+
+            if ((cost < childCost[0]) && (cost < childCost[1])) {
+                break;
+            }
+            sibling = node.child[(childCost[0] < childCost[1]) ? 0 : 1];
+        }
+
+        const Handle oldParent = m_node[sibling].parent;
+        const Handle newParent = allocateNode();
+        Node& P = m_node[newParent];
+        P.parent = oldParent;
+        P.child[0] = sibling;
+        P.child[1] = leaf;
+        m_node[sibling].parent = newParent;
+        m_node[leaf].parent = newParent;
+        replaceChild(oldParent, sibling, newParent);
+
+        refitAncestors(newParent);
+    }
+
+    void removeLeaf(Handle leaf) {
+        if (leaf == m_root) {
+            m_root = NONE;
+            return;
+        }
+
+        const Handle parent = m_node[leaf].parent;
+        const Handle grandparent = m_node[parent].parent;
+        const Handle sibling = (m_node[parent].child[0] == leaf) ? m_node[parent].child[1] : m_node[parent].child[0];
+
+        // The sibling takes the parent's place
+        replaceChild(grandparent, parent, sibling);
+        m_node[sibling].parent = grandparent;
+        freeNode(parent);
+
+        if (grandparent != NONE) {
+            refitAncestors(grandparent);
+        }
+    }
+
+    /** Distance from \a point to \a box, or zero if the point is inside */
+    static float squaredDistance(const AABox& box, const Point3& point) {
+        const Vector3& d = (box.low() - point).max(point - box.high()).max(Vector3::zero());
+        return d.squaredLength();
+    }
+
+    /** Distance along \a ray to the first point within \a box, or finf() if the ray misses
+        it before \a maxDistance. Returns zero if the origin is inside the box. */
+    static float entryTime(const Ray& ray, const AABox& box, float maxDistance) {
+        float t0 = 0.0f, t1 = maxDistance;
+        for (int a = 0; a < 3; ++a) {
+            const float o = ray.origin()[a], d = ray.direction()[a];
+            const float lo = box.low()[a], hi = box.high()[a];
+            if (d == 0.0f) {
+                if ((o < lo) || (o > hi)) { return finf(); }
+            } else {
+                const float inv = 1.0f / d;
+                // Not "near" and "far", which windows.h defines as macros
+                float tNear = (lo - o) * inv, tFar = (hi - o) * inv;
+                if (tNear > tFar) { std::swap(tNear, tFar); }
+                t0 = max(t0, tNear);
+                t1 = min(t1, tFar);
+                if (t0 > t1) { return finf(); }
+            }
+        }
+        return t0;
+    }
+
+public:
+
+    /** \param relativeMargin Fraction of each member's extent by which its leaf box is fattened
+        \param absoluteMargin Distance in world units added to the fattened leaf box, so that points and
+               thin members also get slack */
+    DynamicAABBTree(float relativeMargin = 0.1f, float absoluteMargin = 0.05f) :
+        m_relativeMargin(relativeMargin), m_absoluteMargin(absoluteMargin) {}
+
+    /** Number of members */
+    int size() const {
+        return m_size;
+    }
+
+    /** Height of the tree, or -1 if it is empty */
+    int height() const {
+        return (m_root == NONE) ? -1 : m_node[m_root].height;
+    }
+
+    void clear() {
+        m_node.clear();
+        m_root = NONE;
+        m_freeList = NONE;
+        m_size = 0;
+    }
+
+    /** \a bounds must not be empty */
+    Handle insert(const AABox& bounds, const T& value, uint32 mask = ALL) {
+        debugAssertM(! bounds.isEmpty(), "Cannot insert empty bounds into a DynamicAABBTree");
+        const Handle leaf = allocateNode();
+        Node& node = m_node[leaf];
+        node.tightBounds = bounds;
+        node.bounds = fatten(bounds);
+        node.value = value;
+        node.mask = mask;
+        insertLeaf(leaf);
+        ++m_size;
+        return leaf;
+    }
+
+    void remove(Handle leaf) {
+        debugAssert(m_node[leaf].isLeaf() && (m_node[leaf].height == 0));
+        removeLeaf(leaf);
+        freeNode(leaf);
+        --m_size;
+    }
+
+    /** Sets the bounds of a member that may have moved. Returns true if the member
+        left its fattened box and had to be reinserted. */
+    bool update(Handle leaf, const AABox& bounds) {
+        debugAssertM(! bounds.isEmpty(), "Cannot insert empty bounds into a DynamicAABBTree");
+        Node& node = m_node[leaf];
+        node.tightBounds = bounds;
+        if (node.bounds.contains(bounds)) {
+            return false;
+        }
+
+        removeLeaf(leaf);
+        m_node[leaf].bounds = fatten(bounds);
+        insertLeaf(leaf);
+        return true;
+    }
+
+    /** Changes the mask of a member and the masks of its ancestors */
+    void setMask(Handle leaf, uint32 mask) {
+        m_node[leaf].mask = mask;
+        for (Handle n = m_node[leaf].parent; n != NONE; n = m_node[n].parent) {
+            m_node[n].mask = m_node[m_node[n].child[0]].mask | m_node[m_node[n].child[1]].mask;
+        }
+    }
+
+    const T& value(Handle leaf) const {
+        return m_node[leaf].value;
+    }
+
+    uint32 mask(Handle leaf) const {
+        return m_node[leaf].mask;
+    }
+
+    /** The bounds most recently passed to insert() or update() for this member */
+    const AABox& bounds(Handle leaf) const {
+        return m_node[leaf].tightBounds;
+    }
+
+    /** Invokes \a visit(handle) for every leaf whose fattened box satisfies \a overlaps, and prunes internal nodes by the same test */
+    template<class Overlaps, class Visit>
+    void forEachOverlapping(const Overlaps& overlaps, const Visit& visit, uint32 mask = ALL) const {
+        if (m_root == NONE) { return; }
+        SmallArray<Handle, 64> stack;
+        stack.push(m_root);
+        while (stack.size() > 0) {
+            const Handle n = stack.pop();
+            const Node& node = m_node[n];
+            if (((node.mask & mask) == 0) || ! overlaps(node.bounds)) {
+                continue;
+            }
+            if (node.isLeaf()) {
+                visit(n);
+            } else {
+                stack.push(node.child[0]);
+                stack.push(node.child[1]);
+            }
+        }
+    }
+
+    /** Appends the members whose bounds intersect \a box and whose mask shares a bit with \a mask */
+    void getIntersectingMembers(const AABox& box, Array<T>& members, uint32 mask = ALL) const {
+        forEachOverlapping([&](const AABox& b) { return b.intersects(box); }, [&](Handle n) {
+            if (m_node[n].tightBounds.intersects(box)) {
+                members.append(m_node[n].value);
+            }
+        }, mask);
+    }
+
+    /** Appends the members whose bounds intersect \a sphere and whose mask shares a bit with \a mask */
+    void getIntersectingMembers(const Sphere& sphere, Array<T>& members, uint32 mask = ALL) const {
+        const float r2 = square(sphere.radius);
+        forEachOverlapping([&](const AABox& b) { return squaredDistance(b, sphere.center) <= r2; }, [&](Handle n) {
+            if (squaredDistance(m_node[n].tightBounds, sphere.center) <= r2) {
+                members.append(m_node[n].value);
+            }
+        }, mask);
+    }
+
+    /** Visits the members whose fattened boxes are hit by \a ray closer than \a maxDistance,
+        approximately from nearest to farthest.
+
+        \a intersect is called as <code>bool intersect(const T& value, float& maxDistance)</code>. It performs the
+        exact test, and on a hit returns true and reduces \a maxDistance, which then prunes the rest of
+        the traversal. The ray's own minimum and maximum distance are ignored.
+
+        \return true if any call to \a intersect returned true */
+    template<class Intersect>
+    bool intersectRay(const Ray& ray, float& maxDistance, const Intersect& intersect, uint32 mask = ALL) const {
+        if (m_root == NONE) { return false; }
+
+        class Entry {
+        public:
+            Handle  node;
+            float   time;
+        };
+
+        bool hit = false;
+        SmallArray<Entry, 64> stack;
+        const float t = entryTime(ray, m_node[m_root].bounds, maxDistance);
+        if (t < finf()) {
+            stack.push(Entry{m_root, t});
+        }
+
+        while (stack.size() > 0) {
+            const Entry entry = stack.pop();
+            const Node& node = m_node[entry.node];
+            if ((entry.time > maxDistance) || ((node.mask & mask) == 0)) {
+                continue;
+            }
+
+            if (node.isLeaf()) {
+                hit = intersect(node.value, maxDistance) || hit;
+            } else {
+                Entry child[2];
+                for (int i = 0; i < 2; ++i) {
+                    child[i].node = node.child[i];
+                    child[i].time = entryTime(ray, m_node[node.child[i]].bounds, maxDistance);
+                }
+                // Push the farther child first so that the nearer one is visited first
+                if (child[0].time < child[1].time) {
+                    std::swap(child[0], child[1]);
+                }
+                for (int i = 0; i < 2; ++i) {
+                    if (child[i].time < finf()) {
+                        stack.push(child[i]);
+                    }
+                }
+            }
+        }
+
+        return hit;
+    }
+
+    /** Appends up to \a k members nearest to \a point, in order of increasing distance
+        from the point to their bounds. Members containing the point have distance zero.
+
+        \param maxDistance Members farther than this are ignored */
+    void getNearestMembers(const Point3& point, int k, Array<T>& members, uint32 mask = ALL, float maxDistance = finf()) const {
+        if ((m_root == NONE) || (k <= 0) || ((m_node[m_root].mask & mask) == 0)) { return; }
+
+        // (squared distance, node, distance is to the tight bounds of a leaf)
+        typedef std::tuple<float, Handle, bool> Entry;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+        const float maxDistance2 = square(maxDistance);
+        queue.push(Entry(squaredDistance(m_node[m_root].bounds, point), m_root, false));
+
+        int found = 0;
+        while (! queue.empty() && (found < k)) {
+            const Entry entry = queue.top();
+            queue.pop();
+            if (std::get<0>(entry) > maxDistance2) {
+                // Everything remaining is farther
+                break;
+            }
+
+            const Node& node = m_node[std::get<1>(entry)];
+            if (std::get<2>(entry)) {
+                members.append(node.value);
+                ++found;
+            } else if (node.isLeaf()) {
+                // Requeue keyed by the tight bounds, which may be farther than the fattened ones
+                queue.push(Entry(squaredDistance(node.tightBounds, point), std::get<1>(entry), true));
+            } else {
+                for (int i = 0; i < 2; ++i) {
+                    const Node& child = m_node[node.child[i]];
+                    if ((child.mask & mask) != 0) {
+                        queue.push(Entry(squaredDistance(child.bounds, point), node.child[i], false));
+                    }
+                }
+            }
+        }
+    }
+};
+
+} // namespace G3D
@@ -17,6 +17,8 @@
 
 namespace G3D {
 
+class ZipArchive;
+
 /** 
  OS-independent file system layer that optimizes the performance
  of queries by caching and prefetching.
@@ -138,6 +140,23 @@ private:
         On Windows, all paths are lowercase */
     Table<String, Dir>     m_cache;
 
+    class CachedZipArchive {
+    public:
+        shared_ptr<ZipArchive>  archive;
+
+        /** Size and modification time of the zipfile when archive was opened */
+        int64                   size;
+        int64                   modificationTime;
+
+        /** When size and modificationTime were last compared with the file */
+        double                  lastChecked;
+
+        CachedZipArchive() : size(0), modificationTime(0), lastChecked(0) {}
+    };
+
+    /** Open zipfiles, keyed like m_cache */
+    Table<String, CachedZipArchive> m_zipArchive;
+
     /** Update the cache entry for path if it is not already present.
      \param forceUpdate If true, always override the current cache value.*/
     Dir& getContents(const String& path, bool forceUpdate);
@@ -224,6 +243,9 @@ private:
     /** \copydoc isZipfile */
     bool _isZipfile(const String& path);
 
+    /** \copydoc zipArchive */
+    shared_ptr<ZipArchive> _zipArchive(const String& zipfile);
+
     /** \copydoc getFiles */
     void _getFiles(const String& spec, Array<String>& result, bool includeParentPath = false) {
         ListSettings set;
@@ -340,6 +362,24 @@ public:
         return b;
     }
 
+    /** Returns the index of \a zipfile, or nullptr if it is not a readable zipfile.
+
+        Archives stay open between calls, so the central directory is parsed once rather than
+        on every read. A cached archive is reopened if the file's size or modification time
+        has changed when rechecked after cacheLifetime() seconds, and is released by clearCache().
+        The result may be used from any thread without holding FileSystem's lock.
+
+        The archive is memory-mapped for as long as the cache, the returned pointer, or a
+        BinaryInput reading a large stored entry in place references it. While it is mapped,
+        Windows refuses to replace the zipfile, and on other platforms rewriting it in place
+        makes reads from the old mapping fault with SIGBUS. Call clearCache() on the zipfile and
+        release any such BinaryInput before rewriting it; replacing it by renaming a new file
+        over it is safe on other platforms. */
+    static shared_ptr<ZipArchive> zipArchive(const String& zipfile) {
+        std::lock_guard<std::recursive_mutex> guard(s_mutex);
+        return instance()._zipArchive(zipfile);
+    }
+
    
     /** Set the cacheLifetime().
        \param t in seconds */
@@ -94,9 +94,13 @@
 #include "G3D-base/Welder.h"
 #include "G3D-base/PrecomputedRandom.h"
 #include "G3D-base/MemoryManager.h"
+#include "G3D-base/MemoryMappedFile.h"
+#include "G3D-base/ZipArchive.h"
+#include "G3D-base/AsyncFileReader.h"
 #include "G3D-base/BlockPoolMemoryManager.h"
 #include "G3D-base/AreaMemoryManager.h"
 #include "G3D-base/BumpMapPreprocess.h"
+#include "G3D-base/BlockCompression.h"
 #include "G3D-base/CubeFace.h"
 #include "G3D-base/Line2D.h"
 #include "G3D-base/ThreadsafeQueue.h"
@@ -134,6 +138,7 @@
 #include "G3D-base/vectorMath.h"
 #include "G3D-base/Rect2D.h"
 #include "G3D-base/KDTree.h"
+#include "G3D-base/DynamicAABBTree.h"
 #include "G3D-base/PointKDTree.h"
 #include "G3D-base/TextOutput.h"
 #include "G3D-base/MeshBuilder.h"
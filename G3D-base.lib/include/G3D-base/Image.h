@@ -104,6 +104,45 @@ public:
         String filename;
     };
 
+    /** \brief Reconstruction filter for resample() and generateMipChain() */
+    G3D_DECLARE_ENUM_CLASS(ResampleFilter,
+        /** Averages the source pixels that each destination pixel covers. Fastest, but
+            aliases when reducing by non-integer factors and is blocky when enlarging. */
+        BOX,
+
+        /** Kaiser-windowed sinc with a radius of three destination pixels. Sharp, with little
+            ringing. The default, and a good choice for MIP maps. */
+        KAISER,
+
+        /** Lanczos-windowed sinc with a radius of three destination pixels. Sharpest, but rings
+            at hard edges. */
+        LANCZOS);
+
+    /** \sa resample, generateMipChain */
+    class ResampleSettings {
+    public:
+        ResampleFilter      filter;
+
+        /** RGB values in formats whose ImageFormat::colorSpace is sRGB are always filtered in linear
+            space. Set this to also treat RGB values as sRGB-encoded in formats such as RGB8, for example
+            when they will be uploaded as a Texture with an sRGB encoding. */
+        bool                treatAsSRGB;
+
+        /** If between 0 and 1, the alpha of each MIP level is scaled so that the fraction of pixels
+            with alpha of at least this value matches level 0, so that alpha-tested cutouts such as
+            foliage do not thin out with distance. Ignored by resample(). Negative (the default) disables. */
+        float               alphaCoverageReference;
+
+        /** WrapMode::TILE for tiling textures. Every other mode clamps. */
+        WrapMode            wrapMode;
+
+        ResampleSettings() :
+            filter(ResampleFilter::KAISER),
+            treatAsSRGB(false),
+            alphaCoverageReference(-1.0f),
+            wrapMode(WrapMode::CLAMP) {}
+    };
+
 protected:
 
     fipImage*           m_image;
@@ -152,15 +191,30 @@ public:
         example, RGB8 data could be reinterpreted as SRGB8, RGB8I,
         RGB8UI, BGR8, etc.  
 
+        \param maxDimension If positive, the image is reduced by the smallest power of two
+        that makes neither dimension exceed \a maxDimension. \sa reducedSize
+
         \sa fromBinaryInput, convert
     */
-    static shared_ptr<Image> fromFile(const String& filename, const ImageFormat* imageFormat = ImageFormat::AUTO());
+    static shared_ptr<Image> fromFile(const String& filename, const ImageFormat* imageFormat = ImageFormat::AUTO(), int maxDimension = 0);
 
     /** Loads an image from existing BinaryInput \a bi. 
 
-        \sa fromFile, convert
+        \param maxDimension If positive, the image is reduced by the smallest power of two
+        that makes neither dimension exceed \a maxDimension. JPEG files are reduced by up to 8x
+        during decoding by skipping DCT coefficients, so the full-resolution image is never
+        allocated. Other formats are decoded at full resolution and immediately box-filtered
+        in a single pass, before any format conversion.
+
+        \sa fromFile, convert, reducedSize
     */
-    static shared_ptr<Image> fromBinaryInput(BinaryInput& bi, const ImageFormat* imageFormat = ImageFormat::AUTO());
+    static shared_ptr<Image> fromBinaryInput(BinaryInput& bi, const ImageFormat* imageFormat = ImageFormat::AUTO(), int maxDimension = 0);
+
+    /** The dimensions of a \a width x \a height image loaded with \a maxDimension by fromFile()
+        or fromBinaryInput(). Returns the power-of-two reduction factor, which is 1 if
+        \a maxDimension is not positive or the image already fits. Each reduced dimension is
+        rounded up, so every source pixel contributes to the result. */
+    static int reducedSize(int width, int height, int maxDimension, int& reducedWidth, int& reducedHeight);
 
     /** Reads just metadata (if the file format supports it, undefined otherwise).
         Returns true on success, false on failure */
@@ -221,6 +275,26 @@ public:
     /** Copies the underlying pixel data */
     shared_ptr<Image> clone() const;
 
+    /** Resamples \a src into \a dst, which must have the same format but may have any size.
+        The separable filter runs on multiple threads, with SIMD arithmetic on x86.
+        
+        Supports the 8-bit, 16-bit, and 32-bit floating point formats with one to four
+        channels that Image loads, including their sRGB and BGR variants. Throws Image::Error for other formats. */
+    static void resample(const shared_ptr<PixelTransferBuffer>& src, const shared_ptr<PixelTransferBuffer>& dst,
+        const ResampleSettings& settings = ResampleSettings());
+
+    /** Returns a copy of this resampled to \a width x \a height. \sa resample */
+    shared_ptr<Image> resized(int width, int height, const ResampleSettings& settings = ResampleSettings()) const;
+
+    /** Sets \a chain to \a src followed by successively half-sized (rounding down) MIP levels down to 1x1,
+        in the format of \a src. Each level is resampled from the previous one. The result can be
+        uploaded directly with Texture::fromMipChain. \sa resample, Texture::Preprocess::generateMipMapsOnCPU */
+    static void generateMipChain(const shared_ptr<PixelTransferBuffer>& src, Array<shared_ptr<PixelTransferBuffer>>& chain,
+        const ResampleSettings& settings = ResampleSettings());
+
+    /** \copydoc generateMipChain */
+    void generateMipChain(Array<shared_ptr<PixelTransferBuffer>>& chain, const ResampleSettings& settings = ResampleSettings()) const;
+
     const ImageFormat* format() const;
 
     /** Executes @callback for each pixel at @a coord of this, where @a src is the value before callback
@@ -0,0 +1,87 @@
+/**
+  \file G3D-base.lib/include/G3D-base/MemoryMappedFile.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+
+#include "G3D-base/platform.h"
+#include "G3D-base/G3DString.h"
+#include "G3D-base/g3dmath.h"
+#include "G3D-base/ReferenceCount.h"
+
+namespace G3D {
+
+/** \brief Read-only view of a file on disk through the virtual memory system.
+
+    The operating system reads pages on demand and may evict them under memory pressure, so
+    mapping a multi-gigabyte file neither reads it up front nor allocates heap memory for it.
+    Threads may read the mapped bytes concurrently.
+
+    Files inside zipfiles cannot be mapped; create() returns nullptr for them and for files
+    that do not exist, and callers should fall back to BinaryInput.
+
+    \sa BinaryInput, FileSystem */
+class MemoryMappedFile : public ReferenceCountedObject {
+public:
+
+    /** Hint to the operating system about how the mapping will be read */
+    enum AccessPattern {
+        /** Default read-ahead */
+        NORMAL,
+
+        /** Aggressive read-ahead; pages behind the reader may be dropped early */
+        SEQUENTIAL,
+
+        /** Little read-ahead */
+        RANDOM
+    };
+
+protected:
+
+    String              m_filename;
+    const uint8*        m_data;
+    size_t              m_size;
+
+#   ifdef G3D_WINDOWS
+        HANDLE          m_file;
+        HANDLE          m_mapping;
+#   else
+        int             m_file;
+#   endif
+
+    MemoryMappedFile(const String& filename);
+
+    /** Returns false if the file could not be opened or mapped */
+    bool map(AccessPattern pattern);
+
+public:
+
+    /** Returns nullptr if \a filename cannot be mapped. \a filename is resolved relative to
+        the current directory. */
+    static shared_ptr<MemoryMappedFile> create(const String& filename, AccessPattern pattern = NORMAL);
+
+    ~MemoryMappedFile();
+
+    const String& filename() const {
+        return m_filename;
+    }
+
+    /** The mapped bytes. nullptr for an empty file. */
+    const uint8* data() const {
+        return m_data;
+    }
+
+    /** Size of the file in bytes */
+    size_t size() const {
+        return m_size;
+    }
+
+    /** Asks the operating system to begin reading \a numBytes from \a offset in the background */
+    void prefetch(size_t offset, size_t numBytes) const;
+};
+
+} // namespace G3D
@@ -527,6 +527,41 @@ public:
     static int countBoundaryEdges(const Array<Edge>& edgeArray);
 
 
+    /**
+     \brief Reduces a triangle list to about \a targetTriangleCount triangles
+     by quadric error metric edge collapse.
+
+     Every collapse moves one vertex onto a neighboring one, so the
+     simplified triangles index the original \a vertexArray and all
+     per-vertex attributes (normals, texture coordinates, colors, bone
+     weights) are preserved exactly.
+
+     Colocated vertices with different indices form a seam, such as a
+     texture seam or a hard crease. Seam and mesh boundary vertices only
+     slide along their seam or boundary, and all colocated copies move
+     together so that texture charts do not tear. Vertices at which
+     seams or boundaries meet never move.
+
+     Simplification stops at \a targetTriangleCount or when the next
+     collapse would move the surface farther than \a maxError,
+     whichever comes first.
+
+     @cite Garland and Heckbert, Surface Simplification Using Quadric Error Metrics, SIGGRAPH 1997
+
+     @param vertexArray          %Vertex positions. Colocated vertices must be bit-identical to be treated as a seam.
+     @param indexArray           Triangle list to simplify
+     @param simplifiedIndexArray <I>Output</I> triangle list indexing \a vertexArray. Must not be \a indexArray.
+     @return The estimated maximum distance, in the units of \a vertexArray, between the
+             simplified and original surfaces
+     */
+    static float simplify(
+        const Array<Vector3>& vertexArray,
+        const Array<int>&     indexArray,
+        Array<int>&           simplifiedIndexArray,
+        int                   targetTriangleCount,
+        float                 maxError = finf());
+
+
     /**
      Generates an array of integers from start to start + n - 1 that have run numbers
      in series then omit the next skip before the next run.  Useful for turning
@@ -42,6 +42,10 @@ than TextInput).
 This is intentionally designed to map the file format into memory, not to process it further.
 That supports a number of modeling uses of the data beyond specific OpenGL-trimesh rendering.
 
+For large files, parseFile() memory-maps the file and parseParallel() splits it at line boundaries
+into chunks that are parsed concurrently and then stitched together. The result is identical
+to that of parse().
+
 To iterate over the meshes, use:
 
 \code
@@ -232,6 +236,19 @@ private:
     /** Options for parsing the obj file (for lightMap coord processing, etc.) */
     Options             m_objOptions;
 
+    /** Faces and state changes of one piece of the input for parseParallel */
+    class Chunk;
+
+    /** If not null, this parser is reading a chunk for parseParallel. Faces and group, material,
+        and material library commands are recorded in the chunk instead of being applied. */
+    Chunk*              m_chunk = nullptr;
+
+    /** Clears the parsed data and state */
+    void reset(const String& basePath, const ParseOBJ::Options& options);
+
+    /** Creates the default material, group, and mesh as needed before adding a face */
+    void ensureCurrentMesh();
+
     void processCommand(TextInput& ti, const String& cmd);
 
     /** Processes the "f" command.  Called from processCommand. */
@@ -460,11 +477,24 @@ private:
 
     void processCommand(const Command command);
 
+    /** Applies a GROUP, USEMTL, or MTLLIB command */
+    void processStateCommand(const Command command, const String& name);
+
 public:
 
     void parse(const char* ptr, size_t len, const String& basePath, const ParseOBJ::Options& options);
 
     void parse(BinaryInput& bi, const ParseOBJ::Options& options = ParseOBJ::Options(), const String& basePath = "<AUTO>");
+
+    /** Produces the same result as parse(), using multiple threads. The input is split at line
+        boundaries into chunks of about \a chunkBytes, which are parsed concurrently a few at a time
+        and appended in order, so peak memory is the result plus the chunks in flight. 
+        Relative (negative) indices and the group and material state carry across chunks. */
+    void parseParallel(const char* ptr, size_t len, const String& basePath, const ParseOBJ::Options& options, size_t chunkBytes = 8 * 1024 * 1024);
+
+    /** Memory-maps \a filename and parses it with parseParallel(), so that the file is
+        never copied into memory. Files inside zipfiles are read with BinaryInput instead. */
+    void parseFile(const String& filename, const ParseOBJ::Options& options = ParseOBJ::Options(), const String& basePath = "<AUTO>");
 };
 
 } // namespace G3D
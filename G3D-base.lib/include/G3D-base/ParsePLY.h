@@ -18,16 +18,23 @@
 #include "G3D-base/Vector2.h"
 #include "G3D-base/Vector3.h"
 #include "G3D-base/Vector4.h"
+#include "G3D-base/Color4unorm8.h"
+#include <functional>
 
 namespace G3D {
 
 class BinaryInput;
+class MemoryMappedFile;
 
 /** \brief Parses PLY geometry files to extract face and vertex information.
 
 The input file is required to contain only vertex and (face or triStrip) elements, in that order.
 Each may have any number of properties.
 
+parse() materializes every vertex property as a float. For large point clouds, streamVertices()
+instead memory-maps the file and decodes positions, colors, and normals a chunk at a time, so that
+the caller's own arrays are the only full copy of the data.
+
 \cite http://paulbourke.net/dataformats/ply/
 
 \sa G3D::ParseMTL, G3D::ParseOBJ, G3D::ArticulatedModel
@@ -81,6 +88,27 @@ public:
 
     /** A -1 inside the triStrip means "restart" */
     typedef Array<int> TriStrip;
+
+    /** Vertex attributes decoded by streamVertices(). The arrays are reused between chunks. */
+    class VertexChunk {
+    public:
+        /** Index in the file of the vertex stored at element 0 of the arrays */
+        int                 firstVertex;
+
+        /** From the x, y, z properties. Missing axes are zero. */
+        Array<Point3>       position;
+
+        /** From the red, green, blue, and optional alpha properties. Empty if the vertices have no color.
+            Floating-point channels are assumed to be on [0, 1]. */
+        Array<Color4unorm8> color;
+
+        /** From the nx, ny, nz properties. Empty if the vertices have no normal. */
+        Array<Vector3>      normal;
+
+        VertexChunk() : firstVertex(0) {}
+    };
+
+    typedef std::function<void (const VertexChunk&)> VertexCallback;
     
     int             numVertices;
     int             numFaces;
@@ -111,8 +139,11 @@ private:
 
     void readHeader(BinaryInput& bi);
     void readVertexList(BinaryInput& bi);
+    void skipVertexList(BinaryInput& bi);
     void readFaceList(BinaryInput& bi);
 
+    void streamVertices(const uint8* data, size_t size, const String& filename, const MemoryMappedFile* file, const VertexCallback& callback, int verticesPerChunk);
+
 public:
     
     ParsePLY();
@@ -121,7 +152,30 @@ public:
 
     ~ParsePLY();
 
-    void parse(BinaryInput& bi);
+    /** \param readVertexData If false, vertexData is left nullptr and only the header and faces are read.
+        Use this with streamVertices() to load a mesh without materializing every vertex property. */
+    void parse(BinaryInput& bi, bool readVertexData = true);
+
+    /** Returns true if \a data begins with the header of a binary PLY file */
+    static bool isBinary(const uint8* data, size_t size);
+
+    /** \brief Decodes the vertices of a binary PLY file in chunks of up to \a verticesPerChunk.
+
+        The header fields (numVertices, vertexProperty, etc.) are set before \a callback is first invoked,
+        so the callback may use them to preallocate its output. Faces are not read and vertexData, 
+        faceArray, and triStripArray remain nullptr.
+
+        The property layout is compiled once from the header, and each chunk is decoded in parallel 
+        from the mapped file while the operating system reads ahead to the next one.
+
+        Files inside zipfiles are read through BinaryInput instead of mapped. */
+    void streamVertices(const String& filename, const VertexCallback& callback, int verticesPerChunk = 1 << 20);
+
+    /** \copydoc streamVertices(const String&, const VertexCallback&, int) */
+    void streamVertices(const shared_ptr<MemoryMappedFile>& file, const VertexCallback& callback, int verticesPerChunk = 1 << 20);
+
+    /** Decodes a binary PLY file that is already in memory. \copydoc streamVertices(const String&, const VertexCallback&, int) */
+    void streamVertices(const uint8* data, size_t size, const VertexCallback& callback, int verticesPerChunk = 1 << 20);
 
 };
 
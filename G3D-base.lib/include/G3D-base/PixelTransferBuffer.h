@@ -50,12 +50,17 @@ public:
     const ImageFormat* format() const   { return m_format; }
 
     /** Returns entire size of pixel data in bytes. */
-    size_t size() const                 { return m_height * m_depth * m_rowStride; }
+    size_t size() const                 { return size_t(numRows()) * m_depth * m_rowStride; }
+
+    /** Number of rows of stride() bytes in each layer. For block-compressed formats,
+        each row holds a row of 4x4 blocks. */
+    int numRows() const                 { return m_format->compressed ? (m_height + 3) / 4 : m_height; }
 
     /** Returns alignment of each row of pixel data in bytes. */
     size_t rowAlignment() const         { return m_rowAlignment; }
 
-    /** Returns size of each row of pixel data in bytes. */
+    /** Returns size of each row of pixel data in bytes. For block-compressed formats, whose
+        ImageFormat::cpuBitsPerPixel is the size of a 4x4 block, this is a row of blocks. */
     size_t stride() const               { return m_rowStride; }
 
     int width() const                   { return m_width; }
@@ -65,8 +70,8 @@ public:
 
     /** Return the byte offset from the mapped pointer for the row to raw pixel data at start of row \a y of depth \a d. */
     size_t rowOffset(int y, int d = 0) const {
-        debugAssert(y < m_height && d < m_depth);
-        return (d * m_height * m_rowStride) + (y * m_rowStride); 
+        debugAssert(y < numRows() && d < m_depth);
+        return (d * numRows() * m_rowStride) + (y * m_rowStride); 
     }
 
     /** Obtain a pointer for general access.
@@ -141,6 +141,108 @@ public:
 };
 
 
+/**
+ \brief A Token whose text refers to memory owned by the TextInput that produced it.
+
+ TextInput::read(TokenView&) produces symbols, numbers, and strings without escape
+ sequences (most of the tokens in typical files) without allocating. The text is not
+ null-terminated and remains valid until the TextInput is destroyed. string() and token()
+ allocate an owning copy.
+ */
+class TokenView {
+private:
+
+    friend class TextInput;
+
+    const char*             _data;
+    size_t                  _length;
+    bool                    _bool;
+    int                     _line;
+    int                     _character;
+    uint64                  _bytePosition;
+    Token::Type             _type;
+    Token::ExtendedType     _extendedType;
+
+public:
+
+    TokenView() :
+        _data(""),
+        _length(0),
+        _bool(false),
+        _line(0),
+        _character(0),
+        _bytePosition(0),
+        _type(Token::END),
+        _extendedType(Token::END_TYPE) {}
+
+    Token::Type type() const {
+        return _type;
+    }
+
+    Token::ExtendedType extendedType() const {
+        return _extendedType;
+    }
+
+    /** The text, as for Token::string(). Not null-terminated. */
+    const char* data() const {
+        return _data;
+    }
+
+    size_t length() const {
+        return _length;
+    }
+
+    /** Returns '\0' past the end */
+    char operator[](size_t i) const {
+        return (i < _length) ? _data[i] : '\0';
+    }
+
+    bool operator==(const char* s) const {
+        return (::strlen(s) == _length) && (::memcmp(_data, s, _length) == 0);
+    }
+
+    bool operator==(const String& s) const {
+        return (s.size() == _length) && (::memcmp(_data, s.c_str(), _length) == 0);
+    }
+
+    template<class T>
+    bool operator!=(const T& s) const {
+        return ! (*this == s);
+    }
+
+    /** Allocates a copy of the text */
+    String string() const {
+        return String(_data, _length);
+    }
+
+    /** Allocates an equivalent Token, e.g., for TextInput::push() */
+    Token token() const {
+        return Token(_type, _extendedType, string(), _bool, _line, _character, _bytePosition);
+    }
+
+    bool boolean() const {
+        return _bool;
+    }
+
+    int line() const {
+        return _line;
+    }
+
+    int character() const {
+        return _character;
+    }
+
+    uint64 bytePosition() const {
+        return _bytePosition;
+    }
+
+    /** Return the numeric value for a number type, or zero if this is
+        not a number type. Does not allocate.
+    */
+    double number() const;
+};
+
+
 /**
  \brief A simple tokenizer for parsing text files.  
  
@@ -220,6 +322,10 @@ public:
     /** Includes MSVC specials parsing */
     static double parseNumber(const String& _string);
 
+    /** Parses \a length characters of \a s without allocating for ordinary decimal and
+        hexadecimal numbers. Includes MSVC specials parsing. */
+    static double parseNumber(const char* s, size_t length);
+
     /** toLower(_string) == "true" */
     static bool parseBoolean(const String& _string);
 
@@ -406,6 +512,21 @@ private:
 
     std::deque<Token>       stack;
 
+    /** Text of TokenViews that does not appear verbatim in the buffer, e.g., strings
+        with escape sequences. A deque so that views into it are never invalidated. */
+    std::deque<String>      viewStorage;
+
+    /** Result of peek(TokenView&), which is valid while currentCharOffset == peekedViewStart.
+        Unlike peek(), this does not consume input, so that it is never pushed on the stack. */
+    TokenView               peekedView;
+    int                     peekedViewStart;
+    int                     peekedViewEnd;
+    int                     peekedViewEndLine;
+    int                     peekedViewEndCharacter;
+
+    /** options.falseSymbols and options.trueSymbols, which nextTokenView can iterate quickly */
+    Array<String>           booleanSymbols[2];
+
     /**
      Characters to be tokenized.
      */
@@ -491,6 +612,25 @@ private:
     */
     void parseQuotedString(unsigned char delimiter, Token& t);
 
+    /**
+     Fast path for nextToken that reads whitespace, comments, and the common token types
+     directly from the buffer. Returns false if nextToken must read the token, having consumed
+     only the whitespace and comments before it.
+     */
+    bool nextTokenView(TokenView& t);
+
+    /** Reads the next token from the buffer (ignoring the stack) */
+    void scanTokenView(TokenView& t);
+
+    /** Points \a t into the buffer if \a token's text appears there, and otherwise into viewStorage */
+    void makeView(const Token& token, TokenView& t);
+
+    /** Moves past the token held by peekedView */
+    void consumePeekedView();
+
+    /** Called when options changes */
+    void updateSettings();
+
     void initFromString(const char* str, int len, const Settings& settings);
 
 public:
@@ -582,10 +722,12 @@ public:
     void pushSettings(const Settings& settings) {
         settingsStack.push(options);
         options = settings;
+        updateSettings();
     }
 
     void popSettings() {
         options = settingsStack.pop();
+        updateSettings();
     }
 
     /** Read the next token (which will be the END token if ! hasMore()).
@@ -608,6 +750,10 @@ public:
     /** Avoids the copy of read() */
     void read(Token& t);
 
+    /** Like read(Token&), but \a t refers to the input instead of copying the token's text.
+        This is the fastest way to tokenize large inputs. \sa peek(TokenView&) */
+    void read(TokenView& t);
+
     /** Calls read() until the result is not a newline or comment */
     Token readSignificant();
 
@@ -824,6 +970,9 @@ public:
     */
     Token peek();
 
+    /** Like peek(), but without copying the token's text */
+    void peek(TokenView& t);
+
     /** Returns the line number for the @e next token.  See also peek.  */
     int peekLineNumber();
 
@@ -89,6 +89,41 @@ public:
         meta.append(&indices);
         weld(vertices, textureCoords, normals, meta, settings);
     }
+
+    /**
+     Multithreaded version of weld() for very large meshes, such as
+     scanned models with tens of millions of vertices. The output is
+     identical to weld() with the same arguments: the same vertex
+     order, bit-identical normals, and the same indices.
+
+     Vertices are partitioned into the spatial cells that weld() uses.
+     Normal smoothing and the search for candidate matches run
+     concurrently across cells. Candidates in neighboring cells are
+     then grouped into connected clusters, and each cluster replays
+     weld()'s serial first-match rule independently of the others.
+
+     For small meshes the threading overhead exceeds the savings, so
+     prefer weld() below about 100k indices.
+     */
+    static void weldConcurrently
+    (Array<Vector3>&     vertices,
+     Array<Vector2>&     textureCoords,
+     Array<Vector3>&     normals,
+     Array<Array<int>*>& indices,
+     const Settings&     settings);
+
+    /** \copydoc weldConcurrently */
+    inline static void weldConcurrently
+    (Array<Vector3>&     vertices,
+     Array<Vector2>&     textureCoords,
+     Array<Vector3>&     normals,
+     Array<int>&         indices,
+     const Settings&     settings) {
+
+        Array<Array<int>*> meta;
+        meta.append(&indices);
+        weldConcurrently(vertices, textureCoords, normals, meta, settings);
+    }
 };
 
 }
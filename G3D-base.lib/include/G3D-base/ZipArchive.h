@@ -0,0 +1,121 @@
+/**
+  \file G3D-base.lib/include/G3D-base/ZipArchive.h
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#pragma once
+
+#include <mutex>
+#include "G3D-base/platform.h"
+#include "G3D-base/G3DString.h"
+#include "G3D-base/Array.h"
+#include "G3D-base/Table.h"
+#include "G3D-base/ReferenceCount.h"
+#include "G3D-base/MemoryMappedFile.h"
+
+struct zip;
+
+namespace G3D {
+
+/** \brief Read-only index of a zipfile's central directory over a memory-mapped archive.
+
+    The central directory is parsed once into a case-insensitive name table. Entries stored
+    without compression can be read in place through storedData(), and deflated entries are
+    inflated directly from the mapping, so both kinds may be read from multiple threads at
+    once. Encrypted entries and other compression methods are read through libzip, one
+    thread at a time per archive.
+
+    Use FileSystem::zipArchive() to obtain the cached instance for a zipfile instead of
+    creating one per read. See it for the restrictions on modifying a zipfile while it is mapped.
+
+    \sa FileSystem, BinaryInput, MemoryMappedFile */
+class ZipArchive : public ReferenceCountedObject {
+public:
+
+    class Entry {
+    public:
+        /** Path inside the archive, with '/' separators */
+        String          name;
+
+        /** 0 = stored, 8 = deflated */
+        uint16          method;
+
+        bool            encrypted;
+
+        uint32          crc;
+
+        uint64          compressedSize;
+
+        /** Uncompressed size in bytes */
+        uint64          size;
+
+        /** Offset of the local file header within the archive */
+        uint64          localHeaderOffset;
+
+        Entry() : method(0), encrypted(false), crc(0), compressedSize(0), size(0), localHeaderOffset(0) {}
+    };
+
+protected:
+
+    String                          m_filename;
+    shared_ptr<MemoryMappedFile>    m_file;
+    Array<Entry>                    m_entry;
+
+    /** Lowercase canonical name to index in m_entry */
+    Table<String, int>              m_index;
+
+    /** Opened on demand for entries that libzip must decode */
+    mutable struct zip*             m_zip;
+    mutable std::mutex              m_zipMutex;
+
+    ZipArchive(const String& filename, const shared_ptr<MemoryMappedFile>& file);
+
+    /** Returns false if the archive is not a well-formed, single-disk zipfile */
+    bool parseCentralDirectory();
+
+    /** Start of the entry's data within the mapping, or nullptr if the local header is corrupt */
+    const uint8* dataStart(const Entry& entry) const;
+
+    void readWithLibzip(const Entry& entry, uint8* dst, const String& password) const;
+
+public:
+
+    /** Returns nullptr if \a filename cannot be mapped or is not a zipfile */
+    static shared_ptr<ZipArchive> create(const String& filename);
+
+    ~ZipArchive();
+
+    const String& filename() const {
+        return m_filename;
+    }
+
+    /** Every file and explicit directory in the archive, in central directory order */
+    const Array<Entry>& entries() const {
+        return m_entry;
+    }
+
+    /** Case-insensitive lookup of a path inside the archive. Returns nullptr if absent. */
+    const Entry* find(const String& name) const;
+
+    /** The archive's mapping, for callers that hold pointers returned by storedData() */
+    const shared_ptr<MemoryMappedFile>& mappedFile() const {
+        return m_file;
+    }
+
+    /** Returns a pointer to the bytes of \a entry inside the mapping if it is stored
+        without compression or encryption, and nullptr otherwise. The bytes remain valid as long
+        as mappedFile() is referenced. */
+    const uint8* storedData(const Entry& entry) const;
+
+    /** Decompresses \a entry into \a dst, which must hold entry.size bytes. Throws a String on failure.
+        \param password Used only if entry.encrypted */
+    void read(const Entry& entry, void* dst, const String& password = "") const;
+
+    /** Asks the operating system to begin reading the compressed bytes of \a entry in the background */
+    void prefetch(const Entry& entry) const;
+};
+
+} // namespace G3D
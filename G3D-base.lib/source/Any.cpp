@@ -32,21 +32,6 @@ static bool isContainerType(Any::Type& t) {
     return (t == Any::ARRAY) || (t == Any::TABLE) || (t == Any::EMPTY_CONTAINER);
 }
 
-void Any::serialize(BinaryOutput& b) const {
-    TextOutput::Settings s;
-    s.wordWrap = TextOutput::Settings::WRAP_NONE;
-    b.writeInt32(1);
-    b.writeString32(unparse(s));
-}
-
-
-void Any::deserialize(BinaryInput& b) {
-    const int version = b.readInt32();
-    alwaysAssertM(version == 1, "Wrong Any serialization version");
-    _parse(b.readString32());
-}
-
-
 String Any::resolveStringAsFilename(bool errorIfNotFound) const {
     verifyType(STRING);
     if ((string().length() > 0) && (string()[0] == '<') && (string()[string().length() - 1] == '>')) {
@@ -925,12 +910,42 @@ void Any::_parse(const String& src) {
 }
 
 
+/** The files read so far by the outermost load() on this thread that is writing a binary
+    cache entry, or nullptr. Nested loads from #include append to it. */
+static thread_local Array<String>* s_loadDependencies = nullptr;
+
 void Any::load(const String& filename) {
     beforeRead();
     TextInput::Settings settings;
     getDeserializeSettings(settings);
 
-    TextInput ti(FileSystem::resolve(filename), settings);
+    const String& resolved = FileSystem::resolve(filename);
+
+    if (notNull(s_loadDependencies)) {
+        // Included from a file whose cache entry will cover this one
+        s_loadDependencies->append(resolved);
+    } else if (! binaryCacheDirectory().empty() && ! FileSystem::inZipfile(resolved)) {
+        if (loadBinaryCache(resolved)) {
+            return;
+        }
+
+        Array<String> dependencies;
+        dependencies.append(resolved);
+        s_loadDependencies = &dependencies;
+        try {
+            TextInput ti(resolved, settings);
+            deserialize(ti);
+        } catch (...) {
+            s_loadDependencies = nullptr;
+            throw;
+        }
+        s_loadDependencies = nullptr;
+
+        saveBinaryCache(resolved, dependencies);
+        return;
+    }
+
+    TextInput ti(resolved, settings);
     deserialize(ti);
 }
 
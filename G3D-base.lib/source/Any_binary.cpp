@@ -0,0 +1,386 @@
+/**
+  \file G3D-base.lib/source/Any_binary.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/Any.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/Crypto.h"
+#include "G3D-base/FileSystem.h"
+
+namespace G3D {
+
+/** Version 1 stored the unparsed text */
+static const int32 BINARY_VERSION = 2;
+
+static const char* BINARY_CACHE_MAGIC = "G3D Any";
+static const uint32 BINARY_CACHE_VERSION = 1;
+
+static String s_binaryCacheDirectory;
+
+/** Bits of the per-value flags byte */
+enum {
+    HAS_DATA_BIT     = 1,
+    HEX_INTEGER_BIT  = 2,
+    COMMENT_BIT      = 4,
+    NAME_BIT         = 8,
+    INCLUDE_LINE_BIT = 16,
+    SEMICOLON_BIT    = 32,
+
+    /** Two bits holding the index of the bracket in brackets[] */
+    BRACKET_SHIFT    = 6
+};
+
+
+class Any::BinaryStringTable {
+public:
+    Table<String, uint32>   index;
+    Array<String>           string;
+
+    uint32 operator()(const String& s) {
+        bool created = false;
+        uint32& i = index.getCreate(s, created);
+        if (created) {
+            i = uint32(string.size());
+            string.append(s);
+        }
+        return i;
+    }
+};
+
+
+/** BinaryInput checks bounds only in debug builds, so every read from a cache file that may be
+    truncated or corrupt is preceded by this. Throws if fewer than \a numBytes remain. */
+static void require(const BinaryInput& b, int64 numBytes) {
+    if ((numBytes < 0) || (b.getLength() - b.getPosition() < numBytes)) {
+        throw ParseError(b.getFilename(), b.getPosition(), "Truncated binary Any");
+    }
+}
+
+
+/** Reads a string written by BinaryOutput::writeString, stopping at the end of the input */
+static String readCString(BinaryInput& b) {
+    require(b, 1);
+    return b.readString();
+}
+
+
+/** Unsigned LEB128, since most counts, lines, and string indices are small */
+static void writeVarUInt(BinaryOutput& b, uint32 x) {
+    while (x >= 0x80) {
+        b.writeUInt8(uint8(x | 0x80));
+        x >>= 7;
+    }
+    b.writeUInt8(uint8(x));
+}
+
+
+static uint32 readVarUInt(BinaryInput& b) {
+    uint32 x = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        require(b, 1);
+        const uint8 byte = b.readUInt8();
+        x |= uint32(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return x;
+        }
+    }
+    throw ParseError(b.getFilename(), b.getPosition(), "Corrupt binary Any");
+}
+
+
+static int bracketIndex(const char* bracket) {
+    return (bracket == nullptr) ? 0 : (bracket[0] == '(') ? 1 : (bracket[0] == '[') ? 2 : 3;
+}
+
+
+void Any::serializeBinary(BinaryOutput& b, BinaryStringTable& strings) const {
+    beforeRead();
+
+    uint8 flags = 0;
+    if (notNull(m_data)) {
+        flags |= HAS_DATA_BIT;
+        flags |= m_data->hexInteger ? HEX_INTEGER_BIT : 0;
+        flags |= m_data->comment.empty() ? 0 : COMMENT_BIT;
+        flags |= m_data->name.empty() ? 0 : NAME_BIT;
+        flags |= m_data->includeLine.empty() ? 0 : INCLUDE_LINE_BIT;
+        flags |= (m_data->separator == ';') ? SEMICOLON_BIT : 0;
+        flags |= uint8(bracketIndex(m_data->bracket) << BRACKET_SHIFT);
+    }
+
+    b.writeUInt8(uint8(m_type));
+    b.writeUInt8(flags);
+
+    if (notNull(m_data)) {
+        writeVarUInt(b, strings(m_data->source.filename));
+        writeVarUInt(b, uint32(m_data->source.line));
+        writeVarUInt(b, uint32(m_data->source.character));
+        if (flags & COMMENT_BIT) {
+            writeVarUInt(b, strings(m_data->comment));
+        }
+        if (flags & NAME_BIT) {
+            writeVarUInt(b, strings(m_data->name));
+        }
+        if (flags & INCLUDE_LINE_BIT) {
+            writeVarUInt(b, strings(m_data->includeLine));
+        }
+    }
+
+    switch (m_type) {
+    case NIL:
+    case EMPTY_CONTAINER:
+        break;
+
+    case BOOLEAN:
+        b.writeUInt8(m_simpleValue.b ? 1 : 0);
+        break;
+
+    case NUMBER:
+        b.writeFloat64(m_simpleValue.n);
+        break;
+
+    case STRING:
+        writeVarUInt(b, strings(*m_data->value.s));
+        break;
+
+    case ARRAY:
+        writeVarUInt(b, uint32(m_data->value.a->size()));
+        for (const Any& element : *m_data->value.a) {
+            element.serializeBinary(b, strings);
+        }
+        break;
+
+    case TABLE:
+        writeVarUInt(b, uint32(m_data->value.t->size()));
+        for (const AnyTable::Entry& entry : *m_data->value.t) {
+            writeVarUInt(b, strings(entry.key));
+            entry.value.serializeBinary(b, strings);
+        }
+        break;
+    }
+}
+
+
+void Any::deserializeBinary(BinaryInput& b, const Array<String>& strings) {
+    const auto readString = [&]() -> const String& {
+        const uint32 i = readVarUInt(b);
+        if (i >= uint32(strings.size())) {
+            throw ParseError(b.getFilename(), b.getPosition(), "Corrupt binary Any");
+        }
+        return strings[i];
+    };
+
+    dropReference();
+    require(b, 2);
+    m_type = Type(b.readUInt8());
+    m_simpleValue.b = false;
+    const uint8 flags = b.readUInt8();
+
+    if (m_type > EMPTY_CONTAINER) {
+        throw ParseError(b.getFilename(), b.getPosition(), "Corrupt binary Any");
+    }
+
+    if (flags & HAS_DATA_BIT) {
+        static const char* brackets[] = {nullptr, PAREN, BRACKET, BRACE};
+        const bool isContainer = (m_type == ARRAY) || (m_type == TABLE) || (m_type == EMPTY_CONTAINER);
+        m_data = Data::create(m_type, brackets[flags >> BRACKET_SHIFT],
+                              isContainer ? ((flags & SEMICOLON_BIT) ? ';' : ',') : '\0',
+                              (flags & HEX_INTEGER_BIT) != 0);
+
+        m_data->source.filename  = readString();
+        m_data->source.line      = int(readVarUInt(b));
+        m_data->source.character = int(readVarUInt(b));
+        if (flags & COMMENT_BIT) {
+            m_data->comment = readString();
+        }
+        if (flags & NAME_BIT) {
+            m_data->name = readString();
+        }
+        if (flags & INCLUDE_LINE_BIT) {
+            m_data->includeLine = readString();
+        }
+    } else if ((m_type == STRING) || (m_type == ARRAY) || (m_type == TABLE)) {
+        throw ParseError(b.getFilename(), b.getPosition(), "Corrupt binary Any");
+    }
+
+    switch (m_type) {
+    case NIL:
+    case EMPTY_CONTAINER:
+        break;
+
+    case BOOLEAN:
+        require(b, 1);
+        m_simpleValue.b = (b.readUInt8() != 0);
+        break;
+
+    case NUMBER:
+        require(b, sizeof(float64));
+        m_simpleValue.n = b.readFloat64();
+        break;
+
+    case STRING:
+        *m_data->value.s = readString();
+        break;
+
+    case ARRAY:
+        {
+            AnyArray& array = *m_data->value.a;
+            // Each element occupies at least its type and flags bytes, which bounds the allocation
+            const uint32 n = readVarUInt(b);
+            require(b, 2 * int64(n));
+            array.resize(int(n));
+            for (Any& element : array) {
+                element.deserializeBinary(b, strings);
+            }
+        }
+        break;
+
+    case TABLE:
+        {
+            AnyTable& table = *m_data->value.t;
+            // Each entry occupies at least a key byte and its value's type and flags bytes
+            const uint32 n = readVarUInt(b);
+            require(b, 3 * int64(n));
+            for (uint32 i = 0; i < n; ++i) {
+                table.getCreate(readString()).deserializeBinary(b, strings);
+            }
+        }
+        break;
+    }
+}
+
+
+void Any::serialize(BinaryOutput& b) const {
+    beforeRead();
+
+    // Write the values first so that the string table is complete
+    BinaryStringTable strings;
+    BinaryOutput values("<memory>", b.endian());
+    serializeBinary(values, strings);
+
+    b.writeInt32(BINARY_VERSION);
+    writeVarUInt(b, uint32(strings.string.size()));
+    for (const String& s : strings.string) {
+        writeVarUInt(b, uint32(s.size()));
+        b.writeBytes(s.c_str(), s.size());
+    }
+
+    Array<uint8> bytes;
+    bytes.resize(int(values.size()));
+    values.commit(bytes.getCArray());
+    b.writeBytes(bytes.getCArray(), bytes.size());
+}
+
+
+void Any::deserialize(BinaryInput& b) {
+    beforeRead();
+    require(b, sizeof(int32));
+    const int version = b.readInt32();
+
+    if (version == 1) {
+        require(b, sizeof(uint32));
+        const uint32 length = b.readUInt32();
+        require(b, length);
+        _parse(b.readString(length));
+        return;
+    }
+
+    if (version != BINARY_VERSION) {
+        throw ParseError(b.getFilename(), b.getPosition(), format("Unsupported binary Any version %d", version));
+    }
+
+    // Each string occupies at least its length byte
+    const uint32 numStrings = readVarUInt(b);
+    require(b, numStrings);
+    Array<String> strings;
+    strings.resize(int(numStrings));
+    for (String& s : strings) {
+        const uint32 length = readVarUInt(b);
+        require(b, length);
+        if (length > 0) {
+            s = b.readString(length);
+        }
+    }
+    deserializeBinary(b, strings);
+}
+
+
+void Any::setBinaryCacheDirectory(const String& directory) {
+    s_binaryCacheDirectory = directory;
+}
+
+
+const String& Any::binaryCacheDirectory() {
+    return s_binaryCacheDirectory;
+}
+
+
+static String binaryCacheFilename(const String& filename) {
+    const uint64 hash = Crypto::fnv1a64(filename.c_str(), filename.size());
+    return FilePath::concat(s_binaryCacheDirectory, format("%016llx.Any.bin", (unsigned long long)hash));
+}
+
+
+bool Any::loadBinaryCache(const String& filename) {
+    const String& cacheFilename = binaryCacheFilename(filename);
+    if (! FileSystem::exists(cacheFilename, false)) {
+        return false;
+    }
+
+    try {
+        BinaryInput b(cacheFilename, G3D_LITTLE_ENDIAN);
+
+        // Magic string with its terminator, and version
+        const int64 magicBytes = int64(strlen(BINARY_CACHE_MAGIC)) + 1;
+        require(b, magicBytes + sizeof(uint32));
+        if ((b.readString(magicBytes) != BINARY_CACHE_MAGIC) || (b.readUInt32() != BINARY_CACHE_VERSION) || (readCString(b) != filename)) {
+            return false;
+        }
+
+        require(b, sizeof(int32));
+        const int numDependencies = b.readInt32();
+        for (int i = 0; i < numDependencies; ++i) {
+            const String& dependency = readCString(b);
+            require(b, sizeof(int64));
+            const int64 size = b.readInt64();
+            if ((FileSystem::size(dependency) != size) || FileSystem::isNewer(dependency, cacheFilename)) {
+                return false;
+            }
+        }
+
+        deserialize(b);
+        return true;
+    } catch (...) {
+        debugPrintf("Any: ignoring unreadable cache file %s\n", cacheFilename.c_str());
+        return false;
+    }
+}
+
+
+void Any::saveBinaryCache(const String& filename, const Array<String>& dependencies) const {
+    for (const String& dependency : dependencies) {
+        if (FileSystem::inZipfile(dependency)) {
+            // Time stamps are unavailable
+            return;
+        }
+    }
+
+    FileSystem::createDirectory(s_binaryCacheDirectory);
+    BinaryOutput b(binaryCacheFilename(filename), G3D_LITTLE_ENDIAN);
+    b.writeString(BINARY_CACHE_MAGIC);
+    b.writeUInt32(BINARY_CACHE_VERSION);
+    b.writeString(filename);
+    b.writeInt32(dependencies.size());
+    for (const String& dependency : dependencies) {
+        b.writeString(dependency);
+        b.writeInt64(FileSystem::size(dependency));
+    }
+    serialize(b);
+    b.commit();
+}
+
+} // namespace G3D
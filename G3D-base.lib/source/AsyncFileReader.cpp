@@ -0,0 +1,328 @@
+/**
+  \file G3D-base.lib/source/AsyncFileReader.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/AsyncFileReader.h"
+#include "G3D-base/FileSystem.h"
+#include "G3D-base/System.h"
+#include "G3D-base/ZipArchive.h"
+#include "G3D-base/format.h"
+
+#ifndef G3D_WINDOWS
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace G3D {
+
+/** Largest single read, which keeps byte counts within the 32-bit limits of ReadFile and of
+    Linux's pread */
+static const int64 MAX_READ_BYTES = 1 << 30;
+
+AsyncFileReader::Buffer::~Buffer() {
+    if (notNull(data)) {
+        System::alignedFree(data);
+        data = nullptr;
+    }
+}
+
+
+AsyncFileReader::AsyncFileReader(int numThreads) : m_stop(false) {
+    for (int i = 0; i < G3D::max(1, numThreads); ++i) {
+        m_threadArray.push_back(std::thread([this]() { workerMain(); }));
+    }
+}
+
+
+shared_ptr<AsyncFileReader> AsyncFileReader::create(int numThreads) {
+    return createShared<AsyncFileReader>(numThreads);
+}
+
+
+const shared_ptr<AsyncFileReader>& AsyncFileReader::common() {
+    static const shared_ptr<AsyncFileReader> reader = create();
+    return reader;
+}
+
+
+AsyncFileReader::~AsyncFileReader() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_prefetchQueue.clear();
+    }
+    m_workAvailable.notify_all();
+    for (std::thread& thread : m_threadArray) {
+        thread.join();
+    }
+}
+
+
+void AsyncFileReader::workerMain() {
+    while (true) {
+        Request request;
+        String prefetchFilename;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_workAvailable.wait(lock, [&]() { return m_stop || ! m_readQueue.empty() || ! m_prefetchQueue.empty(); });
+
+            if (! m_readQueue.empty()) {
+                // Reads are finished even when stopping, because callers may be waiting on them
+                request = std::move(m_readQueue.front());
+                m_readQueue.pop_front();
+            } else if (m_stop) {
+                return;
+            } else {
+                prefetchFilename = std::move(m_prefetchQueue.front());
+                m_prefetchQueue.pop_front();
+            }
+        }
+
+        if (! prefetchFilename.empty()) {
+            prefetchFile(prefetchFilename);
+            continue;
+        }
+
+        const shared_ptr<Buffer>& buffer = readFile(request.filename);
+        if (request.callback) {
+            request.callback(buffer);
+        } else {
+            request.promise.set_value(buffer);
+        }
+    }
+}
+
+
+void AsyncFileReader::enqueue(Request&& request) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        debugAssertM(! m_stop, "AsyncFileReader used during destruction");
+        m_readQueue.push_back(std::move(request));
+    }
+    m_workAvailable.notify_one();
+}
+
+
+std::future<shared_ptr<AsyncFileReader::Buffer>> AsyncFileReader::read(const String& filename) {
+    Request request;
+    request.filename = filename;
+    std::future<shared_ptr<Buffer>> future = request.promise.get_future();
+    enqueue(std::move(request));
+    return future;
+}
+
+
+void AsyncFileReader::read(const String& filename, const Callback& callback) {
+    debugAssert(callback);
+    Request request;
+    request.filename = filename;
+    request.callback = callback;
+    enqueue(std::move(request));
+}
+
+
+void AsyncFileReader::prefetch(const String& filename) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_prefetchQueue.push_back(filename);
+    }
+    m_workAvailable.notify_one();
+}
+
+
+int AsyncFileReader::queueDepth() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return int(m_readQueue.size() + m_prefetchQueue.size());
+}
+
+
+shared_ptr<AsyncFileReader::Buffer> AsyncFileReader::readFile(const String& filename) {
+    const shared_ptr<Buffer>& buffer = createShared<Buffer>(filename);
+    try {
+        const String& expanded = FilePath::expandEnvironmentVariables(filename);
+        String zipfile, internalFile;
+        if (FileSystem::inZipfile(expanded, zipfile, internalFile)) {
+            readFromZipfile(zipfile, internalFile, *buffer);
+        } else {
+            readFromDisk(expanded, *buffer);
+        }
+        FileSystem::markFileUsed(filename);
+    } catch (const String& e) {
+        buffer->error = e;
+    } catch (const char* e) {
+        buffer->error = e;
+    } catch (const std::exception& e) {
+        buffer->error = e.what();
+    }
+
+    if (! buffer->ok() && notNull(buffer->data)) {
+        System::alignedFree(buffer->data);
+        buffer->data = nullptr;
+        buffer->size = 0;
+    }
+    return buffer;
+}
+
+
+void AsyncFileReader::readFromZipfile(const String& zipfile, const String& internalFile, Buffer& buffer) {
+    const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(zipfile);
+    const ZipArchive::Entry* entry = notNull(archive) ? archive->find(internalFile) : nullptr;
+    if (isNull(entry)) {
+        throw String("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
+    }
+
+    String password;
+    if (entry->encrypted) {
+        FileSystem::isPasswordProtected(zipfile, password);
+    }
+
+    buffer.size = int64(entry->size);
+    if (buffer.size > 0) {
+        buffer.data = static_cast<uint8*>(System::alignedMalloc(size_t(buffer.size), 16));
+        if (isNull(buffer.data)) {
+            throw format("Out of memory reading \"%s\"", buffer.filename.c_str());
+        }
+        archive->read(*entry, buffer.data, password);
+    }
+}
+
+
+#ifdef G3D_WINDOWS
+
+void AsyncFileReader::readFromDisk(const String& filename, Buffer& buffer) {
+    const HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw format("File not found: \"%s\"", filename.c_str());
+    }
+
+    LARGE_INTEGER size;
+    bool success = (GetFileSizeEx(file, &size) != 0);
+    if (success) {
+        buffer.size = int64(size.QuadPart);
+        if (buffer.size > 0) {
+            buffer.data = static_cast<uint8*>(System::alignedMalloc(size_t(buffer.size), 16));
+            success = notNull(buffer.data);
+        }
+    }
+
+    for (int64 offset = 0; success && (offset < buffer.size); ) {
+        DWORD bytesRead = 0;
+        success = (ReadFile(file, buffer.data + offset, DWORD(G3D::min(buffer.size - offset, MAX_READ_BYTES)), &bytesRead, nullptr) != 0) && (bytesRead > 0);
+        offset += bytesRead;
+    }
+    CloseHandle(file);
+
+    if (! success) {
+        throw format("Could not read \"%s\"", filename.c_str());
+    }
+}
+
+
+void AsyncFileReader::prefetchFile(const String& filename) {
+    // Windows has no read-ahead hint for unmapped files, so read the file into a scratch buffer
+    // and let the file cache keep it. Zipfile entries are prefetched through the archive's mapping.
+    try {
+        const String& expanded = FilePath::expandEnvironmentVariables(filename);
+        String zipfile, internalFile;
+        if (FileSystem::inZipfile(expanded, zipfile, internalFile)) {
+            const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(zipfile);
+            const ZipArchive::Entry* entry = notNull(archive) ? archive->find(internalFile) : nullptr;
+            if (notNull(entry)) {
+                archive->prefetch(*entry);
+            }
+            return;
+        }
+
+        const HANDLE file = CreateFileA(expanded.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        static const DWORD SCRATCH_BYTES = 1 << 20;
+        uint8* scratch = static_cast<uint8*>(System::malloc(SCRATCH_BYTES));
+        DWORD bytesRead = 0;
+        while (notNull(scratch) && ReadFile(file, scratch, SCRATCH_BYTES, &bytesRead, nullptr) && (bytesRead > 0)) {}
+        System::free(scratch);
+        CloseHandle(file);
+    } catch (...) {
+        // Prefetching is only a hint
+    }
+}
+
+#else
+
+void AsyncFileReader::readFromDisk(const String& filename, Buffer& buffer) {
+    const int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw format("File not found: \"%s\"", filename.c_str());
+    }
+
+    struct stat info;
+    bool success = (fstat(file, &info) == 0) && S_ISREG(info.st_mode);
+    if (success) {
+        buffer.size = int64(info.st_size);
+        if (buffer.size > 0) {
+            buffer.data = static_cast<uint8*>(System::alignedMalloc(size_t(buffer.size), 16));
+            success = notNull(buffer.data);
+        }
+#       ifdef G3D_LINUX
+            posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+#       endif
+    }
+
+    // pread leaves the file offset alone, so reads never depend on the descriptor's state
+    for (int64 offset = 0; success && (offset < buffer.size); ) {
+        const ssize_t bytesRead = pread(file, buffer.data + offset, size_t(G3D::min(buffer.size - offset, MAX_READ_BYTES)), off_t(offset));
+        success = (bytesRead > 0);
+        offset += G3D::max(ssize_t(0), bytesRead);
+    }
+    ::close(file);
+
+    if (! success) {
+        throw format("Could not read \"%s\"", filename.c_str());
+    }
+}
+
+
+void AsyncFileReader::prefetchFile(const String& filename) {
+    try {
+        const String& expanded = FilePath::expandEnvironmentVariables(filename);
+        String zipfile, internalFile;
+        if (FileSystem::inZipfile(expanded, zipfile, internalFile)) {
+            const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(zipfile);
+            const ZipArchive::Entry* entry = notNull(archive) ? archive->find(internalFile) : nullptr;
+            if (notNull(entry)) {
+                archive->prefetch(*entry);
+            }
+            return;
+        }
+
+        const int file = ::open(expanded.c_str(), O_RDONLY);
+        if (file < 0) {
+            return;
+        }
+#       ifdef G3D_OSX
+            struct stat info;
+            if (fstat(file, &info) == 0) {
+                struct radvisory advice;
+                advice.ra_offset = 0;
+                advice.ra_count  = int(G3D::min(int64(info.st_size), int64(0x7FFFFFFF)));
+                fcntl(file, F_RDADVISE, &advice);
+            }
+#       else
+            // Starts reading the whole file into the page cache and returns without waiting
+            posix_fadvise(file, 0, 0, POSIX_FADV_WILLNEED);
+#       endif
+        ::close(file);
+    } catch (...) {
+        // Prefetching is only a hint
+    }
+}
+
+#endif
+
+} // namespace G3D
@@ -14,7 +14,7 @@
 #include "G3D-base/Log.h"
 #include "G3D-base/FileSystem.h"
 #include "../../external/zlib.lib/include/zlib.h"
-#include "../../external/zip.lib/include/zip.h"
+#include "G3D-base/ZipArchive.h"
 #include <cstring>
 
 namespace G3D {
@@ -83,10 +83,48 @@ BinaryInput::BinaryInput(
     }
 }
 
+BinaryInput::BinaryInput(
+    const shared_ptr<MemoryMappedFile>& file,
+    G3DEndian           fileEndian) :
+    m_filename(file->filename()),
+    m_bitPos(0),
+    m_bitString(0),
+    m_beginEndBits(0),
+    m_alreadyRead(0),
+    m_length(0),
+    m_bufferLength(0),
+    m_buffer(nullptr),
+    m_pos(0),
+    m_freeBuffer(false),
+    m_mappedFile(file) {
+
+    setEndian(fileEndian);
+    initFromMappedFile();
+}
+
+
+void BinaryInput::initFromMappedFile() {
+    debugAssert(! m_freeBuffer);
+    // The mapping is read-only; BinaryInput never writes through m_buffer
+    m_buffer = const_cast<uint8*>(m_mappedFile->data());
+    m_length = int64(m_mappedFile->size());
+    m_bufferLength = m_length;
+}
+
+
+void BinaryInput::prefetch(int64 numBytes) const {
+    if (notNull(m_mappedFile) && (numBytes > 0)) {
+        // m_buffer may be an entry inside a mapped zipfile
+        m_mappedFile->prefetch(size_t(m_buffer - m_mappedFile->data()) + size_t(getPosition()), size_t(numBytes));
+    }
+}
+
+
 BinaryInput::BinaryInput
 (const String&  filename,
 	G3DEndian           fileEndian,
-	bool                compressed) :
+	bool                compressed,
+	MemoryMappedFile::AccessPattern accessPattern) :
 	m_filename(filename),
 	m_bitPos(0),
 	m_bitString(0),
@@ -106,34 +144,35 @@ BinaryInput::BinaryInput
 		FileSystem::markFileUsed(m_filename);
 		FileSystem::markFileUsed(zipfile);
 
+		const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(zipfile);
+		const ZipArchive::Entry* entry = notNull(archive) ? archive->find(internalFile) : nullptr;
+		if (isNull(entry)) {
+			throw String("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
+		}
+		m_bufferLength = m_length = int64(entry->size);
+
+		const uint8* stored = archive->storedData(*entry);
+		if (notNull(stored) && ! compressed && (m_length >= MEMORY_MAP_MIN_LENGTH)) {
+			// Read large entries in place from the archive's mapping
+			m_mappedFile = archive->mappedFile();
+			m_buffer = const_cast<uint8*>(stored);
+			m_freeBuffer = false;
+			return;
+		}
+
 		String password;
-		bool isPasswordProtected = FileSystem::isPasswordProtected(zipfile, password);
-
-		struct zip* z = zip_open(zipfile.c_str(), ZIP_CHECKCONS, nullptr); {
-			struct zip_stat info;
-			zip_stat_init(&info);
-			zip_stat(z, internalFile.c_str(), ZIP_FL_NOCASE, &info);
-			m_bufferLength = m_length = info.size;
-			// sets machines up to use MMX, if they want
-			m_buffer = reinterpret_cast<uint8*>(System::alignedMalloc(m_length, 16));
-			    struct zip_file* zf = !isPasswordProtected ?
-				zip_fopen(z, internalFile.c_str(), ZIP_FL_NOCASE) :
-				zip_fopen_encrypted(z, internalFile.c_str(), ZIP_FL_NOCASE, password.c_str());
-			if (isNull(zf)) {
-				String msg = String("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
-                if (!isPasswordProtected) {
-                    msg += String(" If the archive is password protected, register it with FileSystem::registerPasswordProtectedZip()");
-                }
-				throw msg;
-			}
-			else {
-				const int64 bytesRead = zip_fread(zf, m_buffer, m_length);
-				debugAssertM(bytesRead == m_length,
-					internalFile + " was corrupt because it unzipped to the wrong size.");
-				(void)bytesRead;
-				zip_fclose(zf);
-			}
-		} zip_close(z); z = nullptr;
+		if (entry->encrypted) {
+			FileSystem::isPasswordProtected(zipfile, password);
+		}
+
+		// sets machines up to use MMX, if they want
+		m_buffer = reinterpret_cast<uint8*>(System::alignedMalloc(m_length, 16));
+		if (notNull(stored)) {
+			// Copy small stored entries, so that this BinaryInput does not keep the archive mapped
+			System::memcpy(m_buffer, stored, size_t(m_length));
+		} else {
+			archive->read(*entry, m_buffer, password);
+		}
 
 		if (compressed) {
 			decompress();
@@ -161,6 +200,20 @@ BinaryInput::BinaryInput
 		throw format("File not found: \"%s\"", m_filename.c_str());
 	}
 
+	if (!compressed && (m_length >= MEMORY_MAP_MIN_LENGTH)) {
+		// Map large files instead of reading them, so that they consume no heap
+		// memory and the first bytes are available without waiting for the rest.
+		// FileSystem::fopen resolved the name the same way.
+		m_mappedFile = MemoryMappedFile::create(FilePath::canonicalize(FilePath::expandEnvironmentVariables(m_filename)), accessPattern);
+		if (notNull(m_mappedFile)) {
+			FileSystem::fclose(file); file = nullptr;
+			m_freeBuffer = false;
+			initFromMappedFile();
+			return;
+		}
+		// Fall through to reading if the file cannot be mapped
+	}
+
 	if (!compressed && (m_length > INITIAL_BUFFER_LENGTH)) {
 		// Read only a subset of the file so we don't consume
 		// all available memory.
@@ -263,6 +316,11 @@ void BinaryInput::loadIntoMemory(int64 startPosition, int64 minLength) {
     // Load the next section of the file
     debugAssertM(m_filename != "<memory>", "Read past end of file.");
 
+    if (notNull(m_mappedFile)) {
+        // The whole file is already mapped
+        throw "Read past end of file.";
+    }
+
     int64 absPos = m_alreadyRead + m_pos;
 
     if (m_bufferLength < minLength) {
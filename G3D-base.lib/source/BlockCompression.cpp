@@ -0,0 +1,871 @@
+/**
+  \file G3D-base.lib/source/BlockCompression.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/BlockCompression.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/CPUPixelTransferBuffer.h"
+#include "G3D-base/Image.h"
+#include "G3D-base/ImageFormat.h"
+#include "G3D-base/System.h"
+#include "G3D-base/Thread.h"
+#include "G3D-base/format.h"
+#ifdef G3D_X86
+#    include <emmintrin.h>
+#endif
+
+namespace G3D {
+
+static const char* MIP_CHAIN_MAGIC = "G3D BlockCompression";
+static const uint32 MIP_CHAIN_VERSION = 1;
+
+namespace _internal {
+
+/** The 16 pixels of a 4x4 block, one array per RGBA channel, with values on [0, 255] */
+class BlockPixels {
+public:
+    alignas(16) float c[4][16];
+};
+
+/** Up to 16 palette entries of up to 4 channels */
+typedef float Palette[16][4];
+
+/** BC7 interpolation weights for 4-bit indices, out of 64 */
+static const int bc7Weight4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+
+/** Sets \a index[i] to the nearest of the first \a paletteSize entries of \a palette to pixel i,
+    over \a numChannels channels, and returns the total squared error. Ties go to the lower index. */
+static float selectIndices(const float* const* channel, int numChannels, const Palette& palette, int paletteSize, uint8 index[16]) {
+#   ifdef G3D_X86
+        __m128 total = _mm_setzero_ps();
+        for (int g = 0; g < 16; g += 4) {
+            __m128  bestDistance = _mm_set1_ps(finf());
+            __m128i bestIndex    = _mm_setzero_si128();
+            for (int p = 0; p < paletteSize; ++p) {
+                __m128 distance = _mm_setzero_ps();
+                for (int c = 0; c < numChannels; ++c) {
+                    const __m128 d = _mm_sub_ps(_mm_load_ps(channel[c] + g), _mm_set1_ps(palette[p][c]));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+                }
+                const __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, bestDistance));
+                bestDistance = _mm_min_ps(distance, bestDistance);
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+            }
+            total = _mm_add_ps(total, bestDistance);
+
+            alignas(16) int32 i[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(i), bestIndex);
+            for (int k = 0; k < 4; ++k) {
+                index[g + k] = uint8(i[k]);
+            }
+        }
+        alignas(16) float t[4];
+        _mm_store_ps(t, total);
+        return (t[0] + t[1]) + (t[2] + t[3]);
+#   else
+        float total = 0.0f;
+        for (int i = 0; i < 16; ++i) {
+            float bestDistance = finf();
+            for (int p = 0; p < paletteSize; ++p) {
+                float distance = 0.0f;
+                for (int c = 0; c < numChannels; ++c) {
+                    const float d = channel[c][i] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    index[i] = uint8(p);
+                }
+            }
+            total += bestDistance;
+        }
+        return total;
+#   endif
+}
+
+
+/** Endpoints at the extremes of the block's projection onto its principal axis */
+static void fitLine(const float* const* channel, int numChannels, float e0[4], float e1[4]) {
+    float mean[4] = {};
+    for (int c = 0; c < numChannels; ++c) {
+        for (int i = 0; i < 16; ++i) {
+            mean[c] += channel[c][i];
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        for (int a = 0; a < numChannels; ++a) {
+            for (int b = a; b < numChannels; ++b) {
+                covariance[a][b] += (channel[a][i] - mean[a]) * (channel[b][i] - mean[b]);
+            }
+        }
+    }
+    for (int a = 0; a < numChannels; ++a) {
+        for (int b = 0; b < a; ++b) {
+            covariance[a][b] = covariance[b][a];
+        }
+    }
+
+    // Power iteration
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        float length2 = 0.0f;
+        for (int a = 0; a < numChannels; ++a) {
+            for (int b = 0; b < numChannels; ++b) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length2 += square(next[a]);
+        }
+        if (length2 < 1e-10f) {
+            // All pixels are (nearly) identical along every axis
+            break;
+        }
+        const float s = 1.0f / sqrt(length2);
+        for (int a = 0; a < numChannels; ++a) {
+            axis[a] = next[a] * s;
+        }
+    }
+
+    float lo = finf(), hi = -finf();
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < numChannels; ++c) {
+            t += (channel[c][i] - mean[c]) * axis[c];
+        }
+        lo = min(lo, t);
+        hi = max(hi, t);
+    }
+
+    for (int c = 0; c < numChannels; ++c) {
+        e0[c] = clamp(mean[c] + axis[c] * lo, 0.0f, 255.0f);
+        e1[c] = clamp(mean[c] + axis[c] * hi, 0.0f, 255.0f);
+    }
+}
+
+
+/** Least-squares endpoints for fixed indices, where palette entry k is e0 * (1 - weight[k]) + e1 * weight[k].
+    Returns false if the indices do not determine the endpoints. */
+static bool refit(const float* const* channel, int numChannels, const uint8 index[16], const float* weight, float e0[4], float e1[4]) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for (int i = 0; i < 16; ++i) {
+        const float t = weight[index[i]];
+        const float s = 1.0f - t;
+        aa += s * s;
+        ab += s * t;
+        bb += t * t;
+        for (int c = 0; c < numChannels; ++c) {
+            ax[c] += s * channel[c][i];
+            bx[c] += t * channel[c][i];
+        }
+    }
+
+    const float det = aa * bb - ab * ab;
+    if (abs(det) < 1e-6f) {
+        return false;
+    }
+    const float invDet = 1.0f / det;
+    for (int c = 0; c < numChannels; ++c) {
+        e0[c] = clamp((bb * ax[c] - ab * bx[c]) * invDet, 0.0f, 255.0f);
+        e1[c] = clamp((aa * bx[c] - ab * ax[c]) * invDet, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+
+/** Little-endian bit stream within one block */
+class BitWriter {
+public:
+    uint8*  data;
+    int     position = 0;
+
+    explicit BitWriter(uint8* d, int numBytes) : data(d) {
+        System::memset(data, 0, numBytes);
+    }
+
+    void write(uint32 value, int numBits) {
+        for (int b = 0; b < numBits; ++b, ++position) {
+            data[position >> 3] |= uint8(((value >> b) & 1) << (position & 7));
+        }
+    }
+};
+
+
+class BitReader {
+public:
+    const uint8*    data;
+    int             position = 0;
+
+    explicit BitReader(const uint8* d) : data(d) {}
+
+    uint32 read(int numBits) {
+        uint32 value = 0;
+        for (int b = 0; b < numBits; ++b, ++position) {
+            value |= uint32((data[position >> 3] >> (position & 7)) & 1) << b;
+        }
+        return value;
+    }
+};
+
+
+////////////////////////////////////////////////////////////////////////////
+// Palettes shared by the encoder and decoder, so that encoder errors are exact
+
+static uint16 pack565(const float c[4]) {
+    const int r = iClamp(iRound(c[0] * (31.0f / 255.0f)), 0, 31);
+    const int g = iClamp(iRound(c[1] * (63.0f / 255.0f)), 0, 63);
+    const int b = iClamp(iRound(c[2] * (31.0f / 255.0f)), 0, 31);
+    return uint16((r << 11) | (g << 5) | b);
+}
+
+
+static void unpack565(uint16 c, int rgb[3]) {
+    const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+
+/** BC1 colors. In three-color mode (c0 <= c1 and not \a alwaysFourColor), entry 3 is black. */
+static void colorPalette(uint16 c0, uint16 c1, bool alwaysFourColor, int palette[4][3]) {
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        if (alwaysFourColor || (c0 > c1)) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+            palette[3][c] = 0;
+        }
+    }
+}
+
+
+/** BC4 values */
+static void scalarPalette(int r0, int r1, int palette[8]) {
+    palette[0] = r0;
+    palette[1] = r1;
+    if (r0 > r1) {
+        for (int i = 2; i < 8; ++i) {
+            palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+        }
+    } else {
+        for (int i = 2; i < 6; ++i) {
+            palette[i] = ((6 - i) * r0 + (i - 1) * r1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+
+static int bc7Interpolate(int e0, int e1, int i) {
+    return ((64 - bc7Weight4[i]) * e0 + bc7Weight4[i] * e1 + 32) >> 6;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Block encoders
+
+/** Four-color BC1 block. Returns the squared error. */
+static float encodeColorBlock(const BlockPixels& block, uint8* out) {
+    static const float weight[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    const float* channel[3] = { block.c[0], block.c[1], block.c[2] };
+
+    float e0[4], e1[4];
+    fitLine(channel, 3, e0, e1);
+
+    float bestError = finf();
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        uint16 c0 = pack565(e0);
+        uint16 c1 = pack565(e1);
+        if (c0 < c1) {
+            std::swap(c0, c1);
+            for (int c = 0; c < 3; ++c) { std::swap(e0[c], e1[c]); }
+        }
+
+        int p[4][3];
+        colorPalette(c0, c1, true, p);
+        Palette palette;
+        for (int k = 0; k < 4; ++k) {
+            for (int c = 0; c < 3; ++c) {
+                palette[k][c] = float(p[k][c]);
+            }
+        }
+
+        uint8 index[16];
+        // When c0 == c1 the block decodes in three-color mode, so only index 0 is safe
+        const float error = selectIndices(channel, 3, palette, (c0 == c1) ? 1 : 4, index);
+        if (error < bestError) {
+            bestError = error;
+            uint32 bits = 0;
+            for (int i = 0; i < 16; ++i) {
+                bits |= uint32(index[i]) << (2 * i);
+            }
+            out[0] = uint8(c0 & 0xFF); out[1] = uint8(c0 >> 8);
+            out[2] = uint8(c1 & 0xFF); out[3] = uint8(c1 >> 8);
+            for (int b = 0; b < 4; ++b) {
+                out[4 + b] = uint8(bits >> (8 * b));
+            }
+        }
+
+        if ((error == 0.0f) || ! refit(channel, 3, index, weight, e0, e1)) {
+            break;
+        }
+    }
+    return bestError;
+}
+
+
+/** BC4 block for one channel. Returns the squared error. */
+static float encodeScalarBlock(const BlockPixels& block, int channelIndex, uint8* out) {
+    static const float weight[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+    const float* channel[1] = { block.c[channelIndex] };
+
+    float e0[4] = { 0.0f }, e1[4] = { 255.0f };
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        lo = min(lo, channel[0][i]);
+        hi = max(hi, channel[0][i]);
+    }
+    e0[0] = hi;
+    e1[0] = lo;
+
+    float bestError = finf();
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        int r0 = iClamp(iRound(e0[0]), 0, 255);
+        int r1 = iClamp(iRound(e1[0]), 0, 255);
+        if (r0 < r1) {
+            std::swap(r0, r1);
+            std::swap(e0[0], e1[0]);
+        }
+
+        int p[8];
+        scalarPalette(r0, r1, p);
+        Palette palette;
+        for (int k = 0; k < 8; ++k) {
+            palette[k][0] = float(p[k]);
+        }
+
+        uint8 index[16];
+        // When r0 == r1 the block decodes in six-value mode, in which only the endpoints are interpolants
+        const float error = selectIndices(channel, 1, palette, (r0 == r1) ? 1 : 8, index);
+        if (error < bestError) {
+            bestError = error;
+            BitWriter w(out, 8);
+            w.write(r0, 8);
+            w.write(r1, 8);
+            for (int i = 0; i < 16; ++i) {
+                w.write(index[i], 3);
+            }
+        }
+
+        if ((error == 0.0f) || ! refit(channel, 1, index, weight, e0, e1)) {
+            break;
+        }
+    }
+    return bestError;
+}
+
+
+/** Chooses the 7-bit endpoint and shared low bit that best represent \a e */
+static void quantizeBC7Endpoint(const float e[4], int q[4], int& pBit) {
+    float bestError = finf();
+    for (int p = 0; p < 2; ++p) {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; ++c) {
+            candidate[c] = iClamp(iRound((e[c] - float(p)) * 0.5f), 0, 127);
+            error += square(float((candidate[c] << 1) | p) - e[c]);
+        }
+        if (error < bestError) {
+            bestError = error;
+            pBit = p;
+            for (int c = 0; c < 4; ++c) { q[c] = candidate[c]; }
+        }
+    }
+}
+
+
+/** BC7 mode 6 block: one RGBA subset with 7.7.7.7 endpoints, a low bit per endpoint, and 4-bit indices */
+static float encodeBC7Block(const BlockPixels& block, uint8* out) {
+    static const float weight[16] = {
+        0.0f / 64.0f, 4.0f / 64.0f, 9.0f / 64.0f, 13.0f / 64.0f, 17.0f / 64.0f, 21.0f / 64.0f, 26.0f / 64.0f, 30.0f / 64.0f,
+        34.0f / 64.0f, 38.0f / 64.0f, 43.0f / 64.0f, 47.0f / 64.0f, 51.0f / 64.0f, 55.0f / 64.0f, 60.0f / 64.0f, 64.0f / 64.0f };
+    const float* channel[4] = { block.c[0], block.c[1], block.c[2], block.c[3] };
+
+    float e0[4], e1[4];
+    fitLine(channel, 4, e0, e1);
+
+    float bestError = finf();
+    for (int iteration = 0; iteration < 3; ++iteration) {
+        int q0[4], q1[4], p0, p1;
+        quantizeBC7Endpoint(e0, q0, p0);
+        quantizeBC7Endpoint(e1, q1, p1);
+
+        Palette palette;
+        for (int k = 0; k < 16; ++k) {
+            for (int c = 0; c < 4; ++c) {
+                palette[k][c] = float(bc7Interpolate((q0[c] << 1) | p0, (q1[c] << 1) | p1, k));
+            }
+        }
+
+        uint8 index[16];
+        const float error = selectIndices(channel, 4, palette, 16, index);
+        if (error < bestError) {
+            bestError = error;
+            if (index[0] >= 8) {
+                // The most significant bit of the anchor index is implicitly zero,
+                // so swap the endpoints. The weights are symmetric, so this is exact.
+                for (int c = 0; c < 4; ++c) {
+                    std::swap(q0[c], q1[c]);
+                    std::swap(e0[c], e1[c]);
+                }
+                std::swap(p0, p1);
+                for (int i = 0; i < 16; ++i) { index[i] = uint8(15 - index[i]); }
+            }
+
+            BitWriter w(out, 16);
+            w.write(1 << 6, 7);
+            for (int c = 0; c < 4; ++c) {
+                w.write(q0[c], 7);
+                w.write(q1[c], 7);
+            }
+            w.write(p0, 1);
+            w.write(p1, 1);
+            w.write(index[0], 3);
+            for (int i = 1; i < 16; ++i) {
+                w.write(index[i], 4);
+            }
+        }
+
+        if ((error == 0.0f) || ! refit(channel, 4, index, weight, e0, e1)) {
+            break;
+        }
+    }
+    return bestError;
+}
+
+
+////////////////////////////////////////////////////////////////////////////
+// Block decoders, each writing 16 RGBA8 pixels
+
+static void decodeColorBlock(const uint8* in, bool alwaysFourColor, uint8 out[16][4]) {
+    const uint16 c0 = uint16(in[0] | (in[1] << 8));
+    const uint16 c1 = uint16(in[2] | (in[3] << 8));
+    const uint32 bits = uint32(in[4]) | (uint32(in[5]) << 8) | (uint32(in[6]) << 16) | (uint32(in[7]) << 24);
+    int palette[4][3];
+    colorPalette(c0, c1, alwaysFourColor, palette);
+    for (int i = 0; i < 16; ++i) {
+        const int k = (bits >> (2 * i)) & 3;
+        for (int c = 0; c < 3; ++c) {
+            out[i][c] = uint8(palette[k][c]);
+        }
+    }
+}
+
+
+static void decodeScalarBlock(const uint8* in, int channel, uint8 out[16][4]) {
+    BitReader r(in);
+    const int r0 = int(r.read(8));
+    const int r1 = int(r.read(8));
+    int palette[8];
+    scalarPalette(r0, r1, palette);
+    for (int i = 0; i < 16; ++i) {
+        out[i][channel] = uint8(palette[r.read(3)]);
+    }
+}
+
+
+static void decodeBC7Block(const uint8* in, uint8 out[16][4]) {
+    if ((in[0] & 0x7F) != 0x40) {
+        // Only mode 6 is supported. Invalid blocks decode to zero in Direct3D, so do the same for unsupported ones.
+        System::memset(out, 0, 16 * 4);
+        return;
+    }
+
+    BitReader r(in);
+    r.read(7);
+    int e[2][4];
+    for (int c = 0; c < 4; ++c) {
+        e[0][c] = int(r.read(7)) << 1;
+        e[1][c] = int(r.read(7)) << 1;
+    }
+    const int p0 = int(r.read(1)), p1 = int(r.read(1));
+    for (int c = 0; c < 4; ++c) {
+        e[0][c] |= p0;
+        e[1][c] |= p1;
+    }
+    for (int i = 0; i < 16; ++i) {
+        const int k = int(r.read((i == 0) ? 3 : 4));
+        for (int c = 0; c < 4; ++c) {
+            out[i][c] = uint8(bc7Interpolate(e[0][c], e[1][c], k));
+        }
+    }
+}
+
+} // namespace _internal
+
+using namespace _internal;
+
+
+const char* BlockCompression::toString(Format format) {
+    static const char* name[] = { "BC1", "BC3", "BC4", "BC5", "BC7" };
+    return name[int(format)];
+}
+
+
+int BlockCompression::bytesPerBlock(Format format) {
+    return ((format == Format::BC1) || (format == Format::BC4)) ? 8 : 16;
+}
+
+
+int BlockCompression::numChannels(Format format) {
+    switch (format) {
+    case Format::BC1: return 3;
+    case Format::BC4: return 1;
+    case Format::BC5: return 2;
+    default:          return 4;
+    }
+}
+
+
+size_t BlockCompression::encodedSize(Format format, int width, int height) {
+    return size_t((width + 3) / 4) * size_t((height + 3) / 4) * size_t(bytesPerBlock(format));
+}
+
+
+const ImageFormat* BlockCompression::imageFormat(Format format, bool sRGB) {
+    switch (format) {
+    case Format::BC1: return sRGB ? ImageFormat::SRGB_DXT1()  : ImageFormat::RGB_DXT1();
+    case Format::BC3: return sRGB ? ImageFormat::SRGBA_DXT5() : ImageFormat::RGBA_DXT5();
+    case Format::BC4: return sRGB ? nullptr : ImageFormat::R_RGTC1();
+    case Format::BC5: return sRGB ? nullptr : ImageFormat::RG_RGTC2();
+    case Format::BC7: return sRGB ? ImageFormat::SRGBA_BPTC() : ImageFormat::RGBA_BPTC();
+    default:          return nullptr;
+    }
+}
+
+
+void BlockCompression::encode(Format format, const uint8* rgba8, int width, int height, uint8* dst, bool singleThread) {
+    debugAssert((width > 0) && (height > 0));
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const int blockBytes = bytesPerBlock(format);
+
+    runConcurrently(0, blocksY, [&](int by) {
+        BlockPixels block;
+        for (int bx = 0; bx < blocksX; ++bx) {
+            // Replicate edge pixels into blocks that extend past the image
+            for (int i = 0; i < 16; ++i) {
+                const int x = min(bx * 4 + (i & 3), width - 1);
+                const int y = min(by * 4 + (i >> 2), height - 1);
+                const uint8* pixel = rgba8 + (size_t(y) * width + x) * 4;
+                for (int c = 0; c < 4; ++c) {
+                    block.c[c][i] = float(pixel[c]);
+                }
+            }
+
+            uint8* out = dst + (size_t(by) * blocksX + bx) * blockBytes;
+            switch (format) {
+            case Format::BC1:
+                encodeColorBlock(block, out);
+                break;
+
+            case Format::BC3:
+                encodeScalarBlock(block, 3, out);
+                encodeColorBlock(block, out + 8);
+                break;
+
+            case Format::BC4:
+                encodeScalarBlock(block, 0, out);
+                break;
+
+            case Format::BC5:
+                encodeScalarBlock(block, 0, out);
+                encodeScalarBlock(block, 1, out + 8);
+                break;
+
+            case Format::BC7:
+                encodeBC7Block(block, out);
+                break;
+            }
+        }
+    }, singleThread);
+}
+
+
+/** Copies \a src into tightly packed RGBA8 */
+static void toRGBA8(const shared_ptr<PixelTransferBuffer>& src, Array<uint8>& rgba8) {
+    const ImageFormat::Code code = src->format()->code;
+    const int w = src->width(), h = src->height();
+
+    int srcChannels = 0;
+    switch (code) {
+    case ImageFormat::CODE_RGBA8:
+    case ImageFormat::CODE_SRGBA8:
+        srcChannels = 4;
+        break;
+    case ImageFormat::CODE_RGB8:
+    case ImageFormat::CODE_SRGB8:
+        srcChannels = 3;
+        break;
+    case ImageFormat::CODE_RG8:
+    case ImageFormat::CODE_LA8:
+        srcChannels = 2;
+        break;
+    case ImageFormat::CODE_R8:
+    case ImageFormat::CODE_L8:
+        srcChannels = 1;
+        break;
+    default:
+        {
+            const shared_ptr<Image>& image = Image::fromPixelTransferBuffer(src);
+            image->convertToRGBA8();
+            toRGBA8(image->toPixelTransferBuffer(), rgba8);
+            return;
+        }
+    }
+
+    const bool luminance = (code == ImageFormat::CODE_L8) || (code == ImageFormat::CODE_LA8);
+    rgba8.resize(w * h * 4);
+    const uint8* base = static_cast<const uint8*>(src->mapRead());
+    runConcurrently(0, h, [&](int y) {
+        const uint8* in = base + src->rowOffset(y);
+        uint8* out = rgba8.getCArray() + size_t(y) * w * 4;
+        for (int x = 0; x < w; ++x, in += srcChannels, out += 4) {
+            switch (srcChannels) {
+            case 4:
+                out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = in[3];
+                break;
+            case 3:
+                out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 255;
+                break;
+            case 2:
+                out[0] = in[0];
+                out[1] = luminance ? in[0] : in[1];
+                out[2] = luminance ? in[0] : 0;
+                out[3] = luminance ? in[1] : 255;
+                break;
+            default:
+                out[0] = in[0];
+                out[1] = out[2] = luminance ? in[0] : 0;
+                out[3] = 255;
+            }
+        }
+    });
+    src->unmap();
+}
+
+
+void BlockCompression::encode(Format format, const shared_ptr<PixelTransferBuffer>& src, Array<uint8>& dst, bool singleThread) {
+    Array<uint8> rgba8;
+    toRGBA8(src, rgba8);
+    dst.resize(int(encodedSize(format, src->width(), src->height())));
+    encode(format, rgba8.getCArray(), src->width(), src->height(), dst.getCArray(), singleThread);
+}
+
+
+void BlockCompression::decode(Format format, const uint8* src, int width, int height, uint8* rgba8) {
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const int blockBytes = bytesPerBlock(format);
+
+    runConcurrently(0, blocksY, [&](int by) {
+        for (int bx = 0; bx < blocksX; ++bx) {
+            const uint8* in = src + (size_t(by) * blocksX + bx) * blockBytes;
+            uint8 block[16][4];
+            System::memset(block, 0, sizeof(block));
+            for (int i = 0; i < 16; ++i) {
+                block[i][3] = 255;
+            }
+
+            switch (format) {
+            case Format::BC1:
+                decodeColorBlock(in, false, block);
+                break;
+
+            case Format::BC3:
+                decodeScalarBlock(in, 3, block);
+                decodeColorBlock(in + 8, true, block);
+                break;
+
+            case Format::BC4:
+                decodeScalarBlock(in, 0, block);
+                break;
+
+            case Format::BC5:
+                decodeScalarBlock(in, 0, block);
+                decodeScalarBlock(in + 8, 1, block);
+                break;
+
+            case Format::BC7:
+                decodeBC7Block(in, block);
+                break;
+            }
+
+            for (int i = 0; i < 16; ++i) {
+                const int x = bx * 4 + (i & 3);
+                const int y = by * 4 + (i >> 2);
+                if ((x < width) && (y < height)) {
+                    System::memcpy(rgba8 + (size_t(y) * width + x) * 4, block[i], 4);
+                }
+            }
+        }
+    });
+}
+
+
+shared_ptr<Image> BlockCompression::decode(Format format, const Array<uint8>& src, int width, int height) {
+    debugAssert(size_t(src.size()) >= encodedSize(format, width, height));
+    const shared_ptr<CPUPixelTransferBuffer>& ptb = CPUPixelTransferBuffer::create(width, height, ImageFormat::RGBA8());
+    decode(format, src.getCArray(), width, height, static_cast<uint8*>(ptb->buffer()));
+    return Image::fromPixelTransferBuffer(ptb);
+}
+
+
+float BlockCompression::psnr(const uint8* a, const uint8* b, int numPixels, int numChannels) {
+    double sum = 0.0;
+    for (int i = 0; i < numPixels; ++i) {
+        for (int c = 0; c < numChannels; ++c) {
+            sum += square(double(a[i * 4 + c]) - double(b[i * 4 + c]));
+        }
+    }
+
+    if (sum == 0.0) {
+        return finf();
+    }
+    const double mse = sum / (double(numPixels) * numChannels);
+    return float(10.0 * log10(255.0 * 255.0 / mse));
+}
+
+
+BlockCompression::Report BlockCompression::measure(Format format, const shared_ptr<PixelTransferBuffer>& src) {
+    Report report;
+    report.format = format;
+    report.width  = src->width();
+    report.height = src->height();
+
+    Array<uint8> rgba8;
+    toRGBA8(src, rgba8);
+
+    Array<uint8> encoded;
+    encoded.resize(int(encodedSize(format, report.width, report.height)));
+    const RealTime start = System::time();
+    encode(format, rgba8.getCArray(), report.width, report.height, encoded.getCArray());
+    report.encodeTime = System::time() - start;
+
+    Array<uint8> decoded;
+    decoded.resize(rgba8.size());
+    decode(format, encoded.getCArray(), report.width, report.height, decoded.getCArray());
+    report.psnr = psnr(rgba8.getCArray(), decoded.getCArray(), report.width * report.height, numChannels(format));
+
+    return report;
+}
+
+
+String BlockCompression::Report::toString() const {
+    return G3D::format("%s %dx%d: %.2f dB PSNR, %.3f s, %.1f Mpixel/s",
+        BlockCompression::toString(this->format), width, height, psnr, encodeTime, megapixelsPerSecond());
+}
+
+
+void BlockCompression::encodeMipChain(Format format, const shared_ptr<PixelTransferBuffer>& src, bool sRGB, MipChain& chain, float alphaCoverageReference) {
+    chain.format = format;
+    chain.width  = src->width();
+    chain.height = src->height();
+    chain.sRGB   = sRGB;
+    chain.level.fastClear();
+
+    Array<uint8> rgba8;
+    toRGBA8(src, rgba8);
+
+    // Filter in linear space when the data are sRGB-encoded, so that the levels do not darken
+    Image::ResampleSettings settings;
+    settings.treatAsSRGB = sRGB;
+    settings.alphaCoverageReference = alphaCoverageReference;
+
+    Array<shared_ptr<PixelTransferBuffer>> mipLevel;
+    Image::generateMipChain(CPUPixelTransferBuffer::fromData(chain.width, chain.height, ImageFormat::RGBA8(), rgba8.getCArray()), mipLevel, settings);
+
+    for (const shared_ptr<PixelTransferBuffer>& ptb : mipLevel) {
+        Array<uint8>& level = chain.level.next();
+        level.resize(int(encodedSize(format, ptb->width(), ptb->height())));
+        encode(format, static_cast<const uint8*>(ptb->mapRead()), ptb->width(), ptb->height(), level.getCArray());
+        ptb->unmap();
+    }
+}
+
+
+void BlockCompression::MipChain::serialize(BinaryOutput& b) const {
+    b.writeString(MIP_CHAIN_MAGIC);
+    b.writeUInt32(MIP_CHAIN_VERSION);
+    b.writeUInt8(uint8(format));
+    b.writeBool8(sRGB);
+    b.writeInt32(width);
+    b.writeInt32(height);
+    b.writeInt32(level.size());
+    for (const Array<uint8>& data : level) {
+        b.writeInt64(data.size());
+        b.writeBytes(data.getCArray(), data.size());
+    }
+}
+
+
+void BlockCompression::MipChain::deserialize(BinaryInput& b) {
+    // Magic string with its terminator, version, format, sRGB, width, height, and number of levels
+    const int64 magicBytes = int64(strlen(MIP_CHAIN_MAGIC)) + 1;
+    if (b.getLength() - b.getPosition() < magicBytes + 4 + 1 + 1 + 4 * 3) {
+        throw String("Truncated BlockCompression::MipChain");
+    }
+
+    if ((b.readString(magicBytes) != MIP_CHAIN_MAGIC) || (b.readUInt32() != MIP_CHAIN_VERSION)) {
+        throw String("Not a BlockCompression::MipChain");
+    }
+
+    const uint8 f = b.readUInt8();
+    if (f > uint8(Format::BC7)) {
+        throw String("Unknown BlockCompression::Format");
+    }
+    format = Format(f);
+    sRGB   = b.readBool8();
+    width  = b.readInt32();
+    height = b.readInt32();
+    const int numLevels = b.readInt32();
+    if ((width <= 0) || (height <= 0) || (numLevels <= 0) || (numLevels > 32)) {
+        throw String("Corrupt BlockCompression::MipChain header");
+    }
+
+    level.resize(numLevels);
+    for (int m = 0; m < numLevels; ++m) {
+        if (b.getLength() - b.getPosition() < int64(sizeof(int64))) {
+            throw String("Truncated BlockCompression::MipChain");
+        }
+        const int64 numBytes = b.readInt64();
+        if ((numBytes != int64(encodedSize(format, levelWidth(m), levelHeight(m)))) || (b.getPosition() + numBytes > b.size())) {
+            throw String("Corrupt BlockCompression::MipChain level");
+        }
+        level[m].resize(int(numBytes));
+        b.readBytes(level[m].getCArray(), numBytes);
+    }
+}
+
+
+shared_ptr<PixelTransferBuffer> BlockCompression::MipChain::toPixelTransferBuffer(int m) const {
+    const ImageFormat* f = imageFormat();
+    alwaysAssertM(notNull(f), String("No ImageFormat for ") + BlockCompression::toString(format));
+    return CPUPixelTransferBuffer::fromData(levelWidth(m), levelHeight(m), f, const_cast<uint8*>(level[m].getCArray()));
+}
+
+} // namespace G3D
@@ -62,11 +62,10 @@ void CPUPixelTransferBuffer::allocateBuffer(const shared_ptr<MemoryManager>& mem
     m_memoryManager = memoryManager;
 
     // allocate buffer
-    m_rowStride = m_width * (m_format->cpuBitsPerPixel / 8);
+    m_rowStride = (m_format->compressed ? (m_width + 3) / 4 : m_width) * (m_format->cpuBitsPerPixel / 8);
     m_rowStride = (m_rowStride + (m_rowAlignment - 1)) & (~ (m_rowAlignment - 1));
 
-    const size_t bufferSize = m_depth * m_height * m_rowStride;
-    m_buffer = m_memoryManager->alloc(bufferSize);
+    m_buffer = m_memoryManager->alloc(size());
 }
 
     
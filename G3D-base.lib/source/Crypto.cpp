@@ -67,4 +67,20 @@ uint32 Crypto::crc32(const void* byte, size_t numBytes) {
     return ::crc32(::crc32(0, Z_NULL, 0), static_cast<const Bytef *>(byte), (int)numBytes);
 }
 
+
+uint64 Crypto::fnv1a64(const void* data, size_t numBytes, uint64 hash) {
+    static const uint64 prime = 1099511628211ull;
+    const uint8* bytes = static_cast<const uint8*>(data);
+    size_t i = 0;
+    for (; i + 8 <= numBytes; i += 8) {
+        uint64 word;
+        System::memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < numBytes; ++i) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+    return hash;
+}
+
 } // G3D
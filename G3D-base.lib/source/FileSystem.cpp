@@ -12,12 +12,12 @@
 #include "G3D-base/fileutils.h"
 #include <sys/stat.h>
 #include <sys/types.h>
-#include "zip.h"
 #include <regex>
 #include <cstring>
 #include "G3D-base/g3dfnmatch.h"
 #include "G3D-base/BinaryInput.h"
 #include "G3D-base/BinaryOutput.h"
+#include "G3D-base/ZipArchive.h"
 
 #ifdef G3D_WINDOWS
     // Needed for _getcwd
@@ -108,16 +108,14 @@ bool FileSystem::Dir::contains(const String& f, bool caseSensitive) const {
 void FileSystem::Dir::computeZipListing(const String& zipfile, const String& _pathInsideZipfile) {
     const String& pathInsideZipfile = FilePath::canonicalize(_pathInsideZipfile);
     const String& filename = FilePath::canonicalize(FilePath::removeTrailingSlash(zipfile));
-    struct zip* z = zip_open(filename.c_str(), ZIP_CHECKCONS, nullptr);
-    debugAssertM(z, format("Could not open zipfile '%s'", filename.c_str()));
+    const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(filename);
+    debugAssertM(archive, format("Could not open zipfile '%s'", filename.c_str()));
+    if (isNull(archive)) {
+        return;
+    }
 
-    int count = zip_get_num_files( z );
     Set<String> alreadyAdded;
-    for (int i = 0; i < count; ++i) {
-        struct zip_stat info;
-        zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-        zip_stat_index( z, i, ZIP_FL_NOCASE, &info );
-        
+    for (const ZipArchive::Entry& info : archive->entries()) {
         // Fully-qualified name of a file inside zipfile
         String name = FilePath::canonicalize(info.name);
 
@@ -154,9 +152,6 @@ void FileSystem::Dir::computeZipListing(const String& zipfile, const String& _pa
             }
         }
     }
-    
-    zip_close(z);
-    z = nullptr;
 }
 
 
@@ -352,6 +347,44 @@ bool FileSystem::_isZipfile(const String& _filename) {
 }
 
 
+shared_ptr<ZipArchive> FileSystem::_zipArchive(const String& zipfile) {
+    const String& filename = FilePath::canonicalize(FilePath::removeTrailingSlash(_resolve(zipfile)));
+    const String& key =
+#   if defined(G3D_WINDOWS)
+        toLower(filename);
+#   else
+        filename;
+#   endif
+
+    const RealTime now = System::time();
+    CachedZipArchive& cached = m_zipArchive.getCreate(key);
+    if (notNull(cached.archive) && (now <= cached.lastChecked + cacheLifetime())) {
+        return cached.archive;
+    }
+
+    struct stat64 st;
+    if (stat64(filename.c_str(), &st) == -1) {
+        m_zipArchive.remove(key);
+        return nullptr;
+    }
+
+    if (isNull(cached.archive) || (cached.size != int64(st.st_size)) || (cached.modificationTime != int64(st.st_mtime))) {
+        // Release the old mapping before opening the new one
+        cached.archive = nullptr;
+        cached.archive = ZipArchive::create(filename);
+        cached.size = int64(st.st_size);
+        cached.modificationTime = int64(st.st_mtime);
+    }
+    cached.lastChecked = now;
+
+    if (isNull(cached.archive)) {
+        m_zipArchive.remove(key);
+        return nullptr;
+    }
+    return cached.archive;
+}
+
+
 FILE* FileSystem::_fopen(const char* _filename, const char* mode) {
     const String& filename = FilePath::canonicalize(FilePath::expandEnvironmentVariables(_filename));
 
@@ -373,6 +406,7 @@ void FileSystem::_clearCache(const String& _path) {
 
     if ((path == "") || FilePath::isRoot(path)) {
         m_cache.clear();
+        m_zipArchive.clear();
     } else {
         Array<String> keys;
         m_cache.getKeys(keys);
@@ -391,6 +425,14 @@ void FileSystem::_clearCache(const String& _path) {
                 m_cache.remove(keys[k]);
             }
         }
+
+        keys.fastClear();
+        m_zipArchive.getKeys(keys);
+        for (const String& key : keys) {
+            if ((key == prefix) || beginsWith(key, prefixSlash)) {
+                m_zipArchive.remove(key);
+            }
+        }
     }
 }
 
@@ -718,20 +760,10 @@ int64 FileSystem::_size(const String& _filename) {
     if (result == -1) {
         String zip, contents;
         if (zipfileExists(filename, zip, contents)) {
-            int64 requiredMem;
-            
-            struct zip *z = zip_open( zip.c_str(), ZIP_CHECKCONS, nullptr );
-            debugAssertM(z != nullptr, zip + ": zip open failed.");
-            {
-                struct zip_stat info;
-                zip_stat_init( &info );    // Docs unclear if zip_stat_init is required.
-                int success = zip_stat( z, contents.c_str(), ZIP_FL_NOCASE, &info );
-                (void) success;
-                debugAssertM(success == 0, zip + ": " + contents + ": zip stat failed.");
-                requiredMem = info.size;
-            }
-            zip_close(z);
-            return requiredMem;
+            const shared_ptr<ZipArchive>& archive = _zipArchive(zip);
+            const ZipArchive::Entry* entry = notNull(archive) ? archive->find(contents) : nullptr;
+            debugAssertM(notNull(entry), zip + ": " + contents + ": zip stat failed.");
+            return notNull(entry) ? int64(entry->size) : -1;
         } else {
             return -1;
         }
@@ -19,6 +19,10 @@
 #include "G3D-base/PixelTransferBuffer.h"
 #include "G3D-base/CPUPixelTransferBuffer.h"
 
+#ifdef G3D_X86
+#    include <emmintrin.h>
+#endif
+
 // Forward declaration for OpenEXR to avoid bringing in the entire header
 namespace Imf_2_2 {
 void staticInitialize();
@@ -91,12 +95,12 @@ bool Image::fileSupported(const String& filename, bool allowCheckSignature) {
 }
 
 
-shared_ptr<Image> Image::fromFile(const String& filename, const ImageFormat* imageFormat) {
+shared_ptr<Image> Image::fromFile(const String& filename, const ImageFormat* imageFormat, int maxDimension) {
     debugAssertM(fileSupported(filename, true), G3D::format("Image file format not supported! (%s)", filename.c_str()));
     // Use BinaryInput to allow reading from zip files
     try {
         BinaryInput bi(filename, G3D::G3D_LITTLE_ENDIAN);
-        return fromBinaryInput(bi, imageFormat);
+        return fromBinaryInput(bi, imageFormat, maxDimension);
     } catch (const String& e) {
         throw Error(e, filename);
     }
@@ -123,12 +127,134 @@ bool Image::metaDataFromBinaryInput(BinaryInput& bi, int& width, int& height, co
 }
 
 
-shared_ptr<Image> Image::fromBinaryInput(BinaryInput& bi, const ImageFormat* imageFormat) {
+int Image::reducedSize(int width, int height, int maxDimension, int& reducedWidth, int& reducedHeight) {
+    int factor = 1;
+    if (maxDimension > 0) {
+        while ((G3D::max(width, height) + factor - 1) / factor > maxDimension) {
+            factor *= 2;
+        }
+    }
+    reducedWidth  = (width  + factor - 1) / factor;
+    reducedHeight = (height + factor - 1) / factor;
+    return factor;
+}
+
+
+/** Sums \a numRows rows of \a rowBytes unsigned bytes each. \a numRows must be at most 257 so
+    that the sums fit in 16 bits. */
+static void sumRows8(const uint8* const* row, int numRows, int rowBytes, uint16* sum) {
+    int i = 0;
+#   ifdef G3D_X86
+        const __m128i zero = _mm_setzero_si128();
+        for (; i + 16 <= rowBytes; i += 16) {
+            __m128i lo = zero, hi = zero;
+            for (int r = 0; r < numRows; ++r) {
+                const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row[r] + i));
+                lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+                hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + i), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + i + 8), hi);
+        }
+#   endif
+    for (; i < rowBytes; ++i) {
+        int s = 0;
+        for (int r = 0; r < numRows; ++r) {
+            s += row[r][i];
+        }
+        sum[i] = uint16(s);
+    }
+}
+
+
+/** Averages each run of \a factor pixels of column sums, rounding to nearest */
+template<int numChannels>
+static void reduceRow8(const uint16* sum, int srcWidth, int numRows, int factor, uint8* dst, int dstWidth) {
+    for (int x = 0; x < dstWidth; ++x) {
+        const int x0 = x * factor;
+        const int x1 = G3D::min(x0 + factor, srcWidth);
+        uint32 total[numChannels] = {};
+        for (int i = x0; i < x1; ++i) {
+            for (int c = 0; c < numChannels; ++c) {
+                total[c] += sum[i * numChannels + c];
+            }
+        }
+        const uint32 n = uint32((x1 - x0) * numRows);
+        for (int c = 0; c < numChannels; ++c) {
+            dst[x * numChannels + c] = uint8((total[c] + n / 2) / n);
+        }
+    }
+}
+
+
+/** Box-filters \a image down by \a factor in a single pass. Partial blocks at the edges
+    average only the pixels that they contain. 8-bit images use a SIMD path; other types fall
+    back to FreeImage's resampler. */
+static void reduceImage(fipImage* image, int factor) {
+    const int srcWidth  = image->getWidth();
+    const int srcHeight = image->getHeight();
+    const int dstWidth  = (srcWidth  + factor - 1) / factor;
+    const int dstHeight = (srcHeight + factor - 1) / factor;
+    const int bpp       = image->getBitsPerPixel();
+
+    if ((image->getImageType() != FIT_BITMAP) || ((bpp != 8) && (bpp != 24) && (bpp != 32)) || (factor > 256)) {
+        image->rescale(dstWidth, dstHeight, FILTER_BOX);
+        return;
+    }
+
+    const int numChannels = bpp / 8;
+    FIBITMAP* reduced = FreeImage_Allocate(dstWidth, dstHeight, bpp);
+    if (isNull(reduced)) {
+        throw Image::Error("Unable to allocate FreeImage buffer for reduced image");
+    }
+
+    Array<uint16> sum;
+    sum.resize(srcWidth * numChannels);
+    Array<const uint8*> row;
+    row.resize(factor);
+
+    for (int y = 0; y < dstHeight; ++y) {
+        const int numRows = G3D::min(factor, srcHeight - y * factor);
+        for (int r = 0; r < numRows; ++r) {
+            row[r] = image->getScanLine(y * factor + r);
+        }
+        sumRows8(row.getCArray(), numRows, srcWidth * numChannels, sum.getCArray());
+
+        uint8* dst = FreeImage_GetScanLine(reduced, y);
+        switch (numChannels) {
+        case 1:  reduceRow8<1>(sum.getCArray(), srcWidth, numRows, factor, dst, dstWidth); break;
+        case 3:  reduceRow8<3>(sum.getCArray(), srcWidth, numRows, factor, dst, dstWidth); break;
+        default: reduceRow8<4>(sum.getCArray(), srcWidth, numRows, factor, dst, dstWidth); break;
+        }
+    }
+
+    // Takes ownership of reduced and releases the full-resolution bitmap
+    *image = reduced;
+}
+
+
+shared_ptr<Image> Image::fromBinaryInput(BinaryInput& bi, const ImageFormat* imageFormat, int maxDimension) {
     const shared_ptr<Image>& img = createShared<Image>();
-    
+
     fipMemoryIO memoryIO(const_cast<uint8*>(bi.getCArray() + bi.getPosition()), static_cast<DWORD>(bi.getLength() - bi.getPosition()));
 
-    if (! img->m_image->loadFromMemory(memoryIO)) {
+    int flags = 0;
+    if ((maxDimension > 0) && (memoryIO.getFileType() == FIF_JPEG)) {
+        int width = 0, height = 0, reducedWidth, reducedHeight;
+        const ImageFormat* ignore = nullptr;
+        if (metaDataFromBinaryInput(bi, width, height, ignore)) {
+            // libjpeg scales by 1/2, 1/4, or 1/8 while decoding by discarding high-frequency
+            // DCT coefficients. FreeImage chooses the largest of those scales that keeps the
+            // longer side at least the size in the upper 16 bits of the flags.
+            const int jpegFactor = G3D::min(reducedSize(width, height, maxDimension, reducedWidth, reducedHeight), 8);
+            if (jpegFactor > 1) {
+                flags = (G3D::max(width, height) / jpegFactor) << 16;
+            }
+        }
+        memoryIO.seek(0, SEEK_SET);
+    }
+
+    if (! img->m_image->loadFromMemory(memoryIO, flags)) {
 
         throw Image::Error("Unsupported file format or unable to allocate FreeImage buffer", bi.getFilename());
         return nullptr;
@@ -183,7 +309,16 @@ shared_ptr<Image> Image::fromBinaryInput(BinaryInput& bi, const ImageFormat* ima
             return shared_ptr<Image>();
         }
     }
-    
+
+    if (maxDimension > 0) {
+        // Finish any reduction that the decoder did not perform
+        int reducedWidth, reducedHeight;
+        const int factor = reducedSize(img->width(), img->height(), maxDimension, reducedWidth, reducedHeight);
+        if (factor > 1) {
+            reduceImage(img->m_image, factor);
+        }
+    }
+
     return img;
 }
 
@@ -8,11 +8,481 @@
 */
 #include "G3D-base/platform.h"
 #include "G3D-base/Image.h"
+#include "G3D-base/CPUPixelTransferBuffer.h"
+#include "G3D-base/Thread.h"
+#include "G3D-base/g3dmath.h"
+#include <algorithm>
+
+#ifdef G3D_X86
+#    include <xmmintrin.h>
+#endif
 
 namespace G3D {
 
+namespace _internal {
 
+/** How resampling reads and writes the pixels of one ImageFormat. Every pixel is
+    processed as four floats, with unused channels zero. */
+class ResampleLayout {
+public:
+    /** 1 for unorm8, 2 for unorm16, 4 for float32, and 0 for unsupported formats */
+    int         bytesPerComponent = 0;
 
+    int         numComponents = 0;
 
-} // namespace G3D
+    /** Index of the alpha component, or -1 */
+    int         alphaIndex = -1;
+
+    /** If true, components other than alpha are sRGB-encoded */
+    bool        sRGB = false;
+
+    ResampleLayout(const ImageFormat* format, bool treatAsSRGB) {
+        switch (format->code) {
+        case ImageFormat::CODE_A8:
+        case ImageFormat::CODE_L8:
+        case ImageFormat::CODE_R8:
+        case ImageFormat::CODE_LA8:
+        case ImageFormat::CODE_RG8:
+        case ImageFormat::CODE_RGB8:
+        case ImageFormat::CODE_SRGB8:
+        case ImageFormat::CODE_BGR8:
+        case ImageFormat::CODE_RGBA8:
+        case ImageFormat::CODE_SRGBA8:
+        case ImageFormat::CODE_BGRA8:
+            bytesPerComponent = 1;
+            break;
+
+        case ImageFormat::CODE_L16:
+        case ImageFormat::CODE_R16:
+        case ImageFormat::CODE_RG16:
+        case ImageFormat::CODE_RGB16:
+        case ImageFormat::CODE_RGBA16:
+            bytesPerComponent = 2;
+            break;
+
+        case ImageFormat::CODE_L32F:
+        case ImageFormat::CODE_R32F:
+        case ImageFormat::CODE_LA32F:
+        case ImageFormat::CODE_RG32F:
+        case ImageFormat::CODE_RGB32F:
+        case ImageFormat::CODE_RGBA32F:
+            bytesPerComponent = 4;
+            break;
+
+        default:
+            return;
+        }
+
+        numComponents = format->numComponents;
+        alphaIndex    = (format->alphaBits > 0) ? numComponents - 1 : -1;
+        sRGB          = treatAsSRGB || (format->colorSpace == ImageFormat::COLOR_SPACE_SRGB);
+    }
+
+    bool supported() const {
+        return bytesPerComponent > 0;
+    }
+
+    bool isEncoded(int c) const {
+        return sRGB && (c != alphaIndex);
+    }
+};
+
+
+static float sRGBToLinear(float s) {
+    return (s <= 0.04045f) ? (s / 12.92f) : ::powf((s + 0.055f) / 1.055f, 2.4f);
+}
+
+
+static float linearToSRGB(float L) {
+    return (L <= 0.0031308f) ? (L * 12.92f) : (1.055f * ::powf(L, 1.0f / 2.4f) - 0.055f);
+}
+
+
+/** Exact conversions between 8-bit sRGB and linear floats */
+class SRGBTables {
+public:
+    float       toLinear[256];
+
+    /** threshold[i] is the linear value halfway between the 8-bit sRGB values i and i + 1 */
+    float       threshold[255];
+
+    SRGBTables() {
+        for (int i = 0; i < 256; ++i) {
+            toLinear[i] = sRGBToLinear(float(i) / 255.0f);
+        }
+        for (int i = 0; i < 255; ++i) {
+            threshold[i] = sRGBToLinear((float(i) + 0.5f) / 255.0f);
+        }
+    }
+
+    uint8 encode(float L) const {
+        return uint8(std::upper_bound(threshold, threshold + 255, L) - threshold);
+    }
+
+    static const SRGBTables& instance() {
+        static const SRGBTables tables;
+        return tables;
+    }
+};
+
+
+/** Unpacks one row to four floats per pixel, converting sRGB to linear */
+static void decodeRow(const ResampleLayout& layout, const void* src, int width, float* dst) {
+    const SRGBTables& tables = SRGBTables::instance();
+    const int n = layout.numComponents;
+    for (int x = 0; x < width; ++x) {
+        float* out = dst + 4 * x;
+        out[0] = out[1] = out[2] = out[3] = 0.0f;
+        for (int c = 0; c < n; ++c) {
+            const int i = x * n + c;
+            switch (layout.bytesPerComponent) {
+            case 1:
+                {
+                    const uint8 v = static_cast<const uint8*>(src)[i];
+                    out[c] = layout.isEncoded(c) ? tables.toLinear[v] : (float(v) * (1.0f / 255.0f));
+                }
+                break;
+
+            case 2:
+                out[c] = float(static_cast<const uint16*>(src)[i]) * (1.0f / 65535.0f);
+                if (layout.isEncoded(c)) { out[c] = sRGBToLinear(out[c]); }
+                break;
+
+            default:
+                out[c] = static_cast<const float*>(src)[i];
+                if (layout.isEncoded(c)) { out[c] = sRGBToLinear(out[c]); }
+                break;
+            }
+        }
+    }
+}
+
+
+/** Inverse of decodeRow. Clamps normalized formats to [0, 1]. */
+static void encodeRow(const ResampleLayout& layout, const float* src, int width, void* dst) {
+    const SRGBTables& tables = SRGBTables::instance();
+    const int n = layout.numComponents;
+    for (int x = 0; x < width; ++x) {
+        const float* in = src + 4 * x;
+        for (int c = 0; c < n; ++c) {
+            const int i = x * n + c;
+            switch (layout.bytesPerComponent) {
+            case 1:
+                static_cast<uint8*>(dst)[i] = layout.isEncoded(c) ? tables.encode(in[c]) : uint8(iRound(clamp(in[c], 0.0f, 1.0f) * 255.0f));
+                break;
+
+            case 2:
+                {
+                    const float v = clamp(in[c], 0.0f, 1.0f);
+                    static_cast<uint16*>(dst)[i] = uint16(iRound((layout.isEncoded(c) ? linearToSRGB(v) : v) * 65535.0f));
+                }
+                break;
+
+            default:
+                static_cast<float*>(dst)[i] = layout.isEncoded(c) ? linearToSRGB(G3D::max(in[c], 0.0f)) : in[c];
+                break;
+            }
+        }
+    }
+}
+
+
+/** Weights for resampling one axis. Every destination pixel has the same number of taps,
+    padded with zero weights, so that the inner loops have no branches. */
+class ResampleKernel {
+public:
+    int             numTaps = 0;
+    Array<int>      index;
+    Array<float>    weight;
+
+    static float sinc(float x) {
+        x *= pif();
+        return (::fabsf(x) < 1e-5f) ? 1.0f : (::sinf(x) / x);
+    }
+
+    /** Modified Bessel function of the first kind, order zero */
+    static float besselI0(float x) {
+        float sum = 1.0f, term = 1.0f;
+        const float halfX = x * 0.5f;
+        for (int k = 1; k < 20; ++k) {
+            term *= square(halfX / float(k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static float radius(Image::ResampleFilter filter) {
+        return (filter == Image::ResampleFilter::BOX) ? 0.5f : 3.0f;
+    }
+
+    static float evaluate(Image::ResampleFilter filter, float x) {
+        switch (filter.value) {
+        case Image::ResampleFilter::BOX:
+            return ((x >= -0.5f) && (x < 0.5f)) ? 1.0f : 0.0f;
+
+        case Image::ResampleFilter::KAISER:
+            {
+                static const float alpha = 4.0f;
+                static const float normalization = 1.0f / besselI0(alpha);
+                const float t = x / 3.0f;
+                return (::fabsf(t) < 1.0f) ? (sinc(x) * besselI0(alpha * ::sqrtf(1.0f - t * t)) * normalization) : 0.0f;
+            }
+
+        default:
+            return (::fabsf(x) < 3.0f) ? (sinc(x) * sinc(x / 3.0f)) : 0.0f;
+        }
+    }
+
+    ResampleKernel(int srcSize, int dstSize, Image::ResampleFilter filter, bool tile) {
+        const float scale       = float(srcSize) / float(dstSize);
+
+        // Widen the filter when reducing so that it covers every source pixel
+        const float filterScale = G3D::max(1.0f, scale);
+        const float support     = radius(filter) * filterScale;
+        numTaps = iCeil(2.0f * support) + 1;
+        index.resize(dstSize * numTaps);
+        weight.resize(dstSize * numTaps);
 
+        for (int i = 0; i < dstSize; ++i) {
+            int*   tapIndex  = index.getCArray() + i * numTaps;
+            float* tapWeight = weight.getCArray() + i * numTaps;
+
+            const float center = (float(i) + 0.5f) * scale - 0.5f;
+            const int   first  = iCeil(center - support);
+            float sum = 0.0f;
+            for (int t = 0; t < numTaps; ++t) {
+                const int j = first + t;
+                tapIndex[t]  = tile ? (((j % srcSize) + srcSize) % srcSize) : iClamp(j, 0, srcSize - 1);
+                tapWeight[t] = evaluate(filter, (float(j) - center) / filterScale);
+                sum += tapWeight[t];
+            }
+
+            if (sum == 0.0f) {
+                // Only possible for a box filter when enlarging; use the nearest pixel
+                tapIndex[0]  = iClamp(iRound(center), 0, srcSize - 1);
+                tapWeight[0] = sum = 1.0f;
+                for (int t = 1; t < numTaps; ++t) {
+                    tapWeight[t] = 0.0f;
+                }
+            }
+
+            for (int t = 0; t < numTaps; ++t) {
+                tapWeight[t] /= sum;
+            }
+        }
+    }
+};
+
+
+/** dst[i] += w * src[i] for \a n floats. n is a multiple of 4. */
+static void multiplyAdd(float* dst, const float* src, float w, int n) {
+    int i = 0;
+#   ifdef G3D_X86
+        const __m128 weight = _mm_set1_ps(w);
+        for (; i < n; i += 4) {
+            _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(weight, _mm_loadu_ps(src + i))));
+        }
+#   endif
+    for (; i < n; ++i) {
+        dst[i] += w * src[i];
+    }
+}
+
+
+/** Filters one row of four-float pixels */
+static void filterRow(const float* src, const ResampleKernel& kernel, int dstWidth, float* dst) {
+    const int    numTaps = kernel.numTaps;
+    const int*   index   = kernel.index.getCArray();
+    const float* weight  = kernel.weight.getCArray();
+
+    for (int x = 0; x < dstWidth; ++x, index += numTaps, weight += numTaps) {
+#       ifdef G3D_X86
+            __m128 sum = _mm_setzero_ps();
+            for (int t = 0; t < numTaps; ++t) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weight[t]), _mm_loadu_ps(src + 4 * index[t])));
+            }
+            _mm_storeu_ps(dst + 4 * x, sum);
+#       else
+            float sum[4] = {};
+            for (int t = 0; t < numTaps; ++t) {
+                const float* p = src + 4 * index[t];
+                for (int c = 0; c < 4; ++c) {
+                    sum[c] += weight[t] * p[c];
+                }
+            }
+            for (int c = 0; c < 4; ++c) {
+                dst[4 * x + c] = sum[c];
+            }
+#       endif
+    }
+}
+
+
+/** Fraction of pixels whose alpha is at least \a reference */
+static float alphaCoverage(const ResampleLayout& layout, const shared_ptr<PixelTransferBuffer>& ptb, float reference) {
+    const int w = ptb->width(), h = ptb->height();
+    const uint8* data = static_cast<const uint8*>(ptb->mapRead());
+    Array<float> row;
+    row.resize(4 * w);
+    int64 count = 0;
+    for (int y = 0; y < h; ++y) {
+        decodeRow(layout, data + ptb->rowOffset(y), w, row.getCArray());
+        for (int x = 0; x < w; ++x) {
+            count += (row[4 * x + layout.alphaIndex] >= reference) ? 1 : 0;
+        }
+    }
+    ptb->unmap();
+    return float(double(count) / (double(w) * double(h)));
+}
+
+
+/** Scales alpha in \a ptb so that alphaCoverage(ptb, reference) is approximately \a coverage */
+static void preserveAlphaCoverage(const ResampleLayout& layout, const shared_ptr<PixelTransferBuffer>& ptb, float reference, float coverage) {
+    const int w = ptb->width(), h = ptb->height();
+    uint8* data = static_cast<uint8*>(ptb->mapReadWrite());
+    Array<float> row;
+    row.resize(4 * w);
+
+    // Find the alpha value that the desired fraction of pixels meet or exceed
+    static const int numBins = 1024;
+    Array<int64> histogram;
+    histogram.resize(numBins);
+    histogram.setAll(0);
+    for (int y = 0; y < h; ++y) {
+        decodeRow(layout, data + ptb->rowOffset(y), w, row.getCArray());
+        for (int x = 0; x < w; ++x) {
+            ++histogram[iClamp(iFloor(row[4 * x + layout.alphaIndex] * numBins), 0, numBins - 1)];
+        }
+    }
+
+    const int64 target = int64(double(coverage) * double(w) * double(h) + 0.5);
+    int64 count = 0;
+    int bin = numBins - 1;
+    for (; (bin > 0) && (count + histogram[bin] < target); --bin) {
+        count += histogram[bin];
+    }
+    const float threshold = float(bin) / float(numBins);
+
+    if (threshold > 0.0f) {
+        const float scale = reference / threshold;
+        for (int y = 0; y < h; ++y) {
+            uint8* p = data + ptb->rowOffset(y);
+            decodeRow(layout, p, w, row.getCArray());
+            for (int x = 0; x < w; ++x) {
+                float& a = row[4 * x + layout.alphaIndex];
+                a = G3D::min(a * scale, 1.0f);
+            }
+            encodeRow(layout, row.getCArray(), w, p);
+        }
+    }
+    ptb->unmap();
+}
+
+} // namespace _internal
+
+
+void Image::resample(const shared_ptr<PixelTransferBuffer>& src, const shared_ptr<PixelTransferBuffer>& dst, const ResampleSettings& settings) {
+    alwaysAssertM(src->format() == dst->format(), "Image::resample requires matching formats");
+    const _internal::ResampleLayout layout(src->format(), settings.treatAsSRGB);
+    if (! layout.supported()) {
+        throw Image::Error("Image::resample does not support " + src->format()->name());
+    }
+
+    const int srcWidth  = src->width(),  srcHeight = src->height();
+    const int dstWidth  = dst->width(),  dstHeight = dst->height();
+    const bool tile     = (settings.wrapMode == WrapMode::TILE);
+
+    const _internal::ResampleKernel horizontal(srcWidth, dstWidth, settings.filter, tile);
+    const _internal::ResampleKernel vertical(srcHeight, dstHeight, settings.filter, tile);
+
+    const uint8* srcData = static_cast<const uint8*>(src->mapRead());
+    uint8*       dstData = static_cast<uint8*>(dst->mapWrite());
+
+    // Each band of destination rows filters the source rows that it needs horizontally, then
+    // combines them vertically, so that memory is proportional to the band size rather than
+    // the image size.
+    static const int bandSize = 32;
+    const int numBands = (dstHeight + bandSize - 1) / bandSize;
+    runConcurrently(0, numBands, [&](int band) {
+        const int y0 = band * bandSize;
+        const int y1 = G3D::min(y0 + bandSize, dstHeight);
+
+        // slot[j] is the index in filtered of source row j, or -1
+        Array<int> slot;
+        slot.resize(srcHeight);
+        slot.setAll(-1);
+        int numSlots = 0;
+        for (int i = y0 * vertical.numTaps; i < y1 * vertical.numTaps; ++i) {
+            int& s = slot[vertical.index[i]];
+            if (s == -1) {
+                s = numSlots++;
+            }
+        }
+
+        Array<float> decoded, filtered, out;
+        decoded.resize(4 * srcWidth);
+        filtered.resize(4 * dstWidth * numSlots);
+        out.resize(4 * dstWidth);
+
+        for (int j = 0; j < srcHeight; ++j) {
+            if (slot[j] >= 0) {
+                _internal::decodeRow(layout, srcData + src->rowOffset(j), srcWidth, decoded.getCArray());
+                _internal::filterRow(decoded.getCArray(), horizontal, dstWidth, filtered.getCArray() + 4 * dstWidth * slot[j]);
+            }
+        }
+
+        for (int y = y0; y < y1; ++y) {
+            out.setAll(0.0f);
+            for (int t = 0; t < vertical.numTaps; ++t) {
+                const float w = vertical.weight[y * vertical.numTaps + t];
+                if (w != 0.0f) {
+                    const int s = slot[vertical.index[y * vertical.numTaps + t]];
+                    _internal::multiplyAdd(out.getCArray(), filtered.getCArray() + 4 * dstWidth * s, w, 4 * dstWidth);
+                }
+            }
+            _internal::encodeRow(layout, out.getCArray(), dstWidth, dstData + dst->rowOffset(y));
+        }
+    });
+
+    dst->unmap();
+    src->unmap();
+}
+
+
+shared_ptr<Image> Image::resized(int width, int height, const ResampleSettings& settings) const {
+    const shared_ptr<CPUPixelTransferBuffer>& dst = CPUPixelTransferBuffer::create(width, height, m_format);
+    resample(toPixelTransferBuffer(), dst, settings);
+    return fromPixelTransferBuffer(dst);
+}
+
+
+void Image::generateMipChain(const shared_ptr<PixelTransferBuffer>& src, Array<shared_ptr<PixelTransferBuffer>>& chain, const ResampleSettings& settings) {
+    const _internal::ResampleLayout layout(src->format(), settings.treatAsSRGB);
+    if (! layout.supported()) {
+        throw Image::Error("Image::generateMipChain does not support " + src->format()->name());
+    }
+
+    const bool preserveCoverage = (layout.alphaIndex >= 0) && (settings.alphaCoverageReference > 0.0f) && (settings.alphaCoverageReference < 1.0f);
+    const float coverage = preserveCoverage ? _internal::alphaCoverage(layout, src, settings.alphaCoverageReference) : 0.0f;
+
+    chain.fastClear();
+    chain.append(src);
+    int w = src->width(), h = src->height();
+    while ((w > 1) || (h > 1)) {
+        w = G3D::max(1, w / 2);
+        h = G3D::max(1, h / 2);
+        const shared_ptr<CPUPixelTransferBuffer>& level = CPUPixelTransferBuffer::create(w, h, src->format());
+        resample(chain.last(), level, settings);
+        if (preserveCoverage) {
+            _internal::preserveAlphaCoverage(layout, level, settings.alphaCoverageReference, coverage);
+        }
+        chain.append(level);
+    }
+}
+
+
+void Image::generateMipChain(Array<shared_ptr<PixelTransferBuffer>>& chain, const ResampleSettings& settings) const {
+    generateMipChain(toPixelTransferBuffer(), chain, settings);
+}
+
+} // namespace G3D
@@ -0,0 +1,155 @@
+/**
+  \file G3D-base.lib/source/MemoryMappedFile.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/MemoryMappedFile.h"
+#include "G3D-base/FileSystem.h"
+
+#ifndef G3D_WINDOWS
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+namespace G3D {
+
+MemoryMappedFile::MemoryMappedFile(const String& filename) :
+    m_filename(filename),
+    m_data(nullptr),
+    m_size(0),
+#   ifdef G3D_WINDOWS
+        m_file(INVALID_HANDLE_VALUE),
+        m_mapping(nullptr)
+#   else
+        m_file(-1)
+#   endif
+    {
+}
+
+
+shared_ptr<MemoryMappedFile> MemoryMappedFile::create(const String& filename, AccessPattern pattern) {
+    if (FileSystem::inZipfile(filename)) {
+        return nullptr;
+    }
+
+    const shared_ptr<MemoryMappedFile>& file = createShared<MemoryMappedFile>(filename);
+    if (! file->map(pattern)) {
+        return nullptr;
+    }
+    return file;
+}
+
+
+#ifdef G3D_WINDOWS
+
+bool MemoryMappedFile::map(AccessPattern pattern) {
+    const DWORD flags = (pattern == SEQUENTIAL) ? FILE_FLAG_SEQUENTIAL_SCAN : (pattern == RANDOM) ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+    m_file = CreateFileA(m_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (! GetFileSizeEx(m_file, &size)) {
+        return false;
+    }
+    m_size = size_t(size.QuadPart);
+    if (m_size == 0) {
+        // Windows cannot map an empty file
+        return true;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (isNull(m_mapping)) {
+        return false;
+    }
+
+    m_data = static_cast<const uint8*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    return notNull(m_data);
+}
+
+
+MemoryMappedFile::~MemoryMappedFile() {
+    if (notNull(m_data)) {
+        UnmapViewOfFile(m_data);
+    }
+    if (notNull(m_mapping)) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+    }
+}
+
+
+void MemoryMappedFile::prefetch(size_t offset, size_t numBytes) const {
+    if (offset >= m_size) {
+        return;
+    }
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = const_cast<uint8*>(m_data + offset);
+    range.NumberOfBytes  = G3D::min(numBytes, m_size - offset);
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MemoryMappedFile::map(AccessPattern pattern) {
+    m_file = ::open(m_filename.c_str(), O_RDONLY);
+    if (m_file < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if ((fstat(m_file, &info) != 0) || ! S_ISREG(info.st_mode)) {
+        return false;
+    }
+    m_size = size_t(info.st_size);
+    if (m_size == 0) {
+        // mmap rejects empty mappings
+        return true;
+    }
+
+    void* ptr = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+    if (ptr == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const uint8*>(ptr);
+
+    if (pattern != NORMAL) {
+        madvise(ptr, m_size, (pattern == SEQUENTIAL) ? MADV_SEQUENTIAL : MADV_RANDOM);
+    }
+    return true;
+}
+
+
+MemoryMappedFile::~MemoryMappedFile() {
+    if (notNull(m_data)) {
+        munmap(const_cast<uint8*>(m_data), m_size);
+    }
+    if (m_file >= 0) {
+        ::close(m_file);
+    }
+}
+
+
+void MemoryMappedFile::prefetch(size_t offset, size_t numBytes) const {
+    if (offset >= m_size) {
+        return;
+    }
+
+    // madvise requires a page-aligned start
+    static const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+    const size_t start = offset - (offset % pageSize);
+    const size_t end   = G3D::min(offset + numBytes, m_size);
+    madvise(const_cast<uint8*>(m_data + start), end - start, MADV_WILLNEED);
+}
+
+#endif
+
+} // namespace G3D
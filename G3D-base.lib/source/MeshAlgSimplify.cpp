@@ -0,0 +1,467 @@
+/**
+  \file G3D-base.lib/source/MeshAlgSimplify.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+
+#include "G3D-base/MeshAlg.h"
+#include "G3D-base/Table.h"
+#include <algorithm>
+
+namespace G3D {
+
+namespace _internal {
+
+/** Sum of weighted squared distances to a set of planes, stored as a symmetric 4x4 matrix.
+    Double precision because the terms cancel heavily for points near the planes. */
+class SimplifyQuadric {
+public:
+    double      a2 = 0, ab = 0, ac = 0, ad = 0;
+    double      b2 = 0, bc = 0, bd = 0;
+    double      c2 = 0, cd = 0;
+    double      d2 = 0;
+    double      weight = 0;
+
+    SimplifyQuadric() {}
+
+    /** The plane through \a point with unit \a normal */
+    SimplifyQuadric(const Vector3& normal, const Point3& point, double w) : weight(w) {
+        const double a = normal.x, b = normal.y, c = normal.z;
+        const double d = -(a * point.x + b * point.y + c * point.z);
+        a2 = w * a * a; ab = w * a * b; ac = w * a * c; ad = w * a * d;
+        b2 = w * b * b; bc = w * b * c; bd = w * b * d;
+        c2 = w * c * c; cd = w * c * d;
+        d2 = w * d * d;
+    }
+
+    SimplifyQuadric& operator+=(const SimplifyQuadric& q) {
+        a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+        b2 += q.b2; bc += q.bc; bd += q.bd;
+        c2 += q.c2; cd += q.cd;
+        d2 += q.d2;
+        weight += q.weight;
+        return *this;
+    }
+
+    /** Weighted mean squared distance from \a point to the planes */
+    double error(const Point3& point) const {
+        if (weight <= 0.0) {
+            return 0.0;
+        }
+        const double x = point.x, y = point.y, z = point.z;
+        const double e =
+            a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+            2.0 * (ab * x * y + ac * x * z + bc * y * z + ad * x + bd * y + cd * z);
+        return max(e, 0.0) / weight;
+    }
+};
+
+
+/** Half-edge collapse simplification for MeshAlg::simplify.
+
+    Colocated vertices ("wedges") share a position ID. Collapses move a position onto an
+    adjacent one and remap each wedge to the wedge it meets in the triangles that degenerate,
+    so every surviving corner still references an original vertex.
+
+    Each pass classifies positions from the current triangles, sorts the candidate collapses
+    by cost, and applies an independent set of the cheapest ones. */
+class Simplifier {
+public:
+
+    enum Kind {MANIFOLD, BORDER, SEAM, LOCKED};
+
+    /** Boundary planes are weighted above surface planes so that silhouettes and seams hold their shape */
+    static constexpr double BOUNDARY_WEIGHT = 10.0;
+
+    class HalfEdge {
+    public:
+        /** Position IDs, lo < hi */
+        int         lo;
+        int         hi;
+        int         triangle;
+        /** The edge runs from this corner to the next one in the triangle */
+        int         corner;
+
+        bool operator<(const HalfEdge& other) const {
+            return (lo < other.lo) || ((lo == other.lo) && (hi < other.hi));
+        }
+    };
+
+    class Collapse {
+    public:
+        int         from;
+        int         to;
+        double      cost;
+
+        bool operator<(const Collapse& other) const {
+            return cost < other.cost;
+        }
+    };
+
+    const Array<Vector3>&       vertexArray;
+    Array<int>&                 index;
+
+    /** Colocated vertices share a position ID */
+    Array<int>                  positionID;
+    Array<Point3>               position;
+    Array<SimplifyQuadric>      quadric;
+
+    /** Triangles adjacent to each position as of the start of the current pass,
+        as rows of triangleList starting at triangleStart[p] */
+    Array<int>                  triangleStart;
+    Array<int>                  triangleList;
+
+    Array<uint8>                kind;
+    Array<bool>                 touched;
+    Array<HalfEdge>             halfEdgeArray;
+    Array<Collapse>             collapseArray;
+
+    Simplifier(const Array<Vector3>& vertices, Array<int>& indices) : vertexArray(vertices), index(indices) {
+        Table<Vector3, int> positionTable;
+        positionID.resize(vertexArray.size());
+        for (int v = 0; v < vertexArray.size(); ++v) {
+            bool created = false;
+            int& p = positionTable.getCreate(vertexArray[v], created);
+            if (created) {
+                p = position.size();
+                position.append(vertexArray[v]);
+            }
+            positionID[v] = p;
+        }
+    }
+
+    int pos(int t, int k) const {
+        return positionID[index[3 * t + k]];
+    }
+
+    int numTriangles() const {
+        return index.size() / 3;
+    }
+
+    /** False for triangles that have degenerated during the current pass */
+    bool live(int t) const {
+        const int i0 = index[3 * t], i1 = index[3 * t + 1], i2 = index[3 * t + 2];
+        return (i0 != i1) && (i1 != i2) && (i0 != i2);
+    }
+
+    /** Returns the corner of triangle \a t at position \a p, or -1 */
+    int cornerOf(int t, int p) const {
+        for (int k = 0; k < 3; ++k) {
+            if (pos(t, k) == p) {
+                return k;
+            }
+        }
+        return -1;
+    }
+
+    /** Removes triangles with fewer than three distinct positions */
+    void removeDegenerateTriangles() {
+        int n = 0;
+        for (int t = 0; t < numTriangles(); ++t) {
+            const int p0 = pos(t, 0), p1 = pos(t, 1), p2 = pos(t, 2);
+            if ((p0 != p1) && (p1 != p2) && (p0 != p2)) {
+                for (int k = 0; k < 3; ++k) {
+                    index[3 * n + k] = index[3 * t + k];
+                }
+                ++n;
+            }
+        }
+        index.resize(3 * n, false);
+    }
+
+    /** Face planes, plus planes perpendicular to the faces along boundary and seam edges */
+    void computeQuadrics() {
+        quadric.resize(position.size());
+
+        Array<Vector3> faceNormal;
+        faceNormal.resize(numTriangles());
+        for (int t = 0; t < numTriangles(); ++t) {
+            const Point3& p0 = position[pos(t, 0)];
+            const Vector3& n = (position[pos(t, 1)] - p0).cross(position[pos(t, 2)] - p0);
+            const float length = n.length();
+            faceNormal[t] = (length > 0.0f) ? n / length : Vector3::zero();
+            if (length > 0.0f) {
+                const SimplifyQuadric q(faceNormal[t], p0, 0.5 * length);
+                for (int k = 0; k < 3; ++k) {
+                    quadric[pos(t, k)] += q;
+                }
+            }
+        }
+
+        // Colocated vertices are separate in the adjacency, so seams appear as boundaries too
+        Array<MeshAlg::Face>    faceArray;
+        Array<MeshAlg::Edge>    edgeArray;
+        Array<MeshAlg::Vertex>  adjacentArray;
+        MeshAlg::computeAdjacency(vertexArray, index, faceArray, edgeArray, adjacentArray);
+        for (const MeshAlg::Edge& edge : edgeArray) {
+            if (! edge.boundary()) {
+                continue;
+            }
+            const int f = (edge.faceIndex[0] != MeshAlg::Face::NONE) ? edge.faceIndex[0] : edge.faceIndex[1];
+            const Point3& a = vertexArray[edge.vertexIndex[0]];
+            const Vector3& along = vertexArray[edge.vertexIndex[1]] - a;
+            const Vector3& n = along.cross(faceNormal[f]).directionOrZero();
+            if (! n.isZero()) {
+                const SimplifyQuadric q(n, a, BOUNDARY_WEIGHT * along.squaredLength());
+                quadric[positionID[edge.vertexIndex[0]]] += q;
+                quadric[positionID[edge.vertexIndex[1]]] += q;
+            }
+        }
+    }
+
+    void buildTriangleLists() {
+        triangleStart.resize(position.size() + 1);
+        triangleStart.setAll(0);
+        for (int i = 0; i < index.size(); ++i) {
+            ++triangleStart[positionID[index[i]] + 1];
+        }
+        for (int p = 0; p < position.size(); ++p) {
+            triangleStart[p + 1] += triangleStart[p];
+        }
+        triangleList.resize(index.size());
+        Array<int> next(triangleStart);
+        for (int i = 0; i < index.size(); ++i) {
+            triangleList[next[positionID[index[i]]]++] = i / 3;
+        }
+    }
+
+    bool canMove(int from, Kind edgeKind) const {
+        switch (kind[from]) {
+        case MANIFOLD:
+            return true;
+        case BORDER:
+        case SEAM:
+            return kind[from] == edgeKind;
+        default:
+            return false;
+        }
+    }
+
+    /** Classifies positions and edges from the current triangles and fills collapseArray */
+    void findCandidates() {
+        halfEdgeArray.fastClear();
+        for (int t = 0; t < numTriangles(); ++t) {
+            for (int k = 0; k < 3; ++k) {
+                const int a = pos(t, k), b = pos(t, (k + 1) % 3);
+                halfEdgeArray.append(HalfEdge{min(a, b), max(a, b), t, k});
+            }
+        }
+        std::sort(halfEdgeArray.begin(), halfEdgeArray.end());
+
+        // Classify each position by the boundary and seam edges that touch it
+        Array<int> borderCount, seamCount;
+        borderCount.resize(position.size());
+        seamCount.resize(position.size());
+        borderCount.setAll(0);
+        seamCount.setAll(0);
+        kind.resize(position.size());
+        kind.setAll(MANIFOLD);
+
+        Array<uint8> edgeKind;
+        edgeKind.resize(halfEdgeArray.size());
+        for (int first = 0, last = 0; first < halfEdgeArray.size(); first = last) {
+            const HalfEdge& e = halfEdgeArray[first];
+            for (last = first + 1; (last < halfEdgeArray.size()) && ! (e < halfEdgeArray[last]); ++last) {}
+
+            Kind k = MANIFOLD;
+            if (last - first == 1) {
+                k = BORDER;
+                ++borderCount[e.lo];
+                ++borderCount[e.hi];
+            } else if (last - first == 2) {
+                const HalfEdge& f = halfEdgeArray[first + 1];
+                if (pos(e.triangle, e.corner) == pos(f.triangle, f.corner)) {
+                    // Inconsistent winding
+                    k = LOCKED;
+                } else if ((index[3 * e.triangle + e.corner] != index[3 * f.triangle + (f.corner + 1) % 3]) ||
+                           (index[3 * f.triangle + f.corner] != index[3 * e.triangle + (e.corner + 1) % 3])) {
+                    k = SEAM;
+                    ++seamCount[e.lo];
+                    ++seamCount[e.hi];
+                }
+            } else {
+                // Nonmanifold
+                k = LOCKED;
+            }
+
+            if (k == LOCKED) {
+                kind[e.lo] = kind[e.hi] = LOCKED;
+            }
+            edgeKind[first] = k;
+        }
+
+        for (int p = 0; p < position.size(); ++p) {
+            if (kind[p] != LOCKED) {
+                if ((borderCount[p] == 0) && (seamCount[p] == 0)) {
+                    kind[p] = MANIFOLD;
+                } else if ((borderCount[p] == 2) && (seamCount[p] == 0)) {
+                    kind[p] = BORDER;
+                } else if ((borderCount[p] == 0) && (seamCount[p] == 2)) {
+                    kind[p] = SEAM;
+                } else {
+                    kind[p] = LOCKED;
+                }
+            }
+        }
+
+        collapseArray.fastClear();
+        for (int first = 0, last = 0; first < halfEdgeArray.size(); first = last) {
+            const HalfEdge& e = halfEdgeArray[first];
+            for (last = first + 1; (last < halfEdgeArray.size()) && ! (e < halfEdgeArray[last]); ++last) {}
+
+            const Kind k = Kind(edgeKind[first]);
+            const double loCost = canMove(e.lo, k) ? quadric[e.lo].error(position[e.hi]) : finf();
+            const double hiCost = canMove(e.hi, k) ? quadric[e.hi].error(position[e.lo]) : finf();
+            if (loCost <= hiCost) {
+                if (loCost < finf()) {
+                    collapseArray.append(Collapse{e.lo, e.hi, loCost});
+                }
+            } else {
+                collapseArray.append(Collapse{e.hi, e.lo, hiCost});
+            }
+        }
+        std::sort(collapseArray.begin(), collapseArray.end());
+    }
+
+    /** Moves position \a u onto position \a v if that keeps every wedge of \a u mapped to a wedge of \a v and
+        flips no triangle. Returns the number of triangles removed, or -1 if the collapse was rejected. */
+    int tryCollapse(int u, int v) {
+        // Triangles containing both u and v degenerate; their corners define the wedge mapping
+        SmallArray<int, 4> fromWedge, toWedge;
+        const auto mapping = [&](int wedge) {
+            for (int j = 0; j < fromWedge.size(); ++j) {
+                if (fromWedge[j] == wedge) {
+                    return j;
+                }
+            }
+            return -1;
+        };
+
+        for (int i = triangleStart[u]; i < triangleStart[u + 1]; ++i) {
+            const int t = triangleList[i];
+            const int kv = live(t) ? cornerOf(t, v) : -1;
+            if (kv >= 0) {
+                const int wu = index[3 * t + cornerOf(t, u)];
+                const int wv = index[3 * t + kv];
+                const int j = mapping(wu);
+                if (j == -1) {
+                    fromWedge.append(wu);
+                    toWedge.append(wv);
+                } else if (toWedge[j] != wv) {
+                    return -1;
+                }
+            }
+        }
+
+        const Point3& target = position[v];
+        for (int i = triangleStart[u]; i < triangleStart[u + 1]; ++i) {
+            const int t = triangleList[i];
+            if (! live(t) || (cornerOf(t, v) >= 0)) {
+                continue;
+            }
+            const int ku = cornerOf(t, u);
+            if (mapping(index[3 * t + ku]) == -1) {
+                // This wedge does not meet v, so moving it would tear its attributes
+                return -1;
+            }
+
+            const Point3& p1 = position[pos(t, (ku + 1) % 3)];
+            const Point3& p2 = position[pos(t, (ku + 2) % 3)];
+            const Vector3& before = (p1 - position[u]).cross(p2 - position[u]);
+            const Vector3& after  = (p1 - target).cross(p2 - target);
+            if (before.dot(after) <= 0.0f) {
+                return -1;
+            }
+        }
+
+        int removed = 0;
+        for (int i = triangleStart[u]; i < triangleStart[u + 1]; ++i) {
+            const int t = triangleList[i];
+            if (live(t)) {
+                const int ku = cornerOf(t, u);
+                if (cornerOf(t, v) >= 0) {
+                    ++removed;
+                }
+                int& w = index[3 * t + ku];
+                w = toWedge[mapping(w)];
+            }
+        }
+        quadric[v] += quadric[u];
+        return removed;
+    }
+
+    /** Returns the largest squared error of an applied collapse */
+    double run(int targetTriangleCount, double maxErrorSquared) {
+        removeDegenerateTriangles();
+        computeQuadrics();
+
+        double resultError = 0.0;
+        int remaining = numTriangles();
+        while (remaining > targetTriangleCount) {
+            buildTriangleLists();
+            findCandidates();
+            if (collapseArray.size() == 0) {
+                break;
+            }
+
+            // Each collapse removes about two triangles. Collapses far more expensive than the
+            // ones needed to reach the target wait for the next pass, when cheaper ones may appear.
+            const int goal = min(collapseArray.size(), max(1, (remaining - targetTriangleCount + 1) / 2));
+            const double passLimit = min(maxErrorSquared, collapseArray[goal - 1].cost * 1.5);
+
+            touched.resize(position.size());
+            touched.setAll(false);
+            int numCollapses = 0;
+            for (const Collapse& c : collapseArray) {
+                if ((c.cost > passLimit) || (remaining <= targetTriangleCount)) {
+                    break;
+                }
+                if (touched[c.from] || touched[c.to]) {
+                    continue;
+                }
+                const int removed = tryCollapse(c.from, c.to);
+                if (removed >= 0) {
+                    touched[c.from] = touched[c.to] = true;
+                    remaining -= removed;
+                    resultError = max(resultError, c.cost);
+                    ++numCollapses;
+                }
+            }
+
+            removeDegenerateTriangles();
+            remaining = numTriangles();
+            if (numCollapses == 0) {
+                break;
+            }
+        }
+
+        return resultError;
+    }
+};
+
+} // namespace _internal
+
+
+float MeshAlg::simplify
+   (const Array<Vector3>&   vertexArray,
+    const Array<int>&       indexArray,
+    Array<int>&             simplifiedIndexArray,
+    int                     targetTriangleCount,
+    float                   maxError) {
+
+    debugAssertM(&indexArray != &simplifiedIndexArray, "MeshAlg::simplify cannot operate in place");
+    debugAssertM(indexArray.size() % 3 == 0, "MeshAlg::simplify requires a triangle list");
+
+    simplifiedIndexArray = indexArray;
+    if (indexArray.size() / 3 <= targetTriangleCount) {
+        return 0.0f;
+    }
+
+    _internal::Simplifier simplifier(vertexArray, simplifiedIndexArray);
+    return float(sqrt(simplifier.run(max(targetTriangleCount, 0), square(double(maxError)))));
+}
+
+} // namespace G3D
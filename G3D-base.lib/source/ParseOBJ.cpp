@@ -9,11 +9,82 @@
 #include "G3D-base/ParseOBJ.h"
 #include "G3D-base/BinaryInput.h"
 #include "G3D-base/FileSystem.h"
+#include "G3D-base/MemoryMappedFile.h"
 #include "G3D-base/stringutils.h"
 #include "G3D-base/TextInput.h"
+#include "G3D-base/Thread.h"
+#include <algorithm>
+#include <thread>
 
 namespace G3D {
 
+class ParseOBJ::Chunk {
+public:
+
+    /** A GROUP, USEMTL, or MTLLIB command that precedes face number firstFace */
+    class Event {
+    public:
+        Command         command;
+        String          name;
+        int             firstFace;
+
+        Event() : command(UNKNOWN), firstFace(0) {}
+        Event(Command command, const String& name, int firstFace) : command(command), name(name), firstFace(firstFace) {}
+    };
+
+    enum {VERTEX_BIT = 1, TEXCOORD_BIT = 2, NORMAL_BIT = 4};
+
+    /** A face corner with relative indices, which are relative to the start of the chunk
+        until the number of elements in the preceding chunks is known */
+    class Fixup {
+    public:
+        int             face;
+        int             corner;
+        int             attributes;
+
+        Fixup() : face(0), corner(0), attributes(0) {}
+        Fixup(int face, int corner, int attributes) : face(face), corner(corner), attributes(attributes) {}
+    };
+
+    /** Offset of the chunk in the input */
+    size_t              offset;
+    const char*         begin;
+    size_t              size;
+
+    /** Storage for a final line that lacks a newline */
+    String              copy;
+
+    /** Holds the vertex attributes */
+    ParseOBJ            parser;
+    Array<Face>         faceArray;
+    Array<Event>        eventArray;
+    Array<Fixup>        fixupArray;
+
+    bool                failed;
+    ParseError          error;
+
+    Chunk() : offset(0), begin(nullptr), size(0), failed(false) {}
+
+    void parse(const String& filename, const Options& options) {
+        parser.m_chunk = this;
+        parser.m_filename = filename;
+        parser.m_objOptions = options;
+        parser.nextCharacter = begin;
+        parser.remainingCharacters = int(size);
+        parser.m_line = 1;
+        try {
+            while (parser.remainingCharacters > 0) {
+                parser.maybeReadWhitespace();
+                parser.processCommand(parser.readCommand());
+            }
+        } catch (const ParseError& e) {
+            failed = true;
+            error = e;
+        }
+    }
+};
+
+
 ParseOBJ::Options::Options(const Any& a) {
     *this = Options();
     a.verifyName("OBJOptions");
@@ -52,7 +123,7 @@ Any ParseOBJ::Options::toAny() const {
 }
 
 
-void ParseOBJ::parse(const char* ptr, size_t len, const String& basePath, const Options& options) {
+void ParseOBJ::reset(const String& basePath, const Options& options) {
     vertexArray.clear();
     normalArray.clear();
     texCoord0Array.clear();
@@ -66,6 +137,11 @@ void ParseOBJ::parse(const char* ptr, size_t len, const String& basePath, const
 
     m_basePath = basePath;
     m_objOptions = options;
+}
+
+
+void ParseOBJ::parse(const char* ptr, size_t len, const String& basePath, const Options& options) {
+    reset(basePath, options);
 
     // Guess the vertex count based on number of characters; intentionally underestimate to avoid overallocation on low RAM machines
     // Assume 50 char/line, 2/3 of lines for v, vt, and vc
@@ -112,6 +188,153 @@ void ParseOBJ::parse(BinaryInput& bi, const ParseOBJ::Options& options, const St
 }
 
 
+/** Index of the first character of the line after the one containing ptr[i] */
+static size_t nextLineStart(const char* ptr, size_t len, size_t i) {
+    while ((i < len) && (ptr[i] != '\n') && (ptr[i] != '\r')) {
+        ++i;
+    }
+    if (i < len) {
+        // Keep two-character newlines together
+        const char c = ptr[i];
+        ++i;
+        if ((i < len) && (ptr[i] != c) && ((ptr[i] == '\n') || (ptr[i] == '\r'))) {
+            ++i;
+        }
+    }
+    return i;
+}
+
+
+/** Appends src[begin, end) to dst */
+static void appendFaces(Array<ParseOBJ::Face>& dst, Array<ParseOBJ::Face>& src, int begin, int end) {
+    if ((dst.size() == 0) && (begin == 0) && (end == src.size())) {
+        Array<ParseOBJ::Face>::swap(dst, src);
+        return;
+    }
+
+    const int offset = dst.size() - begin;
+    dst.resize(dst.size() + end - begin, false);
+
+    static const int blockSize = 16 * 1024;
+    runConcurrently(0, (end - begin + blockSize - 1) / blockSize, [&](int block) {
+        const int blockEnd = G3D::min(begin + (block + 1) * blockSize, end);
+        for (int f = begin + block * blockSize; f < blockEnd; ++f) {
+            dst[f + offset] = src[f];
+        }
+    });
+}
+
+
+void ParseOBJ::parseParallel(const char* ptr, size_t len, const String& basePath, const Options& options, size_t chunkBytes) {
+    reset(basePath, options);
+
+    // The readers look one character past the end of a token, which could fault past the end of 
+    // a memory-mapped file. Parse the final line from a copy if it does not end in a newline.
+    size_t mainLength = len;
+    while ((mainLength > 0) && (ptr[mainLength - 1] != '\n') && (ptr[mainLength - 1] != '\r')) {
+        --mainLength;
+    }
+
+    // Parse a few chunks per thread at a time, so that the chunks waiting to be
+    // appended occupy little memory
+    const int waveSize = 2 * G3D::max(1, int(std::thread::hardware_concurrency()));
+    chunkBytes = G3D::max(chunkBytes, size_t(1));
+
+    Array<shared_ptr<Chunk>> wave;
+    size_t start = 0;
+    bool reserved = false;
+    while (start < len) {
+        wave.fastClear();
+        while ((wave.size() < waveSize) && (start < len)) {
+            const shared_ptr<Chunk>& chunk = std::make_shared<Chunk>();
+            chunk->offset = start;
+            if (start < mainLength) {
+                const size_t end = (start + chunkBytes >= mainLength) ? mainLength : nextLineStart(ptr, mainLength, start + chunkBytes);
+                chunk->begin = ptr + start;
+                chunk->size  = end - start;
+            } else {
+                chunk->copy  = String(ptr + start, len - start) + "\n";
+                chunk->begin = chunk->copy.c_str();
+                chunk->size  = chunk->copy.size();
+            }
+            start = G3D::min(chunk->offset + chunk->size, len);
+            wave.append(chunk);
+        }
+
+        runConcurrently(0, wave.size(), [&](int c) {
+            wave[c]->parse(m_filename, m_objOptions);
+        });
+
+        // Append the chunks in order
+        for (const shared_ptr<Chunk>& chunk : wave) {
+            if (chunk->failed) {
+                // Report the line within the whole input
+                ParseError e = chunk->error;
+                if (e.line != ParseError::UNKNOWN) {
+                    e.line += int(std::count(ptr, ptr + chunk->offset, '\n'));
+                }
+                throw e;
+            }
+
+            ParseOBJ& parser = chunk->parser;
+            const int vertexBase   = vertexArray.size();
+            const int texCoordBase = texCoord0Array.size();
+            const int normalBase   = normalArray.size();
+            for (const Chunk::Fixup& fixup : chunk->fixupArray) {
+                Index& index = chunk->faceArray[fixup.face][fixup.corner];
+                if (fixup.attributes & Chunk::VERTEX_BIT)   { index.vertex   += vertexBase; }
+                if (fixup.attributes & Chunk::TEXCOORD_BIT) { index.texCoord += texCoordBase; }
+                if (fixup.attributes & Chunk::NORMAL_BIT)   { index.normal   += normalBase; }
+            }
+
+            vertexArray.append(parser.vertexArray);
+            normalArray.append(parser.normalArray);
+            texCoord0Array.append(parser.texCoord0Array);
+            texCoord1Array.append(parser.texCoord1Array);
+
+            // Replay the state changes between runs of faces
+            int face = 0;
+            for (int e = 0; e <= chunk->eventArray.size(); ++e) {
+                const int runEnd = (e < chunk->eventArray.size()) ? chunk->eventArray[e].firstFace : chunk->faceArray.size();
+                if (runEnd > face) {
+                    ensureCurrentMesh();
+                    appendFaces(m_currentMesh->faceArray, chunk->faceArray, face, runEnd);
+                    face = runEnd;
+                }
+                if (e < chunk->eventArray.size()) {
+                    processStateCommand(chunk->eventArray[e].command, chunk->eventArray[e].name);
+                }
+            }
+        }
+
+        if (! reserved && (start < len)) {
+            // Extrapolate from the first chunks to avoid repeatedly growing the arrays
+            reserved = true;
+            const double scale = 1.05 * double(len) / double(start);
+            vertexArray.reserve(iCeil(vertexArray.size() * scale));
+            normalArray.reserve(iCeil(normalArray.size() * scale));
+            texCoord0Array.reserve(iCeil(texCoord0Array.size() * scale));
+            texCoord1Array.reserve(iCeil(texCoord1Array.size() * scale));
+        }
+    }
+}
+
+
+void ParseOBJ::parseFile(const String& filename, const Options& options, const String& basePath) {
+    m_filename = filename;
+    const String& resolved = FileSystem::resolve(filename);
+    const String& bp = (basePath == "<AUTO>") ? FilePath::parent(resolved) : basePath;
+
+    const shared_ptr<MemoryMappedFile>& file = MemoryMappedFile::create(resolved, MemoryMappedFile::SEQUENTIAL);
+    if (notNull(file)) {
+        parseParallel(reinterpret_cast<const char*>(file->data()), file->size(), bp, options);
+    } else {
+        BinaryInput bi(filename, G3D_LITTLE_ENDIAN);
+        parseParallel(reinterpret_cast<const char*>(bi.getCArray()), size_t(bi.getLength()), bp, options);
+    }
+}
+
+
 shared_ptr<ParseMTL::Material> ParseOBJ::getMaterial(const String& materialName) {
     bool created = false;
     shared_ptr<ParseMTL::Material>& m =
@@ -255,7 +478,7 @@ ParseOBJ::Command ParseOBJ::readCommand() {
 }
 
 
-void ParseOBJ::readFace() {
+void ParseOBJ::ensureCurrentMesh() {
     // Ensure that we have a material
     if (isNull(m_currentMaterial)) {
         m_currentMaterial = m_currentMaterialLibrary.materialTable["default"];
@@ -283,8 +506,16 @@ void ParseOBJ::readFace() {
         }
         m_currentMesh = m;
     }
+}
+
 
-    Face& face = m_currentMesh->faceArray.next();
+void ParseOBJ::readFace() {
+    // The group, material, and mesh of faces in a chunk are assigned when the chunks are stitched
+    const int faceNumber = notNull(m_chunk) ? m_chunk->faceArray.size() : 0;
+    if (isNull(m_chunk)) {
+        ensureCurrentMesh();
+    }
+    Face& face = notNull(m_chunk) ? m_chunk->faceArray.next() : m_currentMesh->faceArray.next();
 
     const int vertexArraySize   = vertexArray.size();
     const int texCoordArraySize = texCoord0Array.size();
@@ -294,6 +525,7 @@ void ParseOBJ::readFace() {
     bool done = maybeReadWhitespace();
     while (! done) {
         Index& index = face.next();
+        int relative = 0;
 
         // Read index
         index.vertex = readInt();
@@ -304,6 +536,7 @@ void ParseOBJ::readFace() {
             // Negative; make relative to the current end of the array.
             // -1 will be the last element, so just add the size of the array.
             index.vertex += vertexArraySize;
+            relative |= Chunk::VERTEX_BIT;
         }
 
         if ((remainingCharacters > 0) && (*nextCharacter == '/')) {
@@ -322,6 +555,7 @@ void ParseOBJ::readFace() {
                         // of the array.  -1 will be the last element,
                         // so just add the size of the array.
                         index.texCoord += texCoordArraySize;
+                        relative |= Chunk::TEXCOORD_BIT;
                     }
                 }
 
@@ -340,11 +574,16 @@ void ParseOBJ::readFace() {
                         // element, so just add the size of the
                         // array.
                         index.normal += normalArraySize;
+                        relative |= Chunk::NORMAL_BIT;
                     }       
                 }
             }
         }
 
+        if (notNull(m_chunk) && (relative != 0)) {
+            m_chunk->fixupArray.append(Chunk::Fixup(faceNumber, face.size() - 1, relative));
+        }
+
         // Read remaining whitespace
         done = maybeReadWhitespace();
     }
@@ -390,55 +629,65 @@ void ParseOBJ::processCommand(const Command command) {
         break;
 
     case GROUP:
+    case USEMTL:
+    case MTLLIB:
         {
-            // Change group
-            const String& groupName = readName();
+            const String& name = readName();
+            if (notNull(m_chunk)) {
+                // Applied in order when the chunks are stitched
+                m_chunk->eventArray.append(Chunk::Event(command, name, m_chunk->faceArray.size()));
+            } else {
+                processStateCommand(command, name);
+            }
+        }
+        // Consume anything else on this line
+        readUntilNewline();
+        break;
+
+    case UNKNOWN:
+        // Nothing to do
+        readUntilNewline();
+        break;
+    }
+}
 
-            shared_ptr<Group>& g = groupTable.getCreate(groupName);
+
+void ParseOBJ::processStateCommand(const Command command, const String& name) {
+    switch (command) {
+    case GROUP:
+        {
+            // Change group
+            shared_ptr<Group>& g = groupTable.getCreate(name);
 
             if (isNull(g)) {
                 // Newly created
                 g = Group::create();
-                g->name = groupName;
+                g->name = name;
             }
 
             m_currentGroup = g;
         }
-        // Consume anything else on this line
-        readUntilNewline();
         break;
 
     case USEMTL:
-        {
-            // Change the mesh within the group
-            const String& materialName = readName();
-            m_currentMaterial = getMaterial(materialName);
+        // Change the mesh within the group
+        m_currentMaterial = getMaterial(name);
 
-            // Force re-obtaining or creating of the appropriate mesh
-            m_currentMesh.reset();
-        }
-        // Consume anything else on this line
-        readUntilNewline();
+        // Force re-obtaining or creating of the appropriate mesh
+        m_currentMesh.reset();
         break;
 
     case MTLLIB:
         {
             // Specify material library 
-            String mtlFilename = readName();
-            mtlArray.append(mtlFilename);
-            mtlFilename = FilePath::concat(m_basePath, mtlFilename);
-
-            TextInput ti2(mtlFilename);
+            mtlArray.append(name);
+            TextInput ti2(FilePath::concat(m_basePath, name));
             m_currentMaterialLibrary.parse(ti2, "<AUTO>", m_objOptions.materialOptions);
         }
-        // Consume anything else on this line
-        readUntilNewline();
         break;
 
-    case UNKNOWN:
-        // Nothing to do
-        readUntilNewline();
-        break;
+    default:
+        debugAssertM(false, "Not a state command");
     }
 }
 
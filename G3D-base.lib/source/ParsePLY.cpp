@@ -11,13 +11,296 @@
 #include "G3D-base/FileSystem.h"
 #include "G3D-base/stringutils.h"
 #include "G3D-base/ParseError.h"
+#include "G3D-base/MemoryMappedFile.h"
+#include "G3D-base/System.h"
+#include "G3D-base/Thread.h"
+#include <cstring>
+#ifdef G3D_X86
+#    include <emmintrin.h>
+#endif
 
 namespace G3D {
-    
+
+namespace _internal {
+
+/** Reads one property value from unaligned memory */
+typedef float (*PLYReadFunction)(const uint8* src);
+
+template<class T, bool swapBytes>
+static float readPLYValue(const uint8* src) {
+    T value;
+    if (swapBytes) {
+        uint8 b[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            b[i] = src[sizeof(T) - 1 - i];
+        }
+        memcpy(&value, b, sizeof(T));
+    } else {
+        memcpy(&value, src, sizeof(T));
+    }
+    return float(value);
+}
+
+
+template<bool swapBytes>
+static PLYReadFunction plyReadFunction(ParsePLY::DataType type) {
+    switch (type) {
+    case ParsePLY::char_type:   return &readPLYValue<int8, swapBytes>;
+    case ParsePLY::uchar_type:  return &readPLYValue<uint8, swapBytes>;
+    case ParsePLY::short_type:  return &readPLYValue<int16, swapBytes>;
+    case ParsePLY::ushort_type: return &readPLYValue<uint16, swapBytes>;
+    case ParsePLY::int_type:    return &readPLYValue<int32, swapBytes>;
+    case ParsePLY::uint_type:   return &readPLYValue<uint32, swapBytes>;
+    case ParsePLY::float_type:  return &readPLYValue<float32, swapBytes>;
+    case ParsePLY::double_type: return &readPLYValue<float64, swapBytes>;
+    default:                    return nullptr;
+    }
+}
+
+
+static int32 load32(const uint8* src) {
+    int32 value;
+    memcpy(&value, src, 4);
+    return value;
+}
+
+
+/** Copies three adjacent native-endian floats at byte \a offset of each record in [begin, end) */
+static void copyFloat3(const uint8* records, size_t stride, size_t offset, int begin, int end, Vector3* dst) {
+    int i = begin;
+#   ifdef G3D_X86
+        // Each 16-byte move also copies the four bytes after the vector, which the next iteration 
+        // overwrites, so the last element of the range is copied separately. The extra source bytes
+        // lie within the following record.
+        for (; i < end - 1; ++i) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(records + i * stride + offset)));
+        }
+#   endif
+    for (; i < end; ++i) {
+        memcpy(dst + i, records + i * stride + offset, sizeof(Vector3));
+    }
+}
+
+
+/** \brief The vertex record layout of a PLY file, compiled from its header so that type dispatch 
+    happens once per file instead of once per value. */
+class PLYVertexLayout {
+public:
+
+    const Array<ParsePLY::Property>& property;
+
+    /** Bytes per vertex, or zero if some property is a list and records vary in size */
+    size_t                  stride;
+
+    /** Byte offset of each property within a record. For variable-size records, this is
+        rewritten by measure() for each record. */
+    Array<size_t>           offset;
+
+    /** nullptr for list properties */
+    Array<PLYReadFunction>  read;
+
+    /** Reads the lengths of list properties */
+    Array<PLYReadFunction>  readListLength;
+
+    /** Property indices, -1 if absent */
+    int                     position[3];
+    int                     normal[3];
+    int                     color[4];
+
+    /** Maps each color channel to [0, 255] */
+    float                   colorScale[4];
+
+    /** x, y, z are adjacent native-endian floats in fixed-size records */
+    bool                    packedPosition;
+    bool                    packedNormal;
+
+    /** red, green, blue, and alpha if present, are adjacent uchars in fixed-size records */
+    bool                    packedColor;
+
+    PLYVertexLayout(const Array<ParsePLY::Property>& property, bool swapBytes) : property(property), stride(0) {
+        static const char* positionName[3] = {"x", "y", "z"};
+        static const char* normalName[3]   = {"nx", "ny", "nz"};
+        static const char* colorName[4][3] = {{"red", "r", "diffuse_red"}, {"green", "g", "diffuse_green"}, 
+                                               {"blue", "b", "diffuse_blue"}, {"alpha", "a", "diffuse_alpha"}};
+
+        bool fixedSize = true;
+        offset.resize(property.size());
+        read.resize(property.size());
+        readListLength.resize(property.size());
+        for (int p = 0; p < property.size(); ++p) {
+            const ParsePLY::Property& prop = property[p];
+            offset[p] = stride;
+            if (prop.type == ParsePLY::list_type) {
+                fixedSize = false;
+                read[p] = nullptr;
+                readListLength[p] = swapBytes ? plyReadFunction<true>(prop.listLengthType) : plyReadFunction<false>(prop.listLengthType);
+            } else {
+                stride += ParsePLY::byteSize(prop.type);
+                read[p] = swapBytes ? plyReadFunction<true>(prop.type) : plyReadFunction<false>(prop.type);
+                readListLength[p] = nullptr;
+            }
+        }
+        if (! fixedSize) {
+            stride = 0;
+        }
+
+        for (int a = 0; a < 3; ++a) {
+            position[a] = find(positionName[a]);
+            normal[a] = find(normalName[a]);
+        }
+        for (int c = 0; c < 4; ++c) {
+            color[c] = -1;
+            for (int n = 0; (n < 3) && (color[c] == -1); ++n) {
+                color[c] = find(colorName[c][n]);
+            }
+            colorScale[c] = 1.0f;
+            if (color[c] != -1) {
+                switch (property[color[c]].type) {
+                case ParsePLY::short_type:
+                case ParsePLY::ushort_type:
+                    colorScale[c] = 255.0f / 65535.0f;
+                    break;
+                case ParsePLY::float_type:
+                case ParsePLY::double_type:
+                    colorScale[c] = 255.0f;
+                    break;
+                default:;
+                }
+            }
+        }
+        if ((color[0] == -1) || (color[1] == -1) || (color[2] == -1)) {
+            color[0] = color[1] = color[2] = color[3] = -1;
+        }
+
+        packedPosition = (stride > 0) && ! swapBytes && adjacent(position, 3, ParsePLY::float_type);
+        packedNormal   = (stride > 0) && ! swapBytes && adjacent(normal, 3, ParsePLY::float_type);
+        packedColor    = (stride > 0) && adjacent(color, (color[3] == -1) ? 3 : 4, ParsePLY::uchar_type);
+    }
+
+    bool hasColor() const {
+        return color[0] != -1;
+    }
+
+    bool hasNormal() const {
+        return (normal[0] != -1) && (normal[1] != -1) && (normal[2] != -1);
+    }
+
+    /** Sets offset for the variable-size record at \a src and returns its size, or zero if
+        it extends past \a end */
+    size_t measure(const uint8* src, const uint8* end) {
+        size_t size = 0;
+        for (int p = 0; p < property.size(); ++p) {
+            offset[p] = size;
+            const ParsePLY::Property& prop = property[p];
+            if (prop.type == ParsePLY::list_type) {
+                const size_t lengthSize = ParsePLY::byteSize(prop.listLengthType);
+                if (size_t(end - src) < size + lengthSize) {
+                    return 0;
+                }
+                const int length = int(readListLength[p](src + size));
+                size += lengthSize + G3D::max(length, 0) * ParsePLY::byteSize(prop.listElementType);
+            } else {
+                size += ParsePLY::byteSize(prop.type);
+            }
+        }
+        return (size <= size_t(end - src)) ? size : 0;
+    }
+
+    /** Decodes the record at \a src, whose properties are at offset, into element \a i of \a chunk */
+    void decode(const uint8* src, int i, ParsePLY::VertexChunk& chunk) const {
+        Point3& P = chunk.position[i];
+        for (int a = 0; a < 3; ++a) {
+            P[a] = (position[a] == -1) ? 0.0f : value(src, position[a]);
+        }
+        if (hasNormal()) {
+            Vector3& N = chunk.normal[i];
+            for (int a = 0; a < 3; ++a) {
+                N[a] = value(src, normal[a]);
+            }
+        }
+        if (hasColor()) {
+            Color4unorm8& C = chunk.color[i];
+            for (int c = 0; c < 4; ++c) {
+                C[c] = unorm8::fromBits((color[c] == -1) ? 255 : uint8(iClamp(iRound(value(src, color[c]) * colorScale[c]), 0, 255)));
+            }
+        }
+    }
+
+    /** Decodes fixed-size records [begin, end) starting at \a records into the same elements of \a chunk */
+    void decodeFixed(const uint8* records, int begin, int end, ParsePLY::VertexChunk& chunk) const {
+        if (! (packedPosition && (! hasNormal() || packedNormal) && (! hasColor() || packedColor))) {
+            for (int i = begin; i < end; ++i) {
+                decode(records + i * stride, i, chunk);
+            }
+            return;
+        }
+
+        // Common layouts, such as float xyz followed by uchar rgb
+        copyFloat3(records, stride, offset[position[0]], begin, end, chunk.position.getCArray());
+
+        if (hasNormal()) {
+            copyFloat3(records, stride, offset[normal[0]], begin, end, chunk.normal.getCArray());
+        }
+
+        if (hasColor()) {
+            const bool hasAlpha = (color[3] != -1);
+            const uint8* src = records + offset[color[0]];
+            Color4unorm8* dst = chunk.color.getCArray();
+            int i = begin;
+#           ifdef G3D_X86
+                // Gather four colors as 32-bit words and force alpha to opaque if absent. Without 
+                // alpha, the fourth byte of each word lies within the following record.
+                const __m128i opaque = _mm_set1_epi32(hasAlpha ? 0 : int(0xFF000000));
+                for (; i + 4 < end; i += 4) {
+                    const uint8* s = src + i * stride;
+                    const __m128i v = _mm_set_epi32(load32(s + 3 * stride), load32(s + 2 * stride), load32(s + stride), load32(s));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(v, opaque));
+                }
+#           endif
+            for (; i < end; ++i) {
+                memcpy(dst + i, src + i * stride, hasAlpha ? 4 : 3);
+                if (! hasAlpha) {
+                    dst[i].a = unorm8::fromBits(255);
+                }
+            }
+        }
+    }
+
+private:
+
+    float value(const uint8* src, int p) const {
+        return read[p] ? read[p](src + offset[p]) : 0.0f;
+    }
+
+    int find(const char* name) const {
+        for (int p = 0; p < property.size(); ++p) {
+            if (property[p].name == name) {
+                return p;
+            }
+        }
+        return -1;
+    }
+
+    /** True if the properties \a index[0...n-1] are present, of \a type, and consecutive */
+    bool adjacent(const int* index, int n, ParsePLY::DataType type) const {
+        for (int i = 0; i < n; ++i) {
+            if ((index[i] == -1) || (property[index[i]].type != type) || ((i > 0) && (index[i] != index[0] + i))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace _internal
+
+
 ParsePLY::ParsePLY() : vertexData(nullptr), faceArray(nullptr), triStripArray(nullptr) {}
 
 
 void ParsePLY::clear() {
+    vertexProperty.fastClear();
+    faceOrTriStripProperty.fastClear();
     delete[] vertexData;
     vertexData = nullptr;
     delete[] faceArray;
@@ -33,23 +316,119 @@ ParsePLY::~ParsePLY() {
 }
 
 
-void ParsePLY::parse(BinaryInput& bi) {
+void ParsePLY::parse(BinaryInput& bi, bool readVertexData) {
     const G3DEndian oldEndian = bi.endian();
 
     clear();
     readHeader(bi);
 
-    vertexData = new float[numVertices * vertexProperty.size()];
     faceArray = new Face[numFaces];
     triStripArray = new TriStrip[numTriStrips];
 
-    readVertexList(bi);
+    if (readVertexData) {
+        vertexData = new float[size_t(numVertices) * vertexProperty.size()];
+        readVertexList(bi);
+    } else {
+        skipVertexList(bi);
+    }
     readFaceList(bi);
 
     bi.setEndian(oldEndian);
 }
 
 
+bool ParsePLY::isBinary(const uint8* data, size_t size) {
+    static const char* const header[] = {"ply\nformat binary_", "ply\r\nformat binary_"};
+    for (const char* h : header) {
+        const size_t len = strlen(h);
+        if ((size >= len) && (memcmp(data, h, len) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void ParsePLY::streamVertices(const String& filename, const VertexCallback& callback, int verticesPerChunk) {
+    const shared_ptr<MemoryMappedFile>& file = MemoryMappedFile::create(filename, MemoryMappedFile::SEQUENTIAL);
+    if (notNull(file)) {
+        streamVertices(file, callback, verticesPerChunk);
+    } else {
+        // Zipfile, or the file does not exist
+        BinaryInput bi(filename, G3D_LITTLE_ENDIAN);
+        streamVertices((bi.size() > 0) ? bi.getCArray() : nullptr, size_t(bi.size()), filename, nullptr, callback, verticesPerChunk);
+    }
+}
+
+
+void ParsePLY::streamVertices(const shared_ptr<MemoryMappedFile>& file, const VertexCallback& callback, int verticesPerChunk) {
+    streamVertices(file->data(), file->size(), file->filename(), file.get(), callback, verticesPerChunk);
+}
+
+
+void ParsePLY::streamVertices(const uint8* data, size_t size, const VertexCallback& callback, int verticesPerChunk) {
+    streamVertices(data, size, "<memory>", nullptr, callback, verticesPerChunk);
+}
+
+
+void ParsePLY::streamVertices(const uint8* data, size_t size, const String& filename, const MemoryMappedFile* file, const VertexCallback& callback, int verticesPerChunk) {
+    clear();
+
+    // Parse the header in place
+    BinaryInput bi(data, int64(size), G3D_LITTLE_ENDIAN, false, false);
+    try {
+        readHeader(bi);
+    } catch (ParseError& e) {
+        e.filename = filename;
+        throw;
+    }
+
+    _internal::PLYVertexLayout layout(vertexProperty, bi.endian() != System::machineEndian());
+    const size_t stride = layout.stride;
+    const uint8* const end = data + size;
+    const uint8* record = data + bi.getPosition();
+
+    if ((stride > 0) && (size_t(end - record) / stride < size_t(numVertices))) {
+        throw ParseError(filename, bi.getPosition(), "Vertex data is truncated");
+    }
+
+    VertexChunk chunk;
+    verticesPerChunk = G3D::max(verticesPerChunk, 1);
+    for (int first = 0; first < numVertices; first += verticesPerChunk) {
+        const int n = G3D::min(verticesPerChunk, numVertices - first);
+        chunk.firstVertex = first;
+        chunk.position.resize(n, false);
+        chunk.normal.resize(layout.hasNormal() ? n : 0, false);
+        chunk.color.resize(layout.hasColor() ? n : 0, false);
+
+        if (stride > 0) {
+            if (notNull(file)) {
+                // Read ahead to the next chunk while decoding this one
+                file->prefetch(size_t(record - data) + n * stride, size_t(verticesPerChunk) * stride);
+            }
+
+            static const int blockSize = 16 * 1024;
+            runConcurrently(0, (n + blockSize - 1) / blockSize, [&](int block) {
+                layout.decodeFixed(record, block * blockSize, G3D::min((block + 1) * blockSize, n), chunk);
+            });
+            record += n * stride;
+        } else {
+            // Records vary in size, so each must be measured before the next can be found
+            for (int i = 0; i < n; ++i) {
+                const size_t recordSize = layout.measure(record, end);
+                if (recordSize == 0) {
+                    throw ParseError(filename, int64(record - data), "Vertex data is truncated");
+                }
+                layout.decode(record, i, chunk);
+                record += recordSize;
+            }
+        }
+
+        callback(chunk);
+    }
+}
+
+
 ParsePLY::DataType ParsePLY::parseDataType(const char* t) {
     static const char* names[] = {"char", "uchar", "short", "ushort", "int", "uint", "float", "double", "list", nullptr};
 
@@ -72,17 +451,17 @@ void ParsePLY::parseProperty(const String& s, Property& prop) {
 
     char temp[100], name[100];
 
-    sscanf(s.c_str(), "%*s %100s", temp);
+    sscanf(s.c_str(), "%*s %99s", temp);
     prop.type = parseDataType(temp);
 
     if (prop.type == list_type) {
         char temp2[100];
         // Read the index and element types
-        sscanf(s.c_str(), "%*s %*s %100s %100s %100s", temp, temp2, name);
+        sscanf(s.c_str(), "%*s %*s %99s %99s %99s", temp, temp2, name);
         prop.listLengthType = parseDataType(temp);
         prop.listElementType = parseDataType(temp2);
     } else {
-        sscanf(s.c_str(), "%*s %*s %100s", name);
+        sscanf(s.c_str(), "%*s %*s %99s", name);
     }
 
     prop.name = name;
@@ -122,12 +501,12 @@ void ParsePLY::readHeader(BinaryInput& bi) {
 
     String s =  bi.readStringNewline();
     while (s != "end_header") {
-        if (beginsWith(s, "comment ")) {
+        if (beginsWith(s, "comment ") || beginsWith(s, "obj_info ")) {
 
             // Ignore this line
             s = bi.readStringNewline();
 
-        } if (beginsWith(s, "element vertex ")) {
+        } else if (beginsWith(s, "element vertex ")) {
             if (readVertex) {
                 throw String("Already defined vertex.");
             }
@@ -246,17 +625,64 @@ float ParsePLY::readAsFloat(const Property& prop, BinaryInput& bi) {
 
 void ParsePLY::readVertexList(BinaryInput& bi) {
     const int N = vertexProperty.size();
-    int i = 0;
-    for (int v = 0; v < numVertices; ++v) {
-        for (int p = 0; p < N; ++p) {
-            vertexData[i] = readAsFloat(vertexProperty[p], bi);
-            ++i;
+    const _internal::PLYVertexLayout layout(vertexProperty, bi.endian() != System::machineEndian());
+    const size_t stride = layout.stride;
+
+    if (stride == 0) {
+        // Lists make the records variable-sized
+        int i = 0;
+        for (int v = 0; v < numVertices; ++v) {
+            for (int p = 0; p < N; ++p) {
+                vertexData[i] = readAsFloat(vertexProperty[p], bi);
+                ++i;
+            }
+        }
+        return;
+    }
+
+    // Read blocks of whole records and convert each property with its compiled reader
+    static const int blockSize = 64 * 1024;
+    Array<uint8> buffer;
+    buffer.resize(int(G3D::min(numVertices, blockSize) * stride));
+    float* dst = vertexData;
+    for (int first = 0; first < numVertices; first += blockSize) {
+        const int n = G3D::min(blockSize, numVertices - first);
+        if (bi.getPosition() + int64(n * stride) > bi.size()) {
+            throw ParseError(bi.getFilename(), bi.getPosition(), "Vertex data is truncated");
+        }
+        bi.readBytes(buffer.getCArray(), n * stride);
+
+        for (int v = 0; v < n; ++v) {
+            const uint8* src = buffer.getCArray() + v * stride;
+            for (int p = 0; p < N; ++p) {
+                *dst = layout.read[p](src + layout.offset[p]);
+                ++dst;
+            }
+        }
+    }
+}
+
+
+void ParsePLY::skipVertexList(BinaryInput& bi) {
+    const _internal::PLYVertexLayout layout(vertexProperty, false);
+    if (layout.stride > 0) {
+        bi.skip(int64(numVertices) * layout.stride);
+    } else {
+        for (int v = 0; v < numVertices; ++v) {
+            for (int p = 0; p < vertexProperty.size(); ++p) {
+                (void)readAsFloat(vertexProperty[p], bi);
+            }
         }
     }
 }
 
 
 void ParsePLY::readFaceList(BinaryInput& bi) {
+    if (faceOrTriStripProperty.size() == 0) {
+        // Point cloud
+        return;
+    }
+
     // How many properties are there before and after
     // the vertex_index list?
     int numBefore = 0, numAfter = faceOrTriStripProperty.size() - 2;
@@ -27,7 +27,11 @@ PixelTransferBuffer::PixelTransferBuffer(const ImageFormat* format, int width, i
     debugAssert(m_height > 0);
     debugAssert(m_depth > 0);
 
-    m_rowStride = iCeil(width * format->cpuBitsPerPixel / 8.0);
+    if (format->compressed) {
+        m_rowStride = ((width + 3) / 4) * (format->cpuBitsPerPixel / 8);
+    } else {
+        m_rowStride = iCeil(width * format->cpuBitsPerPixel / 8.0);
+    }
     if (m_rowAlignment > 1) {
         // Round up to the nearest multiple of m_rowAlignment
         size_t remainder = m_rowStride % m_rowAlignment;
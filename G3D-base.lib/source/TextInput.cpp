@@ -39,12 +39,23 @@ double Token::number() const {
 }
 
 
+double TokenView::number() const {
+    if (_type == Token::NUMBER) {
+        return TextInput::parseNumber(_data, _length);
+    } else {
+        return 0.0;
+    }
+}
+
+
 bool TextInput::parseBoolean(const String& _string) {
      return toLower(_string) == "true";
 }
 
 
-double TextInput::parseNumber(const String& s) {
+/** Handles the specials and the inputs that TextInput::parseNumber(const char*, size_t) cannot
+    round correctly */
+static double parseNumberSlow(const String& s) {
     if (s == "-1.#IND00" || s == "-1.#IND" || s == "nan" || s == "NaN" || s == "1.#QNAN") {
         return nan();
     }
@@ -73,6 +84,108 @@ double TextInput::parseNumber(const String& s) {
 }
 
 
+double TextInput::parseNumber(const String& s) {
+    return parseNumber(s.c_str(), s.size());
+}
+
+
+double TextInput::parseNumber(const char* s, size_t length) {
+    // Powers of ten that are exactly representable as doubles
+    static const double power10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char* p = s;
+    const char* end = s + length;
+
+    if ((length > 2) && (s[0] == '0') && ((s[1] == 'x') || (s[1] == 'X'))) {
+        // Hex, wrapping to 32 bits like sscanf("%x")
+        uint32 i = 0;
+        for (p += 2; p < end; ++p) {
+            const char c = *p;
+            const uint32 digit = 
+                isDigitFast(c) ? uint32(c - '0') :
+                ((c >= 'a') && (c <= 'f')) ? uint32(c - 'a' + 10) :
+                ((c >= 'A') && (c <= 'F')) ? uint32(c - 'A' + 10) : 16;
+            if (digit == 16) {
+                break;
+            }
+            i = (i << 4) | digit;
+        }
+        return i;
+    }
+
+    bool negative = false;
+    if ((p < end) && ((*p == '-') || (*p == '+'))) {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    // Accumulate up to 19 significant digits, which always fit in 64 bits
+    uint64 mantissa  = 0;
+    int    numDigits = 0;
+    int    exponent  = 0;
+    bool   anyDigits = false;
+    bool   truncated = false;
+    for (; (p < end) && isDigitFast(*p); ++p) {
+        anyDigits = true;
+        if (numDigits < 19) {
+            mantissa = mantissa * 10 + uint64(*p - '0');
+            numDigits += (mantissa != 0) ? 1 : 0;
+        } else {
+            ++exponent;
+            truncated = truncated || (*p != '0');
+        }
+    }
+
+    if ((p < end) && (*p == '.')) {
+        for (++p; (p < end) && isDigitFast(*p); ++p) {
+            anyDigits = true;
+            if (numDigits < 19) {
+                mantissa = mantissa * 10 + uint64(*p - '0');
+                numDigits += (mantissa != 0) ? 1 : 0;
+                --exponent;
+            } else {
+                truncated = truncated || (*p != '0');
+            }
+        }
+    }
+
+    if (anyDigits && (p < end) && ((*p == 'e') || (*p == 'E'))) {
+        ++p;
+        bool negativeExponent = false;
+        if ((p < end) && ((*p == '-') || (*p == '+'))) {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+        int e = 0;
+        for (; (p < end) && isDigitFast(*p); ++p) {
+            // Clamp; anything this large is inf or zero anyway
+            e = G3D::min(e * 10 + (*p - '0'), 100000);
+        }
+        exponent += negativeExponent ? -e : e;
+    }
+
+    if ((p < end) && (*p == 'f')) {
+        // Trailing f on a float
+        ++p;
+    }
+
+    // Clinger's fast path: when both the mantissa and the power of ten are exact
+    // doubles, one IEEE multiply or divide is correctly rounded.
+    if (anyDigits && (p == end) && ! truncated && (mantissa <= (uint64(1) << 53))) {
+        if (mantissa == 0) {
+            return negative ? -0.0 : 0.0;
+        } else if ((exponent >= -22) && (exponent <= 22)) {
+            const double n = (exponent < 0) ? double(mantissa) / power10[-exponent] : double(mantissa) * power10[exponent];
+            return negative ? -n : n;
+        }
+    }
+
+    return parseNumberSlow(String(s, length));
+}
+
+
 TextInput::Settings::Settings () :
     cppBlockComments(true),
     cppLineComments(true),
@@ -100,7 +213,7 @@ TextInput::Settings::Settings () :
 Token TextInput::peek() {
     if (stack.size() == 0) {
         Token t;
-        nextToken(t);
+        read(t);
         push(t);
     }
 
@@ -129,12 +242,101 @@ void TextInput::read(Token& t) {
     if (stack.size() > 0) {
         t = stack.front();
         stack.pop_front();
+    } else if (peekedViewStart == currentCharOffset) {
+        t = peekedView.token();
+        consumePeekedView();
     } else {
         nextToken(t);
     }
 }
 
 
+void TextInput::read(TokenView& t) {
+    if (stack.size() > 0) {
+        makeView(stack.front(), t);
+        stack.pop_front();
+    } else if (peekedViewStart == currentCharOffset) {
+        t = peekedView;
+        consumePeekedView();
+    } else {
+        scanTokenView(t);
+    }
+}
+
+
+void TextInput::peek(TokenView& t) {
+    if (stack.size() > 0) {
+        makeView(stack.front(), t);
+        return;
+    }
+
+    if (peekedViewStart != currentCharOffset) {
+        const int start     = currentCharOffset;
+        const int line      = lineNumber;
+        const int character = charNumber;
+
+        scanTokenView(peekedView);
+        peekedViewEnd          = currentCharOffset;
+        peekedViewEndLine      = lineNumber;
+        peekedViewEndCharacter = charNumber;
+
+        currentCharOffset = start;
+        lineNumber        = line;
+        charNumber        = character;
+        peekedViewStart   = start;
+    }
+
+    t = peekedView;
+}
+
+
+void TextInput::consumePeekedView() {
+    currentCharOffset = peekedViewEnd;
+    lineNumber        = peekedViewEndLine;
+    charNumber        = peekedViewEndCharacter;
+    peekedViewStart   = -1;
+}
+
+
+void TextInput::scanTokenView(TokenView& t) {
+    if (! nextTokenView(t)) {
+        Token token;
+        nextToken(token);
+        makeView(token, t);
+    }
+}
+
+
+void TextInput::makeView(const Token& token, TokenView& t) {
+    t._bool         = token._bool;
+    t._line         = token._line;
+    t._character    = token._character;
+    t._bytePosition = token._bytePosition;
+    t._type         = token._type;
+    t._extendedType = token._extendedType;
+
+    const String& s = token._string;
+    t._length = s.size();
+    if (t._length == 0) {
+        t._data = "";
+        return;
+    }
+
+    // Most text appears verbatim in the buffer at the start of the token or just past a
+    // sign, quote, or comment marker
+    for (size_t skip = 0; skip <= 2; ++skip) {
+        const size_t start = size_t(token._bytePosition) + skip;
+        if ((start + t._length <= size_t(buffer.size())) && (::memcmp(buffer.getCArray() + start, s.c_str(), t._length) == 0)) {
+            t._data = buffer.getCArray() + start;
+            return;
+        }
+    }
+
+    viewStorage.push_back(s);
+    t._data = viewStorage.back().c_str();
+}
+
+
 String TextInput::readUntilDelimiterAsString(const char delimiter1, const char delimiter2) {
 /*
     // Reset the read position back to the start of that token
@@ -202,6 +404,14 @@ void TextInput::init() {
         toUpper(options.trueSymbols);
         toUpper(options.falseSymbols);
     }
+    updateSettings();
+}
+
+
+void TextInput::updateSettings() {
+    peekedViewStart = -1;
+    options.falseSymbols.getMembers(booleanSymbols[0]);
+    options.trueSymbols.getMembers(booleanSymbols[1]);
 }
 
 
@@ -211,7 +421,13 @@ void TextInput::push(const Token& t) {
 
 
 bool TextInput::hasMore() {
-    return (peek()._type != Token::END);
+    if (stack.size() > 0) {
+        return (stack.front()._type != Token::END);
+    }
+
+    TokenView t;
+    peek(t);
+    return (t._type != Token::END);
 }
 
 
@@ -261,6 +477,357 @@ int TextInput::peekInputChar(int distance) {
 }
 
 
+/** True if \a symbols contains the \a length characters at \a s. The symbols are upper case when
+    ! caseSensitive; see TextInput::init. */
+static bool containsSymbol(const Array<String>& symbols, const char* s, size_t length, bool caseSensitive) {
+    for (const String& symbol : symbols) {
+        if (symbol.size() == length) {
+            size_t i = 0;
+            if (caseSensitive) {
+                i = (::memcmp(symbol.c_str(), s, length) == 0) ? length : 0;
+            } else {
+                while ((i < length) && (symbol[i] == char(toupper(s[i])))) {
+                    ++i;
+                }
+            }
+            if (i == length) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+// ASCII character classes for nextTokenView, which are equivalent to the ctype functions in the
+// default "C" locale but inline. EOF is in none of them.
+static inline bool viewIsDigit(int c) {
+    return unsigned(c - '0') < 10u;
+}
+
+
+static inline bool viewIsLetter(int c) {
+    return unsigned((c | 32) - 'a') < 26u;
+}
+
+
+static inline bool viewIsWhitespace(int c) {
+    // ' ', or '\t', '\n', '\v', '\f', '\r'
+    return (c == ' ') || (unsigned(c - '\t') < 5u);
+}
+
+
+bool TextInput::nextTokenView(TokenView& t) {
+    const char* const data = buffer.getCArray();
+    const int end = buffer.size();
+
+    int i         = currentCharOffset;
+    int line      = lineNumber;
+    int character = charNumber;
+
+    const auto peekChar = [&](int j) -> int {
+        return (j < end) ? int((unsigned char)data[j]) : EOF;
+    };
+
+    // Same as eatInputChar()
+    const auto eatChar = [&]() {
+        const char c = data[i];
+        ++i;
+        if (c == '\r') {
+            ++line;
+            character = 1;
+            if ((i < end) && (data[i] == '\n')) {
+                ++i;
+            }
+        } else if (c == '\n') {
+            ++line;
+            character = 1;
+        } else {
+            ++character;
+        }
+    };
+
+    // Skip whitespace and comments, stopping at the ones that produce tokens
+    bool fallback = false;
+    while (i < end) {
+        const int c  = peekChar(i);
+        const int c2 = peekChar(i + 1);
+
+        if (viewIsDigit(c) || ((c == '-') && viewIsDigit(c2) && options.signedNumbers)) {
+            // nextToken checks for numbers before comments
+            break;
+        } else if (viewIsWhitespace(c)) {
+            if (options.generateNewlineTokens && isNewline(c)) {
+                fallback = true;
+                break;
+            }
+            eatChar();
+        } else if ((options.cppLineComments && (c == '/') && (c2 == '/')) ||
+                   ((options.otherCommentCharacter != '\0') && 
+                    ((c == options.otherCommentCharacter) || 
+                     ((options.otherCommentCharacter2 != '\0') && (c == options.otherCommentCharacter2))))) {
+            if (options.generateCommentTokens) {
+                fallback = true;
+                break;
+            }
+            while ((i < end) && ! isNewline(data[i])) {
+                eatChar();
+            }
+        } else if (options.cppBlockComments && (c == '/') && (c2 == '*')) {
+            if (options.generateCommentTokens) {
+                fallback = true;
+                break;
+            }
+            eatChar();
+            eatChar();
+            while ((i < end) && ! ((data[i] == '*') && (peekChar(i + 1) == '/'))) {
+                eatChar();
+            }
+            // Closing */
+            for (int j = 0; (j < 2) && (i < end); ++j) {
+                eatChar();
+            }
+        } else {
+            break;
+        }
+    }
+
+    currentCharOffset = i;
+    lineNumber        = line;
+    charNumber        = character;
+
+    if (fallback) {
+        return false;
+    }
+
+    t._line         = line;
+    t._character    = character;
+    t._bytePosition = i;
+    t._bool         = false;
+
+    if (i == end) {
+        t._type         = Token::END;
+        t._extendedType = Token::END_TYPE;
+        t._data         = "";
+        t._length       = 0;
+        return true;
+    }
+
+    const int c  = peekChar(i);
+    const int c2 = peekChar(i + 1);
+    int j = i;
+
+    if (viewIsDigit(c) || ((c == '.') && viewIsDigit(c2)) ||
+        (options.signedNumbers && (c == '-') && (viewIsDigit(c2) || ((c2 == '.') && viewIsDigit(peekChar(i + 2)))))) {
+
+        // Number; the same grammar as nextToken
+        if (c == '-') {
+            ++j;
+        }
+
+        t._type         = Token::NUMBER;
+        t._extendedType = (data[j] == '.') ? Token::FLOATING_POINT_TYPE : Token::INTEGER_TYPE;
+
+        if ((data[j] == '0') && (peekChar(j + 1) == 'x')) {
+            t._extendedType = Token::HEX_INTEGER_TYPE;
+            j += 2;
+            while (viewIsDigit(peekChar(j)) || ((peekChar(j) >= 'A') && (peekChar(j) <= 'F')) || ((peekChar(j) >= 'a') && (peekChar(j) <= 'f'))) {
+                ++j;
+            }
+        } else {
+            while (viewIsDigit(peekChar(j))) {
+                ++j;
+            }
+
+            if (peekChar(j) == '.') {
+                t._extendedType = Token::FLOATING_POINT_TYPE;
+                ++j;
+                if (options.msvcFloatSpecials && (peekChar(j) == '#')) {
+                    return false;
+                }
+                while (viewIsDigit(peekChar(j))) {
+                    ++j;
+                }
+            }
+
+            if ((peekChar(j) == 'e') || (peekChar(j) == 'E')) {
+                t._extendedType = Token::FLOATING_POINT_TYPE;
+                ++j;
+                if ((peekChar(j) == '-') || (peekChar(j) == '+')) {
+                    ++j;
+                }
+                while (viewIsDigit(peekChar(j))) {
+                    ++j;
+                }
+            }
+
+            if ((t._extendedType == Token::FLOATING_POINT_TYPE) && (peekChar(j) == 'f')) {
+                ++j;
+            }
+        }
+
+    } else if (viewIsLetter(c) || (c == '_')) {
+
+        // Identifier or keyword
+        t._type         = Token::SYMBOL;
+        t._extendedType = Token::SYMBOL_TYPE;
+        do {
+            ++j;
+        } while (viewIsLetter(peekChar(j)) || viewIsDigit(peekChar(j)) || (peekChar(j) == '_'));
+
+        const size_t length = size_t(j - i);
+        if (containsSymbol(booleanSymbols[1], data + i, length, options.caseSensitive)) {
+            t._type         = Token::BOOLEAN;
+            t._extendedType = Token::BOOLEAN_TYPE;
+            t._bool         = true;
+        } else if (containsSymbol(booleanSymbols[0], data + i, length, options.caseSensitive)) {
+            t._type         = Token::BOOLEAN;
+            t._extendedType = Token::BOOLEAN_TYPE;
+        }
+
+        if (options.simpleFloatSpecials && (length == 3) && 
+            ((::memcmp(data + i, "nan", 3) == 0) || (::memcmp(data + i, "inf", 3) == 0))) {
+            t._type         = Token::NUMBER;
+            t._extendedType = Token::FLOATING_POINT_TYPE;
+        }
+
+    } else {
+
+        switch (c) {
+        case '@':                   // Simple symbols
+        case '(': 
+        case ')':
+        case ',':
+        case ';':
+        case '{':
+        case '}':
+        case '[':
+        case ']':
+        case '#':
+        case '$':
+        case '?':
+        case '%':
+            t._type         = Token::SYMBOL;
+            t._extendedType = Token::SYMBOL_TYPE;
+            ++j;
+            break;
+
+        case '-':                   // -, --, -=, or ->
+            if ((c2 == '>') || (c2 == '-') || (c2 == '=')) {
+                j += 2;
+            } else if (options.signedNumbers && options.simpleFloatSpecials && (c2 == 'i')) {
+                // Possibly -inf
+                return false;
+            } else {
+                ++j;
+            }
+            t._type         = Token::SYMBOL;
+            t._extendedType = Token::SYMBOL_TYPE;
+            break;
+
+        case '+':                   // +, ++, or +=
+            if ((c2 == '+') || (c2 == '=')) {
+                j += 2;
+            } else if (options.signedNumbers && (viewIsDigit(c2) || (c2 == '.') || (options.simpleFloatSpecials && (c2 == 'i')))) {
+                // Possibly a number, which does not include the +
+                return false;
+            } else {
+                ++j;
+            }
+            t._type         = Token::SYMBOL;
+            t._extendedType = Token::SYMBOL_TYPE;
+            break;
+
+        case ':':                   // : or :: or ::> or ::= or := or :>
+            if (c2 == ':') {
+                j += (options.proofSymbols && ((peekChar(i + 2) == '>') || (peekChar(i + 2) == '='))) ? 3 : 2;
+            } else {
+                j += (options.proofSymbols && ((c2 == '=') || (c2 == '>'))) ? 2 : 1;
+            }
+            t._type         = Token::SYMBOL;
+            t._extendedType = Token::SYMBOL_TYPE;
+            break;
+
+        case '=':                   // = or == or =>
+            j += ((c2 == '=') || (options.proofSymbols && (c2 == '>'))) ? 2 : 1;
+            t._type         = Token::SYMBOL;
+            t._extendedType = Token::SYMBOL_TYPE;
+            break;
+
+        case '*':                   // * or *=
+        case '/':                   // / or /=
+        case '!':                   // ! or !=
+        case '~':                   // ~ or ~=
+        case '^':                   // ^ or ^=
+            j += (c2 == '=') ? 2 : 1;
+            t._type         = Token::SYMBOL;
+            t._extendedType = Token::SYMBOL_TYPE;
+            break;
+
+        case '>':                   // >, >>,or >=
+        case '<':                   // <<, <<, or <= 
+        case '|':                   // ||, ||, or |= 
+        case '&':                   // &, &&, or &=
+            if ((c2 == '=') || (c2 == c)) {
+                j += 2;
+            } else if (options.proofSymbols) {
+                // <-, |-, <:, and <::
+                return false;
+            } else {
+                ++j;
+            }
+            t._type         = Token::SYMBOL;
+            t._extendedType = Token::SYMBOL_TYPE;
+            break;
+
+        case '\\':                  // Backslash or escaped comment character
+        case '.':                   // ., .., or ...
+            return false;
+
+        default:
+            if ((c != '\"') && ! (options.singleQuotedStrings && (c == options.singleQuoteCharacter))) {
+                // Extended ASCII, or an error
+                return false;
+            }
+
+            // Quoted string. Escape sequences and \r\n newlines change the text, so they
+            // require a copy.
+            t._type         = Token::STRING;
+            t._extendedType = (c == options.singleQuoteCharacter) ? Token::SINGLE_QUOTED_TYPE : Token::DOUBLE_QUOTED_TYPE;
+
+            ++j;
+            while ((j < end) && (data[j] != char(c))) {
+                if ((data[j] == '\r') || (options.escapeSequencesInStrings && (data[j] == '\\'))) {
+                    return false;
+                }
+                ++j;
+            }
+
+            t._data   = data + i + 1;
+            t._length = size_t(j - i - 1);
+
+            // Consume the quotes and any newlines between them
+            const int stop = G3D::min(j + 1, end);
+            while (i < stop) {
+                eatChar();
+            }
+
+            currentCharOffset = i;
+            lineNumber        = line;
+            charNumber        = character;
+            return true;
+        }
+    }
+
+    // None of the tokens above span lines
+    t._data   = data + i;
+    t._length = size_t(j - i);
+    currentCharOffset = j;
+    charNumber        = character + (j - i);
+    return true;
+}
+
+
 void TextInput::nextToken(Token& t) {
 
     t._bytePosition = currentCharOffset;
@@ -996,7 +1563,7 @@ bool TextInput::readBoolean() {
 
 
 int TextInput::readInteger() {
-    Token t;
+    TokenView t;
     read(t);
 
     if (t._extendedType == Token::INTEGER_TYPE) {  // common case
@@ -1006,16 +1573,16 @@ int TextInput::readInteger() {
         // read a signed number, so we handle that case here.
         if (! options.signedNumbers
             && (t._type == Token::SYMBOL)
-            && ((t._string == "-") 
-                 || (t._string == "+"))) {
+            && ((t == "-") 
+                 || (t == "+"))) {
 
-            Token t2;
+            TokenView t2;
             read(t2);
 
             if ((t2._extendedType == Token::INTEGER_TYPE)
                 && (t2._character == t._character + 1)) {
 
-                if (t._string == "-") {
+                if (t == "-") {
                     return (int)-t2.number();
                 } else {
                     return (int)t2.number();
@@ -1023,13 +1590,13 @@ int TextInput::readInteger() {
             }
 
             // push back the second token.
-            push(t2);
+            push(t2.token());
         }
 
         // Push initial token back, and throw an error.  We intentionally
         // indicate that the wrong type is the type of the initial token.
         // Logically, the number started there.
-        push(t);
+        push(t.token());
         throw WrongTokenType(options.sourceFileName, t.line(), t.character(),
                              Token::NUMBER, t._type); 
     }    
@@ -1037,7 +1604,7 @@ int TextInput::readInteger() {
 
 
 double TextInput::readNumber() {
-    Token t;
+    TokenView t;
     read(t);
 
     if (t._type == Token::NUMBER) {  // common case
@@ -1048,15 +1615,16 @@ double TextInput::readNumber() {
     // read a signed number, so we handle that case here.
     if (! options.signedNumbers
         && (t._type == Token::SYMBOL)
-        && ((t._string == "-") 
-             || (t._string == "+"))) {
+        && ((t == "-") 
+             || (t == "+"))) {
 
-        Token t2(read());
+        TokenView t2;
+        read(t2);
 
         if ((t2._type == Token::NUMBER)
             && (t2._character == t._character + 1)) {
 
-            if (t._string == "-") {
+            if (t == "-") {
                 return -t2.number();
             } else {
                 return t2.number();
@@ -1064,13 +1632,13 @@ double TextInput::readNumber() {
         }
 
         // push back the second token.
-        push(t2);
+        push(t2.token());
     }
 
     // Push initial token back, and throw an error.  We intentionally
     // indicate that the wrong type is the type of the initial token.
     // Logically, the number started there.
-    push(t);
+    push(t.token());
     throw WrongTokenType(options.sourceFileName, t.line(), t.character(),
                          Token::NUMBER, t._type); 
 }
@@ -1195,16 +1763,21 @@ String TextInput::readSymbol() {
 
 
 void TextInput::readSymbol(const String& symbol) {
-    Token t;
-    readSymbolToken(t);
+    TokenView t;
+    read(t);
 
-    if (t._string == symbol) { // fast path
+    if ((t._type == Token::SYMBOL) && (t == symbol)) { // fast path
         return;
     }
 
-    push(t);
-    throw WrongSymbol(options.sourceFileName, t.line(), t.character(),
-                      symbol, t._string);
+    push(t.token());
+    if (t._type != Token::SYMBOL) {
+        throw WrongTokenType(options.sourceFileName, t.line(), t.character(),
+                             Token::SYMBOL, t._type);
+    } else {
+        throw WrongSymbol(options.sourceFileName, t.line(), t.character(),
+                          symbol, t.string());
+    }
 }
 
 
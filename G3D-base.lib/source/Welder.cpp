@@ -19,6 +19,8 @@
 #include "G3D-base/stringutils.h"
 #include "G3D-base/BinaryInput.h"
 #include "G3D-base/BinaryOutput.h"
+#include <atomic>
+#include <cstring>
 
 namespace G3D { namespace _internal{
 
@@ -462,6 +464,651 @@ public:
     }
 
 };
+
+
+/** Below this many elements, a loop is not worth splitting across threads */
+static const int CONCURRENT_GRAIN_SIZE = 4096;
+
+
+/** The cell arithmetic of a PointHashGrid */
+class GridCells {
+public:
+
+    /** Computed exactly as PointHashGrid computes m_invCellWidth */
+    float                   invCellWidth;
+
+    explicit GridCells(float cellWidth) : invCellWidth(1.0f / cellWidth) {}
+
+    /** Same as PointHashGrid::getCellCoord */
+    void getCellCoord(const Point3& pos, Point3int32& cellCoord) const {
+        for (int a = 0; a < 3; ++a) {
+            cellCoord[a] = iFloor(pos[a] * invCellWidth);
+        }
+    }
+
+    /** Same as the cell range of PointHashGrid::SphereIterator */
+    void getCellRange(const Sphere& sphere, Point3int32& lo, Point3int32& hi) const {
+        AABox box;
+        sphere.getBounds(box);
+        getCellCoord(box.low(), lo);
+        getCellCoord(box.high(), hi);
+    }
+
+    /** The order in which PointHashGrid::BoxIterator visits cells */
+    static bool cellLess(const Point3int32& a, const Point3int32& b) {
+        if (a.z != b.z) {
+            return a.z < b.z;
+        } else if (a.y != b.y) {
+            return a.y < b.y;
+        } else {
+            return a.x < b.x;
+        }
+    }
+};
+
+
+/**
+ Point indices sorted by the PointHashGrid cell that contains each point,
+ built concurrently and read-only afterward.
+
+ Visiting the cells that overlap a box in (z, y, x) order and each cell's
+ points in ascending index order reproduces the iteration order of
+ PointHashGrid::BoxIterator over points that were inserted in index order.
+ ConcurrentWeldHelper relies on this to match WeldHelper's floating-point
+ sums exactly.
+ */
+class SortedPointGrid : public GridCells {
+public:
+
+    class Entry {
+    public:
+        Point3int32         cell;
+        int                 index;
+
+        bool operator<(const Entry& other) const {
+            if (cell != other.cell) {
+                return cellLess(cell, other.cell);
+            } else {
+                return index < other.index;
+            }
+        }
+    };
+
+    /** First cell of each of the nine rows of cells adjacent to a center cell,
+        starting at x = center.x - 1. Found once per cell instead of once per point. */
+    class Neighborhood {
+    public:
+        Point3int32         center;
+        int                 rowStart[3][3];
+    };
+
+    Array<Entry>            entryArray;
+
+    /** Index in entryArray of the first Entry of each distinct cell, followed by entryArray.size() */
+    Array<int>              cellStart;
+
+    SortedPointGrid(const Array<Point3>& pointArray, float cellWidth) : GridCells(cellWidth) {
+        entryArray.resize(pointArray.size());
+        tbb::parallel_for(tbb::blocked_range<int>(0, pointArray.size(), CONCURRENT_GRAIN_SIZE), [&](const tbb::blocked_range<int>& r) {
+            for (int i = r.begin(); i < r.end(); ++i) {
+                getCellCoord(pointArray[i], entryArray[i].cell);
+                entryArray[i].index = i;
+            }
+        });
+        tbb::parallel_sort(entryArray.begin(), entryArray.end());
+
+        for (int e = 0; e < entryArray.size(); ++e) {
+            if ((e == 0) || (entryArray[e].cell != entryArray[e - 1].cell)) {
+                cellStart.append(e);
+            }
+        }
+        cellStart.append(entryArray.size());
+    }
+
+    int numCells() const {
+        return cellStart.size() - 1;
+    }
+
+    const Point3int32& cellCoord(int c) const {
+        return entryArray[cellStart[c]].cell;
+    }
+
+    /** Returns the first cell in [lo, hi) that is not less than \a coord */
+    int lowerBound(const Point3int32& coord, int lo, int hi) const {
+        while (lo < hi) {
+            const int mid = lo + (hi - lo) / 2;
+            if (cellLess(cellCoord(mid), coord)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    /** Returns the first cell at or after \a start that is not less than \a coord.
+        Exponential search, which is fast when the answer is near \a start. */
+    int gallop(const Point3int32& coord, int start) const {
+        int lo = start;
+        int hi = start;
+        for (int step = 1; (hi < numCells()) && cellLess(cellCoord(hi), coord); step *= 2) {
+            lo = hi + 1;
+            hi += step;
+        }
+        return lowerBound(coord, lo, min(hi, numCells()));
+    }
+
+    /** \param previous If true, \a neighborhood holds the neighborhood of a cell before \a c,
+        from which the search can continue. Neighborhoods only move forward in the sort order. */
+    void getNeighborhood(int c, bool previous, Neighborhood& neighborhood) const {
+        const Point3int32& center = cellCoord(c);
+        neighborhood.center = center;
+        for (int dz = -1; dz <= 1; ++dz) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                const Point3int32 first(center.x - 1, center.y + dy, center.z + dz);
+                int& start = neighborhood.rowStart[dz + 1][dy + 1];
+                if (previous) {
+                    start = gallop(first, start);
+                } else if ((dz < 0) || ((dz == 0) && (dy <= 0))) {
+                    // Rows up to the center's row come before c in the sort order
+                    start = lowerBound(first, 0, c + 1);
+                } else {
+                    start = lowerBound(first, c, numCells());
+                }
+            }
+        }
+    }
+
+    /** Invokes visit(index) for every point in the cells from \a lo to \a hi inclusive, in
+        PointHashGrid::BoxIterator order. \a neighborhood accelerates the rows adjacent to it. */
+    template<class Visitor>
+    void forEachInCells(const Neighborhood& neighborhood, const Point3int32& lo, const Point3int32& hi, Visitor& visit) const {
+        const Point3int32& center = neighborhood.center;
+        for (int z = lo.z; z <= hi.z; ++z) {
+            for (int y = lo.y; y <= hi.y; ++y) {
+                int c;
+                if ((abs(z - center.z) <= 1) && (abs(y - center.y) <= 1) && (lo.x >= center.x - 1)) {
+                    c = neighborhood.rowStart[z - center.z + 1][y - center.y + 1];
+                } else {
+                    c = lowerBound(Point3int32(lo.x, y, z), 0, numCells());
+                }
+
+                for (; c < numCells(); ++c) {
+                    const Point3int32& coord = cellCoord(c);
+                    if ((coord.z != z) || (coord.y != y) || (coord.x > hi.x)) {
+                        break;
+                    } else if (coord.x >= lo.x) {
+                        for (int e = cellStart[c]; e < cellStart[c + 1]; ++e) {
+                            visit(entryArray[e].index);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /** Invokes visit(index, neighborhood) for every point, concurrently across cells */
+    template<class Visitor>
+    void forEachPoint(const Visitor& visit) const {
+        tbb::parallel_for(tbb::blocked_range<int>(0, numCells(), 256), [&](const tbb::blocked_range<int>& r) {
+            Neighborhood neighborhood;
+            for (int c = r.begin(); c < r.end(); ++c) {
+                getNeighborhood(c, c > r.begin(), neighborhood);
+                for (int e = cellStart[c]; e < cellStart[c + 1]; ++e) {
+                    visit(entryArray[e].index, neighborhood);
+                }
+            }
+        });
+    }
+};
+
+
+/**
+ Lock-free disjoint set forest. A root is only ever linked beneath a root with a
+ smaller index, so concurrent unite() calls cannot form a cycle and the root of
+ each set is its smallest member.
+ */
+class ConcurrentUnionFind {
+private:
+
+    std::unique_ptr<std::atomic<int>[]> m_parent;
+
+public:
+
+    ConcurrentUnionFind(int size) : m_parent(new std::atomic<int>[size]) {
+        tbb::parallel_for(tbb::blocked_range<int>(0, size, CONCURRENT_GRAIN_SIZE), [&](const tbb::blocked_range<int>& r) {
+            for (int i = r.begin(); i < r.end(); ++i) {
+                m_parent[i].store(i, std::memory_order_relaxed);
+            }
+        });
+    }
+
+    int find(int i) {
+        while (true) {
+            int parent = m_parent[i].load();
+            if (parent == i) {
+                return i;
+            }
+
+            // Path halving. Losing this race to another thread is harmless.
+            const int grandparent = m_parent[parent].load();
+            if (grandparent != parent) {
+                m_parent[i].compare_exchange_weak(parent, grandparent);
+            }
+            i = grandparent;
+        }
+    }
+
+    void unite(int a, int b) {
+        while (true) {
+            a = find(a);
+            b = find(b);
+            if (a == b) {
+                return;
+            } else if (a < b) {
+                std::swap(a, b);
+            }
+
+            // Fails if another thread linked a since find() returned
+            int expected = a;
+            if (m_parent[a].compare_exchange_strong(expected, b)) {
+                return;
+            }
+        }
+    }
+};
+
+
+/**
+ Produces the same output as WeldHelper using all cores. WeldHelper merges each
+ vertex of the unrolled triangle list into the first earlier output vertex that it
+ matches, in PointHashGrid iteration order. That choice only depends on earlier
+ vertices that it could match, so ConcurrentWeldHelper links every vertex to all
+ such candidates, finds the connected clusters, and replays the serial rule within
+ each cluster independently.
+
+ Each step mirrors the corresponding WeldHelper method, including the order of
+ floating-point operations.
+ */
+class ConcurrentWeldHelper {
+private:
+
+    float                   vertexWeldRadius;
+    float                   normalWeldRadius2;
+    float                   texCoordWeldRadius2;
+    float                   normalSmoothingAngle;
+
+    /** Called from process() */
+    void unroll
+    (const Array<Array<int>*>&   indexArrayArray,
+     const Array<Vector3>&       vertexArray,
+     const Array<Vector2>&       texCoordArray,
+     Array<Vector3>&             unrolledVertexArray,
+     Array<Vector2>&             unrolledTexCoordArray) {
+
+        int numUnrolled = 0;
+        for (int t = 0; t < indexArrayArray.size(); ++t) {
+            if (indexArrayArray[t] != nullptr) {
+                numUnrolled += indexArrayArray[t]->size();
+            }
+        }
+        unrolledVertexArray.resize(numUnrolled);
+        unrolledTexCoordArray.resize(numUnrolled);
+
+        int start = 0;
+        for (int t = 0; t < indexArrayArray.size(); ++t) {
+            if (indexArrayArray[t] != nullptr) {
+                const Array<int>& triList = *(indexArrayArray[t]);
+                tbb::parallel_for(tbb::blocked_range<int>(0, triList.size(), CONCURRENT_GRAIN_SIZE), [&](const tbb::blocked_range<int>& r) {
+                    for (int v = r.begin(); v < r.end(); ++v) {
+                        const int i = triList[v];
+                        unrolledVertexArray[start + v] = vertexArray[i];
+                        unrolledTexCoordArray[start + v] = texCoordArray[i];
+                    }
+                });
+                start += triList.size();
+            }
+        }
+    }
+
+    /** Called from process() */
+    void computeFaceNormals
+    (const Array<Vector3>&  vertexArray,
+     Array<Vector3>&        faceNormalArray) {
+
+        debugAssertM(vertexArray.size() % 3 == 0, "Input is not a triangle soup");
+        faceNormalArray.resize(vertexArray.size());
+
+        tbb::parallel_for(tbb::blocked_range<int>(0, vertexArray.size() / 3, CONCURRENT_GRAIN_SIZE), [&](const tbb::blocked_range<int>& r) {
+            for (int t = r.begin(); t < r.end(); ++t) {
+                const int v = 3 * t;
+                const Vector3& e0 = vertexArray[v + 1] - vertexArray[v];
+                const Vector3& e1 = vertexArray[v + 2] - vertexArray[v];
+                const Vector3& n  = (e0.cross(e1 * 256.0f)).directionOrZero();
+                faceNormalArray[v] = n;
+                faceNormalArray[v + 1] = n;
+                faceNormalArray[v + 2] = n;
+            }
+        });
+    }
+
+    /** The final step of WeldHelper::smoothNormals for one vertex */
+    static Vector3 smoothNormal(const Vector3& sum, const Vector3& original) {
+        const Vector3& average = sum.directionOrZero();
+
+        const bool indeterminate = average.isZero();
+        // Never "smooth" a normal so far that it points backwards
+        const bool backFacing    = original.dot(average) < 0;
+
+        if (indeterminate || backFacing) {
+            // Revert to the face normal
+            return original;
+        } else {
+            // Average available normals
+            return average;
+        }
+    }
+
+    /** Called from process() */
+    void smoothNormals
+    (const Array<Point3>& vertexArray,
+     const Array<Vector3>& normalArray,
+     Array<Vector3>&       smoothNormalArray) {
+
+        if (normalSmoothingAngle <= 0) {
+            smoothNormalArray = normalArray;
+            return;
+        }
+
+        const float cosThresholdAngle = (float)cos(normalSmoothingAngle);
+        smoothNormalArray.resize(normalArray.size());
+
+        if (vertexWeldRadius == 0) {
+            // WeldHelper groups vertices with identical positions in a Table, in index order.
+            // Sort the indices by the bits of the position (as hashed by the Table) and then index.
+            Array<int> order;
+            order.resize(vertexArray.size());
+            for (int v = 0; v < order.size(); ++v) {
+                order[v] = v;
+            }
+
+            const auto bitsLess = [&](int a, int b) {
+                const uint32* A = reinterpret_cast<const uint32*>(&vertexArray[a]);
+                const uint32* B = reinterpret_cast<const uint32*>(&vertexArray[b]);
+                for (int i = 0; i < 3; ++i) {
+                    if (A[i] != B[i]) {
+                        return A[i] < B[i];
+                    }
+                }
+                return a < b;
+            };
+            tbb::parallel_sort(order.begin(), order.end(), bitsLess);
+
+            Array<int> groupStart;
+            for (int i = 0; i < order.size(); ++i) {
+                if ((i == 0) || (memcmp(&vertexArray[order[i]], &vertexArray[order[i - 1]], sizeof(Point3)) != 0)) {
+                    groupStart.append(i);
+                }
+            }
+            groupStart.append(order.size());
+
+            tbb::parallel_for(tbb::blocked_range<int>(0, groupStart.size() - 1, 256), [&](const tbb::blocked_range<int>& r) {
+                for (int g = r.begin(); g < r.end(); ++g) {
+                    for (int i = groupStart[g]; i < groupStart[g + 1]; ++i) {
+                        const Vector3& original = normalArray[order[i]];
+                        Vector3 sum;
+                        for (int j = groupStart[g]; j < groupStart[g + 1]; ++j) {
+                            const Vector3& N = normalArray[order[j]];
+                            const float cosAngle = N.dot(original);
+
+                            if (cosAngle > cosThresholdAngle) {
+                                // This normal is close enough to consider.  Avoid underflow by scaling up
+                                sum += (N * 256.0f);
+                            }
+                        }
+                        smoothNormalArray[order[i]] = smoothNormal(sum, original);
+                    }
+                }
+            });
+
+        } else {
+            alwaysAssertM(vertexWeldRadius > 0, "Cannot smooth with zero vertex weld radius");
+            const SortedPointGrid grid(vertexArray, vertexWeldRadius);
+
+            grid.forEachPoint([&](int v, const SortedPointGrid::Neighborhood& neighborhood) {
+                const Sphere sphere(vertexArray[v], vertexWeldRadius);
+                Point3int32 lo, hi;
+                grid.getCellRange(sphere, lo, hi);
+
+                Vector3 sum;
+                const Vector3& original = normalArray[v];
+                const auto accumulate = [&](int i) {
+                    if (sphere.contains(vertexArray[i])) {
+                        const Vector3& N = normalArray[i];
+                        const float cosAngle = N.dot(original);
+
+                        if (cosAngle > cosThresholdAngle) {
+                            // This normal is close enough to consider.  Avoid underflow by scaling up
+                            sum += (N * 256.0f);
+                        }
+                    }
+                };
+                grid.forEachInCells(neighborhood, lo, hi, accumulate);
+
+                smoothNormalArray[v] = smoothNormal(sum, original);
+            });
+        }
+    }
+
+    /** Same test as WeldHelper::getIndex, for an output vertex created from unrolled vertex \a r */
+    bool matches(int u, int r, const Array<Vector3>& normalArray, const Array<Vector2>& texCoordArray) const {
+        const Vector3& n = normalArray[u];
+        const Vector2& t = texCoordArray[u];
+        if (n.isZero()) {
+            return (t - texCoordArray[r]).squaredLength() <= texCoordWeldRadius2;
+        } else {
+            return ((n - normalArray[r]).squaredLength() <= normalWeldRadius2) &&
+                ((t - texCoordArray[r]).squaredLength() <= texCoordWeldRadius2);
+        }
+    }
+
+    /**
+     Sets representative[u] to the unrolled vertex whose output vertex WeldHelper::getIndex
+     returns for unrolled vertex u. That is u itself when u creates a new output vertex.
+
+     Called from process()
+     */
+    void findRepresentatives
+    (const Array<Vector3>&       vertexArray,
+     const Array<Vector3>&       normalArray,
+     const Array<Vector2>&       texCoordArray,
+     Array<int>&                 representative) {
+
+        const int n = vertexArray.size();
+        representative.resize(n);
+
+        // Same cells as WeldHelper::weldGrid, which determine the order of candidates
+        const GridCells weldCells(max(vertexWeldRadius, 0.1f));
+
+        // Link each vertex to every earlier vertex that WeldHelper::getIndex could return for it.
+        // Any vertex within the radius lies in an adjacent cell of a grid at least twice as fine,
+        // and cells that are much finer than WeldHelper's keep this search short.
+        const float maxCoordinate = tbb::parallel_reduce(tbb::blocked_range<int>(0, n, CONCURRENT_GRAIN_SIZE), 0.0f,
+            [&](const tbb::blocked_range<int>& r, float m) {
+                for (int u = r.begin(); u < r.end(); ++u) {
+                    const Vector3& v = vertexArray[u];
+                    m = max(m, max(fabs(v.x), max(fabs(v.y), fabs(v.z))));
+                }
+                return m;
+            }, [](float a, float b) { return max(a, b); });
+
+        // Keep cell coordinates well within int32 range
+        float linkCellWidth = max(2.0f * vertexWeldRadius, maxCoordinate / float(1 << 20));
+        if (! (linkCellWidth > 0) || ! G3D::isFinite(linkCellWidth)) {
+            linkCellWidth = 1.0f;
+        }
+        const SortedPointGrid linkGrid(vertexArray, linkCellWidth);
+
+        ConcurrentUnionFind cluster(n);
+        linkGrid.forEachPoint([&](int u, const SortedPointGrid::Neighborhood& neighborhood) {
+            const Sphere sphere(vertexArray[u], vertexWeldRadius);
+            const auto link = [&](int v) {
+                if ((v < u) && sphere.contains(vertexArray[v]) && matches(u, v, normalArray, texCoordArray)) {
+                    cluster.unite(u, v);
+                }
+            };
+            linkGrid.forEachInCells(neighborhood, neighborhood.center - Vector3int32(1, 1, 1), neighborhood.center + Vector3int32(1, 1, 1), link);
+        });
+
+        // Gather the members of each cluster in index order
+        Array<uint64> member;
+        member.resize(n);
+        tbb::parallel_for(tbb::blocked_range<int>(0, n, CONCURRENT_GRAIN_SIZE), [&](const tbb::blocked_range<int>& r) {
+            for (int u = r.begin(); u < r.end(); ++u) {
+                member[u] = (uint64(cluster.find(u)) << 32) | uint64(u);
+            }
+        });
+        tbb::parallel_sort(member.begin(), member.end());
+
+        Array<int> clusterStart;
+        for (int i = 0; i < n; ++i) {
+            if ((i == 0) || ((member[i] >> 32) != (member[i - 1] >> 32))) {
+                clusterStart.append(i);
+            }
+        }
+        clusterStart.append(n);
+
+        // Replay the serial rule within each cluster: a vertex reuses the matching earlier output
+        // vertex that PointHashGrid visits first, or else becomes a new output vertex
+        tbb::parallel_for(tbb::blocked_range<int>(0, clusterStart.size() - 1, 256), [&](const tbb::blocked_range<int>& r) {
+            SmallArray<int, 8> outputArray;
+            for (int c = r.begin(); c < r.end(); ++c) {
+                outputArray.clear(false);
+                for (int i = clusterStart[c]; i < clusterStart[c + 1]; ++i) {
+                    const int u = int(member[i] & 0xFFFFFFFF);
+                    const Sphere sphere(vertexArray[u], vertexWeldRadius);
+                    Point3int32 lo, hi;
+                    weldCells.getCellRange(sphere, lo, hi);
+
+                    int best = -1;
+                    Point3int32 bestCell;
+                    for (int j = 0; j < outputArray.size(); ++j) {
+                        const int o = outputArray[j];
+                        Point3int32 cell;
+                        weldCells.getCellCoord(vertexArray[o], cell);
+                        const bool inRange =
+                            (cell.x >= lo.x) && (cell.y >= lo.y) && (cell.z >= lo.z) &&
+                            (cell.x <= hi.x) && (cell.y <= hi.y) && (cell.z <= hi.z);
+
+                        // Within a cell, PointHashGrid visits output vertices in creation order
+                        if (inRange && ((best == -1) || GridCells::cellLess(cell, bestCell)) &&
+                            sphere.contains(vertexArray[o]) && matches(u, o, normalArray, texCoordArray)) {
+                            best = o;
+                            bestCell = cell;
+                        }
+                    }
+
+                    if (best == -1) {
+                        outputArray.append(u);
+                        representative[u] = u;
+                    } else {
+                        representative[u] = best;
+                    }
+                }
+            }
+        });
+    }
+
+public:
+
+    /** Same algorithm as WeldHelper::process() */
+    void process
+    ( Array<Vector3>&     vertexArray,
+      Array<Vector2>&     texCoordArray,
+      Array<Vector3>&     normalArray,
+      Array<Array<int>*>& indexArrayArray,
+      float               normAngle,
+      float               texRadius,
+      float               normRadius) {
+
+        normalSmoothingAngle = normAngle;
+        normalWeldRadius2    = square(normRadius);
+        texCoordWeldRadius2  = square(texRadius);
+
+        const bool hasTexCoords = (texCoordArray.size() > 0);
+
+        if (hasTexCoords) {
+            debugAssertM(vertexArray.size() == texCoordArray.size(),
+                "Input arrays are not parallel.");
+        } else {
+            // Generate all zero texture coordinates
+            texCoordArray.resize(vertexArray.size());
+        }
+
+        Array<Vector3> unrolledVertexArray;
+        Array<Vector2> unrolledTexCoordArray;
+        unroll(indexArrayArray, vertexArray, texCoordArray, unrolledVertexArray, unrolledTexCoordArray);
+
+        Array<Vector3> unrolledSmoothNormalArray;
+        {
+            Array<Vector3> unrolledFaceNormalArray;
+            computeFaceNormals(unrolledVertexArray, unrolledFaceNormalArray);
+            smoothNormals(unrolledVertexArray, unrolledFaceNormalArray, unrolledSmoothNormalArray);
+        }
+
+        Array<int> representative;
+        findRepresentatives(unrolledVertexArray, unrolledSmoothNormalArray, unrolledTexCoordArray, representative);
+
+        // Output vertices are numbered in the order that they were first encountered
+        const int numUnrolled = unrolledVertexArray.size();
+        Array<int> outputIndex;
+        outputIndex.resize(numUnrolled);
+        int numOutput = 0;
+        for (int u = 0; u < numUnrolled; ++u) {
+            if (representative[u] == u) {
+                outputIndex[u] = numOutput;
+                ++numOutput;
+            }
+        }
+
+        // Put the output back into the input slots
+        vertexArray.resize(numOutput);
+        normalArray.resize(numOutput);
+        texCoordArray.resize(numOutput);
+        tbb::parallel_for(tbb::blocked_range<int>(0, numUnrolled, CONCURRENT_GRAIN_SIZE), [&](const tbb::blocked_range<int>& r) {
+            for (int u = r.begin(); u < r.end(); ++u) {
+                if (representative[u] == u) {
+                    const int i = outputIndex[u];
+                    vertexArray[i]   = unrolledVertexArray[u];
+                    normalArray[i]   = unrolledSmoothNormalArray[u];
+                    texCoordArray[i] = unrolledTexCoordArray[u];
+                }
+            }
+        });
+
+        // Regenerate the triangle lists
+        int start = 0;
+        for (int t = 0; t < indexArrayArray.size(); ++t) {
+            if (indexArrayArray[t] != nullptr) {
+                Array<int>& triList = *(indexArrayArray[t]);
+                tbb::parallel_for(tbb::blocked_range<int>(0, triList.size(), CONCURRENT_GRAIN_SIZE), [&](const tbb::blocked_range<int>& r) {
+                    for (int v = r.begin(); v < r.end(); ++v) {
+                        triList[v] = outputIndex[representative[start + v]];
+                    }
+                });
+                start += triList.size();
+            }
+        }
+
+        if (! hasTexCoords) {
+            // Throw away the generated texCoords
+            texCoordArray.resize(0);
+        }
+    }
+
+    ConcurrentWeldHelper(float vertRadius) : vertexWeldRadius(vertRadius) {}
+};
+
 } // Internal
 
 
@@ -491,7 +1138,20 @@ void Welder::weld
     _internal::WeldHelper(settings.vertexWeldRadius).process
         (vertexArray, texCoordArray, normalArray, indexArrayArray, 
          settings.normalSmoothingAngle, settings.textureWeldRadius, settings.normalWeldRadius);
-        
+
+}
+
+
+void Welder::weldConcurrently
+(Array<Vector3>&     vertexArray,
+ Array<Vector2>&     texCoordArray,
+ Array<Vector3>&     normalArray,
+ Array<Array<int>*>& indexArrayArray,
+ const Welder::Settings& settings) {
+
+    _internal::ConcurrentWeldHelper(settings.vertexWeldRadius).process
+        (vertexArray, texCoordArray, normalArray, indexArrayArray,
+         settings.normalSmoothingAngle, settings.textureWeldRadius, settings.normalWeldRadius);
 }
 
 
@@ -0,0 +1,307 @@
+/**
+  \file G3D-base.lib/source/ZipArchive.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-base/ZipArchive.h"
+#include "G3D-base/FileSystem.h"
+#include "G3D-base/stringutils.h"
+#include "../../external/zlib.lib/include/zlib.h"
+#include "../../external/zip.lib/include/zip.h"
+
+namespace G3D {
+
+/** Record signatures from the PKWARE APPNOTE */
+enum {
+    LOCAL_HEADER_SIGNATURE      = 0x04034b50,
+    CENTRAL_HEADER_SIGNATURE    = 0x02014b50,
+    END_SIGNATURE               = 0x06054b50,
+    ZIP64_END_SIGNATURE         = 0x06064b50,
+    ZIP64_LOCATOR_SIGNATURE     = 0x07064b50,
+
+    END_SIZE                    = 22,
+    ZIP64_LOCATOR_SIZE          = 20,
+    ZIP64_END_SIZE              = 56,
+    CENTRAL_HEADER_SIZE         = 46,
+    LOCAL_HEADER_SIZE           = 30,
+
+    ZIP64_EXTRA_ID              = 0x0001,
+    ENCRYPTED_FLAG              = 0x0001
+};
+
+
+static uint16 readLE16(const uint8* p) {
+    return uint16(p[0] | (p[1] << 8));
+}
+
+
+static uint32 readLE32(const uint8* p) {
+    return uint32(p[0]) | (uint32(p[1]) << 8) | (uint32(p[2]) << 16) | (uint32(p[3]) << 24);
+}
+
+
+static uint64 readLE64(const uint8* p) {
+    return uint64(readLE32(p)) | (uint64(readLE32(p + 4)) << 32);
+}
+
+
+ZipArchive::ZipArchive(const String& filename, const shared_ptr<MemoryMappedFile>& file) :
+    m_filename(filename),
+    m_file(file),
+    m_zip(nullptr) {
+}
+
+
+ZipArchive::~ZipArchive() {
+    if (notNull(m_zip)) {
+        zip_discard(m_zip);
+        m_zip = nullptr;
+    }
+}
+
+
+shared_ptr<ZipArchive> ZipArchive::create(const String& filename) {
+    const shared_ptr<MemoryMappedFile>& file = MemoryMappedFile::create(filename, MemoryMappedFile::RANDOM);
+    if (isNull(file)) {
+        return nullptr;
+    }
+
+    const shared_ptr<ZipArchive>& archive = createShared<ZipArchive>(filename, file);
+    if (! archive->parseCentralDirectory()) {
+        return nullptr;
+    }
+    return archive;
+}
+
+
+bool ZipArchive::parseCentralDirectory() {
+    const uint8* data = m_file->data();
+    const uint64 size = m_file->size();
+    if (size < END_SIZE) {
+        return false;
+    }
+
+    // The end record is followed only by a comment of at most 64 kB
+    const uint64 searchStart = size - END_SIZE;
+    const uint64 searchEnd   = (searchStart > 0xFFFF) ? searchStart - 0xFFFF : 0;
+    uint64 end = searchStart + 1;
+    for (uint64 i = searchStart + 1; i > searchEnd; --i) {
+        if (readLE32(data + i - 1) == END_SIGNATURE) {
+            end = i - 1;
+            break;
+        }
+    }
+    if (end > searchStart) {
+        return false;
+    }
+
+    uint64 numEntries       = readLE16(data + end + 10);
+    uint64 directorySize    = readLE32(data + end + 12);
+    uint64 directoryOffset  = readLE32(data + end + 16);
+
+    if ((end >= ZIP64_LOCATOR_SIZE) && (readLE32(data + end - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE)) {
+        const uint64 zip64End = readLE64(data + end - ZIP64_LOCATOR_SIZE + 8);
+        if ((size < ZIP64_END_SIZE) || (zip64End > size - ZIP64_END_SIZE) || (readLE32(data + zip64End) != ZIP64_END_SIGNATURE)) {
+            return false;
+        }
+        numEntries      = readLE64(data + zip64End + 32);
+        directorySize   = readLE64(data + zip64End + 40);
+        directoryOffset = readLE64(data + zip64End + 48);
+    }
+
+    if ((directoryOffset > size) || (directorySize > size - directoryOffset) ||
+        (numEntries > directorySize / CENTRAL_HEADER_SIZE)) {
+        return false;
+    }
+
+    m_entry.resize(int(numEntries));
+    const uint8* p            = data + directoryOffset;
+    const uint8* directoryEnd = p + directorySize;
+    for (Entry& entry : m_entry) {
+        if ((p + CENTRAL_HEADER_SIZE > directoryEnd) || (readLE32(p) != CENTRAL_HEADER_SIGNATURE)) {
+            return false;
+        }
+
+        const uint16 nameLength    = readLE16(p + 28);
+        const uint16 extraLength   = readLE16(p + 30);
+        const uint16 commentLength = readLE16(p + 32);
+        const uint8* name  = p + CENTRAL_HEADER_SIZE;
+        const uint8* extra = name + nameLength;
+        const uint8* next  = extra + extraLength + commentLength;
+        if (next > directoryEnd) {
+            return false;
+        }
+
+        entry.encrypted         = (readLE16(p + 8) & ENCRYPTED_FLAG) != 0;
+        entry.method            = readLE16(p + 10);
+        entry.crc               = readLE32(p + 16);
+        entry.compressedSize    = readLE32(p + 20);
+        entry.size              = readLE32(p + 24);
+        entry.localHeaderOffset = readLE32(p + 42);
+        entry.name              = String(reinterpret_cast<const char*>(name), nameLength);
+
+        // Fields that overflowed 32 bits are stored in the zip64 extra field, in this order
+        for (const uint8* e = extra; e + 4 <= extra + extraLength; e += 4 + readLE16(e + 2)) {
+            if (readLE16(e) == ZIP64_EXTRA_ID) {
+                const uint8* field    = e + 4;
+                const uint8* fieldEnd = min(field + readLE16(e + 2), extra + extraLength);
+                for (uint64* value : {&entry.size, &entry.compressedSize, &entry.localHeaderOffset}) {
+                    if ((*value == 0xFFFFFFFF) && (field + 8 <= fieldEnd)) {
+                        *value = readLE64(field);
+                        field += 8;
+                    }
+                }
+                break;
+            }
+        }
+
+        bool created = false;
+        int& index = m_index.getCreate(toLower(FilePath::canonicalize(entry.name)), created);
+        if (created) {
+            // The first of duplicate names wins, as in libzip
+            index = int(&entry - m_entry.getCArray());
+        }
+
+        p = next;
+    }
+
+    return true;
+}
+
+
+const ZipArchive::Entry* ZipArchive::find(const String& name) const {
+    const int* index = m_index.getPointer(toLower(FilePath::canonicalize(name)));
+    return isNull(index) ? nullptr : &m_entry[*index];
+}
+
+
+const uint8* ZipArchive::dataStart(const Entry& entry) const {
+    const uint64 size = m_file->size();
+    if ((size < LOCAL_HEADER_SIZE) || (entry.localHeaderOffset > size - LOCAL_HEADER_SIZE) ||
+        (readLE32(m_file->data() + entry.localHeaderOffset) != LOCAL_HEADER_SIGNATURE)) {
+        return nullptr;
+    }
+
+    // The local extra field may differ in length from the central directory's
+    const uint8* header = m_file->data() + entry.localHeaderOffset;
+    const uint64 start  = entry.localHeaderOffset + LOCAL_HEADER_SIZE + readLE16(header + 26) + readLE16(header + 28);
+    if ((start > size) || (entry.compressedSize > size - start)) {
+        return nullptr;
+    }
+    return m_file->data() + start;
+}
+
+
+const uint8* ZipArchive::storedData(const Entry& entry) const {
+    if ((entry.method != 0) || entry.encrypted || (entry.compressedSize != entry.size)) {
+        return nullptr;
+    }
+    return dataStart(entry);
+}
+
+
+void ZipArchive::prefetch(const Entry& entry) const {
+    const uint8* start = dataStart(entry);
+    if (notNull(start)) {
+        m_file->prefetch(size_t(start - m_file->data()), size_t(entry.compressedSize));
+    }
+}
+
+
+void ZipArchive::read(const Entry& entry, void* dst, const String& password) const {
+    uint8* out = static_cast<uint8*>(dst);
+
+    if (entry.encrypted || ((entry.method != 0) && (entry.method != Z_DEFLATED))) {
+        readWithLibzip(entry, out, password);
+        return;
+    }
+
+    const uint8* in = dataStart(entry);
+    if (isNull(in)) {
+        throw String("\"") + entry.name + "\" inside \"" + m_filename + "\" is corrupt.";
+    }
+
+    if (entry.method == 0) {
+        if (entry.compressedSize != entry.size) {
+            throw String("\"") + entry.name + "\" inside \"" + m_filename + "\" is corrupt.";
+        }
+        System::memcpy(out, in, size_t(entry.size));
+    } else {
+        // Raw deflate stream, inflated in pieces because zlib counts bytes in 32 bits
+        static const uint64 PIECE = 1 << 30;
+        z_stream stream;
+        System::memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+            throw String("zlib initialization failed reading \"") + entry.name + "\"";
+        }
+
+        uint64 inRemaining  = entry.compressedSize;
+        uint64 outRemaining = entry.size;
+        stream.next_in  = const_cast<Bytef*>(in);
+        stream.next_out = out;
+        int result = Z_OK;
+        do {
+            if ((stream.avail_in == 0) && (inRemaining > 0)) {
+                stream.avail_in = uInt(min(inRemaining, PIECE));
+                inRemaining -= stream.avail_in;
+            }
+            if ((stream.avail_out == 0) && (outRemaining > 0)) {
+                stream.avail_out = uInt(min(outRemaining, PIECE));
+                outRemaining -= stream.avail_out;
+            }
+            // Z_BUF_ERROR means truncated input or more output than the directory claims
+            result = inflate(&stream, Z_NO_FLUSH);
+        } while (result == Z_OK);
+        const uint64 produced = entry.size - outRemaining - stream.avail_out;
+        inflateEnd(&stream);
+
+        if ((result != Z_STREAM_END) || (produced != entry.size)) {
+            throw String("\"") + entry.name + "\" inside \"" + m_filename + "\" was corrupt because it unzipped to the wrong size.";
+        }
+    }
+
+    // Stored entries read in place through storedData() are not checked, since that would
+    // page in the whole entry
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (uint64 i = 0; i < entry.size; i += 1 << 30) {
+        crc = crc32(crc, out + i, uInt(min(entry.size - i, uint64(1 << 30))));
+    }
+    if (uint32(crc) != entry.crc) {
+        throw String("\"") + entry.name + "\" inside \"" + m_filename + "\" failed its CRC check.";
+    }
+}
+
+
+void ZipArchive::readWithLibzip(const Entry& entry, uint8* dst, const String& password) const {
+    std::lock_guard<std::mutex> guard(m_zipMutex);
+
+    if (isNull(m_zip)) {
+        m_zip = zip_open(m_filename.c_str(), ZIP_RDONLY, nullptr);
+        if (isNull(m_zip)) {
+            throw String("\"") + m_filename + "\" could not be opened.";
+        }
+    }
+
+    struct zip_file* zf = entry.encrypted ?
+        zip_fopen_encrypted(m_zip, entry.name.c_str(), 0, password.c_str()) :
+        zip_fopen(m_zip, entry.name.c_str(), 0);
+
+    if (isNull(zf)) {
+        String msg = String("\"") + entry.name + "\" inside \"" + m_filename + "\" could not be opened.";
+        if (entry.encrypted && password.empty()) {
+            msg += String(" If the archive is password protected, register it with FileSystem::registerPasswordProtectedZip()");
+        }
+        throw msg;
+    }
+
+    const int64 bytesRead = zip_fread(zf, dst, entry.size);
+    zip_fclose(zf);
+    if (bytesRead != int64(entry.size)) {
+        throw String("\"") + entry.name + "\" inside \"" + m_filename + "\" was corrupt because it unzipped to the wrong size.";
+    }
+}
+
+} // namespace G3D
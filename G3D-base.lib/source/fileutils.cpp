@@ -21,7 +21,7 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
-#include "zip.h"
+#include "G3D-base/ZipArchive.h"
 
 #ifdef G3D_WINDOWS
    // Needed for _getcwd
@@ -133,40 +133,30 @@ String readWholeFile(const String& filename) {
         // In zipfile
         FileSystem::markFileUsed(zipfile);
 
-        struct zip* z = zip_open(zipfile.c_str(), ZIP_CHECKCONS, nullptr);
-        {
-            struct zip_stat info;
-            zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-            zip_stat(z, internalFile.c_str(), ZIP_FL_NOCASE, &info);
-
-            // Add nullptr termination
-            char* buffer = reinterpret_cast<char*>(System::alignedMalloc(info.size + 1, 16));
-            buffer[info.size] = '\0';
+        const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(zipfile);
+        const ZipArchive::Entry* entry = notNull(archive) ? archive->find(internalFile) : nullptr;
+        if (isNull(entry)) {
+            throw String("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
+        }
 
+        const uint8* stored = archive->storedData(*entry);
+        if (notNull(stored)) {
+            s = String(reinterpret_cast<const char*>(stored), size_t(entry->size));
+        } else {
             String password;
-            bool isPasswordProtected = FileSystem::isPasswordProtected(zipfile, password);
-
-            struct zip_file* zf = isPasswordProtected ?
-                                  zip_fopen_encrypted(z, internalFile.c_str(), ZIP_FL_NOCASE, password.c_str()) :
-                                  zip_fopen( z, internalFile.c_str(), ZIP_FL_NOCASE );
-            if (isNull(zf)) {
-                String msg = String("\"") + internalFile + "\" inside \"" + zipfile + "\" could not be opened.";
-                if (!isPasswordProtected) {
-                    msg += String(" If the archive is password protected, register it with FileSystem::registerPasswordProtectedZip()");
-                }
-                throw msg;
-            } else {
-                const int64 bytesRead = zip_fread( zf, buffer, (info.size));
-                debugAssertM((int64)bytesRead == (int64)info.size,
-                             internalFile + " was corrupt because it unzipped to the wrong size.");
-                (void)bytesRead;
-                zip_fclose(zf);
+            if (entry->encrypted) {
+                FileSystem::isPasswordProtected(zipfile, password);
             }
-            // Copy the string
-            s = buffer;
-            System::alignedFree(buffer);
+
+            s = String(size_t(entry->size), '\0');
+            archive->read(*entry, &s[0], password);
+        }
+
+        // Stop at the first nullptr, as when reading into a C string
+        const size_t end = s.find('\0');
+        if (end != String::npos) {
+            s = s.substr(0, end);
         }
-        zip_close(z);
     }
 
     return s;
@@ -180,20 +170,10 @@ int64 fileLength(const String& filename) {
     if (result == -1) {
         String zip, contents;
         if(zipfileExists(filename, zip, contents)){
-            int64 requiredMem;
-
-                        struct zip *z = zip_open( zip.c_str(), ZIP_CHECKCONS, nullptr );
-                        debugAssertM(z != nullptr, zip + ": zip open failed.");
-            {
-                                struct zip_stat info;
-                                zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-                                int success = zip_stat( z, contents.c_str(), ZIP_FL_NOCASE, &info );
-                (void)success;
-                                debugAssertM(success == 0, zip + ": " + contents + ": zip stat failed.");
-                                requiredMem = info.size;
-            }
-                        zip_close( z );
-            return requiredMem;
+            const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(zip);
+            const ZipArchive::Entry* entry = notNull(archive) ? archive->find(contents) : nullptr;
+            debugAssertM(notNull(entry), zip + ": " + contents + ": zip stat failed.");
+            return notNull(entry) ? int64(entry->size) : -1;
         } else {
         return -1;
         }
@@ -316,15 +296,8 @@ static void _zip_resolveDirectory(String& completeDir, const String& drive, cons
 
 /** assumes that zipDir references a .zip file */
 static bool _zip_zipContains(const String& zipDir, const String& desiredFile){
-    struct zip *z = zip_open( zipDir.c_str(), ZIP_CHECKCONS, nullptr );
-    //the last parameter, an int, determines case sensitivity:
-    //1 is sensitive, 2 is not, 0 is default
-    zip_int64_t test = zip_name_locate( z, desiredFile.c_str(), ZIP_FL_NOCASE );
-    zip_close( z );
-    if(test == -1){
-        return false;
-    }
-    return true;
+    const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(zipDir);
+    return notNull(archive) && notNull(archive->find(desiredFile));
 }
 
 
@@ -764,20 +737,15 @@ static void getFileOrDirListZip(const String& path,
                                 Array<String>& files,
                                 bool wantFiles,
                                 bool includePath){
-    struct zip *z = zip_open( path.c_str(), ZIP_CHECKCONS, nullptr );
-
     Set<String> fileSet;
 
-    int count = zip_get_num_files( z );
-    for( int i = 0; i < count; ++i ) {
-        struct zip_stat info;
-        zip_stat_init( &info );    // TODO: Docs unclear if zip_stat_init is required.
-        zip_stat_index( z, i, ZIP_FL_NOCASE, &info );
-        _zip_addEntry(path, prefix, info.name, fileSet, wantFiles, includePath);
+    const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive(path);
+    if (notNull(archive)) {
+        for (const ZipArchive::Entry& entry : archive->entries()) {
+            _zip_addEntry(path, prefix, entry.name, fileSet, wantFiles, includePath);
+        }
     }
 
-    zip_close( z );
-
     fileSet.getMembers(files);
 }
 
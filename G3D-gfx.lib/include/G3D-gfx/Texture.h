@@ -30,10 +30,12 @@
 #include "G3D-base/Image4unorm8.h"
 #include "G3D-base/PixelTransferBuffer.h"
 #include "G3D-base/BumpMapPreprocess.h"
+#include "G3D-base/BlockCompression.h"
 #include "G3D-base/WeakCache.h"
 #include "G3D-base/FrameName.h"
 #include "G3D-gfx/glheaders.h"
 #include "G3D-gfx/Sampler.h"
+#include <exception>
 
 #ifdef G3D_ENABLE_CUDA
 #include <cuda.h>
@@ -551,9 +553,26 @@ public:
             values by the alpha value. */
         bool                        convertToPremultipliedAlpha;
 
+        /** If positive, fromFile() loads the image reduced by the smallest power of two that 
+            makes neither dimension exceed this, before any other preprocessing. JPEG files are
+            reduced during decoding, so neither the decode time nor the peak memory depends on the
+            full resolution. Default is 0, which loads the full resolution.
+            
+            \sa Image::fromBinaryInput, LoaderSettings::maxDimension, LoaderSettings::memoryBudget */
+        int                         maxDimension;
+
+        /** If true and the texture generates MIP maps, build them on the loading thread with 
+            Image::generateMipChain instead of glGenerateMipmap. The CPU filter is gamma-correct for
+            sRGB textures and preserves the alpha-test coverage of textures detected as AlphaFilter::BINARY,
+            so cutouts such as foliage do not thin out with distance. Formats that Image::resample does
+            not support fall back to glGenerateMipmap. Default is false. */
+        bool                        generateMipMapsOnCPU;
+
         Preprocess() : modulate(Color4::one()), gammaAdjust(1.0f), 
             computeMinMaxMean(true),
-            convertToPremultipliedAlpha(false) {}
+            convertToPremultipliedAlpha(false),
+            maxDimension(0),
+            generateMipMapsOnCPU(false) {}
 
         /** \param a Must be in the form of a table of the fields or appear as
             a call to a static factory method, e.g.,:
@@ -806,9 +825,68 @@ protected:
         /** Used during PREPROCESS when autodetecting formats */
         bool                            preferSRGBForAuto = true;
 
+        /** Set if completeCPULoading() threw on a loader thread. Rethrown by force(). */
+        std::exception_ptr              error;
+
+        /** Nonzero if this texture is block-compressed after PREPROCESS and stored in the
+            block compression cache. \sa setBlockCompressionCacheDirectory */
+        uint64                          blockCompressionKey = 0;
+
+        /** Owns the memory of ptbArray when it holds block-compressed data */
+        shared_ptr<BlockCompression::MipChain> blockCompressed;
+
+        /** Passed to Image::fromBinaryInput during LOAD_FROM_DISK. Combines Preprocess::maxDimension
+            with the LoaderSettings. Set on construction. */
+        int                             maxDimension = 0;
+
         LoadingInfo(NextStep s) : nextStep(s) {}
     };
 
+    /** Fixed-size pool of threads that run completeCPULoading() for lazily loaded textures
+        in priority order. Implemented in Texture_Loader.cpp. */
+    class Loader;
+
+    enum class LoadState {
+        /** Not waiting for the Loader */
+        NONE,
+
+        /** In the Loader's queue */
+        QUEUED,
+
+        /** completeCPULoading() is running on some thread */
+        DECODING,
+
+        /** completeCPULoading() finished. Waiting for force() to upload to the GPU. */
+        DECODED
+    };
+
+    /** Protected by the Loader's mutex */
+    mutable LoadState                 m_loadState = LoadState::NONE;
+
+    /** Estimated size of the decoded image, charged against LoaderSettings::maxPendingDecodedBytes
+        while DECODING or DECODED */
+    int64                             m_loadDecodedBytes = 0;
+
+    /** Size of the file data held in LoadingInfo::binaryInput while QUEUED */
+    int64                             m_loadInputBytes = 0;
+
+    /** \sa setLoadPriority */
+    float                             m_loadPriority = 0.0f;
+
+    /** Queues \a texture for completeCPULoading() on a Loader thread */
+    static void enqueueLoad(const shared_ptr<Texture>& texture, int64 decodedBytes);
+
+    /** Blocks until completeCPULoading() has run, running it on this thread if it has not started */
+    void finishLoad() const;
+
+    /** Removes this from the Loader queue. Called by the destructor. */
+    void cancelLoad();
+
+    /** The maximum dimension at which fromFile() should load a \a width x \a height image,
+        combining \a requested (from Preprocess::maxDimension) with LoaderSettings::maxDimension 
+        and LoaderSettings::memoryBudget. 0 means full resolution. \a bytesPerTexel includes all faces. */
+    static int loadMaxDimension(int requested, int width, int height, int64 bytesPerTexel, bool generateMipMaps);
+
     /** If true, this Texture is waiting for loading and/or upload to the GPU. Set by certain
         lazy initialization paths of Texture::fromFile. This is protected by m_loadingMutex,
         but can be conservatively checked for the false case without a mutex for efficiency. 
@@ -819,19 +897,8 @@ protected:
 
     mutable LoadingInfo*              m_loadingInfo = nullptr;
 
-    /** Protects m_needsForce, m_loadingThread, and m_loadingGLCallback. \sa force()  */
+    /** Protects m_needsForce during force(). \sa force()  */
     mutable std::mutex                m_loadingMutex;
-
-    /** The thread that lazy loads into memory by invoking the m_loadingCPUCallbackQueue
-        callbacks. Not permitted to make any OpenGL calls.
-        Mutable so that it can be deallocated during the const force() method.
-
-        The loading thread advances through m_loadingInfo.nextStep processing
-        until it reaches the UPLOAD_TO_GPU stage. That must be run during force
-        on the GL thread.
-
-        \sa force() */
-    mutable std::thread*              m_loadingThread = nullptr;
     
     static int64                      m_sizeOfAllTexturesInMemory;
     
@@ -853,10 +920,14 @@ protected:
         bool                           needsForce);
 
     /** If the underlying texture has not yet been uploaded to the GPU, then this method immediately 
-        blocks on the loading thread and does not return until the upload is completed. Otherwise it 
+        completes loading and does not return until the upload is completed. Otherwise it 
         does nothing. This should be called on the OpenGL thread. 
+
+        A texture that is still waiting in the loader queue is decoded on the calling thread
+        rather than waiting for its turn, so textures that are actually used are never delayed
+        by a long queue. If a loader thread is already decoding it, this blocks on that thread.
         
-        \sa m_loadingThread, m_loadingGLCallback, m_loadingMutex, m_needsForce */
+        \sa Loader, m_loadingMutex, m_needsForce */
     void force() const;
 
     friend class BufferTexture;
@@ -871,6 +942,31 @@ protected:
         Blocks. Does nothing if GPU loading is already complete. */
     void completeCPULoading();
 
+    /** Increment whenever the block compression cache layout or the encoder output changes */
+    static const uint32 BLOCK_COMPRESSION_CACHE_VERSION = 2;
+
+    /** True if the texture being loaded from a file can be block-compressed and cached.
+        Requires a cache directory, DIM_2D, an AUTO format, MIP-maps, and no bump map preprocessing. */
+    bool blockCompressionEligible() const;
+
+    /** Combines the source file's contents with the Preprocess and sRGB preference. 
+        Does not change the position of \a source. */
+    uint64 blockCompressionKey(BinaryInput& source) const;
+
+    static String blockCompressionCacheFilename(uint64 key);
+
+    /** Fills m_loadingInfo from the cache file for m_loadingInfo->blockCompressionKey and 
+        advances to TRANSFER_TO_GPU. Returns false if there is no valid cache file. */
+    bool loadBlockCompressionCache();
+
+    /** Replaces the preprocessed level 0 in m_loadingInfo with a BC1 (opaque) or BC3 MIP chain 
+        and writes it to the cache. Called at the end of PREPROCESS. */
+    void blockCompressAndSaveCache();
+
+    /** Appends MIP levels generated by Image::generateMipChain to the single level in m_loadingInfo.
+        Called at the end of PREPROCESS when Preprocess::generateMipMapsOnCPU is set. */
+    void generateMipMapsOnCPU();
+
     /** Perform the final GPU step specified in m_loadingInfo.
         It assumes that CPU loading has been completed and that
         the caller is on the GL thread.
@@ -884,6 +980,119 @@ public:
     /** Used to display this Texture in a GuiTextureBox  */
     Visualization                       visualization;
 
+    /** \brief Configuration of the thread pool that decodes textures lazily loaded by fromFile().
+        \sa setLoaderSettings, loaderStats */
+    class LoaderSettings {
+    public:
+        /** Number of decoding threads. Changes take effect only before the first lazy load.
+            The default is one less than the number of hardware threads, at least one and at most four. */
+        int                             numThreads;
+
+        /** Decoding of queued textures pauses while the estimated size of decoded images that have not yet
+            been uploaded by force() exceeds this. At least one texture is always allowed to decode. */
+        int64                           maxPendingDecodedBytes = 1024 * 1024 * 1024;
+
+        /** fromFile() reads each file on the calling thread to obtain its dimensions. While the files
+            held for queued textures exceed this many bytes, newly queued textures release their file
+            data and the loader thread reads the file again when it decodes it. */
+        int64                           maxQueuedInputBytes = 256 * 1024 * 1024;
+
+        /** If positive, fromFile() loads every image reduced by the smallest power of two that makes
+            neither dimension exceed this. Combined with Preprocess::maxDimension by taking the smaller. */
+        int                             maxDimension = 0;
+
+        /** If positive, fromFile() halves the resolution at which it loads a texture while the texture
+            would push sizeOfAllTexturesInMemory() plus the estimated size of textures that are still
+            loading over this many bytes. Textures loaded earlier are never reduced afterward, so 
+            load the most important textures first. */
+        int64                           memoryBudget = 0;
+
+        /** memoryBudget never reduces the longer side of a texture below this */
+        int                             minBudgetDimension = 256;
+
+        LoaderSettings();
+    };
+
+    /** \brief Counters for the thread pool that decodes lazily loaded textures. \sa loaderStats */
+    class LoaderStats {
+    public:
+        /** Textures waiting to begin decoding */
+        int                             queueDepth = 0;
+
+        /** Largest queueDepth since startup */
+        int                             peakQueueDepth = 0;
+
+        /** Textures being decoded right now */
+        int                             decoding = 0;
+
+        /** Textures decoded since startup, including those decoded by force() */
+        int                             decoded = 0;
+
+        /** Queued textures that were destroyed before they were decoded */
+        int                             cancelled = 0;
+
+        /** Queued textures whose file data was released to stay within LoaderSettings::maxQueuedInputBytes */
+        int                             deferredReads = 0;
+
+        /** Textures that force() decoded on the calling thread because they had not begun decoding.
+            Each one stalled rendering. Raise the priority of textures that will soon be visible to reduce this. */
+        int                             forcedDecodes = 0;
+
+        /** Textures that fromFile() loaded at less than their full resolution */
+        int                             reduced = 0;
+
+        int64                           pendingDecodedBytes = 0;
+
+        /** Estimated decoded size of the textures in queueDepth */
+        int64                           queuedDecodedBytes = 0;
+
+        int64                           queuedInputBytes = 0;
+
+        /** Sum of the time spent in decoding, across all threads */
+        RealTime                        totalDecodeTime = 0;
+
+        RealTime                        maxDecodeTime = 0;
+    };
+
+    static void setLoaderSettings(const LoaderSettings& settings);
+
+    static LoaderSettings loaderSettings();
+
+    static LoaderStats loaderStats();
+
+    /** Drops the references that loader threads hold to textures that they have finished decoding,
+        so that textures the application has released, and their file and decoded data, are destroyed.
+        Loader threads cannot drop them because the last reference must be released on the OpenGL thread.
+        Call on the OpenGL thread only. RenderDevice::endFrame() invokes this every frame. */
+    static void releaseLoaderReferences();
+
+    /** \brief Directory in which fromFile() stores block-compressed MIP chains of the
+        2D textures that it loads.
+
+        When set, 2D textures with an AUTO format that generate MIP-maps and have no
+        bump map preprocessing are encoded on the CPU after Preprocess, as BC1 if they
+        are opaque and BC3 otherwise, using BlockCompression. This reduces GPU memory
+        by 4-8x, at some loss of quality. The MIP chain is written to the directory, and
+        later loads of the same file with the same Preprocess and sRGB preference read
+        it instead of decoding and encoding the source image.
+
+        The default is empty, which disables both block compression and the cache.
+        Textures are not reloaded when this changes. */
+    static void setBlockCompressionCacheDirectory(const String& directory);
+
+    /** \copydoc setBlockCompressionCacheDirectory */
+    static const String& blockCompressionCacheDirectory();
+
+    /** Textures that are waiting to be decoded are decoded in decreasing order of priority,
+        and in the order that they were loaded among equal priorities. The default priority
+        is zero. Has no effect if this texture has already begun decoding. 
+
+        Applications that know which textures are visible can raise their priority so that
+        they appear first. Any texture that is used for rendering is decoded immediately
+        regardless of its priority. Renderer::cullAndSort() raises the priority of the textures
+        of visible surfaces via Surface::setLoadPriority(). */
+    void setLoadPriority(float priority) const;
+
     static void getAllTextures(Array<shared_ptr<Texture>>& textures);
     static void getAllTextures(Array<weak_ptr<Texture>>& textures);
 
@@ -1150,6 +1359,15 @@ public:
         bool                                generateMipMaps = true,
         const Preprocess&                   preprocess      = Preprocess::defaults());
 
+    /** Creates a DIM_2D texture whose MIP levels are the elements of \a mipChain, e.g., from
+        Image::generateMipChain. Each level must be half the size of the previous one, rounding down,
+        and all must have the same format.  */
+    static shared_ptr<Texture> fromMipChain
+       (const String&                       name,
+        const Array<shared_ptr<PixelTransferBuffer>>& mipChain,
+        Encoding                            desiredEncoding = Encoding(),
+        const Preprocess&                   preprocess      = Preprocess::defaults());
+
     /** Shorthand for `Texture::fromPixelTransferBuffer(name, image->toPixelTransferBuffer(), ...)`
         \sa Texture::fromMemory  */
     static shared_ptr<Texture> fromImage
@@ -1263,6 +1263,7 @@ void RenderDevice::setSwapBuffersAutomatically(bool b) {
 void RenderDevice::endFrame() {
     --m_beginEndFrame;
     VertexBuffer::resetCacheMarkers();
+    Texture::releaseLoaderReferences();
     
 
     // Because of modal dialogs, this can be higher than 0 but should never be negative or 
@@ -178,10 +178,25 @@ void Texture::completeCPULoading() {
         Array<shared_ptr<PixelTransferBuffer>>& faceArray = m_loadingInfo->ptbArray[0];
 
         debugAssertM(m_loadingInfo->filename[0] != "<white>", "Pseudotextures should have been handled above");    
+        if (isNull(m_loadingInfo->binaryInput)) {
+            // The loader released the file data while this texture was queued
+            m_loadingInfo->binaryInput = new BinaryInput(m_loadingInfo->filename[0], G3D::G3D_LITTLE_ENDIAN);
+        }
+
+        if (blockCompressionEligible()) {
+            m_loadingInfo->blockCompressionKey = blockCompressionKey(*m_loadingInfo->binaryInput);
+            if (loadBlockCompressionCache()) {
+                // Skip decoding and preprocessing entirely
+                delete m_loadingInfo->binaryInput;
+                m_loadingInfo->binaryInput = nullptr;
+                return;
+            }
+        }
+
         if ((m_dimension == DIM_2D) || (m_dimension == DIM_3D)) {
             m_loadingInfo->ptbArray[0].resize(1);
             try {
-                const shared_ptr<Image>& image = Image::fromBinaryInput(*m_loadingInfo->binaryInput);
+                const shared_ptr<Image>& image = Image::fromBinaryInput(*m_loadingInfo->binaryInput, ImageFormat::AUTO(), m_loadingInfo->maxDimension);
 
                 // Convert L8/R8 to RGB8 for OpenGL, unless bump map processing is going to happen and convert it anyway.
                 if ((image->format() == ImageFormat::L8() || image->format() == ImageFormat::R8()) &&
@@ -200,7 +215,9 @@ void Texture::completeCPULoading() {
                 // The first image was already loaded into memory
                 // in compressed form in the binary input for metadata,
                 // so reuse it here.
-                const shared_ptr<Image>& image = (f == 0) ? Image::fromBinaryInput(*m_loadingInfo->binaryInput) : Image::fromFile(m_loadingInfo->filename[f]);
+                const shared_ptr<Image>& image = (f == 0) ? 
+                    Image::fromBinaryInput(*m_loadingInfo->binaryInput, ImageFormat::AUTO(), m_loadingInfo->maxDimension) :
+                    Image::fromFile(m_loadingInfo->filename[f], ImageFormat::AUTO(), m_loadingInfo->maxDimension);
                 if (image->format() == ImageFormat::L8() || image->format() == ImageFormat::R8()) {
                     image->convertToRGB8();
                 }
@@ -256,17 +273,17 @@ void Texture::completeCPULoading() {
                 (f->code == ImageFormat::CODE_RGBA8)) {
 
                 // Copy the source array
-                const int numBytes = iCeil(m_width * m_height * m_depth * f->cpuBitsPerPixel / 8.0f);
                 for (int m = 0; m < numMipMaps; ++m) {
                     for (int f = 0; f < m_loadingInfo->ptbArray[m].size(); ++f) {
                         // No reference because we may assign to ptbArray below
                         const shared_ptr<PixelTransferBuffer> src = m_loadingInfo->ptbArray[m][f];
+                        const int numBytes = iCeil(src->width() * src->height() * m_depth * src->format()->cpuBitsPerPixel / 8.0f);
                         if (src->ownsMemory()) {
                             // Mutate in place
                             void* data = const_cast<void*>(src->mapReadWrite());
                             m_loadingInfo->preprocess.modulateOffsetAndGammaAdjustImage(m_loadingInfo->ptbArray[0][0]->format()->code, data, data, numBytes);
                         } else {
-                            const shared_ptr<PixelTransferBuffer>& dst = CPUPixelTransferBuffer::create(m_width, m_height, src->format());
+                            const shared_ptr<PixelTransferBuffer>& dst = CPUPixelTransferBuffer::create(src->width(), src->height(), src->format());
                             m_loadingInfo->preprocess.modulateOffsetAndGammaAdjustImage(m_loadingInfo->ptbArray[0][0]->format()->code, (void*)src->mapRead(), dst->mapWrite(), numBytes);
                             dst->unmap();
                             // Replace the source with the destination
@@ -398,12 +415,46 @@ void Texture::completeCPULoading() {
         }
 
         debugAssert(notNull(m_encoding.format));
+
+        if (m_loadingInfo->blockCompressionKey != 0) {
+            blockCompressAndSaveCache();
+        }
+
+        if (m_loadingInfo->generateMipMaps && m_loadingInfo->preprocess.generateMipMapsOnCPU &&
+            (m_loadingInfo->ptbArray.size() == 1) && ((m_dimension == DIM_2D) || (m_dimension == DIM_CUBE_MAP)) &&
+            ! m_loadingInfo->ptbArray[0][0]->format()->compressed) {
+            generateMipMapsOnCPU();
+        }
     
         m_loadingInfo->nextStep = LoadingInfo::TRANSFER_TO_GPU;
     }
 }
 
 
+void Texture::generateMipMapsOnCPU() {
+    Image::ResampleSettings settings;
+    settings.treatAsSRGB = (m_encoding.format->colorSpace == ImageFormat::COLOR_SPACE_SRGB);
+    settings.alphaCoverageReference = (m_detectedHint == AlphaFilter::BINARY) ? 0.5f : -1.0f;
+
+    Array<Array<shared_ptr<PixelTransferBuffer>>>& ptbArray = m_loadingInfo->ptbArray;
+    const int numFaces = ptbArray[0].size();
+    Array<shared_ptr<PixelTransferBuffer>> chain;
+    try {
+        for (int f = 0; f < numFaces; ++f) {
+            Image::generateMipChain(ptbArray[0][f], chain, settings);
+            ptbArray.resize(chain.size());
+            for (int m = 1; m < chain.size(); ++m) {
+                ptbArray[m].resize(numFaces);
+                ptbArray[m][f] = chain[m];
+            }
+        }
+    } catch (const Image::Error&) {
+        // Leave the format to glGenerateMipmap
+        ptbArray.resize(1);
+    }
+}
+
+
 void Texture::completeGPULoading() {
     debugAssert(notNull(m_loadingInfo) && 
         (m_loadingInfo->nextStep >= LoadingInfo::TRANSFER_TO_GPU));
@@ -546,24 +597,31 @@ void Texture::force() const {
     // Quick, mutex-less conservative out for the common run-time case
     if (! m_needsForce) { return; }
 
-    m_loadingMutex.lock(); {
-        // Check for race condition
-        if (! m_needsForce) { m_loadingMutex.unlock(); return; }
+    std::lock_guard<std::mutex> guard(m_loadingMutex);
+
+    // Check for race condition
+    if (! m_needsForce) { return; }
 
-        debugAssert(notNull(m_loadingInfo));
-        debugAssert(notNull(m_loadingThread));
+    debugAssert(notNull(m_loadingInfo));
 
-        // Block on the actual loading operation
-        m_loadingThread->join();
-        // Free the callback code
-        delete m_loadingThread;
-        m_loadingThread = nullptr;       
-        // Upload to GL
-        const_cast<Texture*>(this)->completeGPULoading();
+    // Block on the actual loading operation
+    finishLoad();
 
-        debugAssert(isNull(m_loadingInfo));
+    if (m_loadingInfo->error) {
+        // Report decoding failures on this thread, as the synchronous load paths do
+        const std::exception_ptr error = m_loadingInfo->error;
+        delete m_loadingInfo->binaryInput;
+        delete m_loadingInfo;
+        m_loadingInfo = nullptr;
         m_needsForce = false;
-    } m_loadingMutex.unlock();
+        std::rethrow_exception(error);
+    }
+
+    // Upload to GL
+    const_cast<Texture*>(this)->completeGPULoading();
+
+    debugAssert(isNull(m_loadingInfo));
+    m_needsForce = false;
 }
 
 
@@ -1276,8 +1334,10 @@ shared_ptr<Texture> Texture::fromFile
 
         Array<shared_ptr<Image>> images;
         images.resize(files.length());
+        // The dimensions are unknown until the files are decoded, so the memory budget does not apply
+        const int maxDimension = loadMaxDimension(preprocess.maxDimension, 1, 1, 0, false);
         runConcurrently(0, images.size(), [&](int i) {
-            images[i] = Image::fromFile(files[i]);
+            images[i] = Image::fromFile(files[i], ImageFormat::AUTO(), maxDimension);
         });
 
         return Texture::fromPixelTransferBuffer(String("file: ") + FilePath::base(filenameSpec), Image::arrayToPixelTransferBuffer(images), desiredEncoding.format, dimension);
@@ -1354,6 +1414,16 @@ shared_ptr<Texture> Texture::fromFile
         desiredEncoding.format = preferSRGBSpaceForAuto ? ImageFormat::getSRGBFormat(format) : format;
     }
 
+    // Load at reduced resolution if requested or if needed to fit the memory budget
+    const int64 bytesPerTexel = int64(numFaces) * iCeil(format->cpuBitsPerPixel / 8.0f);
+    loadingInfo->maxDimension = loadMaxDimension(preprocess.maxDimension, width, height, bytesPerTexel, generateMipMaps);
+    {
+        int reducedWidth, reducedHeight;
+        Image::reducedSize(width, height, loadingInfo->maxDimension, reducedWidth, reducedHeight);
+        width  = reducedWidth;
+        height = reducedHeight;
+    }
+
     // Allocate instance now and then push all other work else to another thread
     const shared_ptr<Texture>& instance = createShared<Texture>(String("file: ") + FilePath::base(filenameSpec), width, height, depth, dimension, desiredEncoding, 1, true);
     instance->m_loadingInfo = loadingInfo;
@@ -1375,12 +1445,7 @@ shared_ptr<Texture> Texture::fromFile
         instance->completeCPULoading();
         instance->completeGPULoading();
     } else {
-        instance->m_loadingThread = new std::thread([instance]() { instance->completeCPULoading(); });
-#       if defined(G3D_WINDOWS) && 0
-            String sname = String("Loading ") + instance->m_name;
-            std::wstring wname(sname.begin(), sname.end());
-            SetThreadDescription(instance->m_loadingThread->native_handle(), wname.c_str());
-#       endif
+        enqueueLoad(instance, int64(width) * height * depth * bytesPerTexel);
     }
 
     return instance;
@@ -1618,6 +1683,41 @@ shared_ptr<Texture> Texture::fromPixelTransferBuffer
     return t;
 }
 
+
+shared_ptr<Texture> Texture::fromMipChain
+   (const String&                   name,
+    const Array<shared_ptr<PixelTransferBuffer>>& mipChain,
+    Encoding                        desiredEncoding,
+    const Preprocess&               preprocess) {
+
+    debugAssertM(mipChain.size() > 0, "Texture::fromMipChain requires at least one level");
+    const shared_ptr<PixelTransferBuffer>& base = mipChain[0];
+    const shared_ptr<Texture>& t = createShared<Texture>(name, base->width(), base->height(), 1, DIM_2D, desiredEncoding, 1, false);
+    s_allTextures.set((uintptr_t)t.get(), t);
+
+    t->m_loadingInfo = new LoadingInfo(LoadingInfo::PREPROCESS);
+
+    LoadingInfo& info = *t->m_loadingInfo;
+    info.ptbArray.resize(mipChain.size());
+    for (int m = 0; m < mipChain.size(); ++m) {
+        debugAssertM((mipChain[m]->width() == G3D::max(1, base->width() >> m)) && (mipChain[m]->height() == G3D::max(1, base->height() >> m)),
+                     "Each MIP level must be half the size of the previous one");
+        debugAssertM(mipChain[m]->format() == base->format(), "All MIP levels must have the same format");
+        info.ptbArray[m].append(mipChain[m]);
+    }
+
+    info.desiredEncoding   = desiredEncoding;
+    // Because the data are shared, we cannot lazy load
+    info.lazyLoadable      = false;
+    info.generateMipMaps   = false;
+    info.preprocess        = preprocess;
+
+    t->completeCPULoading();
+    t->completeGPULoading();
+
+    return t;
+}
+
 shared_ptr<Texture> Texture::createEmpty
 (const String&                    name,
  int                              width,
@@ -2238,13 +2338,19 @@ bool Texture::isSupportedImage(const String& filename) {
 Texture::~Texture() {
     reallocateHook(m_textureID);
     s_allTextures.remove((uintptr_t)this);
-    if (m_destroyGLTextureInDestructor) {
-        if (notNull(m_loadingThread)) {
-            m_loadingThread->detach();
-            delete m_loadingThread;
-            m_loadingThread = nullptr;
-        }
 
+    // Cancel loading if this was destroyed before anything forced it. m_loadState may only be
+    // read under the Loader's mutex, which cancelLoad() acquires.
+    if (m_needsForce) {
+        cancelLoad();
+    }
+    if (notNull(m_loadingInfo) && m_loadingInfo->lazyLoadable) {
+        delete m_loadingInfo->binaryInput;
+        delete m_loadingInfo;
+        m_loadingInfo = nullptr;
+    }
+
+    if (m_destroyGLTextureInDestructor) {
         m_sizeOfAllTexturesInMemory -= sizeInMemory();
         if (m_textureID != GL_NONE) {
             glDeleteTextures(1, &m_textureID);
@@ -0,0 +1,382 @@
+/**
+  \file G3D-gfx.lib/source/Texture_Loader.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-gfx/Texture.h"
+#include "G3D-base/AsyncFileReader.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/Image.h"
+#include "G3D-base/System.h"
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace G3D {
+
+/**
+  Decodes lazily loaded textures on a fixed number of threads, highest priority first.
+  All Texture::m_load* fields are protected by m_mutex.
+
+  Worker threads never release the last reference to a Texture, because Texture's destructor
+  makes OpenGL calls. A worker hands its reference to m_releaseArray under m_mutex when it is
+  done with a texture, and releaseParked() drops them on the GL thread. Because the worker's own
+  reference outlives anything releaseParked() can drop, it is never the last one.
+*/
+class Texture::Loader {
+private:
+
+    class Entry {
+    public:
+        float               priority;
+
+        /** Breaks ties in first-in-first-out order */
+        uint64              sequence;
+
+        weak_ptr<Texture>   texture;
+
+        /** For std::priority_queue, which pops the largest element */
+        bool operator<(const Entry& other) const {
+            return (priority < other.priority) || ((priority == other.priority) && (sequence > other.sequence));
+        }
+    };
+
+    std::mutex                  m_mutex;
+
+    /** Signaled when the queue or budget changes */
+    std::condition_variable     m_workAvailable;
+
+    /** Signaled when a texture finishes decoding */
+    std::condition_variable     m_decodeFinished;
+
+    /** May contain stale entries for textures whose priority changed, or that have already
+        been decoded by force() */
+    std::priority_queue<Entry>  m_queue;
+
+    uint64                      m_nextSequence = 0;
+
+    std::vector<std::thread>    m_threadArray;
+
+    bool                        m_stop = false;
+
+    Array<shared_ptr<Texture>>  m_releaseArray;
+
+    LoaderSettings              m_settings;
+    LoaderStats                 m_stats;
+
+    Loader() {}
+
+    /** Requires m_mutex */
+    void beginDecode(Texture* t) {
+        debugAssert(t->m_loadState == LoadState::QUEUED);
+        t->m_loadState = LoadState::DECODING;
+        --m_stats.queueDepth;
+        ++m_stats.decoding;
+        m_stats.queuedInputBytes    -= t->m_loadInputBytes;
+        m_stats.queuedDecodedBytes  -= t->m_loadDecodedBytes;
+        m_stats.pendingDecodedBytes += t->m_loadDecodedBytes;
+    }
+
+    /** Requires m_mutex */
+    void endDecode(Texture* t, RealTime time) {
+        t->m_loadState = LoadState::DECODED;
+        --m_stats.decoding;
+        ++m_stats.decoded;
+        m_stats.totalDecodeTime += time;
+        m_stats.maxDecodeTime = G3D::max(m_stats.maxDecodeTime, time);
+    }
+
+    /** Does not require m_mutex. Captures exceptions in the LoadingInfo for force() to rethrow. */
+    static RealTime decode(Texture* t) {
+        const RealTime start = System::time();
+        try {
+            t->completeCPULoading();
+        } catch (...) {
+            t->m_loadingInfo->error = std::current_exception();
+        }
+        return System::time() - start;
+    }
+
+    /** Requires m_mutex */
+    bool canStartDecode() const {
+        return ! m_queue.empty() &&
+            ((m_stats.pendingDecodedBytes < m_settings.maxPendingDecodedBytes) || (m_stats.pendingDecodedBytes == 0));
+    }
+
+    /** Requires m_mutex. Gives the worker's reference to releaseParked() so that it is never the last one. */
+    void park(shared_ptr<Texture>& t) {
+        m_releaseArray.append(t);
+        t.reset();
+    }
+
+    void workerMain() {
+        while (true) {
+            shared_ptr<Texture> t;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_workAvailable.wait(lock, [&]() { return m_stop || canStartDecode(); });
+                if (m_stop) { return; }
+
+                const Entry entry = m_queue.top();
+                m_queue.pop();
+                t = entry.texture.lock();
+                if (isNull(t)) {
+                    // Destroyed before loading. The destructor already counted the cancellation.
+                    continue;
+                }
+
+                if ((t->m_loadState != LoadState::QUEUED) || (t->m_loadPriority != entry.priority)) {
+                    // Stale entry
+                    park(t);
+                    continue;
+                }
+                beginDecode(t.get());
+            }
+
+            const RealTime time = decode(t.get());
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                endDecode(t.get(), time);
+                park(t);
+            }
+            m_decodeFinished.notify_all();
+        }
+    }
+
+public:
+
+    static Loader& instance() {
+        static Loader loader;
+        return loader;
+    }
+
+    ~Loader() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_workAvailable.notify_all();
+        for (std::thread& thread : m_threadArray) {
+            thread.join();
+        }
+        m_releaseArray.clear();
+    }
+
+    /** Drops references held by worker threads. Call on the GL thread only. */
+    void releaseParked() {
+        Array<shared_ptr<Texture>> release;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Array<shared_ptr<Texture>>::swap(release, m_releaseArray);
+        }
+        // Textures may be destroyed here, which locks m_mutex
+        release.clear();
+    }
+
+    /** Called by fromFile on the GL thread after \a t's LoadingInfo is ready for completeCPULoading() */
+    void enqueue(const shared_ptr<Texture>& t, int64 decodedBytes) {
+        releaseParked();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_threadArray.empty()) {
+                for (int i = 0; i < G3D::max(1, m_settings.numThreads); ++i) {
+                    m_threadArray.push_back(std::thread([this]() { workerMain(); }));
+                }
+            }
+
+            LoadingInfo* info = t->m_loadingInfo;
+            const int64 inputBytes = info->binaryInput->getLength();
+            if ((m_stats.queueDepth > 0) && (m_stats.queuedInputBytes + inputBytes > m_settings.maxQueuedInputBytes)) {
+                // Bound the memory held by queued files. completeCPULoading() will read the file again,
+                // ideally from the operating system's cache.
+                delete info->binaryInput;
+                info->binaryInput = nullptr;
+                AsyncFileReader::common()->prefetch(info->filename[0]);
+                t->m_loadInputBytes = 0;
+                ++m_stats.deferredReads;
+            } else {
+                t->m_loadInputBytes = inputBytes;
+                m_stats.queuedInputBytes += inputBytes;
+            }
+
+            t->m_loadDecodedBytes = decodedBytes;
+            t->m_loadPriority = 0.0f;
+            t->m_loadState = LoadState::QUEUED;
+            ++m_stats.queueDepth;
+            m_stats.queuedDecodedBytes += decodedBytes;
+            m_stats.peakQueueDepth = G3D::max(m_stats.peakQueueDepth, m_stats.queueDepth);
+            m_queue.push(Entry{ t->m_loadPriority, m_nextSequence++, t });
+        }
+        m_workAvailable.notify_one();
+    }
+
+    void setPriority(const shared_ptr<Texture>& t, float priority) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if ((t->m_loadState != LoadState::QUEUED) || (t->m_loadPriority == priority)) {
+                return;
+            }
+            t->m_loadPriority = priority;
+            m_queue.push(Entry{ priority, m_nextSequence++, t });
+        }
+        m_workAvailable.notify_one();
+    }
+
+    /** Called by force() on the GL thread. When this returns, completeCPULoading() has finished for \a t. */
+    void finish(Texture* t) {
+        releaseParked();
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (t->m_loadState == LoadState::QUEUED) {
+                // Needed now, so skip the queue and decode on this thread
+                ++m_stats.forcedDecodes;
+                beginDecode(t);
+                lock.unlock();
+                const RealTime time = decode(t);
+                lock.lock();
+                endDecode(t, time);
+            } else {
+                m_decodeFinished.wait(lock, [&]() { return t->m_loadState != LoadState::DECODING; });
+            }
+
+            if (t->m_loadState == LoadState::DECODED) {
+                m_stats.pendingDecodedBytes -= t->m_loadDecodedBytes;
+                t->m_loadState = LoadState::NONE;
+            }
+        }
+        m_workAvailable.notify_all();
+    }
+
+    /** Called by ~Texture. No thread can be decoding \a t because workers hold a reference while decoding.
+        Reads \a t's state under m_mutex, since a worker may have just finished with it. */
+    void cancel(Texture* t) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (t->m_loadState == LoadState::QUEUED) {
+                --m_stats.queueDepth;
+                ++m_stats.cancelled;
+                m_stats.queuedInputBytes -= t->m_loadInputBytes;
+                m_stats.queuedDecodedBytes -= t->m_loadDecodedBytes;
+            } else if (t->m_loadState == LoadState::DECODED) {
+                m_stats.pendingDecodedBytes -= t->m_loadDecodedBytes;
+            } else {
+                debugAssert(t->m_loadState == LoadState::NONE);
+                return;
+            }
+            t->m_loadState = LoadState::NONE;
+        }
+        m_workAvailable.notify_all();
+    }
+
+    void setSettings(const LoaderSettings& settings) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_settings = settings;
+        }
+        m_workAvailable.notify_all();
+    }
+
+    LoaderSettings settings() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_settings;
+    }
+
+    LoaderStats stats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    /** Called by fromFile on the GL thread, before enqueue(). \a residentBytes is sizeOfAllTexturesInMemory(). */
+    int maxDimension(int requested, int width, int height, int64 bytesPerTexel, bool generateMipMaps, int64 residentBytes) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        int result = requested;
+        if ((m_settings.maxDimension > 0) && ((result <= 0) || (m_settings.maxDimension < result))) {
+            result = m_settings.maxDimension;
+        }
+
+        int reducedWidth, reducedHeight;
+        Image::reducedSize(width, height, result, reducedWidth, reducedHeight);
+
+        if (m_settings.memoryBudget > 0) {
+            const int64 committed = residentBytes + m_stats.queuedDecodedBytes + m_stats.pendingDecodedBytes;
+            while (true) {
+                int64 bytes = int64(reducedWidth) * reducedHeight * bytesPerTexel;
+                if (generateMipMaps) {
+                    bytes += bytes / 3;
+                }
+                const int longer = G3D::max(reducedWidth, reducedHeight);
+                if ((committed + bytes <= m_settings.memoryBudget) || ((longer + 1) / 2 < m_settings.minBudgetDimension)) {
+                    break;
+                }
+                result = (longer + 1) / 2;
+                Image::reducedSize(width, height, result, reducedWidth, reducedHeight);
+            }
+        }
+
+        if ((reducedWidth != width) || (reducedHeight != height)) {
+            ++m_stats.reduced;
+        }
+        return result;
+    }
+};
+
+
+Texture::LoaderSettings::LoaderSettings() :
+    numThreads(clamp(int(std::thread::hardware_concurrency()) - 1, 1, 4)) {
+}
+
+
+void Texture::setLoaderSettings(const LoaderSettings& settings) {
+    Loader::instance().setSettings(settings);
+}
+
+
+Texture::LoaderSettings Texture::loaderSettings() {
+    return Loader::instance().settings();
+}
+
+
+Texture::LoaderStats Texture::loaderStats() {
+    return Loader::instance().stats();
+}
+
+
+void Texture::releaseLoaderReferences() {
+    Loader::instance().releaseParked();
+}
+
+
+void Texture::setLoadPriority(float priority) const {
+    if (m_needsForce) {
+        Loader::instance().setPriority(dynamic_pointer_cast<Texture>(const_cast<Texture*>(this)->shared_from_this()), priority);
+    }
+}
+
+
+int Texture::loadMaxDimension(int requested, int width, int height, int64 bytesPerTexel, bool generateMipMaps) {
+    return Loader::instance().maxDimension(requested, width, height, bytesPerTexel, generateMipMaps, sizeOfAllTexturesInMemory());
+}
+
+
+void Texture::enqueueLoad(const shared_ptr<Texture>& texture, int64 decodedBytes) {
+    Loader::instance().enqueue(texture, decodedBytes);
+}
+
+
+void Texture::finishLoad() const {
+    Loader::instance().finish(const_cast<Texture*>(this));
+}
+
+
+void Texture::cancelLoad() {
+    Loader::instance().cancel(this);
+}
+
+} // namespace G3D
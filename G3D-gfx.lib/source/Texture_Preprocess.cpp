@@ -18,6 +18,8 @@ Any Texture::Preprocess::toAny() const {
     a["computeMinMaxMean"] = computeMinMaxMean;
     a["bumpMapPreprocess"] = bumpMapPreprocess;
     a["convertToPremultipliedAlpha"] = convertToPremultipliedAlpha;
+    a["maxDimension"] = maxDimension;
+    a["generateMipMapsOnCPU"] = generateMipMapsOnCPU;
     return a;
 }
 
@@ -28,7 +30,9 @@ bool Texture::Preprocess::operator==(const Preprocess& other) const {
         (gammaAdjust == other.gammaAdjust) &&
         (computeMinMaxMean == other.computeMinMaxMean) &&
         (bumpMapPreprocess == other.bumpMapPreprocess) &&
-        (convertToPremultipliedAlpha == other.convertToPremultipliedAlpha);
+        (convertToPremultipliedAlpha == other.convertToPremultipliedAlpha) &&
+        (maxDimension == other.maxDimension) &&
+        (generateMipMapsOnCPU == other.generateMipMapsOnCPU);
 }
 
 
@@ -48,6 +52,10 @@ Texture::Preprocess::Preprocess(const Any& any) {
                 convertToPremultipliedAlpha = it->value;
             } else if (key == "bumpMapPreprocess") {
                 bumpMapPreprocess = it->value;
+            } else if (key == "maxDimension") {
+                maxDimension = it->value;
+            } else if (key == "generateMipMapsOnCPU") {
+                generateMipMapsOnCPU = it->value;
             } else {
                 any.verify(false, "Illegal key in Texture::PreProcess: " + it->key);
             }
@@ -64,7 +64,10 @@ bool Texture::Encoding::operator==(const Encoding& e) const {
 Any Texture::Specification::toAny() const {
     Any a = Any(Any::TABLE, "Texture::Specification");
     a["filename"]           = filename;
-    a["alphaFilename"]      = alphaFilename;
+    if (! alphaFilename.empty()) {
+        // An empty filename would resolve to the current directory when parsed
+        a["alphaFilename"]  = alphaFilename;
+    }
     a["encoding"]           = encoding;
     a["dimension"]          = toString(dimension);
     a["generateMipMaps"]    = generateMipMaps;
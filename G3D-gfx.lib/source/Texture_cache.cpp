@@ -0,0 +1,185 @@
+/**
+  \file G3D-gfx.lib/source/Texture_cache.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D-gfx/Texture.h"
+#include "G3D-base/Any.h"
+#include "G3D-base/BinaryInput.h"
+#include "G3D-base/BinaryOutput.h"
+#include "G3D-base/Crypto.h"
+#include "G3D-base/FileSystem.h"
+#include "G3D-base/Log.h"
+
+namespace G3D {
+
+static String s_blockCompressionCacheDirectory;
+
+static const char* BLOCK_COMPRESSION_CACHE_MAGIC = "G3D Texture";
+
+void Texture::setBlockCompressionCacheDirectory(const String& directory) {
+    s_blockCompressionCacheDirectory = directory;
+}
+
+
+const String& Texture::blockCompressionCacheDirectory() {
+    return s_blockCompressionCacheDirectory;
+}
+
+
+bool Texture::blockCompressionEligible() const {
+    return ! s_blockCompressionCacheDirectory.empty() &&
+        (m_dimension == DIM_2D) &&
+        (m_numSamples == 1) &&
+        (m_encoding.format == ImageFormat::AUTO()) &&
+        m_loadingInfo->generateMipMaps &&
+        (m_loadingInfo->preprocess.bumpMapPreprocess.mode == BumpMapPreprocess::Mode::NONE);
+}
+
+
+uint64 Texture::blockCompressionKey(BinaryInput& source) const {
+    const String& preprocessText = m_loadingInfo->preprocess.toAny().unparse();
+
+    uint64 hash = Crypto::FNV1A64_BASIS;
+    // Copy the constant, because taking the address of an in-class initialized static member requires a definition
+    const uint32 version = BLOCK_COMPRESSION_CACHE_VERSION;
+    hash = Crypto::fnv1a64(&version, sizeof(version), hash);
+    hash = Crypto::fnv1a64(preprocessText.c_str(), preprocessText.size(), hash);
+    const uint8 preferSRGB = m_loadingInfo->preferSRGBForAuto ? 1 : 0;
+    hash = Crypto::fnv1a64(&preferSRGB, 1, hash);
+    hash = Crypto::fnv1a64(&m_loadingInfo->maxDimension, sizeof(m_loadingInfo->maxDimension), hash);
+
+    const int64 start = source.getPosition();
+    const int64 length = source.size();
+    hash = Crypto::fnv1a64(&length, sizeof(length), hash);
+
+    static const int64 chunkSize = 1 << 20;
+    Array<uint8> buffer;
+    buffer.resize(int(G3D::min(length, chunkSize)));
+    source.setPosition(0);
+    for (int64 remaining = length; remaining > 0; ) {
+        const int64 n = G3D::min(remaining, chunkSize);
+        source.readBytes(buffer.getCArray(), n);
+        hash = Crypto::fnv1a64(buffer.getCArray(), size_t(n), hash);
+        remaining -= n;
+    }
+    source.setPosition(start);
+
+    return hash;
+}
+
+
+String Texture::blockCompressionCacheFilename(uint64 key) {
+    return FilePath::concat(s_blockCompressionCacheDirectory, G3D::format("%016llx.Texture", (unsigned long long)key));
+}
+
+
+static void require(const BinaryInput& b, int64 numBytes) {
+    if ((numBytes < 0) || (b.getLength() - b.getPosition() < numBytes)) {
+        throw "Truncated Texture cache file";
+    }
+}
+
+
+bool Texture::loadBlockCompressionCache() {
+    const uint64 key = m_loadingInfo->blockCompressionKey;
+    const String& filename = blockCompressionCacheFilename(key);
+    if (! FileSystem::exists(filename, false)) {
+        return false;
+    }
+
+    try {
+        BinaryInput b(filename, G3D_LITTLE_ENDIAN);
+
+        // Magic string with its terminator, version, key, and at least the terminator of the preprocess string
+        const int64 magicBytes = int64(strlen(BLOCK_COMPRESSION_CACHE_MAGIC)) + 1;
+        require(b, magicBytes + sizeof(uint32) + sizeof(uint64) + 1);
+        if ((b.readString(magicBytes) != BLOCK_COMPRESSION_CACHE_MAGIC) || (b.readUInt32() != BLOCK_COMPRESSION_CACHE_VERSION) ||
+            (b.readUInt64() != key) || (b.readString() != m_loadingInfo->preprocess.toAny().unparse())) {
+            return false;
+        }
+
+        // min, max, and mean, then the alpha hint
+        require(b, sizeof(float) * 4 * 3 + sizeof(int32));
+        Color4 minValue, maxValue, meanValue;
+        minValue.deserialize(b);
+        maxValue.deserialize(b);
+        meanValue.deserialize(b);
+        const AlphaFilter::Value hint = AlphaFilter::Value(b.readInt32());
+
+        const shared_ptr<BlockCompression::MipChain>& chain = std::make_shared<BlockCompression::MipChain>();
+        chain->deserialize(b);
+        if ((chain->width != m_width) || (chain->height != m_height) || isNull(chain->imageFormat())) {
+            return false;
+        }
+
+        m_min = minValue;
+        m_max = maxValue;
+        m_mean = meanValue;
+        m_detectedHint = hint;
+        m_encoding.format = chain->imageFormat();
+
+        m_loadingInfo->ptbArray.resize(chain->level.size());
+        for (int m = 0; m < chain->level.size(); ++m) {
+            m_loadingInfo->ptbArray[m].resize(1);
+            m_loadingInfo->ptbArray[m][0] = chain->toPixelTransferBuffer(m);
+        }
+        m_loadingInfo->blockCompressed = chain;
+        m_loadingInfo->nextStep = LoadingInfo::TRANSFER_TO_GPU;
+        return true;
+    } catch (...) {
+        debugPrintf("Texture: ignoring unreadable cache file %s\n", filename.c_str());
+        return false;
+    }
+}
+
+
+void Texture::blockCompressAndSaveCache() {
+    const shared_ptr<PixelTransferBuffer>& src = m_loadingInfo->ptbArray[0][0];
+    const ImageFormat::Code code = src->format()->code;
+    if ((m_loadingInfo->ptbArray.size() != 1) ||
+        ((code != ImageFormat::CODE_RGB8) && (code != ImageFormat::CODE_RGBA8) &&
+         (code != ImageFormat::CODE_SRGB8) && (code != ImageFormat::CODE_SRGBA8))) {
+        // Only 8-bit color is block-compressed
+        return;
+    }
+
+    // m_min.a is NaN if the stats were not computed
+    const bool opaque = (src->format()->numComponents == 3) || (m_min.a >= 1.0f);
+    const bool sRGB = (m_encoding.format->colorSpace == ImageFormat::COLOR_SPACE_SRGB);
+
+    // Cutout alpha keeps the same coverage at every level, so that foliage does not thin out with distance
+    const float alphaCoverageReference = (m_detectedHint == AlphaFilter::BINARY) ? 0.5f : -1.0f;
+
+    const shared_ptr<BlockCompression::MipChain>& chain = std::make_shared<BlockCompression::MipChain>();
+    BlockCompression::encodeMipChain(opaque ? BlockCompression::Format::BC1 : BlockCompression::Format::BC3, src, sRGB, *chain, alphaCoverageReference);
+    if (isNull(chain->imageFormat())) {
+        return;
+    }
+
+    m_encoding.format = chain->imageFormat();
+    m_loadingInfo->ptbArray.resize(chain->level.size());
+    for (int m = 0; m < chain->level.size(); ++m) {
+        m_loadingInfo->ptbArray[m].resize(1);
+        m_loadingInfo->ptbArray[m][0] = chain->toPixelTransferBuffer(m);
+    }
+    m_loadingInfo->blockCompressed = chain;
+
+    FileSystem::createDirectory(s_blockCompressionCacheDirectory);
+    BinaryOutput b(blockCompressionCacheFilename(m_loadingInfo->blockCompressionKey), G3D_LITTLE_ENDIAN);
+    b.writeString(BLOCK_COMPRESSION_CACHE_MAGIC);
+    b.writeUInt32(BLOCK_COMPRESSION_CACHE_VERSION);
+    b.writeUInt64(m_loadingInfo->blockCompressionKey);
+    b.writeString(m_loadingInfo->preprocess.toAny().unparse());
+    m_min.serialize(b);
+    m_max.serialize(b);
+    m_mean.serialize(b);
+    b.writeInt32(int32(m_detectedHint.value));
+    chain->serialize(b);
+    b.commit();
+}
+
+} // namespace G3D
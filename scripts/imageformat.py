@@ -120,7 +120,11 @@ AllFormats = [
 {"name":        "STENCIL4",     "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [1, "UNCOMP_FORMAT",     "GL_STENCIL_INDEX4_EXT",              "GL_STENCIL_INDEX",  0, 0, 0, 0, 0, 0, 4, 4, 4,      "GL_UNSIGNED_BYTE", "CLEAR_FORMAT", "NORMALIZED_FIXED_POINT_FORMAT", "ImageFormat::CODE_STENCIL4", "ImageFormat::COLOR_SPACE_NONE"]},
 {"name":        "STENCIL8",     "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [1, "UNCOMP_FORMAT",     "GL_STENCIL_INDEX8_EXT",              "GL_STENCIL_INDEX",  0, 0, 0, 0, 0, 0, 8, 8, 8,      "GL_UNSIGNED_BYTE", "CLEAR_FORMAT", "NORMALIZED_FIXED_POINT_FORMAT", "ImageFormat::CODE_STENCIL8", "ImageFormat::COLOR_SPACE_NONE"]},
 {"name":        "STENCIL16",    "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [1, "UNCOMP_FORMAT",     "GL_STENCIL_INDEX16_EXT",             "GL_STENCIL_INDEX", 0, 0, 0, 0, 0, 0, 16, 16, 16,   "GL_UNSIGNED_SHORT", "CLEAR_FORMAT", "NORMALIZED_FIXED_POINT_FORMAT", "ImageFormat::CODE_STENCIL16", "ImageFormat::COLOR_SPACE_NONE"]},
-{"name":"DEPTH24_STENCIL8" ,    "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [2, "UNCOMP_FORMAT", "GL_DEPTH24_STENCIL8_EXT",    "GL_DEPTH_STENCIL_EXT",0, 0, 0, 0, 0, 24, 8, 32, 32,  "GL_UNSIGNED_INT_24_8", "CLEAR_FORMAT", "NORMALIZED_FIXED_POINT_FORMAT", "ImageFormat::CODE_DEPTH24_STENCIL8", "ImageFormat::COLOR_SPACE_NONE"]}
+{"name":"DEPTH24_STENCIL8" ,    "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [2, "UNCOMP_FORMAT", "GL_DEPTH24_STENCIL8_EXT",    "GL_DEPTH_STENCIL_EXT",0, 0, 0, 0, 0, 24, 8, 32, 32,  "GL_UNSIGNED_INT_24_8", "CLEAR_FORMAT", "NORMALIZED_FIXED_POINT_FORMAT", "ImageFormat::CODE_DEPTH24_STENCIL8", "ImageFormat::COLOR_SPACE_NONE"]},
+{"name":        "R_RGTC1",      "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [1, "COMP_FORMAT ",      "GL_COMPRESSED_RED_RGTC1",                "GL_RED",            0, 0, 0, 0, 0, 0, 0, 64, 64,    "GL_UNSIGNED_BYTE", "OPAQUE_FORMAT", "OTHER", "ImageFormat::CODE_R_RGTC1", "ImageFormat::COLOR_SPACE_RGB"]},
+{"name":        "RG_RGTC2",     "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [2, "COMP_FORMAT ",      "GL_COMPRESSED_RG_RGTC2",                 "GL_RG",             0, 0, 0, 0, 0, 0, 0, 128, 128,  "GL_UNSIGNED_BYTE", "OPAQUE_FORMAT", "OTHER", "ImageFormat::CODE_RG_RGTC2", "ImageFormat::COLOR_SPACE_RGB"]},
+{"name":        "RGBA_BPTC",    "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": True , "methodData": [4, "COMP_FORMAT ",      "GL_COMPRESSED_RGBA_BPTC_UNORM",          "GL_RGBA",           0, 0, 0, 0, 0, 0, 0, 128, 128,  "GL_UNSIGNED_BYTE", "CLEAR_FORMAT", "OTHER", "ImageFormat::CODE_RGBA_BPTC", "ImageFormat::COLOR_SPACE_RGB"]},
+{"name":        "SRGBA_BPTC",   "Implemented" : True, "AlphaVersion": ""                , "hasSRGBVersion": False, "methodData": [4, "COMP_FORMAT ",      "GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM",    "GL_RGBA",           0, 0, 0, 0, 0, 0, 0, 128, 128,  "GL_UNSIGNED_BYTE", "CLEAR_FORMAT", "OTHER", "ImageFormat::CODE_SRGBA_BPTC", "ImageFormat::COLOR_SPACE_SRGB"]}
     ]
 CODE_NUM = len(AllFormats)
 
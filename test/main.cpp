@@ -72,6 +72,12 @@ void testQuat();
 void perfKDTree();
 void testKDTree();
 
+void testDynamicAABBTree();
+
+void testSceneSimulation();
+
+void testSurfaceCuller();
+
 void testSphere();
 
 void testAABox();
@@ -101,11 +107,24 @@ void testBinaryIO();
 void testHugeBinaryIO();
 void perfBinaryIO();
 
+void testAsyncFileReader();
+void perfAsyncFileReader();
+
 void testTextInput();
 void testTextInput2();
+void perfTextInput();
 
 void testTable();
 void testAdjacency();
+void testMeshAlgSimplify();
+
+void testBlockCompression();
+void perfBlockCompression();
+
+void testParseOBJ();
+void perfParseOBJ();
+void testParsePLY();
+void perfParsePLY();
 
 void perfTable();
 
@@ -116,6 +135,7 @@ void testThread();
 void testfilter();
 
 void testAny();
+void perfAny();
 
 void testFastPODTable() {
     typedef FastPODTable<int, int, HashTrait<int>, EqualsTrait<int>, true> TestTable;
@@ -141,10 +161,24 @@ void testsnorm16();
 void testPointHashGrid();
 void perfPointHashGrid();
 
+void testWelder();
+void perfWelder(bool large);
+
 void perfHashTrait();
 
 void testFullRender(bool generateGoldStandard);
 
+void perfTriTree(const String& csvFilename, const String& jsonFilename, bool loadScenes);
+void testTriTreeCache();
+void testCompactTriTree();
+
+void testArticulatedModelCache();
+void testArticulatedModelConcurrentCreate();
+
+void testPathTracerMotionBlur();
+
+void testTextureLoader();
+
 void testTableTable() {
 
     // Test making tables out of tables
@@ -699,9 +733,15 @@ void testCompassDirection() {
 
 int main(int argc, char* argv[]) {
     bool generateGoldStandard = false;
+    bool benchmarkTriTree = false;
+    bool benchmarkTriTreeHeadless = false;
+    bool benchmarkWelder = false;
     if (argc > 1) {
         const String flag = argv[1];
         generateGoldStandard = (flag == "--override");
+        benchmarkTriTree = (flag == "--benchmark-tritree");
+        benchmarkTriTreeHeadless = (flag == "--benchmark-tritree-headless");
+        benchmarkWelder = (flag == "--benchmark-welder");
     }
 
     char x[2000];
@@ -727,6 +767,28 @@ int main(int argc, char* argv[]) {
     settings.rgbBits = 8;
     settings.stencilBits = 0;
     settings.msaaSamples = 1;
+
+    if (benchmarkTriTreeHeadless) {
+        // Only run the ray tracing benchmark on procedural scenes, without a GL context
+        perfTriTree("TriTreeBenchmark.csv", "TriTreeBenchmark.json", false);
+        return 0;
+    }
+
+    if (benchmarkTriTree) {
+        // Only run the ray tracing benchmark, which needs a GL context for loading scenes
+        renderDevice = new RenderDevice();
+        renderDevice->init(settings);
+        perfTriTree("TriTreeBenchmark.csv", "TriTreeBenchmark.json", true);
+        renderDevice->cleanup();
+        delete renderDevice;
+        return 0;
+    }
+
+    if (benchmarkWelder) {
+        // Only run the welder benchmark, including the largest meshes
+        perfWelder(true);
+        return 0;
+    }
     
 #    ifndef _DEBUG
         printf("Performance analysis:\n\n");
@@ -737,6 +799,7 @@ int main(int argc, char* argv[]) {
         perfArray();
 
         perfBinaryIO();
+        perfAsyncFileReader();
 
         perfTable();
 
@@ -750,8 +813,13 @@ int main(int argc, char* argv[]) {
 
         perfTextOutput();
 
+        perfAny();
+        perfTextInput();
+
         measureNormalizationPerformance();
 
+        perfTriTree("", "", false);
+
         if (! renderDevice) {
             renderDevice = new RenderDevice();
         }
@@ -765,6 +833,13 @@ int main(int argc, char* argv[]) {
 
         perfPointHashGrid();
 
+        perfWelder(false);
+
+        perfBlockCompression();
+
+        perfParseOBJ();
+        perfParsePLY();
+
         measureRDPushPopPerformance(renderDevice);
         
         perfKDTree();
@@ -808,6 +883,7 @@ int main(int argc, char* argv[]) {
     testAny();
 
     testBinaryIO();
+    testAsyncFileReader();
 
     testReliableConduit(NetworkDevice::instance());
 
@@ -833,6 +909,10 @@ int main(int argc, char* argv[]) {
     if (renderDevice) {
         testKDTree();
         testGLight();
+        testArticulatedModelCache();
+        testArticulatedModelConcurrentCreate();
+        testPathTracerMotionBlur();
+        testTextureLoader();
     }
 
     if (renderDevice) {
@@ -894,6 +974,10 @@ int main(int argc, char* argv[]) {
     printf("  passed\n");
     testAdjacency();
     printf("  passed\n");
+    testMeshAlgSimplify();
+    testBlockCompression();
+    testParseOBJ();
+    testParsePLY();
     testWildcards();
     printf("  passed\n");
 
@@ -919,6 +1003,16 @@ int main(int argc, char* argv[]) {
 
     testPointHashGrid();
 
+    testWelder();
+
+    testDynamicAABBTree();
+    testTriTreeCache();
+    testCompactTriTree();
+
+    testSceneSimulation();
+
+    testSurfaceCuller();
+
 #   ifdef RUN_SLOW_TESTS
         testHugeBinaryIO();
         printf("  passed\n");
@@ -9,6 +9,7 @@
 
 #include "G3D/G3D.h"
 #include "testassert.h"
+#include "printhelpers.h"
 #include <sstream>
 
 static void testRefCount1() {
@@ -302,11 +303,137 @@ static void testTableReader() {
     testAssert(b == false);
 }
 
+/** Checks everything that operator== ignores */
+static void testSameDetails(const Any& a, const Any& b) {
+    testAssert(a == b);
+    testAssert(a.comment() == b.comment());
+    testAssert(a.source().filename == b.source().filename);
+    testAssert(a.source().line == b.source().line);
+    testAssert(a.source().character == b.source().character);
+    if (a.type() == Any::ARRAY) {
+        for (int i = 0; i < a.size(); ++i) {
+            testSameDetails(a[i], b[i]);
+        }
+    } else if (a.type() == Any::TABLE) {
+        for (const Any::AnyTable::Entry& entry : a.table()) {
+            testSameDetails(entry.value, b[entry.key]);
+        }
+    }
+}
+
+
+/** A serialization version that no build has written */
+static const int BINARY_TEST_FUTURE_VERSION = 100;
+
+static void testBinary() {
+    Any a;
+    a.load("Any-load.txt");
+
+    BinaryOutput out("<memory>", G3D_LITTLE_ENDIAN);
+    a.serialize(out);
+    Array<uint8> bytes;
+    bytes.resize(int(out.size()));
+    out.commit(bytes.getCArray());
+
+    BinaryInput in(bytes.getCArray(), bytes.size(), G3D_LITTLE_ENDIAN);
+    Any b;
+    b.deserialize(in);
+    testSameDetails(a, b);
+    testAssert(a.unparse() == b.unparse());
+
+    // Version 1 stored the text
+    {
+        BinaryOutput old("<memory>", G3D_LITTLE_ENDIAN);
+        old.writeInt32(1);
+        old.writeString32(a.unparse());
+        Array<uint8> oldBytes;
+        oldBytes.resize(int(old.size()));
+        old.commit(oldBytes.getCArray());
+        BinaryInput oldIn(oldBytes.getCArray(), oldBytes.size(), G3D_LITTLE_ENDIAN);
+        Any c;
+        c.deserialize(oldIn);
+        testAssert(a == c);
+    }
+
+    // Truncated input and unknown versions throw rather than reading past the end
+    for (int length = 0; length < bytes.size(); length += 1 + length / 4) {
+        BinaryInput truncated(bytes.getCArray(), length, G3D_LITTLE_ENDIAN);
+        Any t;
+        bool threw = false;
+        try {
+            t.deserialize(truncated);
+        } catch (const ParseError&) {
+            threw = true;
+        }
+        testAssertM(threw, format("Truncated to %d bytes", length));
+    }
+    {
+        Array<uint8> future(bytes);
+        future[0] = uint8(BINARY_TEST_FUTURE_VERSION);
+        BinaryInput in(future.getCArray(), future.size(), G3D_LITTLE_ENDIAN);
+        Any t;
+        bool threw = false;
+        try {
+            t.deserialize(in);
+        } catch (const ParseError&) {
+            threw = true;
+        }
+        testAssert(threw);
+    }
+
+    // Cache round trip, and invalidation when the text changes size
+    const String& cacheDirectory = "tAny-cache";
+    const String& filename = "tAny-cached.Any";
+    a.save(filename);
+    Any::setBinaryCacheDirectory(cacheDirectory);
+    Any fromText, fromCache;
+    fromText.load(filename);
+    Array<String> cacheFiles;
+    FileSystem::getFiles(FilePath::concat(cacheDirectory, "*"), cacheFiles);
+    testAssert(cacheFiles.size() == 1);
+    fromCache.load(filename);
+    testSameDetails(fromText, fromCache);
+
+    // Truncated cache files are ignored and rewritten
+    const String& cacheFilename = FilePath::concat(cacheDirectory, cacheFiles[0]);
+    Array<uint8> cacheContents;
+    {
+        BinaryInput in(cacheFilename, G3D_LITTLE_ENDIAN);
+        cacheContents.resize(int(in.getLength()));
+        in.readBytes(cacheContents.getCArray(), in.getLength());
+    }
+    const int truncatedLengths[] = {1, 5, cacheContents.size() / 2, cacheContents.size() - 1};
+    for (const int length : truncatedLengths) {
+        BinaryOutput out(cacheFilename, G3D_LITTLE_ENDIAN);
+        out.writeBytes(cacheContents.getCArray(), length);
+        out.commit();
+        FileSystem::clearCache();
+        Any fromTruncated;
+        fromTruncated.load(filename);
+        testSameDetails(fromText, fromTruncated);
+        FileSystem::clearCache();
+        testAssertM(FileSystem::size(cacheFilename) == cacheContents.size(), format("Truncated to %d bytes", length));
+    }
+
+    Any modified(Any::TABLE);
+    modified["changed"] = true;
+    modified.save(filename);
+    Any reloaded;
+    reloaded.load(filename);
+    testAssert(reloaded == modified);
+    Any::setBinaryCacheDirectory("");
+
+    FileSystem::removeFile(filename);
+    FileSystem::removeFile(FilePath::concat(cacheDirectory, "*"));
+}
+
+
 void testAny() {
 
     printf("G3D::Any ");
     testTableReader();
     testParse();
+    testBinary();
 
     testRefCount1();
     testRefCount2();
@@ -359,3 +486,52 @@ void testAny() {
     printf("passed\n");
 
 };    // void testAny()
+
+
+void perfAny() {
+    PRINT_SECTION("Performance:: Any", "");
+    PRINT_TEXT("MB", "parse (ms)", "binary", "speedup");
+
+    // Resembles a large generated scene file
+    Random rnd(7, false);
+    Any scene(Any::TABLE, "Scene");
+    scene["name"] = "Generated";
+    Any entities(Any::TABLE);
+    for (int i = 0; i < 20000; ++i) {
+        Any entity(Any::TABLE, "VisibleEntity");
+        entity["model"] = format("model%d", i % 40);
+        entity["frame"] = CFrame::fromXYZYPRDegrees(rnd.uniform(-100, 100), rnd.uniform(0, 10), rnd.uniform(-100, 100), rnd.uniform(0, 360));
+        entity["canChange"] = (i % 3) == 0;
+        entity["visible"] = true;
+        entities[format("entity%d", i)] = entity;
+    }
+    scene["entities"] = entities;
+    const String& text = scene.unparse();
+
+    Stopwatch stopwatch;
+    stopwatch.tick();
+    const Any& parsed = Any::parse(text);
+    stopwatch.tock();
+    const chrono::nanoseconds parseTime = stopwatch.elapsedDuration();
+
+    BinaryOutput out("<memory>", G3D_LITTLE_ENDIAN);
+    parsed.serialize(out);
+    Array<uint8> bytes;
+    bytes.resize(int(out.size()));
+    out.commit(bytes.getCArray());
+
+    Any loaded;
+    stopwatch.tick();
+    {
+        BinaryInput in(bytes.getCArray(), bytes.size(), G3D_LITTLE_ENDIAN, false, false);
+        loaded.deserialize(in);
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds binaryTime = stopwatch.elapsedDuration();
+    testAssert(loaded == parsed);
+
+    printLeader(format("%.1f", text.size() / 1.0e6).c_str());
+    printDurationColumns<std::milli>(parseTime, binaryTime);
+    printf(" %12.2fx\n", double(parseTime.count()) / double(max(binaryTime.count(), chrono::nanoseconds::rep(1))));
+    printf("  %.1f MB text, %.1f MB binary\n", text.size() / 1.0e6, bytes.size() / 1.0e6);
+}
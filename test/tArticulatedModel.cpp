@@ -0,0 +1,174 @@
+/**
+  \file test/tArticulatedModel.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+static String testOBJFilename(int i) {
+    return format("tArticulatedModel%d.obj", i);
+}
+
+
+/** Writes a bumpy sphere with enough triangles that ArticulatedModel builds a TriTree for it */
+static void writeTestOBJ(int i) {
+    const int slices = 24 + 4 * i;
+    const int stacks = 12 + 2 * i;
+    String obj;
+    for (int y = 0; y <= stacks; ++y) {
+        const float phi = pif() * float(y) / float(stacks);
+        for (int x = 0; x < slices; ++x) {
+            const float theta = 2.0f * pif() * float(x) / float(slices);
+            const float r = 1.0f + 0.1f * sin(float(i + 3) * theta) * sin(phi);
+            obj += format("v %f %f %f\n", r * sin(phi) * cos(theta), r * cos(phi) + float(i), r * sin(phi) * sin(theta));
+        }
+    }
+    for (int y = 0; y < stacks; ++y) {
+        for (int x = 0; x < slices; ++x) {
+            const int a = y * slices + x + 1;
+            const int b = y * slices + (x + 1) % slices + 1;
+            obj += format("f %d %d %d %d\n", a, b, b + slices, a + slices);
+        }
+    }
+    writeWholeFile(testOBJFilename(i), obj);
+}
+
+
+static ArticulatedModel::Specification testSpecification(int i) {
+    ArticulatedModel::Specification specification;
+    specification.filename = testOBJFilename(i);
+    // Bypass the in-memory cache so that every create() loads
+    specification.cachable = false;
+    return specification;
+}
+
+
+/** Requires \a a and \a b to have identical geometry and bounds, and to return the same intersections */
+static void testSameModel(const shared_ptr<ArticulatedModel>& a, const shared_ptr<ArticulatedModel>& b) {
+    testAssert(a->geometryArray().size() == b->geometryArray().size());
+    for (int g = 0; g < a->geometryArray().size(); ++g) {
+        const ArticulatedModel::Geometry* ga = a->geometryArray()[g];
+        const ArticulatedModel::Geometry* gb = b->geometryArray()[g];
+        const Array<CPUVertexArray::Vertex>& va = ga->cpuVertexArray.vertex;
+        const Array<CPUVertexArray::Vertex>& vb = gb->cpuVertexArray.vertex;
+        testAssert(va.size() == vb.size());
+        for (int v = 0; v < va.size(); ++v) {
+            testAssert((va[v].position == vb[v].position) && (va[v].normal == vb[v].normal));
+        }
+        testAssert(ga->boxBounds == gb->boxBounds);
+    }
+
+    testAssert(a->meshArray().size() == b->meshArray().size());
+    for (int m = 0; m < a->meshArray().size(); ++m) {
+        const ArticulatedModel::Mesh* ma = a->meshArray()[m];
+        const ArticulatedModel::Mesh* mb = b->meshArray()[m];
+        testAssert(ma->cpuIndexArray.size() == mb->cpuIndexArray.size());
+        for (int i = 0; i < ma->cpuIndexArray.size(); ++i) {
+            testAssert(ma->cpuIndexArray[i] == mb->cpuIndexArray[i]);
+        }
+        testAssert(ma->boxBounds == mb->boxBounds);
+        testAssert(ma->sphereBounds.center == mb->sphereBounds.center);
+        testAssert(isNull(ma->triTree) == isNull(mb->triTree));
+    }
+
+    Random rnd(10, false);
+    for (int r = 0; r < 500; ++r) {
+        const Ray& ray = Ray::fromOriginAndDirection(Point3(rnd.uniform(-3, 3), rnd.uniform(-3, 6), 5), Vector3(rnd.uniform(-0.3f, 0.3f), rnd.uniform(-0.3f, 0.3f), -1).direction());
+        float da = finf(), db = finf();
+        const bool hitA = a->intersect(ray, CFrame(), da);
+        const bool hitB = b->intersect(ray, CFrame(), db);
+        testAssert(hitA == hitB);
+        testAssert(! hitA || (da == db));
+    }
+}
+
+
+static void removeTestFiles(int numFiles) {
+    for (int i = 0; i < numFiles; ++i) {
+        FileSystem::removeFile(testOBJFilename(i));
+    }
+}
+
+
+/** Loads a model from its source, again from the disk cache, and compares them */
+void testArticulatedModelCache() {
+    printf("ArticulatedModel disk cache ");
+
+    writeTestOBJ(0);
+    const String oldDirectory = ArticulatedModel::diskCacheDirectory();
+    ArticulatedModel::setDiskCacheDirectory(".");
+
+    const String& pattern = "*.ArticulatedModel";
+    Array<String> cacheFiles;
+    FileSystem::getFiles(pattern, cacheFiles);
+    for (const String& f : cacheFiles) {
+        FileSystem::removeFile(f);
+    }
+    FileSystem::clearCache();
+
+    const shared_ptr<ArticulatedModel>& cold = ArticulatedModel::create(testSpecification(0));
+    FileSystem::clearCache();
+    cacheFiles.fastClear();
+    FileSystem::getFiles(pattern, cacheFiles);
+    testAssertM(cacheFiles.size() == 1, "The cold load did not write a cache file");
+
+    const shared_ptr<ArticulatedModel>& cached = ArticulatedModel::create(testSpecification(0));
+    testAssert(cached->meshArray().size() > 0);
+    if (Model::useOptimizedIntersect()) {
+        testAssertM(notNull(cached->meshArray()[0]->triTree), "The cached model has no TriTree");
+    }
+    testSameModel(cold, cached);
+
+    FileSystem::removeFile(cacheFiles[0]);
+    removeTestFiles(1);
+    ArticulatedModel::setDiskCacheDirectory(oldDirectory);
+
+    printf("passed\n");
+}
+
+
+/** Loads several models with createConcurrently() and compares each with a serial create() */
+void testArticulatedModelConcurrentCreate() {
+    printf("ArticulatedModel::createConcurrently ");
+
+    const int numModels = 5;
+    const String oldDirectory = ArticulatedModel::diskCacheDirectory();
+    ArticulatedModel::setDiskCacheDirectory("");
+
+    Array<ArticulatedModel::Specification> specificationArray;
+    Array<String> nameArray;
+    for (int i = 0; i < numModels; ++i) {
+        writeTestOBJ(i);
+        specificationArray.append(testSpecification(i));
+        nameArray.append(format("model%d", i));
+    }
+
+    Array<int> finishedIndex;
+    Array<shared_ptr<ArticulatedModel>> concurrentArray;
+    ArticulatedModel::createConcurrently(specificationArray, nameArray, concurrentArray, 3,
+        [&](int index, int numFinished) {
+            finishedIndex.append(index);
+            testAssert(numFinished == finishedIndex.size());
+        });
+
+    testAssert(concurrentArray.size() == numModels);
+    testAssert(finishedIndex.size() == numModels);
+    for (int i = 0; i < numModels; ++i) {
+        testAssertM(finishedIndex.contains(i), "progress was not reported for every model");
+        testAssert(notNull(concurrentArray[i]));
+        testAssert(concurrentArray[i]->name() == nameArray[i]);
+
+        const shared_ptr<ArticulatedModel>& serial = ArticulatedModel::create(specificationArray[i], nameArray[i]);
+        testSameModel(serial, concurrentArray[i]);
+    }
+
+    removeTestFiles(numModels);
+    ArticulatedModel::setDiskCacheDirectory(oldDirectory);
+
+    printf("passed\n");
+}
@@ -0,0 +1,192 @@
+/**
+  \file test/tAsyncFileReader.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+#ifdef G3D_LINUX
+#   include <fcntl.h>
+#   include <unistd.h>
+#endif
+
+static String testFilename(int i) {
+    return format("tAsyncFileReader%d.bin", i);
+}
+
+
+/** Writes \a numBytes of a pattern that depends on \a i */
+static void writeTestFile(int i, int64 numBytes) {
+    BinaryOutput b(testFilename(i), G3D_LITTLE_ENDIAN);
+    for (int64 j = 0; j < numBytes; ++j) {
+        b.writeUInt8(uint8(j * 7 + i));
+    }
+    b.commit();
+}
+
+
+static bool hasTestContents(const AsyncFileReader::Buffer& buffer, int i, int64 numBytes) {
+    if (! buffer.ok() || (buffer.size != numBytes)) {
+        return false;
+    }
+    for (int64 j = 0; j < numBytes; ++j) {
+        if (buffer.data[j] != uint8(j * 7 + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void testAsyncFileReader() {
+    printf("AsyncFileReader ");
+
+    const int64 sizes[] = {0, 1, 4096, 3 * 1024 * 1024 + 17};
+    const int numFiles = 4;
+    for (int i = 0; i < numFiles; ++i) {
+        writeTestFile(i, sizes[i]);
+    }
+
+    {
+        shared_ptr<AsyncFileReader> reader = AsyncFileReader::create(2);
+        testAssert(reader->numThreads() == 2);
+
+        // Futures
+        std::vector<std::future<shared_ptr<AsyncFileReader::Buffer>>> futures;
+        for (int i = 0; i < numFiles; ++i) {
+            reader->prefetch(testFilename(i));
+            futures.push_back(reader->read(testFilename(i)));
+        }
+        for (int i = 0; i < numFiles; ++i) {
+            const shared_ptr<AsyncFileReader::Buffer>& buffer = futures[i].get();
+            testAssert(buffer->filename == testFilename(i));
+            testAssert(hasTestContents(*buffer, i, sizes[i]));
+        }
+
+        // Errors are reported in the buffer
+        reader->prefetch("Grawk");
+        const shared_ptr<AsyncFileReader::Buffer>& missing = reader->read("Grawk").get();
+        testAssert(! missing->ok() && isNull(missing->data) && (missing->size == 0));
+
+        // Zipfile entries
+        const shared_ptr<AsyncFileReader::Buffer>& zipped = reader->read(FileSystem::resolve("apiTest.zip/zipTest/Folder/TestCompare.txt")).get();
+        testAssert(zipped->ok());
+        testAssert(String(reinterpret_cast<const char*>(zipped->data), size_t(zipped->size)) == readWholeFile("TestDir/Test.txt"));
+
+        // Callbacks, which the destructor must wait for
+        std::atomic_int numCorrect(0);
+        for (int k = 0; k < 20; ++k) {
+            const int i = k % numFiles;
+            const int64 size = sizes[i];
+            reader->read(testFilename(i), [&numCorrect, i, size](const shared_ptr<AsyncFileReader::Buffer>& buffer) {
+                if (hasTestContents(*buffer, i, size)) {
+                    ++numCorrect;
+                }
+            });
+        }
+        reader.reset();
+        testAssert(numCorrect == 20);
+    }
+
+    for (int i = 0; i < numFiles; ++i) {
+        FileSystem::removeFile(testFilename(i));
+    }
+
+    printf("passed\n");
+}
+
+
+/** Asks the operating system to drop \a filename from its cache. Returns false if it cannot. */
+static bool evictFromCache(const String& filename) {
+#   ifdef G3D_LINUX
+        const int file = ::open(filename.c_str(), O_RDONLY);
+        if (file < 0) {
+            return false;
+        }
+        // Dirty pages cannot be dropped
+        fdatasync(file);
+        const bool success = (posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0);
+        ::close(file);
+        return success;
+#   else
+        (void)filename;
+        return false;
+#   endif
+}
+
+
+void perfAsyncFileReader() {
+    PRINT_SECTION("Performance:: AsyncFileReader", "");
+
+    const int numFiles = 32;
+    const int64 fileBytes = 4 * 1024 * 1024;
+    for (int i = 0; i < numFiles; ++i) {
+        BinaryOutput b(testFilename(i), G3D_LITTLE_ENDIAN);
+        b.skip(int(fileBytes) - 1);
+        b.writeUInt8(uint8(i));
+        b.commit();
+    }
+
+    bool cold = true;
+    const auto evictAll = [&]() {
+        for (int i = 0; i < numFiles; ++i) {
+            cold = evictFromCache(testFilename(i)) && cold;
+        }
+    };
+
+    Stopwatch stopwatch;
+    const shared_ptr<AsyncFileReader>& reader = AsyncFileReader::create();
+
+    // One blocking read at a time on this thread
+    evictAll();
+    int64 total = 0;
+    stopwatch.tick();
+    for (int i = 0; i < numFiles; ++i) {
+        BinaryInput b(testFilename(i), G3D_LITTLE_ENDIAN);
+        total += b.getLength();
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds blockingTime = stopwatch.elapsedDuration();
+
+    // All reads in flight at once
+    evictAll();
+    stopwatch.tick();
+    {
+        std::vector<std::future<shared_ptr<AsyncFileReader::Buffer>>> futures;
+        for (int i = 0; i < numFiles; ++i) {
+            futures.push_back(reader->read(testFilename(i)));
+        }
+        for (std::future<shared_ptr<AsyncFileReader::Buffer>>& future : futures) {
+            total += future.get()->size;
+        }
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds asyncTime = stopwatch.elapsedDuration();
+
+    // Prefetch everything, then read with BinaryInput
+    evictAll();
+    stopwatch.tick();
+    for (int i = 0; i < numFiles; ++i) {
+        reader->prefetch(testFilename(i));
+    }
+    for (int i = 0; i < numFiles; ++i) {
+        BinaryInput b(testFilename(i), G3D_LITTLE_ENDIAN);
+        total += b.getLength();
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds prefetchTime = stopwatch.elapsedDuration();
+
+    testAssert(total == 3 * numFiles * fileBytes);
+    for (int i = 0; i < numFiles; ++i) {
+        FileSystem::removeFile(testFilename(i));
+    }
+
+    printf("  %d x %d MB files, %s cache\n", numFiles, int(fileBytes / (1024 * 1024)), cold ? "cold" : "warm");
+    PRINT_TEXT("", "blocking (ms)", "async", "prefetch");
+    PRINT_MILLI("read", "", blockingTime, asyncTime, prefetchTime);
+}
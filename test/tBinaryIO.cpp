@@ -180,6 +180,108 @@ static void testCompression() {
 }
 
 
+static void writeMemoryMapTestFile(const String& filename, int numWords) {
+    BinaryOutput b(filename, G3D_LITTLE_ENDIAN);
+    for (int i = 0; i < numWords; ++i) {
+        b.writeUInt32(uint32(i) * 2654435761u);
+    }
+    b.commit();
+}
+
+
+static void testMemoryMapped() {
+    printf("BinaryInput Memory-Mapped Files\n");
+    const int numWords = int(BinaryInput::MEMORY_MAP_MIN_LENGTH / 4) + 1000;
+    writeMemoryMapTestFile("mapped.bin", numWords);
+
+    {
+        BinaryInput b("mapped.bin", G3D_LITTLE_ENDIAN, false, MemoryMappedFile::RANDOM);
+        testAssert(b.isMemoryMapped());
+        testAssert(b.getLength() == int64(numWords) * 4);
+        testAssert(b.readUInt32() == 0);
+        testAssert(b.readUInt32() == 2654435761u);
+
+        // Random access, including the last word
+        for (const int i : {numWords - 1, 7, numWords / 2, 1000}) {
+            b.setPosition(int64(i) * 4);
+            b.prefetch(4096);
+            testAssert(b.readUInt32() == uint32(i) * 2654435761u);
+        }
+        testAssert(b.hasMore());
+        b.setPosition(b.getLength() - 4);
+        b.readUInt32();
+        testAssert(! b.hasMore());
+
+        // Big-endian interpretation of the same pages
+        b.setEndian(G3D_BIG_ENDIAN);
+        b.setPosition(4);
+        const uint32 x = 2654435761u;
+        testAssert(b.readUInt32() == ((x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24)));
+    }
+
+    {
+        const shared_ptr<MemoryMappedFile>& file = MemoryMappedFile::create("mapped.bin");
+        testAssert(notNull(file));
+        BinaryInput b(file, G3D_LITTLE_ENDIAN);
+        testAssert(b.isMemoryMapped());
+        testAssert(b.getCArray() == file->data());
+        Array<uint32> words;
+        b.skip(40);
+        b.readUInt32(words, 100);
+        testAssert(words[99] == uint32(109) * 2654435761u);
+    }
+    FileSystem::removeFile("mapped.bin");
+
+    // Small files are read as before
+    writeMemoryMapTestFile("mapped.bin", 1000);
+    {
+        BinaryInput b("mapped.bin", G3D_LITTLE_ENDIAN);
+        testAssert(! b.isMemoryMapped());
+        b.setPosition(999 * 4);
+        testAssert(b.readUInt32() == uint32(999) * 2654435761u);
+    }
+    FileSystem::removeFile("mapped.bin");
+}
+
+
+/** Time until the first byte of a large file is available */
+static void measureMemoryMappedStartup() {
+    const int numWords = 64 * 1024 * 1024;
+    writeMemoryMapTestFile("mapped.bin", numWords);
+    Stopwatch stopwatch;
+
+    // What the filename constructor does for small files
+    stopwatch.tick();
+    uint32 first = 0;
+    {
+        FILE* file = FileSystem::fopen("mapped.bin", "rb");
+        uint8* buffer = (uint8*)System::alignedMalloc(size_t(numWords) * 4, 16);
+        (void)fread(buffer, size_t(numWords) * 4, 1, file);
+        FileSystem::fclose(file);
+        BinaryInput b(buffer, int64(numWords) * 4, G3D_LITTLE_ENDIAN, false, false);
+        first += b.readUInt32();
+        System::alignedFree(buffer);
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds readTime = stopwatch.elapsedDuration();
+
+    stopwatch.tick();
+    {
+        BinaryInput b("mapped.bin", G3D_LITTLE_ENDIAN);
+        first += b.readUInt32();
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds mapTime = stopwatch.elapsedDuration();
+    testAssert(first == 0);
+
+    FileSystem::removeFile("mapped.bin");
+
+    PRINT_HEADER("256 MB file until first byte");
+    PRINT_MICRO("read", "(us)", readTime);
+    PRINT_MICRO("memory-mapped", "(us)", mapTime);
+}
+
+
 static void measureSerializerPerformance() {
     Array<uint8> x;
     x.resize(1024);
@@ -262,6 +364,7 @@ void perfBinaryIO() {
     PRINT_SECTION("Performance: BinaryOutput", "Measures performance of read/write operations");
     measureOverhead();
     measureSerializerPerformance();
+    measureMemoryMappedStartup();
 }
 
 
@@ -429,4 +532,5 @@ void testBinaryIO() {
     testBasicSerialization();
     testBitSerialization();
     testCompression();
+    testMemoryMapped();
 }
@@ -0,0 +1,123 @@
+/**
+  \file test/tBlockCompression.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+static bool equal(const Array<uint8>& a, const Array<uint8>& b) {
+    return (a.size() == b.size()) && (memcmp(a.getCArray(), b.getCArray(), a.size()) == 0);
+}
+
+
+static const BlockCompression::Format allFormats[] = {
+    BlockCompression::Format::BC1, BlockCompression::Format::BC3, BlockCompression::Format::BC4,
+    BlockCompression::Format::BC5, BlockCompression::Format::BC7 };
+
+/** Smooth gradients in every channel, with alpha cut out in a checkerboard. The size
+    is not a multiple of four, so the edge blocks are partial. */
+static shared_ptr<CPUPixelTransferBuffer> makeTestImage(int width, int height) {
+    const shared_ptr<CPUPixelTransferBuffer>& ptb = CPUPixelTransferBuffer::create(width, height, ImageFormat::RGBA8());
+    uint8* p = static_cast<uint8*>(ptb->buffer());
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x, p += 4) {
+            p[0] = uint8(127.5f + 127.0f * sin(x * 0.05f));
+            p[1] = uint8((x * 255) / width);
+            p[2] = uint8((y * 255) / height);
+            p[3] = (((x / 16) + (y / 16)) & 1) ? 255 : uint8(128.0f + 100.0f * cos(y * 0.1f));
+        }
+    }
+    return ptb;
+}
+
+
+void testBlockCompression() {
+    printf("BlockCompression ");
+
+    const shared_ptr<CPUPixelTransferBuffer>& src = makeTestImage(130, 70);
+    const uint8* original = static_cast<const uint8*>(src->buffer());
+
+    for (const BlockCompression::Format f : allFormats) {
+        Array<uint8> encoded;
+        BlockCompression::encode(f, src, encoded);
+        testAssert(size_t(encoded.size()) == BlockCompression::encodedSize(f, 130, 70));
+
+        // Threading does not change the result
+        Array<uint8> serial;
+        serial.resize(encoded.size());
+        BlockCompression::encode(f, original, 130, 70, serial.getCArray(), true);
+        testAssert(equal(serial, encoded));
+
+        Array<uint8> decoded;
+        decoded.resize(130 * 70 * 4);
+        BlockCompression::decode(f, encoded.getCArray(), 130, 70, decoded.getCArray());
+        const float psnr = BlockCompression::psnr(original, decoded.getCArray(), 130 * 70, BlockCompression::numChannels(f));
+        testAssertM(psnr > 38.0f, format("%s PSNR %f", BlockCompression::toString(f), psnr));
+
+        // Blocks of a single value that every format represents exactly are lossless
+        Array<uint8> flat, flatEncoded, flatDecoded;
+        flat.resize(8 * 8 * 4);
+        flat.setAll(255);
+        flatEncoded.resize(int(BlockCompression::encodedSize(f, 8, 8)));
+        flatDecoded.resize(flat.size());
+        BlockCompression::encode(f, flat.getCArray(), 8, 8, flatEncoded.getCArray());
+        BlockCompression::decode(f, flatEncoded.getCArray(), 8, 8, flatDecoded.getCArray());
+        testAssert(BlockCompression::psnr(flat.getCArray(), flatDecoded.getCArray(), 64, BlockCompression::numChannels(f)) == finf());
+    }
+
+    {
+        // MIP chains round trip through serialization
+        BlockCompression::MipChain chain;
+        BlockCompression::encodeMipChain(BlockCompression::Format::BC3, src, true, chain);
+        testAssert(chain.level.size() == 8);
+        testAssert(chain.levelWidth(7) == 1 && chain.levelHeight(7) == 1);
+        testAssert(chain.imageFormat() == ImageFormat::SRGBA_DXT5());
+        testAssert(BlockCompression::imageFormat(BlockCompression::Format::BC7, true) == ImageFormat::SRGBA_BPTC());
+        testAssert(BlockCompression::imageFormat(BlockCompression::Format::BC7, true)->cpuBitsPerPixel == 8 * BlockCompression::bytesPerBlock(BlockCompression::Format::BC7));
+
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        chain.serialize(b);
+        BinaryInput in(b.getCArray(), b.length(), G3D_LITTLE_ENDIAN, false, true);
+        BlockCompression::MipChain copy;
+        copy.deserialize(in);
+        testAssert(copy.format == chain.format && copy.sRGB && copy.width == 130 && copy.height == 70);
+        testAssert(copy.level.size() == chain.level.size());
+        for (int m = 0; m < copy.level.size(); ++m) {
+            testAssert(equal(copy.level[m], chain.level[m]));
+        }
+
+        // Truncated chains throw instead of reading past the end
+        const int64 truncatedLengths[] = {0, 10, b.length() / 2, b.length() - 1};
+        for (const int64 length : truncatedLengths) {
+            BinaryInput truncated(b.getCArray(), length, G3D_LITTLE_ENDIAN, false, true);
+            BlockCompression::MipChain t;
+            bool threw = false;
+            try {
+                t.deserialize(truncated);
+            } catch (const String&) {
+                threw = true;
+            }
+            testAssert(threw);
+        }
+
+        const shared_ptr<PixelTransferBuffer>& level1 = copy.toPixelTransferBuffer(1);
+        testAssert(level1->width() == 65 && level1->height() == 35);
+        testAssert(level1->size() == BlockCompression::encodedSize(copy.format, 65, 35));
+    }
+
+    printf("passed\n");
+}
+
+
+void perfBlockCompression() {
+    PRINT_SECTION("Performance:: BlockCompression", "");
+    const shared_ptr<CPUPixelTransferBuffer>& src = makeTestImage(2048, 2048);
+    for (const BlockCompression::Format format : allFormats) {
+        printf("%s\n", BlockCompression::measure(format, src).toString().c_str());
+    }
+}
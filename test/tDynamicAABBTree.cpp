@@ -0,0 +1,133 @@
+/**
+  \file test/tDynamicAABBTree.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+static float squaredDistance(const AABox& box, const Point3& point) {
+    return (box.low() - point).max(point - box.high()).max(Vector3::zero()).squaredLength();
+}
+
+
+/** Compares every query against brute force after random insertion, motion, and removal */
+void testDynamicAABBTree() {
+    printf("DynamicAABBTree ");
+
+    const int N = 1000;
+    Random rng(1234, false);
+    DynamicAABBTree<int> tree;
+    Array<AABox> bounds;
+    Array<DynamicAABBTree<int>::Handle> handle;
+    Array<bool> present;
+
+    const auto randomBox = [&]() {
+        const Point3& P = Point3(rng.uniform(-100, 100), rng.uniform(-100, 100), rng.uniform(-100, 100));
+        return AABox(P, P + Vector3(rng.uniform(0, 5), rng.uniform(0, 5), rng.uniform(0, 5)));
+    };
+
+    for (int i = 0; i < N; ++i) {
+        bounds.append(randomBox());
+        handle.append(tree.insert(bounds[i], i, 1 << (i % 3)));
+        present.append(true);
+    }
+
+    // Move everything several times, by amounts both inside and outside the fattened boxes
+    for (int pass = 0; pass < 4; ++pass) {
+        for (int i = 0; i < N; ++i) {
+            const Vector3& delta = Vector3(rng.uniform(-1, 1), rng.uniform(-1, 1), rng.uniform(-1, 1)) * float(pass * 2);
+            bounds[i] = AABox(bounds[i].low() + delta, bounds[i].high() + delta);
+            tree.update(handle[i], bounds[i]);
+        }
+    }
+
+    for (int i = 0; i < N; i += 3) {
+        tree.remove(handle[i]);
+        present[i] = false;
+    }
+    testAssert(tree.size() == N - (N + 2) / 3);
+
+    // Balanced to within a small factor of log2(n)
+    testAssert(tree.height() < 4 * iCeil(log2(float(tree.size()))));
+
+    const uint32 mask = 1 | 4;
+    for (int q = 0; q < 100; ++q) {
+        const Point3& P = Point3(rng.uniform(-100, 100), rng.uniform(-100, 100), rng.uniform(-100, 100));
+
+        // Box
+        const AABox box(P - Vector3(15, 15, 15), P + Vector3(15, 15, 15));
+        Array<int> result;
+        tree.getIntersectingMembers(box, result, mask);
+        int expected = 0;
+        for (int i = 0; i < N; ++i) {
+            if (present[i] && ((mask & (1 << (i % 3))) != 0) && bounds[i].intersects(box)) {
+                ++expected;
+                testAssert(result.contains(i));
+            }
+        }
+        testAssert(result.size() == expected);
+
+        // Sphere
+        const Sphere sphere(P, 20);
+        result.fastClear();
+        tree.getIntersectingMembers(sphere, result);
+        expected = 0;
+        for (int i = 0; i < N; ++i) {
+            expected += (present[i] && (squaredDistance(bounds[i], P) <= square(sphere.radius))) ? 1 : 0;
+        }
+        testAssert(result.size() == expected);
+
+        // Nearest
+        const int k = 5;
+        result.fastClear();
+        tree.getNearestMembers(P, k, result);
+        testAssert(result.size() == k);
+        Array<float> distance;
+        for (int i = 0; i < N; ++i) {
+            if (present[i]) { distance.append(squaredDistance(bounds[i], P)); }
+        }
+        distance.sort();
+        for (int j = 0; j < k; ++j) {
+            testAssert(fuzzyEq(squaredDistance(bounds[result[j]], P), distance[j]));
+        }
+
+        // Ray
+        const Ray& ray = Ray::fromOriginAndDirection(P, Vector3::random(rng));
+        float closest = finf();
+        for (int i = 0; i < N; ++i) {
+            if (present[i]) { closest = min(closest, ray.intersectionTime(bounds[i])); }
+        }
+
+        float maxDistance = finf();
+        tree.intersectRay(ray, maxDistance, [&](int i, float& d) {
+            const float t = ray.intersectionTime(bounds[i]);
+            if (t < d) {
+                d = t;
+                return true;
+            } else {
+                return false;
+            }
+        });
+        testAssert(maxDistance == closest);
+    }
+
+    // A lone member is the root, which must also be tested against the mask
+    {
+        DynamicAABBTree<int> single;
+        single.insert(AABox(Point3(0, 0, 0), Point3(1, 1, 1)), 7, 2);
+        Array<int> result;
+        single.getNearestMembers(Point3(5, 0, 0), 1, result, 1);
+        testAssert(result.size() == 0);
+        single.getIntersectingMembers(AABox(Point3(-1, -1, -1), Point3(2, 2, 2)), result, 1);
+        testAssert(result.size() == 0);
+        single.getNearestMembers(Point3(5, 0, 0), 1, result, 2);
+        testAssert((result.size() == 1) && (result[0] == 7));
+    }
+
+    printf("passed\n");
+}
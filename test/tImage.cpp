@@ -23,12 +23,100 @@ static void testImageLoading() {
     testAssert(notNull(img) && img->format() == ImageFormat::RGBA32F());
 }
 
+static void testImageReducedLoading() {
+    int w, h;
+    testAssert(Image::reducedSize(130, 70, 0, w, h) == 1 && w == 130 && h == 70);
+    testAssert(Image::reducedSize(130, 70, 64, w, h) == 4 && w == 33 && h == 18);
+
+    // JPEG is reduced while decoding, the others after
+    const shared_ptr<Image>& full = Image::fromFile("ImageTest/test-image.png");
+    for (const String& ext : { "png", "jpg", "exr" }) {
+        const shared_ptr<Image>& img = Image::fromFile("ImageTest/test-image." + ext, ImageFormat::AUTO(), 100);
+        testAssert(img->width() == 64 && img->height() == 32);
+    }
+
+    // Each reduced pixel is the mean of the 8x8 block that it covers
+    const shared_ptr<Image>& reduced = Image::fromFile("ImageTest/test-image.png", ImageFormat::AUTO(), 100);
+    testAssert(reduced->format() == ImageFormat::RGB8());
+    for (int y = 0; y < reduced->height(); y += 7) {
+        for (int x = 0; x < reduced->width(); x += 5) {
+            Color3 sum;
+            for (int j = 0; j < 8; ++j) {
+                for (int i = 0; i < 8; ++i) {
+                    sum += full->get<Color3>(x * 8 + i, y * 8 + j);
+                }
+            }
+            const Color3& error = sum / 64.0f - reduced->get<Color3>(x, y);
+            testAssert(G3D::max(fabs(error.r), fabs(error.g), fabs(error.b)) <= 1.0f / 255.0f);
+        }
+    }
+}
+
+
+static void testImageResampling() {
+    // Every filter reproduces a constant image at any size
+    for (const Image::ResampleFilter filter : { Image::ResampleFilter::BOX, Image::ResampleFilter::KAISER, Image::ResampleFilter::LANCZOS }) {
+        const shared_ptr<Image>& flat = Image::create(37, 21, ImageFormat::RGBA8());
+        flat->setAll(Color4unorm8(Color4(0.4f, 0.4f, 0.4f, 0.4f)));
+        Image::ResampleSettings settings;
+        settings.filter = filter;
+        const shared_ptr<Image>& resized = flat->resized(13, 50, settings);
+        for (int y = 0; y < resized->height(); ++y) {
+            for (int x = 0; x < resized->width(); ++x) {
+                testAssert(resized->get<Color4unorm8>(x, y) == Color4unorm8(Color4(0.4f, 0.4f, 0.4f, 0.4f)));
+            }
+        }
+    }
+
+    // sRGB data average in linear space: black and white make 188, not 128
+    const shared_ptr<CPUPixelTransferBuffer>& halves = CPUPixelTransferBuffer::create(2, 2, ImageFormat::SRGB8());
+    uint8* p = static_cast<uint8*>(halves->buffer());
+    for (int i = 0; i < 12; ++i) {
+        p[i] = ((i / 3) & 1) ? 255 : 0;
+    }
+    Image::ResampleSettings box;
+    box.filter = Image::ResampleFilter::BOX;
+    Array<shared_ptr<PixelTransferBuffer>> chain;
+    Image::generateMipChain(halves, chain, box);
+    testAssert(chain.size() == 2);
+    testAssert(static_cast<const uint8*>(chain[1]->mapRead())[0] == 188);
+    chain[1]->unmap();
+
+    // Cutout alpha keeps its coverage through the chain
+    const shared_ptr<Image>& cutout = Image::create(300, 257, ImageFormat::RGBA8());
+    for (int y = 0; y < cutout->height(); ++y) {
+        for (int x = 0; x < cutout->width(); ++x) {
+            cutout->set(x, y, Color4unorm8(unorm8::fromBits(uint8(x)), unorm8::fromBits(uint8(y)), unorm8::zero(),
+                                           ((x / 3 + y / 5) % 4 == 0) ? unorm8::one() : unorm8::zero()));
+        }
+    }
+    Image::ResampleSettings coverage;
+    coverage.alphaCoverageReference = 0.5f;
+    cutout->generateMipChain(chain, coverage);
+    testAssert(chain.size() == 9);
+    for (int m = 0; m < 3; ++m) {
+        testAssert(chain[m]->width() == (300 >> m) && chain[m]->height() == (257 >> m));
+        const shared_ptr<Image>& level = Image::fromPixelTransferBuffer(chain[m]);
+        int covered = 0;
+        for (int y = 0; y < level->height(); ++y) {
+            for (int x = 0; x < level->width(); ++x) {
+                covered += (level->get<Color4unorm8>(x, y).a.bits() >= 128) ? 1 : 0;
+            }
+        }
+        testAssert(fabs(covered / float(level->width() * level->height()) - 0.25f) < 0.02f);
+    }
+    testAssert(chain.last()->width() == 1 && chain.last()->height() == 1);
+}
+
+
 void testImage() {
 
     printf("Image  ");
 
     // Test loading image files
     testImageLoading();
+    testImageReducedLoading();
+    testImageResampling();
 
     shared_ptr<Image> im = Image::create(10, 10, ImageFormat::RGB32F());
 
@@ -0,0 +1,134 @@
+/**
+  \file test/tMeshAlgSimplify.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "testassert.h"
+
+/** Unit sphere with one vertex at each pole and a texture seam at longitude zero,
+    where the first and last columns are colocated but separate vertices */
+static void makeSeamedSphere(int n, Array<Vector3>& vertex, Array<int>& index) {
+    const int W = 2 * n + 1;
+    const int southPole = n * W;
+    for (int j = 0; j <= n; ++j) {
+        for (int i = 0; i < W; ++i) {
+            const float theta = float(j) / float(n) * pif();
+            const float phi   = float(i % (2 * n)) / float(2 * n) * 2.0f * pif();
+            vertex.append((j == 0) ? Vector3(0, 1, 0) : (j == n) ? Vector3(0, -1, 0) :
+                          Vector3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+        }
+    }
+
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i < 2 * n; ++i) {
+            const int a = (j == 0) ? 0 : j * W + i;
+            const int b = (j == 0) ? 0 : a + 1;
+            const int c = (j == n - 1) ? southPole : (j + 1) * W + i;
+            const int d = (j == n - 1) ? southPole : c + 1;
+            if (j > 0) {
+                index.append(a, c, b);
+            }
+            if (j < n - 1) {
+                index.append(b, c, d);
+            }
+        }
+    }
+}
+
+
+/** Number of edges, by position, that do not have exactly two adjacent triangles */
+static int countOpenEdges(const Array<Vector3>& vertex, const Array<int>& index) {
+    Table<Vector3, int> positionTable;
+    Table<uint64, int> edgeTable;
+    for (int i = 0; i < index.size(); i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            bool created = false;
+            int& a = positionTable.getCreate(vertex[index[i + k]], created);
+            if (created) { a = positionTable.size(); }
+            int& b = positionTable.getCreate(vertex[index[i + (k + 1) % 3]], created);
+            if (created) { b = positionTable.size(); }
+            const uint64 key = (uint64(min(a, b)) << 32) | uint64(max(a, b));
+            int& count = edgeTable.getCreate(key, created);
+            count = created ? 1 : count + 1;
+        }
+    }
+
+    int open = 0;
+    for (Table<uint64, int>::Iterator it = edgeTable.begin(); it.isValid(); ++it) {
+        if (it->value != 2) {
+            ++open;
+        }
+    }
+    return open;
+}
+
+
+static float area(const Array<Vector3>& vertex, const Array<int>& index) {
+    float sum = 0.0f;
+    for (int i = 0; i < index.size(); i += 3) {
+        sum += (vertex[index[i + 1]] - vertex[index[i]]).cross(vertex[index[i + 2]] - vertex[index[i]]).length() * 0.5f;
+    }
+    return sum;
+}
+
+
+void testMeshAlgSimplify() {
+    printf("MeshAlg::simplify ");
+
+    {
+        // A flat grid collapses to two triangles without moving its corners
+        Array<Vector3> vertex;
+        Array<int> index, simplified;
+        const int N = 20;
+        for (int z = 0; z <= N; ++z) {
+            for (int x = 0; x <= N; ++x) {
+                vertex.append(Vector3(float(x), 0.0f, float(z)));
+            }
+        }
+        for (int z = 0; z < N; ++z) {
+            for (int x = 0; x < N; ++x) {
+                const int a = z * (N + 1) + x;
+                index.append(a, a + N + 1, a + 1);
+                index.append(a + 1, a + N + 1, a + N + 2);
+            }
+        }
+        const float error = MeshAlg::simplify(vertex, index, simplified, 2, 0.001f);
+        testAssert(simplified.size() == 6);
+        testAssert(error == 0.0f);
+        testAssert(fuzzyEq(area(vertex, simplified), float(N * N)));
+    }
+
+    {
+        // Seams stay closed at every level and the error grows as triangles are removed
+        Array<Vector3> vertex;
+        Array<int> index;
+        makeSeamedSphere(40, vertex, index);
+        testAssert(countOpenEdges(vertex, index) == 0);
+
+        float previousError = 0.0f;
+        for (int target = index.size() / 6; target >= 100; target /= 4) {
+            Array<int> simplified;
+            const float error = MeshAlg::simplify(vertex, index, simplified, target);
+            testAssert(simplified.size() / 3 <= target);
+            testAssert(countOpenEdges(vertex, simplified) == 0);
+            testAssert(error >= previousError);
+            testAssert(error < 0.1f);
+            for (int i = 0; i < simplified.size(); ++i) {
+                testAssert((simplified[i] >= 0) && (simplified[i] < vertex.size()));
+            }
+            previousError = error;
+        }
+
+        // The error bound stops simplification early
+        Array<int> simplified;
+        const float error = MeshAlg::simplify(vertex, index, simplified, 4, 0.01f);
+        testAssert(error <= 0.01f);
+        testAssert(simplified.size() / 3 > 4);
+    }
+
+    printf("passed\n");
+}
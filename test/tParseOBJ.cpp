@@ -0,0 +1,164 @@
+/**
+  \file test/tParseOBJ.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+/** Random OBJ text with groups, material changes, comments, mixed newlines, faces of
+    three to six vertices in all three index styles, and optionally relative indices.
+    The last line has no newline. */
+static String makeOBJ(int numLines, bool relative, uint32 seed) {
+    Random rnd(seed, false);
+    String s;
+    int numVertices = 0;
+    for (int line = 0; line < numLines; ++line) {
+        const int r = rnd.integer(0, 99);
+        if (r < 40) {
+            s += format("v %f %f %.3e\r\n", rnd.uniform(-100, 100), rnd.uniform(-1, 1), rnd.uniform(0, 1e5f));
+            ++numVertices;
+        } else if (r < 50) {
+            s += format("vt %f %f\n", rnd.uniform(), rnd.uniform());
+        } else if (r < 60) {
+            s += format("vn 0 %d 1\n", rnd.integer(0, 4));
+        } else if (r < 62) {
+            s += format("g group%d\n", rnd.integer(0, 6));
+        } else if (r < 64) {
+            s += format("usemtl material%d\n", rnd.integer(0, 2));
+        } else if (r < 65) {
+            s += "# f 1 2 3\n\n";
+        } else if (numVertices >= 3) {
+            s += "f";
+            const int n = rnd.integer(3, 6);
+            for (int i = 0; i < n; ++i) {
+                const int index = (relative && rnd.integer(0, 1)) ? -rnd.integer(1, numVertices) : rnd.integer(1, numVertices);
+                switch (rnd.integer(0, 2)) {
+                case 0:  s += format(" %d/%d/%d", index, index, index); break;
+                case 1:  s += format(" %d//%d", index, index); break;
+                default: s += format(" %d", index); break;
+                }
+            }
+            s += rnd.integer(0, 1) ? "\n" : "\r\n";
+        }
+    }
+    s += "v 1 2 3";
+    return s;
+}
+
+
+template<class T>
+static bool sameArray(const Array<T>& a, const Array<T>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (int i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static bool sameIndex(const ParseOBJ::Index& a, const ParseOBJ::Index& b) {
+    return (a.vertex == b.vertex) && (a.normal == b.normal) && (a.texCoord == b.texCoord);
+}
+
+
+/** Meshes are keyed by material pointers, which differ between parsers, so this matches them by
+    material name */
+static void testSameResult(const ParseOBJ& a, const ParseOBJ& b) {
+    testAssert(sameArray(a.vertexArray, b.vertexArray));
+    testAssert(sameArray(a.normalArray, b.normalArray));
+    testAssert(sameArray(a.texCoord0Array, b.texCoord0Array));
+    testAssert(a.groupTable.size() == b.groupTable.size());
+
+    for (const ParseOBJ::GroupTable::Entry& groupEntry : a.groupTable) {
+        testAssert(b.groupTable.containsKey(groupEntry.key));
+        const shared_ptr<ParseOBJ::Group>& groupB = b.groupTable[groupEntry.key];
+        testAssert(groupEntry.value->meshTable.size() == groupB->meshTable.size());
+
+        for (const ParseOBJ::MeshTable::Entry& meshEntry : groupEntry.value->meshTable) {
+            shared_ptr<ParseOBJ::Mesh> meshB;
+            for (const ParseOBJ::MeshTable::Entry& entryB : groupB->meshTable) {
+                if (isNull(entryB.key) ? isNull(meshEntry.key) : (notNull(meshEntry.key) && (entryB.key->name == meshEntry.key->name))) {
+                    meshB = entryB.value;
+                }
+            }
+            testAssert(notNull(meshB));
+
+            const Array<ParseOBJ::Face>& faceA = meshEntry.value->faceArray;
+            const Array<ParseOBJ::Face>& faceB = meshB->faceArray;
+            testAssert(faceA.size() == faceB.size());
+            for (int f = 0; f < faceA.size(); ++f) {
+                testAssert(faceA[f].size() == faceB[f].size());
+                for (int i = 0; i < faceA[f].size(); ++i) {
+                    testAssert(sameIndex(faceA[f][i], faceB[f][i]));
+                }
+            }
+        }
+    }
+}
+
+
+void testParseOBJ() {
+    printf("ParseOBJ ");
+
+    for (const bool relative : {false, true}) {
+        const String& text = makeOBJ(20000, relative, relative ? 3 : 4);
+        ParseOBJ serial;
+        serial.parse(text.c_str(), text.size(), "", ParseOBJ::Options());
+
+        // Chunks from smaller than a line to larger than the input
+        for (const size_t chunkBytes : {size_t(1), size_t(100), size_t(4096), size_t(8 * 1024 * 1024)}) {
+            ParseOBJ parallel;
+            parallel.parseParallel(text.c_str(), text.size(), "", ParseOBJ::Options(), chunkBytes);
+            testSameResult(serial, parallel);
+        }
+
+        {
+            BinaryOutput b("tParseOBJ.obj", G3D_LITTLE_ENDIAN);
+            b.writeBytes(text.c_str(), text.size());
+            b.commit();
+        }
+        ParseOBJ mapped;
+        mapped.parseFile("tParseOBJ.obj");
+        testSameResult(serial, mapped);
+        FileSystem::removeFile("tParseOBJ.obj");
+    }
+
+    printf("passed\n");
+}
+
+
+void perfParseOBJ() {
+    PRINT_SECTION("Performance:: ParseOBJ", "");
+    PRINT_TEXT("MB", "parse (ms)", "parallel", "speedup");
+
+    const String& text = makeOBJ(6000000, false, 5);
+    Stopwatch stopwatch;
+
+    ParseOBJ serial;
+    stopwatch.tick();
+    serial.parse(text.c_str(), text.size(), "", ParseOBJ::Options());
+    stopwatch.tock();
+    const chrono::nanoseconds serialTime = stopwatch.elapsedDuration();
+
+    ParseOBJ parallel;
+    stopwatch.tick();
+    parallel.parseParallel(text.c_str(), text.size(), "", ParseOBJ::Options());
+    stopwatch.tock();
+    const chrono::nanoseconds parallelTime = stopwatch.elapsedDuration();
+
+    printLeader(format("%d", iRound(text.size() / 1.0e6)).c_str());
+    printDurationColumns<std::milli>(serialTime, parallelTime);
+    printf(" %12.2fx\n", double(serialTime.count()) / double(max(parallelTime.count(), chrono::nanoseconds::rep(1))));
+    printf("  %.2f GB/s serial, %.2f GB/s parallel\n",
+           double(text.size()) / double(max(serialTime.count(), chrono::nanoseconds::rep(1))),
+           double(text.size()) / double(max(parallelTime.count(), chrono::nanoseconds::rep(1))));
+}
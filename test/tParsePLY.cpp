@@ -0,0 +1,165 @@
+/**
+  \file test/tParsePLY.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+/** Binary PLY point cloud with float xyz and uchar rgb, the layout of most scanners */
+static void writeScan(BinaryOutput& b, int numVertices) {
+    const String& header = format("ply\nformat binary_little_endian 1.0\ncomment scan\ncomment second comment\nelement vertex %d\nproperty float x\nproperty float y\nproperty float z\n"
+        "property uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n", numVertices);
+    b.writeBytes(header.c_str(), header.size());
+    for (int v = 0; v < numVertices; ++v) {
+        b.writeFloat32(float(v));
+        b.writeFloat32(-float(v) * 0.5f);
+        b.writeFloat32(1.0f);
+        b.writeUInt8(uint8(v));
+        b.writeUInt8(uint8(v * 3));
+        b.writeUInt8(uint8(v * 7));
+    }
+}
+
+
+/** Big-endian mesh with double positions, a list property between them, and float normals,
+    exercising the general decoder */
+static void writeMesh(BinaryOutput& b, int numVertices) {
+    b.setEndian(G3D_BIG_ENDIAN);
+    const String& header = format("ply\nformat binary_big_endian 1.0\nelement vertex %d\nproperty double x\n"
+        "property list uchar short extra\nproperty double y\nproperty double z\nproperty float nx\nproperty float ny\n"
+        "property float nz\nelement face 1\nproperty list uchar int vertex_index\nend_header\n", numVertices);
+    b.writeBytes(header.c_str(), header.size());
+    for (int v = 0; v < numVertices; ++v) {
+        b.writeFloat64(v + 0.25);
+        b.writeUInt8(uint8(v % 3));
+        for (int i = 0; i < v % 3; ++i) {
+            b.writeInt16(int16(i));
+        }
+        b.writeFloat64(2.0);
+        b.writeFloat64(-v);
+        b.writeFloat32(0.0f);
+        b.writeFloat32(1.0f);
+        b.writeFloat32(0.0f);
+    }
+    b.writeUInt8(3);
+    b.writeInt32(0);
+    b.writeInt32(1);
+    b.writeInt32(2);
+}
+
+
+/** Checks that streaming in chunks of \a chunkSize produces the same positions as ParsePLY::parse */
+static void testStream(const Array<uint8>& file, int chunkSize, bool hasColor, bool hasNormal) {
+    ParsePLY reference;
+    BinaryInput bi(file.getCArray(), file.size(), G3D_LITTLE_ENDIAN, false, false);
+    reference.parse(bi);
+    const int N = reference.vertexProperty.size();
+
+    ParsePLY parser;
+    int next = 0;
+    parser.streamVertices(file.getCArray(), file.size(), [&](const ParsePLY::VertexChunk& chunk) {
+        testAssert(chunk.firstVertex == next);
+        testAssert(chunk.position.size() <= chunkSize);
+        testAssert((chunk.color.size() > 0) == hasColor);
+        testAssert((chunk.normal.size() > 0) == hasNormal);
+        for (int i = 0; i < chunk.position.size(); ++i) {
+            const int v = chunk.firstVertex + i;
+            const float* data = reference.vertexData + v * N;
+            testAssert(chunk.position[i] == Point3(data[0], hasColor ? data[1] : data[2], hasColor ? data[2] : data[3]));
+            if (hasColor) {
+                testAssert(chunk.color[i] == Color4unorm8(unorm8::fromBits(uint8(v)), unorm8::fromBits(uint8(v * 3)), unorm8::fromBits(uint8(v * 7)), unorm8::one()));
+            }
+            if (hasNormal) {
+                testAssert(chunk.normal[i] == Vector3(0, 1, 0));
+            }
+        }
+        next += chunk.position.size();
+    }, chunkSize);
+    testAssert(next == reference.numVertices);
+    testAssert(parser.numVertices == reference.numVertices);
+}
+
+
+void testParsePLY() {
+    printf("ParsePLY ");
+
+    for (const int numVertices : {0, 1, 5, 100001}) {
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        writeScan(b, numVertices);
+        Array<uint8> file;
+        file.resize(int(b.size()));
+        b.commit(file.getCArray());
+        testAssert(ParsePLY::isBinary(file.getCArray(), file.size()));
+        for (const int chunkSize : {1, 7, 1 << 20}) {
+            testStream(file, chunkSize, true, false);
+        }
+    }
+
+    {
+        BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+        writeMesh(b, 50);
+        Array<uint8> file;
+        file.resize(int(b.size()));
+        b.commit(file.getCArray());
+        for (const int chunkSize : {1, 16, 1000}) {
+            testStream(file, chunkSize, false, true);
+        }
+
+        // Skipping the vertices must still find the faces
+        ParsePLY faces;
+        BinaryInput bi(file.getCArray(), file.size(), G3D_LITTLE_ENDIAN, false, false);
+        faces.parse(bi, false);
+        testAssert(isNull(faces.vertexData));
+        testAssert(faces.numFaces == 1);
+        testAssert(faces.faceArray[0].size() == 3 && faces.faceArray[0][2] == 2);
+    }
+
+    printf("passed\n");
+}
+
+
+void perfParsePLY() {
+    PRINT_SECTION("Performance:: ParsePLY", "");
+    PRINT_TEXT("Mvertices", "parse (ms)", "stream", "speedup");
+
+    const int numVertices = 10000000;
+    BinaryOutput b("<memory>", G3D_LITTLE_ENDIAN);
+    writeScan(b, numVertices);
+    Array<uint8> file;
+    file.resize(int(b.size()));
+    b.commit(file.getCArray());
+
+    Stopwatch stopwatch;
+
+    stopwatch.tick();
+    {
+        ParsePLY parser;
+        BinaryInput bi(file.getCArray(), file.size(), G3D_LITTLE_ENDIAN, false, false);
+        parser.parse(bi);
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds parseTime = stopwatch.elapsedDuration();
+
+    Array<Point3> position;
+    stopwatch.tick();
+    {
+        ParsePLY parser;
+        parser.streamVertices(file.getCArray(), file.size(), [&](const ParsePLY::VertexChunk& chunk) {
+            if (chunk.firstVertex == 0) {
+                position.resize(parser.numVertices);
+            }
+            System::memcpy(position.getCArray() + chunk.firstVertex, chunk.position.getCArray(), chunk.position.size() * sizeof(Point3));
+        });
+    }
+    stopwatch.tock();
+    const chrono::nanoseconds streamTime = stopwatch.elapsedDuration();
+
+    printLeader(format("%d", numVertices / 1000000).c_str());
+    printDurationColumns<std::milli>(parseTime, streamTime);
+    printf(" %12.2fx\n", double(parseTime.count()) / double(max(streamTime.count(), chrono::nanoseconds::rep(1))));
+}
@@ -0,0 +1,93 @@
+/**
+  \file test/tPathTracer.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+static const char* testOBJFilename = "tPathTracer.obj";
+
+/** A scene containing one unit square facing +z that moved from x = -0.5 to x = +0.5 since the previous frame */
+static shared_ptr<Scene> createMovingQuadScene() {
+    writeWholeFile(testOBJFilename,
+        "v -0.5 -0.5 0\nv 0.5 -0.5 0\nv 0.5 0.5 0\nv -0.5 0.5 0\n"
+        "f 1 2 3 4\n");
+
+    const shared_ptr<Scene>& scene = Scene::create(nullptr);
+    scene->createModel(Any(String(testOBJFilename)), "quad");
+    const shared_ptr<Entity>& entity = scene->createEntity("VisibleEntity", "mover",
+        Any::parse("VisibleEntity { model = \"quad\"; frame = Point3(-0.5, 0, 0); canChange = true; }"));
+    entity->setFrame(CFrame(Point3(0.5f, 0, 0)));
+    return scene;
+}
+
+
+/** Renders the fraction of each pixel's rays that hit the scene along the middle row of the image */
+static void traceCoverage(const shared_ptr<PathTracer>& pathTracer, bool motionBlur, Array<float>& coverage) {
+    const int width = 64, height = 16;
+    const float quadDistance = 3.0f;
+
+    const shared_ptr<Camera>& camera = Camera::create();
+    camera->setFrame(CFrame(Point3(0, 0, quadDistance)));
+    camera->setFieldOfView(toRadians(60), FOVDirection::HORIZONTAL);
+
+    PathTracer::Options options;
+    options.raysPerPixel = 64;
+    options.maxScatteringEvents = 1;
+    options.motionBlur = motionBlur;
+
+    PathTracer::AOVImages aov;
+    aov.depth = Image::create(width, height, ImageFormat::R32F());
+    pathTracer->traceImage(Image::create(width, height, ImageFormat::RGB32F()), aov, camera, options);
+
+    // Missed rays contribute zero depth, so the average depth is proportional to coverage
+    coverage.resize(width);
+    for (int x = 0; x < width; ++x) {
+        coverage[x] = aov.depth->get<Color1>(Point2int32(x, height / 2)).value / quadDistance;
+    }
+}
+
+
+static int countPartiallyCovered(const Array<float>& coverage) {
+    int count = 0;
+    for (const float c : coverage) {
+        if ((c > 0.1f) && (c < 0.9f)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+
+/** Checks that motion blur smears a moving square across the pixels that it swept over, even
+    when the PathTracer was created with the default TriTree, which cannot trace motion */
+void testPathTracerMotionBlur() {
+    printf("PathTracer motion blur ");
+
+    const shared_ptr<PathTracer>& pathTracer = PathTracer::create();
+    pathTracer->setScene(createMovingQuadScene());
+
+    Array<float> sharp, blurred;
+    traceCoverage(pathTracer, false, sharp);
+    traceCoverage(pathTracer, true, blurred);
+
+    const shared_ptr<TriTreeBase>& tree = dynamic_pointer_cast<TriTreeBase>(pathTracer->triTree());
+    testAssertM(notNull(tree) && tree->supportsMotion() && tree->hasMotion(), "motionBlur did not switch to a TriTree that supports motion");
+
+    // Without blur, only antialiased edges are partially covered. With blur, the square
+    // covers the pixels near its previous and current edges for part of the shutter interval.
+    testAssert(countPartiallyCovered(sharp) <= 4);
+    testAssert(countPartiallyCovered(blurred) >= 10);
+
+    // The left half of the previous pose is only visible with blur
+    testAssert(sharp[0] < 0.1f && sharp[sharp.size() / 2 - 8] < 0.1f);
+    testAssert(blurred[sharp.size() / 2 - 8] > 0.1f);
+
+    FileSystem::removeFile(testOBJFilename);
+    printf("passed\n");
+}
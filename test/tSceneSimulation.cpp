@@ -0,0 +1,68 @@
+/**
+  \file test/tSceneSimulation.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+/** A forest of Entitys whose tracks follow their parents, so that the result depends on simulation order */
+static shared_ptr<Scene> createDependentScene(int numEntities, bool concurrent) {
+    const shared_ptr<Scene>& scene = Scene::create(nullptr);
+    scene->setConcurrentSimulation(concurrent);
+
+    // Insert children ahead of their parents so that the scene must sort them
+    for (int i = numEntities - 1; i >= 0; --i) {
+        const int parent = (i - 1) / 4;
+        const String& track = (i < 8) ?
+            format("orbit(%d, %d)", 2 + i, 3 + i) :
+            format("transform(entity(\"e%d\"), orbit(%f, %f))", parent, 0.5f + (i % 7) * 0.25f, 1.0f + (i % 5));
+        const Any& any = Any::parse(format("VisibleEntity { canChange = true; track = %s; }", track.c_str()));
+        scene->createEntity("VisibleEntity", format("e%d", i), any);
+
+        if (i % 97 == 0) {
+            // Some Entitys opt out of concurrent simulation
+            scene->entity(format("e%d", i))->setConcurrentSimulation(false);
+        }
+    }
+
+    return scene;
+}
+
+
+/** Simulates the same dependent scene serially and concurrently and requires identical frames */
+void testSceneSimulation() {
+    printf("Scene::onSimulation determinism ");
+
+    const int N = 2000;
+    const shared_ptr<Scene>& serial = createDependentScene(N, false);
+    const shared_ptr<Scene>& concurrent = createDependentScene(N, true);
+
+    for (int step = 0; step < 30; ++step) {
+        const SimTime dt = 1.0 / 60.0;
+        serial->onSimulation(dt);
+        concurrent->onSimulation(dt);
+
+        for (int i = 0; i < N; ++i) {
+            const String& name = format("e%d", i);
+            testAssertM(serial->entity(name)->frame() == concurrent->entity(name)->frame(), name);
+        }
+    }
+
+    // Removing an Entity changes the dependency levels
+    serial->removeEntity("e3");
+    concurrent->removeEntity("e3");
+    serial->onSimulation(1.0 / 60.0);
+    concurrent->onSimulation(1.0 / 60.0);
+    for (int i = 0; i < N; ++i) {
+        if (i == 3) { continue; }
+        const String& name = format("e%d", i);
+        testAssertM(serial->entity(name)->frame() == concurrent->entity(name)->frame(), name);
+    }
+
+    printf("passed\n");
+}
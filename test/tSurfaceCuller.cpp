@@ -0,0 +1,165 @@
+/**
+  \file test/tSurfaceCuller.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+/** An opaque box that needs no GPU, for testing culling */
+class BoxSurface : public Surface {
+protected:
+    CFrame      m_frame;
+    AABox       m_box;
+
+public:
+
+    BoxSurface(const CFrame& frame, const AABox& box) : m_frame(frame), m_box(box) {}
+
+    virtual void getCoordinateFrame(CoordinateFrame& cframe, bool previous = false) const override {
+        cframe = m_frame;
+    }
+
+    virtual void getObjectSpaceBoundingBox(AABox& box, bool previous = false) const override {
+        box = m_box;
+    }
+
+    virtual void getObjectSpaceBoundingSphere(Sphere& sphere, bool previous = false) const override {
+        m_box.getBounds(sphere);
+    }
+
+    virtual bool getObjectSpaceOccluderGeometry(Array<int>& index, Array<Point3>& vertex, int maxTriangles, bool previous = false) const override {
+        index.fastClear();
+        vertex.fastClear();
+        if (maxTriangles < 12) {
+            return false;
+        }
+
+        for (int c = 0; c < 8; ++c) {
+            vertex.append(m_box.corner(c));
+        }
+        // Two triangles per face of the AABox::corner ordering
+        static const int face[6][4] = { {0, 1, 2, 3}, {4, 5, 6, 7}, {0, 1, 5, 4}, {3, 2, 6, 7}, {0, 3, 7, 4}, {1, 2, 6, 5} };
+        for (int f = 0; f < 6; ++f) {
+            index.append(face[f][0], face[f][1], face[f][2]);
+            index.append(face[f][0], face[f][2], face[f][3]);
+        }
+        return true;
+    }
+
+    virtual TransparencyType transparencyType() const override {
+        return TransparencyType::NONE;
+    }
+
+    virtual void renderWireframeHomogeneous(RenderDevice* rd, const Array<shared_ptr<Surface> >& surfaceArray, const Color4& color, bool previous) const override {}
+
+    virtual bool canBeFullyRepresentedInGBuffer(const GBuffer::Specification& specification) const override {
+        return false;
+    }
+
+    virtual void render(RenderDevice* rd, const LightingEnvironment& environment, RenderPassType passType) const override {}
+
+    virtual void setStorage(ImageStorage newStorage) override {}
+};
+
+
+/** The frustum test that Surface::cull used before it shared SurfaceCuller's SIMD path */
+static bool referenceCulled(const shared_ptr<Surface>& surface, const Array<Plane>& clipPlanes) {
+    CFrame frame;
+    AABox osBox;
+    surface->getCoordinateFrame(frame);
+    surface->getObjectSpaceBoundingBox(osBox);
+    return osBox.isEmpty() || frame.toWorldSpace(osBox).culledBy(clipPlanes);
+}
+
+
+static void testFrustumCulling() {
+    Projection projection;
+    projection.setFieldOfViewAngleDegrees(60);
+    projection.setFarPlaneZ(-200);
+    const Rect2D& viewport = Rect2D::xywh(0, 0, 800, 600);
+    const CFrame& cameraFrame = CFrame::fromXYZYPRDegrees(3, 1, 2, 30, -10, 5);
+
+    Array<Plane> clipPlanes;
+    projection.getClipPlanes(viewport, clipPlanes);
+    for (Plane& plane : clipPlanes) {
+        plane = cameraFrame.toWorldSpace(plane);
+    }
+
+    // Rotated boxes scattered around and beyond the frustum, plus an empty one.
+    // 1001 is not a multiple of the SIMD width.
+    Random rng(0xc011, false);
+    Array<shared_ptr<Surface>> surfaceArray;
+    for (int i = 0; i < 1000; ++i) {
+        const CFrame& frame = CFrame::fromXYZYPRDegrees(rng.uniform(-150, 150), rng.uniform(-150, 150), rng.uniform(-250, 50),
+            rng.uniform(0, 360), rng.uniform(-90, 90), rng.uniform(0, 360));
+        const Vector3& extent = Vector3(rng.uniform(0.1f, 10), rng.uniform(0.1f, 10), rng.uniform(0.1f, 10));
+        surfaceArray.append(std::make_shared<BoxSurface>(frame, AABox(-extent, extent)));
+    }
+    surfaceArray.append(std::make_shared<BoxSurface>(CFrame(), AABox::empty()));
+
+    const shared_ptr<SurfaceCuller>& culler = SurfaceCuller::create();
+    testAssertM(! culler->settings().occlusionCulling, "Occlusion culling must be opt-in");
+    Array<shared_ptr<Surface>> fromCuller;
+    culler->cull(cameraFrame, projection, viewport, surfaceArray, fromCuller);
+
+    Array<shared_ptr<Surface>> fromSurface;
+    Surface::cull(cameraFrame, projection, viewport, surfaceArray, fromSurface);
+
+    Array<shared_ptr<Surface>> fromReference;
+    for (const shared_ptr<Surface>& surface : surfaceArray) {
+        if (! referenceCulled(surface, clipPlanes)) {
+            fromReference.append(surface);
+        }
+    }
+
+    testAssert(fromReference.size() > 0 && fromReference.size() < surfaceArray.size());
+    testAssert(fromCuller.size() == fromReference.size());
+    testAssert(fromSurface.size() == fromReference.size());
+    for (int i = 0; i < fromReference.size(); ++i) {
+        testAssert(fromCuller[i] == fromReference[i]);
+        testAssert(fromSurface[i] == fromReference[i]);
+    }
+    testAssert(culler->stats().occlusionCulled == 0);
+    testAssert(culler->stats().visible == fromReference.size());
+}
+
+
+static void testOcclusionCulling() {
+    Projection projection;
+    projection.setFieldOfViewAngleDegrees(60);
+    const Rect2D& viewport = Rect2D::xywh(0, 0, 800, 600);
+    const CFrame cameraFrame;
+
+    // A wall across the whole view, a box hidden behind it, a box in front of it,
+    // and a box behind it that is visible over its top edge
+    const shared_ptr<Surface>& wall   = std::make_shared<BoxSurface>(CFrame::fromXYZYPRDegrees(0, 0, -10), AABox(Point3(-20, -20, -0.5f), Point3(20, 2, 0.5f)));
+    const shared_ptr<Surface>& hidden = std::make_shared<BoxSurface>(CFrame::fromXYZYPRDegrees(0, 0, -30), AABox(Point3(-1, -1, -1), Point3(1, 1, 1)));
+    const shared_ptr<Surface>& front  = std::make_shared<BoxSurface>(CFrame::fromXYZYPRDegrees(0, 0, -5),  AABox(Point3(-1, -1, -1), Point3(1, 1, 1)));
+    const shared_ptr<Surface>& above  = std::make_shared<BoxSurface>(CFrame::fromXYZYPRDegrees(0, 15, -40), AABox(Point3(-1, -1, -1), Point3(1, 1, 1)));
+    Array<shared_ptr<Surface>> surfaceArray;
+    surfaceArray.append(wall, hidden, front, above);
+
+    const shared_ptr<SurfaceCuller>& culler = SurfaceCuller::create();
+    culler->settings().occlusionCulling = true;
+    Array<shared_ptr<Surface>> visible;
+    culler->cull(cameraFrame, projection, viewport, surfaceArray, visible);
+
+    testAssert(culler->stats().occluders >= 1);
+    testAssert(culler->stats().occlusionCulled == 1);
+    testAssert(visible.size() == 3);
+    testAssert(! visible.contains(hidden));
+    testAssert(visible.contains(wall) && visible.contains(front) && visible.contains(above));
+}
+
+
+void testSurfaceCuller() {
+    printf("SurfaceCuller ");
+    testFrustumCulling();
+    testOcclusionCulling();
+    printf("passed\n");
+}
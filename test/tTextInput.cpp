@@ -7,12 +7,14 @@
   Available under the BSD License
 */
 #include "G3D/G3D.h"
+#include "printhelpers.h"
 #include "testassert.h"
 
 static void tfunc1();
 static void tfunc2();
 static void tCommentTokens();
 static void tNewlineTokens();
+static void tTokenView();
 
 void testTextInput() {
     printf("TextInput\n");
@@ -329,6 +331,7 @@ void testTextInput() {
     
     tCommentTokens();
     tNewlineTokens();
+    tTokenView();
 }
 
     // these defines are duplicated in tTextInput2.cpp
@@ -507,3 +510,223 @@ static void tNewlineTokens() {
         CHECK_END_TOKEN(ti,         6, 1);
     }
 }
+
+
+/** Text in the style of a scene .Any file */
+static String makeAnyText(int numEntities) {
+    Random rnd(10, false);
+    String s = "/* -*- c++ -*- */\n{\n    name = \"Generated\";\n    entities = {\n";
+    for (int i = 0; i < numEntities; ++i) {
+        s += format("        object%d = VisibleEntity {\n", i);
+        s += format("            model = \"model%d\";\n", rnd.integer(0, 20));
+        s += format("            frame = CFrame::fromXYZYPRDegrees(%g, %g, %.4f, %d, 0, -%g);\n",
+                    rnd.uniform(-100, 100), rnd.uniform(0, 10), rnd.uniform(-100, 100), rnd.integer(0, 359), rnd.uniform(0, 90));
+        s += format("            canChange = %s; // Static geometry\n", rnd.integer(0, 1) ? "true" : "false");
+        s += format("            scale = %.6e;\n", rnd.uniform(0.01f, 100.0f));
+        s += "        };\n\n";
+    }
+    s += "    };\n}\n";
+    return s;
+}
+
+
+/** Text in the style of a GLSL shader */
+static String makeGLSLText(int numFunctions) {
+    Random rnd(11, false);
+    String s = "#version 410\n#include <g3dmath.glsl>\n\nuniform sampler2D lambertianBuffer;\n\n";
+    for (int i = 0; i < numFunctions; ++i) {
+        s += format("/** Helper %d */\nvec3 shade%d(in vec3 n, in vec3 w_i, float alpha) {\n", i, i);
+        s += format("    float cos_i = max(dot(n, w_i), 0.0) * %ff;\n", rnd.uniform());
+        s += format("    vec3 result = vec3(%g, %g, %g) * cos_i + texture(lambertianBuffer, n.xy * 0.5 + 0.5).rgb;\n",
+                    rnd.uniform(), rnd.uniform(), rnd.uniform());
+        s += "    for (int j = 0; j < 4; ++j) { result *= (alpha >= 0.5) ? 1.0 : -0.25; }\n";
+        s += "    return result; // Done\n}\n\n";
+    }
+    return s;
+}
+
+
+/** Checks that views match the owning tokens exactly */
+static void checkSameTokens(const String& text, const TextInput::Settings& settings) {
+    TextInput expected(TextInput::FROM_STRING, text, settings);
+    TextInput actual(TextInput::FROM_STRING, text, settings);
+    Random rnd(7, false);
+
+    while (true) {
+        const Token& e = expected.read();
+        TokenView v;
+        if (rnd.integer(0, 3) == 0) {
+            // Peeking must not consume input
+            TokenView peeked;
+            actual.peek(peeked);
+            testAssert(actual.hasMore() == (e.type() != Token::END));
+            actual.read(v);
+            testAssert((peeked.data() == v.data()) && (peeked.length() == v.length()));
+        } else if (rnd.integer(0, 7) == 0) {
+            // Token and view reads interleave
+            const Token& t = actual.read();
+            actual.push(t);
+            actual.read(v);
+        } else {
+            actual.read(v);
+        }
+
+        testAssert(v.type() == e.type());
+        testAssert(v.extendedType() == e.extendedType());
+        testAssert(v == e.string());
+        testAssert(v.line() == e.line());
+        testAssert(v.character() == e.character());
+        testAssert(v.bytePosition() == e.bytePosition());
+        testAssert(v.boolean() == e.boolean());
+        testAssert((v.type() != Token::NUMBER) || (v.number() == e.number()) || (isNaN(v.number()) && isNaN(e.number())));
+
+        if (e.type() == Token::END) {
+            break;
+        }
+    }
+}
+
+
+static void tTokenView() {
+    const char* text[] = {
+        "",
+        "  \t\n",
+        "foo\nbar\r\nbaz\r  qux",
+        "x = -1.5e3f, y=+2, z = .25 - -.5 ->w; q = 0x1Ff + -0x10 - 1e 7.",
+        "true false TRUE nan inf -inf +inf 1.#INF00 -1.#IND 1.#QNAN",
+        "\"plain\" \"with \\\"escape\\\"\" 'single' \"two\nlines\" \"crlf\r\nstring\" \"unterminated",
+        "a /* block\r\n comment */ b // line comment\n c # other ; another\n d",
+        "@ ( ) , ; { } [ ] # $ ? % :: := == => != ~= ^= >= >> << <- |- && ... .. \\#",
+        "\x80\xff",
+    };
+
+    TextInput::Settings settings[5];
+    settings[1].generateCommentTokens = true;
+    settings[1].generateNewlineTokens = true;
+    settings[2].signedNumbers = false;
+    settings[2].otherCommentCharacter = '#';
+    settings[2].otherCommentCharacter2 = ';';
+    settings[3].caseSensitive = false;
+    settings[3].escapeSequencesInStrings = false;
+    settings[3].singleQuotedStrings = false;
+    settings[3].proofSymbols = true;
+    settings[4].msvcFloatSpecials = false;
+    settings[4].simpleFloatSpecials = false;
+    settings[4].otherCommentCharacter = '#';
+    settings[4].generateCommentTokens = true;
+
+    for (int s = 0; s < 5; ++s) {
+        for (int i = 0; i < 9; ++i) {
+            try {
+                checkSameTokens(text[i], settings[s]);
+            } catch (const ParseError&) {
+                // Invalid input for these settings; the owning tokens threw first
+            }
+        }
+        checkSameTokens(makeAnyText(20), settings[s]);
+        checkSameTokens(makeGLSLText(20), settings[s]);
+    }
+
+    {
+        // Numbers parse exactly like sscanf
+        Random rnd(3, false);
+        for (int i = 0; i < 20000; ++i) {
+            const double x = rnd.uniform(-1, 1) * pow(10.0, rnd.uniform(-30, 30));
+            for (const char* f : {"%g", "%.17g", "%.3f", "%e", "%.0f"}) {
+                const String& s = format(f, x);
+                double expected = 0;
+                sscanf(s.c_str(), "%lg", &expected);
+                testAssert(TextInput::parseNumber(s) == expected);
+            }
+        }
+        testAssert(TextInput::parseNumber("12345678901234567890123") == 12345678901234567890123.0);
+        testAssert(TextInput::parseNumber("0.000000000000000000000000001") == 1e-27);
+        testAssert(TextInput::parseNumber("-0") == 0.0);
+        testAssert(TextInput::parseNumber("1.5f") == 1.5);
+        testAssert(TextInput::parseNumber("0xFF") == 255.0);
+        testAssert(TextInput::parseNumber("-1.#INF00") == -inf());
+        testAssert(isNaN(TextInput::parseNumber("nan")));
+    }
+
+    {
+        // readNumber, readInteger, and readSymbol go through views
+        TextInput ti(TextInput::FROM_STRING, "- 3 + 4 foo(");
+        ti.readSymbol("-");
+        testAssert(ti.readInteger() == 3);
+        try {
+            ti.readNumber();
+            testAssertM(false, "Expected WrongTokenType");
+        } catch (const TextInput::WrongTokenType&) {
+        }
+        ti.readSymbol("+");
+        testAssert(ti.readNumber() == 4);
+        try {
+            ti.readSymbol("bar");
+            testAssertM(false, "Expected WrongSymbol");
+        } catch (const TextInput::WrongSymbol&) {
+        }
+        testAssert(ti.readSymbol() == "foo");
+        ti.readSymbol("(");
+        testAssert(! ti.hasMore());
+    }
+}
+
+
+/** Times tokenizing \a text with owning Tokens and with TokenViews, including parsing
+    every number */
+static void timeTokenize(const String& text, const TextInput::Settings& settings, chrono::nanoseconds& tokenTime, chrono::nanoseconds& viewTime) {
+    Stopwatch stopwatch;
+    double sum[2] = {0, 0};
+
+    stopwatch.tick();
+    {
+        TextInput ti(TextInput::FROM_STRING, text, settings);
+        Token t;
+        for (ti.read(t); t.type() != Token::END; ti.read(t)) {
+            sum[0] += t.number();
+        }
+    }
+    stopwatch.tock();
+    tokenTime = stopwatch.elapsedDuration();
+
+    stopwatch.tick();
+    {
+        TextInput ti(TextInput::FROM_STRING, text, settings);
+        TokenView t;
+        for (ti.read(t); t.type() != Token::END; ti.read(t)) {
+            sum[1] += t.number();
+        }
+    }
+    stopwatch.tock();
+    viewTime = stopwatch.elapsedDuration();
+
+    testAssert(sum[0] == sum[1]);
+}
+
+
+void perfTextInput() {
+    PRINT_SECTION("Performance:: TextInput", "");
+    PRINT_TEXT("Input (MB)", "Token (ms)", "TokenView", "speedup");
+
+    // As in Any::parse
+    TextInput::Settings anySettings;
+    anySettings.otherLineComments = false;
+    anySettings.generateCommentTokens = true;
+    anySettings.singleQuotedStrings = false;
+    anySettings.caseSensitive = false;
+
+    TextInput::Settings glslSettings;
+    glslSettings.generateNewlineTokens = true;
+
+    const String  text[]     = {makeAnyText(50000), makeGLSLText(30000)};
+    const char*   name[]     = {".Any", "GLSL"};
+    const TextInput::Settings* settings[] = {&anySettings, &glslSettings};
+
+    for (int i = 0; i < 2; ++i) {
+        chrono::nanoseconds tokenTime, viewTime;
+        timeTokenize(text[i], *settings[i], tokenTime, viewTime);
+        printLeader(format("%s %.1f", name[i], text[i].size() / 1.0e6).c_str());
+        printDurationColumns<std::milli>(tokenTime, viewTime);
+        printf(" %12.2fx\n", double(tokenTime.count()) / double(max(viewTime.count(), chrono::nanoseconds::rep(1))));
+    }
+}
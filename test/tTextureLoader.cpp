@@ -0,0 +1,118 @@
+/**
+  \file test/tTextureLoader.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2021, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+static const int numTestImages = 6;
+
+static String testImageFilename(int i) {
+    return format("tTextureLoader%d.png", i);
+}
+
+
+/** Waits up to ten seconds for the loader threads to satisfy \a condition. Returns false on timeout. */
+static bool waitForLoader(const std::function<bool(const Texture::LoaderStats&)>& condition) {
+    const RealTime stop = System::time() + 10.0;
+    while (! condition(Texture::loaderStats())) {
+        if (System::time() > stop) {
+            return false;
+        }
+        System::sleep(0.001);
+    }
+    return true;
+}
+
+
+/** Forces every texture, so that the loader is idle and decodes nothing for earlier tests */
+static void forceAllTextures() {
+    Array<shared_ptr<Texture>> textureArray;
+    Texture::getAllTextures(textureArray);
+    for (const shared_ptr<Texture>& texture : textureArray) {
+        texture->openGLID();
+    }
+    Texture::releaseLoaderReferences();
+}
+
+
+/** Checks that the loader decodes the highest-priority queued texture first */
+static void testLoadPriority() {
+    // While one decoded texture awaits upload, no other may begin decoding
+    const Texture::LoaderStats& start = Texture::loaderStats();
+    const shared_ptr<Texture>& blocker = Texture::fromFile(testImageFilename(0));
+    testAssert(waitForLoader([&](const Texture::LoaderStats& s) { return (s.decoded == start.decoded + 1) && (s.decoding == 0); }));
+
+    Array<shared_ptr<Texture>> textureArray;
+    for (int i = 1; i < numTestImages; ++i) {
+        textureArray.append(Texture::fromFile(testImageFilename(i)));
+    }
+    testAssert(Texture::loaderStats().queueDepth == textureArray.size());
+    textureArray.last()->setLoadPriority(1.0f);
+
+    // Uploading the blocker lets exactly one more texture decode
+    blocker->openGLID();
+    testAssert(waitForLoader([&](const Texture::LoaderStats& s) { return (s.decoded == start.decoded + 2) && (s.decoding == 0); }));
+
+    // The high-priority texture was decoded by a loader thread, not by force()
+    const int forcedDecodes = Texture::loaderStats().forcedDecodes;
+    textureArray.last()->openGLID();
+    testAssert(Texture::loaderStats().forcedDecodes == forcedDecodes);
+
+    for (const shared_ptr<Texture>& texture : textureArray) {
+        texture->openGLID();
+    }
+}
+
+
+/** Checks that a decoded texture released by the application is destroyed by releaseLoaderReferences() */
+static void testReleaseLoaderReferences() {
+    const Texture::LoaderStats& start = Texture::loaderStats();
+    shared_ptr<Texture> texture = Texture::fromFile(testImageFilename(0));
+    testAssert(waitForLoader([&](const Texture::LoaderStats& s) { return (s.decoded == start.decoded + 1) && (s.decoding == 0); }));
+
+    const weak_ptr<Texture> weak = texture;
+    texture.reset();
+
+    // The loader thread's reference keeps the texture, and its decoded image, alive
+    testAssert(! weak.expired());
+    testAssert(Texture::loaderStats().pendingDecodedBytes > start.pendingDecodedBytes);
+
+    Texture::releaseLoaderReferences();
+    testAssert(weak.expired());
+    testAssert(Texture::loaderStats().pendingDecodedBytes == start.pendingDecodedBytes);
+}
+
+
+void testTextureLoader() {
+    printf("Texture::Loader ");
+
+    for (int i = 0; i < numTestImages; ++i) {
+        const shared_ptr<Image>& image = Image::create(64, 64, ImageFormat::RGB8());
+        image->setAll(Color3(float(i) / float(numTestImages), 0.5f, 1.0f));
+        image->save(testImageFilename(i));
+    }
+
+    const Texture::LoaderSettings oldSettings = Texture::loaderSettings();
+    Texture::LoaderSettings settings = oldSettings;
+    settings.maxPendingDecodedBytes = 1;
+    settings.memoryBudget = 0;
+    Texture::setLoaderSettings(settings);
+    forceAllTextures();
+
+    testLoadPriority();
+    forceAllTextures();
+    testReleaseLoaderReferences();
+
+    Texture::setLoaderSettings(oldSettings);
+    for (int i = 0; i < numTestImages; ++i) {
+        FileSystem::removeFile(testImageFilename(i));
+    }
+
+    printf("passed\n");
+}
@@ -0,0 +1,491 @@
+/**
+  \file test/tTriTree.cpp
+
+  Ray-tracing throughput benchmark for the TriTree implementations. Run the test
+  executable with --benchmark-tritree to produce TriTreeBenchmark.csv and
+  TriTreeBenchmark.json in the current directory, or with --benchmark-tritree-headless
+  to benchmark only the procedural scenes, which need no OpenGL context.
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include "G3D/G3D.h"
+#include "printhelpers.h"
+#include "testassert.h"
+#include <thread>
+
+namespace {
+
+/** Scenes from the G3D data directory, in increasing order of triangle count */
+const char* benchmarkSceneName[] = {"G3D Simple Cornell Box", "G3D Debug Teapot", "G3D Test Models", "G3D Sponza"};
+
+/** Scenes generated by makeProceduralScene(), which need no files or GPU resources */
+const char* proceduralSceneName[] = {"Procedural Sphere Grid", "Procedural Triangle Soup"};
+
+const int  RAY_WIDTH  = 640;
+const int  RAY_HEIGHT = 360;
+const int  NUM_TRIALS = 3;
+
+class BenchmarkResult {
+public:
+    String      scene;
+    String      implementation;
+    int         numTris = 0;
+
+    /** Seconds for setContents() with the triangles already extracted */
+    RealTime    buildTime = 0;
+
+    /** Tri and CPUVertexArray storage in the tree */
+    size_t      triBytes = 0;
+
+    String      rayType;
+    int         threads = 0;
+    int         numRays = 0;
+
+    /** Best of NUM_TRIALS */
+    RealTime    traceTime = 0;
+    float       hitFraction = 0;
+
+    double mraysPerSecond() const {
+        return (traceTime > 0) ? numRays / (traceTime * 1e6) : 0.0;
+    }
+};
+
+
+shared_ptr<TriTreeBase> createTree(const String& implementation) {
+#   if defined(G3D_X86) && (defined(G3D_WINDOWS) || defined(G3D_LINUX) || defined(G3D_MACOS))
+    if (implementation == "EmbreeTriTree") {
+        return EmbreeTriTree::create();
+    }
+#   endif
+    return NativeTriTree::create();
+}
+
+
+/** One pinhole ray through the center of each pixel of a RAY_WIDTH x RAY_HEIGHT image */
+void makePrimaryRays(const CFrame& cameraFrame, const Projection& projection, Array<Ray>& rays) {
+    const Rect2D viewport = Rect2D::xywh(0, 0, float(RAY_WIDTH), float(RAY_HEIGHT));
+    rays.resize(RAY_WIDTH * RAY_HEIGHT);
+    runConcurrently(Point2int32(0, 0), Point2int32(RAY_WIDTH, RAY_HEIGHT), [&](Point2int32 P) {
+        rays[P.x + P.y * RAY_WIDTH] = cameraFrame.toWorldSpace(projection.ray(P.x + 0.5f, P.y + 0.5f, viewport));
+    });
+}
+
+
+/** Shadow rays toward \a lightPosition and cosine-distributed bounce rays from each primary hit */
+void makeSecondaryRays
+   (const shared_ptr<TriTreeBase>&  tree,
+    const Array<Ray>&               primary,
+    const Array<TriTree::Hit>&      hits,
+    const Point3&                   lightPosition,
+    Array<Ray>&                     shadow,
+    Array<Ray>&                     diffuse) {
+
+    const float epsilon = 1e-4f;
+    Random rng(0x5eed, false);
+    shadow.fastClear();
+    diffuse.fastClear();
+    for (int i = 0; i < hits.size(); ++i) {
+        const TriTree::Hit& hit = hits[i];
+        if (hit.triIndex == TriTree::Hit::NONE) {
+            continue;
+        }
+
+        const Point3& P = primary[i].origin() + primary[i].direction() * hit.distance;
+        Vector3 n = tree->triArray()[hit.triIndex].normal(tree->vertexArray());
+        if (n.dot(primary[i].direction()) > 0.0f) {
+            n = -n;
+        }
+
+        const Point3& origin = P + n * epsilon;
+        const Vector3& toLight = lightPosition - origin;
+        const float distance = toLight.length();
+        shadow.append(Ray(origin, toLight / distance, 0.0f, distance));
+        diffuse.append(Ray(origin, Vector3::cosHemiRandom(n, rng)));
+    }
+}
+
+
+/** Uniformly random origins within the scene bounds and uniformly random directions */
+void makeRandomRays(const AABox& bounds, int count, Array<Ray>& rays) {
+    Random rng(0xbeef, false);
+    rays.resize(count);
+    for (int i = 0; i < count; ++i) {
+        const Point3& P = bounds.low() + bounds.extent() * Vector3(rng.uniform(), rng.uniform(), rng.uniform());
+        rays[i] = Ray(P, Vector3::random(rng));
+    }
+}
+
+
+RealTime timeTrace(const shared_ptr<TriTreeBase>& tree, const Array<Ray>& rays, TriTree::IntersectRayOptions options, int threads, float& hitFraction) {
+    Array<TriTree::Hit> hits;
+    RealTime best = finf();
+    tbb::task_arena arena(threads);
+    for (int trial = 0; trial < NUM_TRIALS; ++trial) {
+        Stopwatch timer;
+        timer.tick();
+        arena.execute([&] { tree->intersectRays(rays, hits, options); });
+        timer.tock();
+        best = min(best, timer.elapsedTime());
+    }
+
+    int numHits = 0;
+    for (const TriTree::Hit& hit : hits) {
+        numHits += (hit.triIndex != TriTree::Hit::NONE) ? 1 : 0;
+    }
+    hitFraction = float(numHits) / float(max(1, hits.size()));
+    return best;
+}
+
+
+/** Benchmarks every implementation on the triangles of one scene */
+void benchmarkTris
+   (const String&                   sceneName,
+    const CPUVertexArray&           vertexArray,
+    const Array<Tri>&               triArray,
+    const CFrame&                   cameraFrame,
+    const Projection&               projection,
+    const Point3&                   lightPosition,
+    const Array<String>&            implementationArray,
+    const Array<int>&               threadCountArray,
+    Array<BenchmarkResult>&         results) {
+
+    AABox bounds;
+    for (const CPUVertexArray::Vertex& v : vertexArray.vertex) {
+        bounds.merge(v.position);
+    }
+
+    for (const String& implementation : implementationArray) {
+        const shared_ptr<TriTreeBase>& tree = createTree(implementation);
+        if (tree->className() != implementation) {
+            // Not available on this platform
+            continue;
+        }
+
+        Stopwatch buildTimer;
+        buildTimer.tick();
+        tree->setContents(triArray, vertexArray);
+        buildTimer.tock();
+
+        // Ray sets use fixed seeds, so every implementation traces the same rays
+        Array<Ray> primary, shadow, diffuse, random;
+        Array<TriTree::Hit> primaryHits;
+        makePrimaryRays(cameraFrame, projection, primary);
+        tree->intersectRays(primary, primaryHits);
+        makeSecondaryRays(tree, primary, primaryHits, lightPosition, shadow, diffuse);
+        makeRandomRays(bounds, primary.size(), random);
+
+        const struct { const char* name; const Array<Ray>* rays; TriTree::IntersectRayOptions options; } rayTypeArray[] = {
+            {"primary", &primary, TriTree::COHERENT_RAY_HINT},
+            {"shadow",  &shadow,  TriTree::OCCLUSION_TEST_ONLY},
+            {"diffuse", &diffuse, 0},
+            {"random",  &random,  0}};
+
+        for (const auto& rayType : rayTypeArray) {
+            for (const int threads : threadCountArray) {
+                BenchmarkResult r;
+                r.scene = sceneName;
+                r.implementation = implementation;
+                r.numTris = triArray.size();
+                r.buildTime = buildTimer.elapsedTime();
+                r.triBytes = CompactTriArray::sizeInBytes(tree->triArray(), tree->vertexArray());
+                r.rayType = rayType.name;
+                r.threads = threads;
+                r.numRays = rayType.rays->size();
+                r.traceTime = timeTrace(tree, *rayType.rays, rayType.options, threads, r.hitFraction);
+                results.append(r);
+
+                printf("%-24s %-14s %-8s %2d threads: %8.2f Mrays/s\n", sceneName.c_str(), implementation.c_str(), rayType.name, threads, r.mraysPerSecond());
+            }
+        }
+    }
+}
+
+
+/** Appends a sphere with \a slices x \a stacks quads, as two triangles each */
+void appendSphere(const Point3& center, float radius, int slices, int stacks, CPUVertexArray& vertexArray, Array<Tri>& triArray) {
+    const int first = vertexArray.size();
+    for (int y = 0; y <= stacks; ++y) {
+        const float phi = pif() * float(y) / float(stacks);
+        for (int x = 0; x < slices; ++x) {
+            const float theta = 2.0f * pif() * float(x) / float(slices);
+            vertexArray.vertex.append(CPUVertexArray::Vertex(center + radius * Vector3(sin(phi) * cos(theta), cos(phi), sin(phi) * sin(theta))));
+        }
+    }
+    for (int y = 0; y < stacks; ++y) {
+        for (int x = 0; x < slices; ++x) {
+            const int a = first + y * slices + x;
+            const int b = first + y * slices + (x + 1) % slices;
+            triArray.append(Tri(a, a + slices, b, vertexArray));
+            triArray.append(Tri(b, a + slices, b + slices, vertexArray));
+        }
+    }
+}
+
+
+/** Generates the triangles of proceduralSceneName[index] from fixed seeds, and a viewpoint
+    and light for them. The sphere grid has the spatial coherence of modeled
+    scenes; the triangle soup has long, overlapping triangles that stress tree building. */
+void makeProceduralScene(int index, CPUVertexArray& vertexArray, Array<Tri>& triArray, CFrame& cameraFrame, Projection& projection, Point3& lightPosition) {
+    vertexArray.clear();
+    triArray.fastClear();
+    Random rng(0x9e0 + index, false);
+
+    if (index == 0) {
+        // 16 x 16 spheres on a ground plane, 262k triangles
+        for (int z = 0; z < 16; ++z) {
+            for (int x = 0; x < 16; ++x) {
+                appendSphere(Point3(float(x) * 3.0f - 22.5f, rng.uniform(0.5f, 1.5f), float(z) * -3.0f), rng.uniform(0.5f, 1.4f), 32, 16, vertexArray, triArray);
+            }
+        }
+        const int first = vertexArray.size();
+        vertexArray.vertex.append(CPUVertexArray::Vertex(Point3(-30, 0, 5)), CPUVertexArray::Vertex(Point3(30, 0, 5)),
+                                  CPUVertexArray::Vertex(Point3(30, 0, -55)), CPUVertexArray::Vertex(Point3(-30, 0, -55)));
+        triArray.append(Tri(first, first + 1, first + 2, vertexArray), Tri(first, first + 2, first + 3, vertexArray));
+    } else {
+        // 100k triangles with random vertices in a 40 m cube
+        for (int t = 0; t < 100000; ++t) {
+            const Point3& center = Point3(rng.uniform(-20, 20), rng.uniform(0, 40), rng.uniform(-45, -5));
+            for (int i = 0; i < 3; ++i) {
+                vertexArray.vertex.append(CPUVertexArray::Vertex(center + Vector3::random(rng) * rng.uniform(0.1f, 2.0f)));
+            }
+            triArray.append(Tri(3 * t, 3 * t + 1, 3 * t + 2, vertexArray));
+        }
+    }
+
+    cameraFrame = CFrame::fromXYZYPRDegrees(0, 12, 12, 0, -25, 0);
+    projection = Projection();
+    projection.setFieldOfView(toRadians(70), FOVDirection::HORIZONTAL);
+    lightPosition = Point3(10, 60, 0);
+}
+
+
+void benchmarkScene(const String& sceneName, const Array<String>& implementationArray, const Array<int>& threadCountArray, Array<BenchmarkResult>& results) {
+    const shared_ptr<Scene>& scene = Scene::create(AmbientOcclusion::create());
+    try {
+        scene->load(sceneName);
+    } catch (...) {
+        printf("Skipping %s: could not load the scene\n", sceneName.c_str());
+        return;
+    }
+
+    Array<shared_ptr<Surface>> surfaceArray;
+    scene->onPose(surfaceArray);
+    CPUVertexArray vertexArray;
+    Array<Tri> triArray;
+    Surface::getTris(surfaceArray, vertexArray, triArray);
+
+    AABox bounds;
+    for (const CPUVertexArray::Vertex& v : vertexArray.vertex) {
+        bounds.merge(v.position);
+    }
+
+    const shared_ptr<Camera>& camera = scene->defaultCamera();
+    Point3 lightPosition = bounds.center() + Vector3(0, bounds.extent().y, 0);
+    if (scene->lightingEnvironment().lightArray.size() > 0) {
+        // Directional lights are at infinity; place them well outside the bounds
+        const Vector4& L = scene->lightingEnvironment().lightArray[0]->position();
+        lightPosition = (L.w != 0.0f) ? L.xyz() / L.w : bounds.center() + L.xyz() * bounds.extent().length();
+    }
+
+    benchmarkTris(sceneName, vertexArray, triArray, camera->frame(), camera->projection(), lightPosition, implementationArray, threadCountArray, results);
+}
+
+
+void writeResults(const Array<BenchmarkResult>& results, const String& csvFilename, const String& jsonFilename) {
+    String csv = "scene,implementation,tris,buildSeconds,triBytes,rayType,threads,rays,traceSeconds,mraysPerSecond,hitFraction\n";
+    String json = "[\n";
+    for (int i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        csv += format("\"%s\",%s,%d,%f,%llu,%s,%d,%d,%f,%f,%f\n",
+            r.scene.c_str(), r.implementation.c_str(), r.numTris, r.buildTime, (unsigned long long)r.triBytes,
+            r.rayType.c_str(), r.threads, r.numRays, r.traceTime, r.mraysPerSecond(), r.hitFraction);
+        json += format("  {\"scene\": \"%s\", \"implementation\": \"%s\", \"tris\": %d, \"buildSeconds\": %f, \"triBytes\": %llu, "
+                       "\"rayType\": \"%s\", \"threads\": %d, \"rays\": %d, \"traceSeconds\": %f, \"mraysPerSecond\": %f, \"hitFraction\": %f}%s\n",
+            r.scene.c_str(), r.implementation.c_str(), r.numTris, r.buildTime, (unsigned long long)r.triBytes,
+            r.rayType.c_str(), r.threads, r.numRays, r.traceTime, r.mraysPerSecond(), r.hitFraction,
+            (i < results.size() - 1) ? "," : "");
+    }
+    json += "]\n";
+
+    writeWholeFile(csvFilename, csv);
+    writeWholeFile(jsonFilename, json);
+    printf("Wrote %s and %s\n", csvFilename.c_str(), jsonFilename.c_str());
+}
+
+} // namespace
+
+
+/** Checks that a NativeTriTree loaded from its cache traces the same hits as a freshly built one,
+    and that empty and truncated cache files are rebuilt instead of read */
+void testTriTreeCache() {
+    printf("NativeTriTree cache ");
+
+    // The cache directory is the current one, so that removeFile() can clean it up
+    const String& pattern = "*.NativeTriTree";
+    FileSystem::removeFile(pattern);
+
+    Random rng(0xcac4e, false);
+    CPUVertexArray vertexArray;
+    Array<Tri> triArray;
+    AABox bounds;
+    for (int t = 0; t < 2000; ++t) {
+        const Point3& center = Point3(rng.uniform(-10, 10), rng.uniform(-10, 10), rng.uniform(-10, 10));
+        for (int i = 0; i < 3; ++i) {
+            vertexArray.vertex.append(CPUVertexArray::Vertex(center + Vector3::random(rng)));
+            bounds.merge(vertexArray.vertex.last().position);
+        }
+        triArray.append(Tri(3 * t, 3 * t + 1, 3 * t + 2, vertexArray));
+    }
+
+    Array<Ray> rays;
+    makeRandomRays(bounds, 10000, rays);
+
+    const shared_ptr<NativeTriTree>& tree = NativeTriTree::create();
+    Array<TriTree::Hit> expected;
+    tree->setContents(triArray, vertexArray);
+    tree->intersectRays(rays, expected);
+
+    const auto testSameHits = [&]() {
+        Array<TriTree::Hit> hits;
+        tree->intersectRays(rays, hits);
+        testAssert(hits.size() == expected.size());
+        for (int i = 0; i < hits.size(); ++i) {
+            testAssert((hits[i].triIndex == expected[i].triIndex) && (hits[i].distance == expected[i].distance));
+        }
+    };
+
+    // Build and save
+    tree->setCacheDirectory(".");
+    tree->setContents(triArray, vertexArray);
+    testSameHits();
+
+    Array<String> files;
+    FileSystem::getFiles(pattern, files);
+    testAssert(files.size() == 1);
+    const String filename = files[0];
+    const int64 fullSize = FileSystem::size(filename);
+    testAssert(fullSize > 0);
+
+    // Reload
+    tree->setContents(triArray, vertexArray);
+    testSameHits();
+
+    // Truncated files, as left by a process killed while saving. The file is binary, so
+    // copy it with BinaryInput rather than readWholeFile(), which stops at the first zero byte.
+    Array<uint8> contents;
+    {
+        BinaryInput in(filename, G3D_LITTLE_ENDIAN);
+        contents.resize(int(in.getLength()));
+        in.readBytes(contents.getCArray(), in.getLength());
+    }
+    testAssert(contents.size() == fullSize);
+    for (const int64 size : {int64(0), int64(10), fullSize / 2, fullSize - 1}) {
+        if (size == 0) {
+            // BinaryOutput refuses to commit an empty file
+            writeWholeFile(filename, "");
+        } else {
+            BinaryOutput out(filename, G3D_LITTLE_ENDIAN);
+            out.writeBytes(contents.getCArray(), size);
+            out.commit();
+        }
+        FileSystem::clearCache();
+        testAssert(FileSystem::size(filename) == size);
+        tree->setContents(triArray, vertexArray);
+        testSameHits();
+
+        // Rebuilding replaced the file
+        FileSystem::clearCache();
+        testAssert(FileSystem::size(filename) == fullSize);
+    }
+
+    FileSystem::removeFile(pattern);
+    printf("passed\n");
+}
+
+
+/** Checks that a compact NativeTriTree traces the same hits as an uncompressed one when many
+    small meshes that are far apart share quantization pages, and that TriTree::operator[]
+    and size() read the compact storage */
+void testCompactTriTree() {
+    printf("NativeTriTree compact storage ");
+
+    // 126 vertices per sphere, so that each CompactTriArray page spans several meshes
+    const int numMeshes = 40;
+    const int slices = 14;
+    const int stacks = 8;
+    CPUVertexArray vertexArray;
+    Array<Tri> triArray;
+    for (int m = 0; m < numMeshes; ++m) {
+        appendSphere(Point3(1000.0f * float(m), 0, 0), 1.0f, slices, stacks, vertexArray, triArray);
+    }
+
+    const shared_ptr<NativeTriTree>& tree = NativeTriTree::create();
+    tree->setContents(triArray, vertexArray);
+    const shared_ptr<NativeTriTree>& compact = NativeTriTree::create();
+    compact->setCompactStorage(true);
+    compact->setContents(triArray, vertexArray);
+    testAssert(compact->compactStorage() && (compact->triArray().size() == 0));
+
+    testAssert(compact->size() == triArray.size());
+    for (int t = 0; t < triArray.size(); ++t) {
+        const Tri& tri = (*compact)[t];
+        for (int i = 0; i < 3; ++i) {
+            testAssert(tri.index[i] == triArray[t].index[i]);
+            testAssert((compact->compactTriArray().position(tri.index[i]) - vertexArray.vertex[tri.index[i]].position).length() < 1e-3f);
+        }
+    }
+
+    Random rng(0xc0ac7, false);
+    for (int m = 0; m < numMeshes; ++m) {
+        for (int r = 0; r < 50; ++r) {
+            const Point3& origin = Point3(1000.0f * float(m) + rng.uniform(-0.5f, 0.5f), rng.uniform(-0.5f, 0.5f), 5.0f);
+            const Ray& ray = Ray::fromOriginAndDirection(origin, Vector3(rng.uniform(-0.05f, 0.05f), rng.uniform(-0.05f, 0.05f), -1.0f).direction());
+            TriTree::Hit expected, hit;
+            testAssert(tree->intersectRay(ray, expected));
+            testAssert(compact->intersectRay(ray, hit));
+            testAssert(fabs(hit.distance - expected.distance) < 1e-3f);
+        }
+    }
+
+    printf("passed\n");
+}
+
+
+/** Benchmarks the procedural scenes and, if \a loadScenes, the data-files scenes as well. Loading
+    a Scene requires an OpenGL context because it creates textures. Empty filenames skip writing results. */
+void perfTriTree(const String& csvFilename, const String& jsonFilename, bool loadScenes) {
+    PRINT_SECTION("Performance: TriTree", "Build time, triangle storage, and Mrays/s for primary, shadow, diffuse, and random rays");
+
+    Array<String> implementationArray("NativeTriTree", "EmbreeTriTree");
+
+    const int maxThreads = max(1, int(std::thread::hardware_concurrency()));
+    Array<int> threadCountArray;
+    for (int t = 1; t < maxThreads; t *= 2) {
+        threadCountArray.append(t);
+    }
+    threadCountArray.append(maxThreads);
+
+    Array<BenchmarkResult> results;
+    for (int i = 0; i < int(sizeof(proceduralSceneName) / sizeof(proceduralSceneName[0])); ++i) {
+        CPUVertexArray vertexArray;
+        Array<Tri> triArray;
+        CFrame cameraFrame;
+        Projection projection;
+        Point3 lightPosition;
+        makeProceduralScene(i, vertexArray, triArray, cameraFrame, projection, lightPosition);
+        benchmarkTris(proceduralSceneName[i], vertexArray, triArray, cameraFrame, projection, lightPosition, implementationArray, threadCountArray, results);
+    }
+
+    if (loadScenes) {
+        for (const char* sceneName : benchmarkSceneName) {
+            benchmarkScene(sceneName, implementationArray, threadCountArray, results);
+        }
+    }
+
+    if (! csvFilename.empty()) {
+        writeResults(results, csvFilename, jsonFilename);
+    }
+}
@@ -0,0 +1,129 @@
+/**
+  \file test/tWelder.cpp
+
+  G3D Innovation Engine http://casual-effects.com/g3d
+  Copyright 2000-2019, Morgan McGuire
+  All rights reserved
+  Available under the BSD License
+*/
+#include <G3D/G3D.h>
+#include "printhelpers.h"
+#include "testassert.h"
+
+/** A wavy height field stored as a triangle soup, as in an STL scan: every triangle has
+    its own three vertices, perturbed by up to \a jitter so that welding must use the radius. */
+static void makeSoup(int gridSize, float jitter, bool texCoords, Array<Vector3>& vertex, Array<Vector2>& texCoord, Array<int>& index) {
+    Random rng(gridSize, false);
+    vertex.fastClear();
+    texCoord.fastClear();
+    index.fastClear();
+
+    const auto point = [&](int x, int z) {
+        const float s = 10.0f / float(gridSize);
+        return Point3(x * s, sin(x * 0.05f) * cos(z * 0.07f), z * s) + Vector3(rng.uniform(), rng.uniform(), rng.uniform()) * jitter;
+    };
+
+    for (int z = 0; z < gridSize; ++z) {
+        for (int x = 0; x < gridSize; ++x) {
+            const int corner[6][2] = {{x, z}, {x, z + 1}, {x + 1, z}, {x + 1, z}, {x, z + 1}, {x + 1, z + 1}};
+            for (int c = 0; c < 6; ++c) {
+                index.append(vertex.size());
+                vertex.append(point(corner[c][0], corner[c][1]));
+                if (texCoords) {
+                    // Texture seam down the middle, so that some collocated vertices must not weld
+                    texCoord.append(Point2(float(corner[c][0] % (gridSize / 2 + 1)), float(corner[c][1])) / float(gridSize));
+                }
+            }
+        }
+    }
+}
+
+
+static void testWelderSettings(int gridSize, float jitter, bool texCoords, const Welder::Settings& settings) {
+    Array<Vector3> serialVertex, serialNormal;
+    Array<Vector2> serialTexCoord;
+    Array<int>     serialIndex;
+    makeSoup(gridSize, jitter, texCoords, serialVertex, serialTexCoord, serialIndex);
+
+    Array<Vector3> vertex(serialVertex), normal;
+    Array<Vector2> texCoord(serialTexCoord);
+    Array<int>     index(serialIndex);
+
+    Welder::weld(serialVertex, serialTexCoord, serialNormal, serialIndex, settings);
+    Welder::weldConcurrently(vertex, texCoord, normal, index, settings);
+
+    testAssert(serialVertex.size() < gridSize * gridSize * 6);
+    testAssert(vertex.size() == serialVertex.size());
+    testAssert(texCoord.size() == serialTexCoord.size());
+    testAssert(index.size() == serialIndex.size());
+    for (int i = 0; i < index.size(); ++i) {
+        testAssert(index[i] == serialIndex[i]);
+    }
+    for (int i = 0; i < vertex.size(); ++i) {
+        testAssert(vertex[i] == serialVertex[i]);
+        testAssertM(normal[i] == serialNormal[i], "Normals must be bit-identical");
+    }
+    for (int i = 0; i < texCoord.size(); ++i) {
+        testAssert(texCoord[i] == serialTexCoord[i]);
+    }
+}
+
+
+void testWelder() {
+    printf("Welder::weldConcurrently ");
+
+    // Default settings
+    testWelderSettings(60, 0.0002f, true, Welder::Settings());
+
+    // Exact matches only, which takes a different normal smoothing path
+    Welder::Settings exact;
+    exact.vertexWeldRadius = 0;
+    testWelderSettings(60, 0, true, exact);
+
+    // No smoothing and no texture coordinates
+    testWelderSettings(60, 0.0002f, false, Welder::Settings(0));
+
+    // Radii that span grid cells
+    Welder::Settings wide;
+    wide.vertexWeldRadius = 0.05f;
+    testWelderSettings(40, 0.02f, true, wide);
+    wide.vertexWeldRadius = 0.15f;
+    wide.normalWeldRadius = 0.5f;
+    testWelderSettings(40, 0.05f, true, wide);
+
+    printf("passed\n");
+}
+
+
+/** \param large Also weld the 10M and 50M vertex soups, which take minutes and several GB of memory */
+void perfWelder(bool large) {
+    PRINT_SECTION("Performance:: Welder", "");
+    PRINT_TEXT("vertices", "weld (ms)", "concurrent", "speedup");
+
+    // Triangle soups of about 1M, 10M, and 50M vertices
+    const int gridSize[] = {409, 1291, 2887};
+    const int numSizes = large ? 3 : 1;
+    for (int g = 0; g < numSizes; ++g) {
+        Array<Vector3> vertex, normal;
+        Array<Vector2> texCoord;
+        Array<int>     index;
+        Stopwatch stopwatch;
+
+        makeSoup(gridSize[g], 0.0002f, true, vertex, texCoord, index);
+        const int numVertices = vertex.size();
+        stopwatch.tick();
+        Welder::weld(vertex, texCoord, normal, index, Welder::Settings());
+        stopwatch.tock();
+        const chrono::nanoseconds serialTime = stopwatch.elapsedDuration();
+
+        makeSoup(gridSize[g], 0.0002f, true, vertex, texCoord, index);
+        stopwatch.tick();
+        Welder::weldConcurrently(vertex, texCoord, normal, index, Welder::Settings());
+        stopwatch.tock();
+        const chrono::nanoseconds concurrentTime = stopwatch.elapsedDuration();
+
+        printLeader(format("%dM", iRound(numVertices / 1.0e6)).c_str());
+        printDurationColumns<std::milli>(serialTime, concurrentTime);
+        printf(" %12.2fx\n", double(serialTime.count()) / double(max(concurrentTime.count(), chrono::nanoseconds::rep(1))));
+    }
+}
@@ -24,6 +24,54 @@ static bool zipfileExistsTest(const String& filename) {
 }
 
 
+/** Single-entry zipfile with no compression */
+static void writeStoredZip(BinaryOutput& b, const String& name, const String& data) {
+	const uint32 crc = Crypto::crc32(data.c_str(), data.size());
+
+	b.writeUInt32(0x04034b50);
+	b.writeUInt16(20);
+	b.writeUInt16(0);
+	b.writeUInt16(0);
+	b.writeUInt32(0);
+	b.writeUInt32(crc);
+	b.writeUInt32(uint32(data.size()));
+	b.writeUInt32(uint32(data.size()));
+	b.writeUInt16(uint16(name.size()));
+	b.writeUInt16(0);
+	b.writeBytes(name.c_str(), name.size());
+	b.writeBytes(data.c_str(), data.size());
+
+	const int64 directoryOffset = b.position();
+	b.writeUInt32(0x02014b50);
+	b.writeUInt16(20);
+	b.writeUInt16(20);
+	b.writeUInt16(0);
+	b.writeUInt16(0);
+	b.writeUInt32(0);
+	b.writeUInt32(crc);
+	b.writeUInt32(uint32(data.size()));
+	b.writeUInt32(uint32(data.size()));
+	b.writeUInt16(uint16(name.size()));
+	b.writeUInt16(0);
+	b.writeUInt16(0);
+	b.writeUInt16(0);
+	b.writeUInt16(0);
+	b.writeUInt32(0);
+	b.writeUInt32(0);
+	b.writeBytes(name.c_str(), name.size());
+	const int64 directorySize = b.position() - directoryOffset;
+
+	b.writeUInt32(0x06054b50);
+	b.writeUInt16(0);
+	b.writeUInt16(0);
+	b.writeUInt16(1);
+	b.writeUInt16(1);
+	b.writeUInt32(uint32(directorySize));
+	b.writeUInt32(uint32(directoryOffset));
+	b.writeUInt16(0);
+}
+
+
 void testZip() {
 	
 	printf("zip API ");
@@ -123,6 +171,61 @@ void testZip() {
 	}
 	testAssertM(zipLength, "Zip fileLength failed.");
 
+	// Cached central directory
+	const shared_ptr<ZipArchive>& archive = FileSystem::zipArchive("apiTest.zip");
+	testAssertM(notNull(archive), "zipArchive failed.");
+	testAssert(FileSystem::zipArchive("apiTest.zip") == archive);
+	testAssert(archive->entries().size() == 3);
+	const ZipArchive::Entry* entry = archive->find("zipTest/folder/TESTCOMPARE.txt");
+	testAssert(notNull(entry) && (entry->size == 69));
+	testAssert(isNull(archive->find("Grawk")));
+	testAssert(isNull(archive->storedData(*entry)));
+
+	// Reads from many threads share the archive
+	const String& expected = readWholeFile("TestDir/Test.txt");
+	const String& zipped = FileSystem::resolve("apiTest.zip/Test.txt");
+	const String& zippedInFolder = FileSystem::resolve("apiTest.zip/zipTest/Folder/TestCompare.txt");
+	testAssert(readWholeFile(zipped) == expected);
+	Array<String> contents;
+	contents.resize(64);
+	runConcurrently(0, contents.size(), [&](int i) {
+		BinaryInput b((i % 2 == 0) ? zipped : zippedInFolder, G3D_LITTLE_ENDIAN);
+		contents[i] = b.readString(b.size());
+	});
+	for (const String& c : contents) {
+		testAssert(c == expected);
+	}
+
+	// Small stored entries are copied, so that readers do not keep the archive mapped.
+	// Large ones are read in place.
+	const String largeContents(size_t(BinaryInput::MEMORY_MAP_MIN_LENGTH), 'x');
+	{
+		BinaryOutput b("stored.zip", G3D_LITTLE_ENDIAN);
+		writeStoredZip(b, "stored.txt", expected);
+		b.commit();
+	}
+	{
+		BinaryOutput b("storedLarge.zip", G3D_LITTLE_ENDIAN);
+		writeStoredZip(b, "stored.txt", largeContents);
+		b.commit();
+	}
+	{
+		const String& stored = FileSystem::resolve("stored.zip/stored.txt");
+		BinaryInput b(stored, G3D_LITTLE_ENDIAN);
+		testAssert(! b.isMemoryMapped());
+		testAssert(b.readString(b.size()) == expected);
+		testAssert(readWholeFile(stored) == expected);
+	}
+	{
+		BinaryInput b(FileSystem::resolve("storedLarge.zip/stored.txt"), G3D_LITTLE_ENDIAN);
+		testAssert(b.isMemoryMapped());
+		testAssert(b.readString(b.size()) == largeContents);
+	}
+	// Release the mappings so that the files can be removed on Windows
+	FileSystem::clearCache();
+	FileSystem::removeFile("stored.zip");
+	FileSystem::removeFile("storedLarge.zip");
+
 
 	printf("passed\n");
 }